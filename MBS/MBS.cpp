@@ -29,6 +29,7 @@
 #include "MBS.hpp"
 #include <vector>
 #include <cmath>
+#include <cctype>
 
 using namespace std;
 using namespace cv;
@@ -37,6 +38,7 @@ using namespace cv;
 #define TOLERANCE 0.01
 #define FRAME_MAX 20
 #define SOBEL_THRESH 0.4
+#define MIN_TILE_DIM 32
 
 MBS::MBS(const Mat& src)
 :mAttMapCount(0)
@@ -73,46 +75,37 @@ Mat MBS::getSaliencyMap()
 }
 
 
-void rasterScan(const Mat& featMap, Mat& map, Mat& lb, Mat& ub)
+// Forward raster scan over rows [r0, r1) and columns [c0, c1)
+// of the map. Each pixel only looks at its left and upper
+// neighbours, so a tile can be scanned once the tiles to its
+// left and above it are finished
+void rasterScan(const Mat& featMap, Mat& map, Mat& lb, Mat& ub, int r0, int r1, int c0, int c1)
 {
-	Size sz = featMap.size();
-	float *pMapup = (float*)map.data + 1;
-	float *pMap = pMapup + sz.width;
-	uchar *pFeatup = featMap.data + 1;
-	uchar *pFeat = pFeatup + sz.width;
-	uchar *pLBup = lb.data + 1;
-	uchar *pLB = pLBup + sz.width;
-	uchar *pUBup = ub.data + 1;
-	uchar *pUB = pUBup + sz.width;
-
-	float mapPrev;
-	float featPrev;
-	uchar lbPrev, ubPrev;
-
 	float lfV, upV;
 	int flag;
-	for (int r = 1; r < sz.height - 1; r++)
+	for (int r = r0; r < r1; r++)
 	{
-		mapPrev = *(pMap - 1);
-		featPrev = *(pFeat - 1);
-		lbPrev = *(pLB - 1);
-		ubPrev = *(pUB - 1);
-
-
-		for (int c = 1; c < sz.width - 1; c++)
+		const uchar *pFeat = featMap.ptr<uchar>(r);
+		float *pMap = map.ptr<float>(r);
+		uchar *pLB = lb.ptr<uchar>(r);
+		uchar *pUB = ub.ptr<uchar>(r);
+		const uchar *pLBup = lb.ptr<uchar>(r - 1);
+		const uchar *pUBup = ub.ptr<uchar>(r - 1);
+
+		for (int c = c0; c < c1; c++)
 		{
-			lfV = MAX(*pFeat, ubPrev) - MIN(*pFeat, lbPrev);//(*pFeat >= lbPrev && *pFeat <= ubPrev) ? mapPrev : mapPrev + abs((float)(*pFeat) - featPrev);
-			upV = MAX(*pFeat, *pUBup) - MIN(*pFeat, *pLBup);//(*pFeat >= *pLBup && *pFeat <= *pUBup) ? *pMapup : *pMapup + abs((float)(*pFeat) - (float)(*pFeatup));
+			lfV = MAX(pFeat[c], pUB[c - 1]) - MIN(pFeat[c], pLB[c - 1]);
+			upV = MAX(pFeat[c], pUBup[c]) - MIN(pFeat[c], pLBup[c]);
 
 			flag = 0;
-			if (lfV < *pMap)
+			if (lfV < pMap[c])
 			{
-				*pMap = lfV;
+				pMap[c] = lfV;
 				flag = 1;
 			}
-			if (upV < *pMap)
+			if (upV < pMap[c])
 			{
-				*pMap = upV;
+				pMap[c] = upV;
 				flag = 2;
 			}
 
@@ -121,73 +114,48 @@ void rasterScan(const Mat& featMap, Mat& map, Mat& lb, Mat& ub)
 			case 0:		// no update
 				break;
 			case 1:		// update from left
-				*pLB = MIN(*pFeat, lbPrev);
-				*pUB = MAX(*pFeat, ubPrev);
+				pLB[c] = MIN(pFeat[c], pLB[c - 1]);
+				pUB[c] = MAX(pFeat[c], pUB[c - 1]);
 				break;
 			case 2:		// update from up
-				*pLB = MIN(*pFeat, *pLBup);
-				*pUB = MAX(*pFeat, *pUBup);
+				pLB[c] = MIN(pFeat[c], pLBup[c]);
+				pUB[c] = MAX(pFeat[c], pUBup[c]);
 				break;
 			default:
 				break;
 			}
-
-			mapPrev = *pMap;
-			pMap++; pMapup++;
-			featPrev = *pFeat;
-			pFeat++; pFeatup++;
-			lbPrev = *pLB;
-			pLB++; pLBup++;
-			ubPrev = *pUB;
-			pUB++; pUBup++;
 		}
-		pMapup += 2; pMap += 2;
-		pFeat += 2; pFeatup += 2;
-		pLBup += 2; pLB += 2;
-		pUBup += 2; pUB += 2;
 	}
 }
 
-void invRasterScan(const Mat& featMap, Mat& map, Mat& lb, Mat& ub)
+// Same going backwards, looking at right and lower neighbours
+void invRasterScan(const Mat& featMap, Mat& map, Mat& lb, Mat& ub, int r0, int r1, int c0, int c1)
 {
-	Size sz = featMap.size();
-	int datalen = sz.width*sz.height;
-	float *pMapdn = (float*)map.data + datalen - 2;
-	float *pMap = pMapdn - sz.width;
-	uchar *pFeatdn = featMap.data + datalen - 2;
-	uchar *pFeat = pFeatdn - sz.width;
-	uchar *pLBdn = lb.data + datalen - 2;
-	uchar *pLB = pLBdn - sz.width;
-	uchar *pUBdn = ub.data + datalen - 2;
-	uchar *pUB = pUBdn - sz.width;
-	
-	float mapPrev;
-	float featPrev;
-	uchar lbPrev, ubPrev;
-
 	float rtV, dnV;
 	int flag;
-	for (int r = 1; r < sz.height - 1; r++)
+	for (int r = r1 - 1; r >= r0; r--)
 	{
-		mapPrev = *(pMap + 1);
-		featPrev = *(pFeat + 1);
-		lbPrev = *(pLB + 1);
-		ubPrev = *(pUB + 1);
-
-		for (int c = 1; c < sz.width - 1; c++)
+		const uchar *pFeat = featMap.ptr<uchar>(r);
+		float *pMap = map.ptr<float>(r);
+		uchar *pLB = lb.ptr<uchar>(r);
+		uchar *pUB = ub.ptr<uchar>(r);
+		const uchar *pLBdn = lb.ptr<uchar>(r + 1);
+		const uchar *pUBdn = ub.ptr<uchar>(r + 1);
+
+		for (int c = c1 - 1; c >= c0; c--)
 		{
-			rtV = MAX(*pFeat, ubPrev) - MIN(*pFeat, lbPrev);//(*pFeat >= lbPrev && *pFeat <= ubPrev) ? mapPrev : mapPrev + abs((float)(*pFeat) - featPrev);
-			dnV = MAX(*pFeat, *pUBdn) - MIN(*pFeat, *pLBdn);//(*pFeat >= *pLBdn && *pFeat <= *pUBdn) ? *pMapdn : *pMapdn + abs((float)(*pFeat) - (float)(*pFeatdn));
+			rtV = MAX(pFeat[c], pUB[c + 1]) - MIN(pFeat[c], pLB[c + 1]);
+			dnV = MAX(pFeat[c], pUBdn[c]) - MIN(pFeat[c], pLBdn[c]);
 
 			flag = 0;
-			if (rtV < *pMap)
+			if (rtV < pMap[c])
 			{
-				*pMap = rtV;
+				pMap[c] = rtV;
 				flag = 1;
 			}
-			if (dnV < *pMap)
+			if (dnV < pMap[c])
 			{
-				*pMap = dnV;
+				pMap[c] = dnV;
 				flag = 2;
 			}
 
@@ -196,61 +164,128 @@ void invRasterScan(const Mat& featMap, Mat& map, Mat& lb, Mat& ub)
 			case 0:		// no update
 				break;
 			case 1:		// update from right
-				*pLB = MIN(*pFeat, lbPrev);
-				*pUB = MAX(*pFeat, ubPrev);
+				pLB[c] = MIN(pFeat[c], pLB[c + 1]);
+				pUB[c] = MAX(pFeat[c], pUB[c + 1]);
 				break;
 			case 2:		// update from down
-				*pLB = MIN(*pFeat, *pLBdn);
-				*pUB = MAX(*pFeat, *pUBdn);
+				pLB[c] = MIN(pFeat[c], pLBdn[c]);
+				pUB[c] = MAX(pFeat[c], pUBdn[c]);
 				break;
 			default:
 				break;
 			}
-
-			mapPrev = *pMap;
-			pMap--; pMapdn--;
-			featPrev = *pFeat;
-			pFeat--; pFeatdn--;
-			lbPrev = *pLB;
-			pLB--; pLBdn--;
-			ubPrev = *pUB;
-			pUB--; pUBdn--;
 		}
+	}
+}
 
+// Scans every tile on one anti-diagonal of the tile grid, for
+// every channel. Tiles on the same diagonal don't touch any of
+// the pixels the others read, so they can run in parallel. A
+// forward scan goes through the diagonals top left to bottom
+// right, an inverse scan the other way
+class MBSScanBody : public ParallelLoopBody
+{
+public:
+	MBSScanBody(const vector<Mat>& featureMaps, vector<Mat>& maps, vector<Mat>& lb, vector<Mat>& ub,
+			int rowTiles, int colTiles, int diag, bool inverse)
+		: mFeatureMaps(featureMaps), mMaps(maps), mLB(lb), mUB(ub),
+		mRowTiles(rowTiles), mColTiles(colTiles), mDiag(diag), mInverse(inverse)
+	{
+		mFirstRow = MAX(0, diag - (colTiles - 1));
+		mDiagTiles = MIN(diag, rowTiles - 1) - mFirstRow + 1;
+	}
 
-		pMapdn -= 2; pMap -= 2;
-		pFeatdn -= 2; pFeat -= 2;
-		pLBdn -= 2; pLB -= 2;
-		pUBdn -= 2; pUB -= 2;
+	int tasks() const { return mDiagTiles * (int)mFeatureMaps.size(); }
+
+	void operator()(const Range& range) const
+	{
+		// Scans cover the interior, leaving a 1 pixel border
+		const int h = mFeatureMaps[0].rows - 2;
+		const int w = mFeatureMaps[0].cols - 2;
+		for (int t = range.start; t < range.end; t++)
+		{
+			const int ch = t / mDiagTiles;
+			const int ty = mFirstRow + t % mDiagTiles;
+			const int tx = mDiag - ty;
+			const int r0 = 1 + ty * h / mRowTiles;
+			const int r1 = 1 + (ty + 1) * h / mRowTiles;
+			const int c0 = 1 + tx * w / mColTiles;
+			const int c1 = 1 + (tx + 1) * w / mColTiles;
+			if (mInverse)
+				invRasterScan(mFeatureMaps[ch], mMaps[ch], mLB[ch], mUB[ch], r0, r1, c0, c1);
+			else
+				rasterScan(mFeatureMaps[ch], mMaps[ch], mLB[ch], mUB[ch], r0, r1, c0, c1);
+		}
 	}
-}
 
-cv::Mat fastMBS(const std::vector<cv::Mat> featureMaps)
+private:
+	const vector<Mat>& mFeatureMaps;
+	vector<Mat>& mMaps;
+	vector<Mat>& mLB;
+	vector<Mat>& mUB;
+	int mRowTiles;
+	int mColTiles;
+	int mDiag;
+	bool mInverse;
+	int mFirstRow;
+	int mDiagTiles;
+};
+
+const Mat& FastMBS::compute(const std::vector<cv::Mat>& featureMaps)
 {
 	assert(featureMaps[0].type() == CV_8UC1);
 
 	Size sz = featureMaps[0].size();
-	Mat ret = Mat::zeros(sz, CV_32FC1);
+	const int channels = (int)featureMaps.size();
+	mResult.create(sz, CV_32FC1);
+	mResult.setTo(Scalar(0));
 	if (sz.width < 3 || sz.height < 3)
-		return ret;
+		return mResult;
 
-	for (int i = 0; i < featureMaps.size(); i++)
+	mMaps.resize(channels);
+	mLB.resize(channels);
+	mUB.resize(channels);
+	for (int i = 0; i < channels; i++)
 	{
-		Mat map = Mat::zeros(sz, CV_32FC1);
-		Mat mapROI(map, Rect(1, 1, sz.width - 2, sz.height - 2));
+		mMaps[i].create(sz, CV_32FC1);
+		mMaps[i].setTo(Scalar(0));
+		Mat mapROI(mMaps[i], Rect(1, 1, sz.width - 2, sz.height - 2));
 		mapROI.setTo(Scalar(100000));
-		Mat lb = featureMaps[i].clone();
-		Mat ub = featureMaps[i].clone();
+		featureMaps[i].copyTo(mLB[i]);
+		featureMaps[i].copyTo(mUB[i]);
+	}
 
-		rasterScan(featureMaps[i], map, lb, ub);
-		invRasterScan(featureMaps[i], map, lb, ub);
-		rasterScan(featureMaps[i], map, lb, ub);
-		
-		ret += map;
+	// Channels are independent, so they're the first thing
+	// to run in parallel. Only split them into tiles if
+	// there are more cores than that. Using more rows of
+	// tiles than columns keeps the wavefront wide for more
+	// of the scan
+	const int threads = MAX(getNumThreads(), 1);
+	const int colTiles = MAX(1, MIN((threads + channels - 1) / channels, (sz.width - 2) / MIN_TILE_DIM));
+	const int rowTiles = (colTiles == 1) ? 1 : MAX(1, MIN(4 * colTiles, (sz.height - 2) / MIN_TILE_DIM));
+	const int diags = rowTiles + colTiles - 1;
+
+	for (int pass = 0; pass < 3; pass++)
+	{
+		const bool inverse = (pass == 1);
+		for (int d = 0; d < diags; d++)
+		{
+			MBSScanBody body(featureMaps, mMaps, mLB, mUB, rowTiles, colTiles,
+					inverse ? (diags - 1 - d) : d, inverse);
+			parallel_for_(Range(0, body.tasks()), body);
+		}
 	}
 
-	return ret;
-	
+	for (int i = 0; i < channels; i++)
+		mResult += mMaps[i];
+
+	return mResult;
+}
+
+cv::Mat fastMBS(const std::vector<cv::Mat> featureMaps)
+{
+	FastMBS mbs;
+	return mbs.compute(featureMaps);
 }
 
 float getThreshForGeo(const Mat& src)
@@ -525,6 +560,64 @@ Mat doWork(
 	return result;
 }
 
+MBSStream::MBSStream(bool use_lab, int maxDim)
+: mUseLab(use_lab), mMaxDim(maxDim)
+{
+}
+
+const Mat& MBSStream::process(const Mat& frame)
+{
+	// Shrink to the working size. Use a separate buffer rather
+	// than pointing mSmall at frame, otherwise a later resize
+	// into mSmall would write over the caller's image
+	const Mat* src = &frame;
+	const int maxD = MAX(frame.cols, frame.rows);
+	if (maxD > mMaxDim)
+	{
+		resize(frame, mSmall, Size(frame.cols * mMaxDim / maxD, frame.rows * mMaxDim / maxD), 0.0, 0.0, INTER_AREA);
+		src = &mSmall;
+	}
+	if (mUseLab)
+	{
+		cvtColor(*src, mLab, CV_RGB2Lab);
+		src = &mLab;
+	}
+
+	split(*src, mChannels);
+	mFeatureMaps.resize(mChannels.size());
+	for (size_t i = 0; i < mChannels.size(); i++)
+		medianBlur(mChannels[i], mFeatureMaps[i], 5);
+
+	normalize(mMBS.compute(mFeatureMaps), mSaliency, 0.0, 1.0, NORM_MINMAX);
+	resize(mSaliency, mResult, frame.size());
+	return mResult;
+}
+
+// Run saliency on each frame of a video or camera, showing
+// the result and how fast it is going
+int doStream(VideoCapture& cap, bool use_lab)
+{
+	MBSStream mbs(use_lab, MAX_IMG_DIM);
+	Mat frame;
+	int frames = 0;
+	double total = 0;
+	while (cap.read(frame))
+	{
+		const int64 start = getTickCount();
+		const Mat& dst = mbs.process(frame);
+		total += (getTickCount() - start) / getTickFrequency();
+		if (++frames % 30 == 0)
+			cout << frames << " frames, " << frames / total << " FPS" << endl;
+
+		imshow("SRC", frame);
+		imshow("DST", dst);
+		if ((waitKey(1) & 0xFF) == 27)
+			break;
+	}
+	if (frames)
+		cout << frames << " frames, " << frames / total << " FPS" << endl;
+	return 0;
+}
 
 /**
  * Main entry called from Matlab
@@ -537,15 +630,35 @@ int main(int argc, char **argv)
 {
     // Check the number of arguments
     if (argc < 2)
+    {
         cerr << "mexopencv:error Wrong number of arguments";
+        return 1;
+    }
     
     // Decide second arguments
     bool use_geodesic = false;
     bool use_lab = true;
     bool remove_border = true;
     
-    // Apply
+    // Anything which isn't an image is treated as a
+    // video file or camera number and run frame by frame
     Mat src = imread(argv[1]);
+    if (src.empty())
+    {
+        VideoCapture cap;
+        if (isdigit(argv[1][0]) && (argv[1][1] == '\0'))
+            cap.open(argv[1][0] - '0');
+        else
+            cap.open(argv[1]);
+        if (!cap.isOpened())
+        {
+            cerr << "Could not open " << argv[1] << endl;
+            return 1;
+        }
+        return doStream(cap, use_lab);
+    }
+
+    // Apply
 	pyrDown(src, src);
     Mat dst = doWork(src, use_lab, remove_border, use_geodesic);
 	pyrDown(src, src);
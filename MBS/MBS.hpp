@@ -54,6 +54,47 @@ private:
 	void computeBorderPriorMap(float reg, float marginRatio);
 };
 
+// fastMBS with its buffers kept between calls, so running it
+// on a stream of same sized frames doesn't allocate. Channels
+// are scanned in parallel, and when there are more cores than
+// channels each channel is also split into tiles scanned in
+// anti-diagonal wavefronts
+class FastMBS
+{
+public:
+	// Result is overwritten by the next call
+	const cv::Mat& compute(const std::vector<cv::Mat>& featureMaps);
+private:
+	std::vector<cv::Mat> mMaps;
+	std::vector<cv::Mat> mLB;
+	std::vector<cv::Mat> mUB;
+	cv::Mat mResult;
+};
+
+// Saliency for consecutive video frames. Each frame is shrunk
+// so its larger side is maxDim pixels, the size the paper's
+// timings are for, then run through the same steps as a
+// still image minus the border removal. All intermediate
+// images are reused from frame to frame
+class MBSStream
+{
+public:
+	MBSStream(bool use_lab = true, int maxDim = 300);
+	// CV_32FC1 saliency in [0,1] at the size of frame.
+	// Overwritten by the next call
+	const cv::Mat& process(const cv::Mat& frame);
+private:
+	bool mUseLab;
+	int mMaxDim;
+	cv::Mat mSmall;
+	cv::Mat mLab;
+	std::vector<cv::Mat> mChannels;
+	std::vector<cv::Mat> mFeatureMaps;
+	FastMBS mMBS;
+	cv::Mat mSaliency;
+	cv::Mat mResult;
+};
+
 cv::Mat computeCWS(const cv::Mat src, float reg, float marginRatio);
 cv::Mat fastMBS(const std::vector<cv::Mat> featureMaps);
 cv::Mat fastGeodesic(const std::vector<cv::Mat> featureMaps);
@@ -138,7 +138,8 @@ void cvShowVecSamples( const char* filename, int winwidth, int winheight, double
  * nneg             - number of negative samples used in training of each stage
  * nstages          - number of stages
  * numprecalculated - number of features being precalculated. Each precalculated feature
- *   requires (number_of_samples*(sizeof( float ) + sizeof( short ))) bytes of memory
+ *   requires (number_of_samples*(sizeof( float ) + sizeof( short ))) bytes of memory,
+ *   sizeof( int ) instead of sizeof( short ) for more than SHRT_MAX samples
  * numsplits        - number of binary splits in each weak classifier
  *   1 - stumps, 2 and more - trees.
  * minhitrate       - desired min hit rate of each stage
@@ -160,6 +161,12 @@ void cvShowVecSamples( const char* filename, int winwidth, int winheight, double
  *   0 - misclassification error
  *   1 - gini error
  *   2 - entropy error
+ * quantizecache    - if not 0 precalculated feature values are stored as 16 bit
+ *   (sizeof( short ) instead of sizeof( float ) above), each feature scaled to its
+ *   own range
+ * cachefile        - if not NULL precalculated values and indices are kept in a
+ *   memory mapped temporary file of this name rather than in memory, so they can
+ *   be bigger than physical memory. Not supported on Windows
  */
 void cvCreateCascadeClassifier( const char* dirname,
                                 const char* vecfilename,
@@ -172,7 +179,8 @@ void cvCreateCascadeClassifier( const char* dirname,
                                 int mode = 0, int symmetric = 1,
                                 int equalweights = 1,
                                 int winwidth = 24, int winheight = 24,
-                                int boosttype = 3, int stumperror = 0 );
+                                int boosttype = 3, int stumperror = 0,
+                                int quantizecache = 0, const char* cachefile = NULL );
 
 void cvCreateTreeCascadeClassifier( const char* dirname,
                                     const char* vecfilename,
@@ -186,6 +194,7 @@ void cvCreateTreeCascadeClassifier( const char* dirname,
                                     int equalweights,
                                     int winwidth, int winheight,
                                     int boosttype, int stumperror,
-                                    int maxtreesplits, int minpos );
+                                    int maxtreesplits, int minpos,
+                                    int quantizecache = 0, const char* cachefile = NULL );
 
 #endif /* _CVHAARTRAINING_H_ */
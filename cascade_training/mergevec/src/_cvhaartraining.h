@@ -167,7 +167,19 @@ typedef struct CvHaarTrainingData
     CvMat  weights;     /* weights */
 
     CvMat* valcache;    /* precalculated feature values (CV_32FC1) */
-    CvMat* idxcache;    /* presorted indices (CV_IDX_MAT_TYPE) */
+    CvMat* idxcache;    /* presorted indices (CV_IDX_MAT_TYPE, or CV_32SC1 for
+                           more than SHRT_MAX samples) */
+
+    /* If quantizecache is set feature values are stored in qvalcache instead of
+     * valcache and restored as offset + q * step using qscale */
+    int    quantizecache;
+    CvMat* qvalcache;   /* quantized feature values, a row per feature (CV_16UC1) */
+    CvMat* qscale;      /* per feature offset and step (CV_32FC2) */
+
+    /* If cachefile is set the caches are mapped from that file, not allocated */
+    const char* cachefile;
+    void*  cachemap;
+    size_t cachemapsize;
 } CvHaarTrainigData;
 
 
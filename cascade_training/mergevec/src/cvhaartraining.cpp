@@ -54,6 +54,17 @@
 #include <highgui.h>
 #include <limits.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif /* _WIN32 */
+
+/* cxmisc.h isn't included, so match its allocator alignment here */
+#ifndef CV_MALLOC_ALIGN
+#define CV_MALLOC_ALIGN 32
+#endif
+
 #ifdef CV_VERBOSE
 #include <time.h>
 
@@ -497,6 +508,12 @@ CvHaarTrainigData* icvCreateHaarTrainingData( CvSize winsize, int maxnumsamples
 
     data->valcache = NULL;
     data->idxcache = NULL;
+    data->quantizecache = 0;
+    data->qvalcache = NULL;
+    data->qscale = NULL;
+    data->cachefile = NULL;
+    data->cachemap = NULL;
+    data->cachemapsize = 0;
 
     __END__;
 
@@ -518,6 +535,25 @@ void icvReleaseHaarTrainingDataCache( CvHaarTrainigData** haarTrainingData )
             cvReleaseMat( &(*haarTrainingData)->idxcache );
             (*haarTrainingData)->idxcache = NULL;
         }
+        if( (*haarTrainingData)->qvalcache != NULL )
+        {
+            cvReleaseMat( &(*haarTrainingData)->qvalcache );
+            (*haarTrainingData)->qvalcache = NULL;
+        }
+        if( (*haarTrainingData)->qscale != NULL )
+        {
+            cvReleaseMat( &(*haarTrainingData)->qscale );
+            (*haarTrainingData)->qscale = NULL;
+        }
+#ifndef _WIN32
+        /* the matrices above were only headers over the mapping */
+        if( (*haarTrainingData)->cachemap != NULL )
+        {
+            munmap( (*haarTrainingData)->cachemap, (*haarTrainingData)->cachemapsize );
+            (*haarTrainingData)->cachemap = NULL;
+            (*haarTrainingData)->cachemapsize = 0;
+        }
+#endif /* _WIN32 */
     }
 }
 
@@ -538,8 +574,10 @@ void icvGetTrainingDataCallback( CvMat* mat, CvMat* sampleIdx, CvMat*,
 {
     int i = 0;
     int j = 0;
+    int cached = 0;
     float val = 0.0F;
     float normfactor = 0.0F;
+    float* qscale = NULL;
     
     CvHaarTrainingData* training_data;
     CvIntHaarFeatures* haar_features;
@@ -552,6 +590,15 @@ void icvGetTrainingDataCallback( CvMat* mat, CvMat* sampleIdx, CvMat*,
 
     training_data = ((CvUserdata*) userdata)->trainingData;
     haar_features = ((CvUserdata*) userdata)->haarFeatures;
+
+    /* the first <cached> features are restored from the quantized cache,
+       the rest are evaluated */
+    if( training_data->qvalcache != NULL && first < training_data->qvalcache->rows )
+    {
+        cached = MIN( num, training_data->qvalcache->rows - first );
+        qscale = training_data->qscale->data.fl + 2 * first;
+    }
+
     if( sampleIdx == NULL )
     {
         int num_samples;
@@ -565,15 +612,23 @@ void icvGetTrainingDataCallback( CvMat* mat, CvMat* sampleIdx, CvMat*,
         {
             for( j = 0; j < num; j++ )
             {
-                val = cvEvalFastHaarFeature(
-                        ( haar_features->fastfeature
-                            + first + j ),
-                        (sum_type*) (training_data->sum.data.ptr
-                            + i * training_data->sum.step),
-                        (sum_type*) (training_data->tilted.data.ptr
-                            + i * training_data->tilted.step) );
-                normfactor = training_data->normfactor.data.fl[i];
-                val = ( normfactor == 0.0F ) ? 0.0F : (val / normfactor);
+                if( j < cached )
+                {
+                    val = qscale[2 * j] + qscale[2 * j + 1] *
+                        CV_MAT_ELEM( *training_data->qvalcache, ushort, first + j, i );
+                }
+                else
+                {
+                    val = cvEvalFastHaarFeature(
+                            ( haar_features->fastfeature
+                                + first + j ),
+                            (sum_type*) (training_data->sum.data.ptr
+                                + i * training_data->sum.step),
+                            (sum_type*) (training_data->tilted.data.ptr
+                                + i * training_data->tilted.step) );
+                    normfactor = training_data->normfactor.data.fl[i];
+                    val = ( normfactor == 0.0F ) ? 0.0F : (val / normfactor);
+                }
 
 #ifdef CV_COL_ARRANGEMENT
                 CV_MAT_ELEM( *mat, float, j, i ) = val;
@@ -609,15 +664,23 @@ void icvGetTrainingDataCallback( CvMat* mat, CvMat* sampleIdx, CvMat*,
             for( j = 0; j < num; j++ )
             {
                 idx = (int)( *((float*) (idxdata + i * step)) );
-                val = cvEvalFastHaarFeature(
-                        ( haar_features->fastfeature
-                            + first + j ),
-                        (sum_type*) (training_data->sum.data.ptr
-                            + idx * training_data->sum.step),
-                        (sum_type*) (training_data->tilted.data.ptr
-                            + idx * training_data->tilted.step) );
-                normfactor = training_data->normfactor.data.fl[idx];
-                val = ( normfactor == 0.0F ) ? 0.0F : (val / normfactor);
+                if( j < cached )
+                {
+                    val = qscale[2 * j] + qscale[2 * j + 1] *
+                        CV_MAT_ELEM( *training_data->qvalcache, ushort, first + j, idx );
+                }
+                else
+                {
+                    val = cvEvalFastHaarFeature(
+                            ( haar_features->fastfeature
+                                + first + j ),
+                            (sum_type*) (training_data->sum.data.ptr
+                                + idx * training_data->sum.step),
+                            (sum_type*) (training_data->tilted.data.ptr
+                                + idx * training_data->tilted.step) );
+                    normfactor = training_data->normfactor.data.fl[idx];
+                    val = ( normfactor == 0.0F ) ? 0.0F : (val / normfactor);
+                }
 
 #ifdef CV_COL_ARRANGEMENT
                 CV_MAT_ELEM( *mat, float, j, idx ) = val;
@@ -638,10 +701,162 @@ void icvGetTrainingDataCallback( CvMat* mat, CvMat* sampleIdx, CvMat*,
 #endif /* CV_VERBOSE */
 }
 
+/*
+ * icvRadixSortIndices
+ *
+ * Stable LSD radix sort of the indices 0..n-1 by keys[], a byte per pass.
+ * Passes over a byte which is the same in every key are skipped
+ *
+ * keys    - sort keys, compared as unsigned integers
+ * n       - number of keys
+ * keybits - number of low bits of the keys used
+ * idx     - output sorted indices
+ * tmp     - work buffer of n elements
+ */
+static
+void icvRadixSortIndices( const unsigned int* keys, int n, int keybits,
+                          int* idx, int* tmp )
+{
+    int count[256];
+    int* src = idx;
+    int* dst = tmp;
+    int* swap = NULL;
+    int shift = 0;
+    int pos = 0;
+    int c = 0;
+    int i = 0;
+
+    for( i = 0; i < n; i++ )
+    {
+        src[i] = i;
+    }
+    if( n <= 1 )
+    {
+        return;
+    }
+
+    for( shift = 0; shift < keybits; shift += 8 )
+    {
+        memset( count, 0, sizeof( count ) );
+        for( i = 0; i < n; i++ )
+        {
+            count[(keys[i] >> shift) & 0xFF]++;
+        }
+        if( count[(keys[0] >> shift) & 0xFF] == n )
+        {
+            continue;
+        }
+        for( i = 0, pos = 0; i < 256; i++ )
+        {
+            c = count[i];
+            count[i] = pos;
+            pos += c;
+        }
+        for( i = 0; i < n; i++ )
+        {
+            dst[count[(keys[src[i]] >> shift) & 0xFF]++] = src[i];
+        }
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if( src != idx )
+    {
+        memcpy( idx, src, sizeof( int ) * n );
+    }
+}
+
+/* maps float to unsigned int keeping the order */
+CV_INLINE unsigned int icvFloatSortKey( float val )
+{
+    Cv32suf v;
+
+    v.f = val;
+
+    return ( v.u & 0x80000000U ) ? ~v.u : (v.u | 0x80000000U);
+}
+
+/*
+ * icvSortPrecalculatedFeature
+ *
+ * Fill presorted indices of one precalculated feature
+ *
+ * val     - feature values of all m samples
+ * qval    - if not NULL, quantized values are stored here and sorted instead of val
+ * qscale  - offset and step of the quantized values, qval = (val - offset) / step
+ * idx     - output sorted indices of type idxtype (CV_16SC1 or CV_32SC1)
+ * keys, order, tmp - work buffers of m elements
+ */
+static
+void icvSortPrecalculatedFeature( const float* val, int m,
+                                  ushort* qval, float* qscale,
+                                  uchar* idx, int idxtype,
+                                  unsigned int* keys, int* order, int* tmp )
+{
+    int i = 0;
+    int q = 0;
+    int keybits = 32;
+    float minval = 0.0F;
+    float maxval = 0.0F;
+    float step = 0.0F;
+
+    if( qval != NULL )
+    {
+        minval = maxval = val[0];
+        for( i = 1; i < m; i++ )
+        {
+            minval = MIN( minval, val[i] );
+            maxval = MAX( maxval, val[i] );
+        }
+        step = (maxval - minval) / USHRT_MAX;
+        for( i = 0; i < m; i++ )
+        {
+            q = ( step > 0.0F ) ? cvRound( (val[i] - minval) / step ) : 0;
+            qval[i] = (ushort) MIN( MAX( q, 0 ), USHRT_MAX );
+            keys[i] = qval[i];
+        }
+        qscale[0] = minval;
+        qscale[1] = step;
+        keybits = 16;
+    }
+    else
+    {
+        for( i = 0; i < m; i++ )
+        {
+            keys[i] = icvFloatSortKey( val[i] );
+        }
+    }
+
+    icvRadixSortIndices( keys, m, keybits, order, tmp );
+
+    if( idxtype == CV_32SC1 )
+    {
+        memcpy( idx, order, sizeof( int ) * m );
+    }
+    else
+    {
+        for( i = 0; i < m; i++ )
+        {
+            ((short*) idx)[i] = (short) order[i];
+        }
+    }
+}
+
+/*
+ * icvPrecalculate
+ *
+ * Calculate values of the first <numprecalculated> features for all samples and
+ * presort them. Values are kept as floats in data->valcache, or if
+ * data->quantizecache is set as 16 bit in data->qvalcache, restored by
+ * icvGetTrainingDataCallback. If data->cachefile is set the caches live in
+ * a memory mapped file instead of allocated memory
+ */
 static
 void icvPrecalculate( CvHaarTrainingData* data, CvIntHaarFeatures* haarFeatures,
                       int numprecalculated )
 {
+    CvMat* qvalcache = NULL;
+
     CV_FUNCNAME( "icvPrecalculate" );
 
     __BEGIN__;
@@ -654,59 +869,153 @@ void icvPrecalculate( CvHaarTrainingData* data, CvIntHaarFeatures* haarFeatures,
     if( numprecalculated > 0 )
     {
         int portion = CV_STUMP_TRAIN_PORTION;
-        int idx = 0;
-        //size_t datasize;
         int m;
+        int idxtype;
+        int valtype;
+        int first;
+        size_t valsize;
+        size_t idxsize;
+        CvMat* valcache = NULL;
         CvUserdata userdata;
 
         /* private variables */
-        #ifdef _OPENMP
         CvMat t_data;
-        CvMat t_idx;
-        int first;
+        CvMat* t_values;
+        uchar* t_buf;
+        float* t_val;
         int t_portion;
-        #endif /* _OPENMP */
+        int i;
+        int j;
 
         m = data->sum.rows;
 
+        /* short indices can't address more than SHRT_MAX samples */
+        idxtype = ( m > SHRT_MAX ) ? CV_32SC1 : CV_IDX_MAT_TYPE;
+        valtype = ( data->quantizecache ) ? CV_16UC1 : CV_32FC1;
+        valsize = (size_t) numprecalculated * m * CV_ELEM_SIZE( valtype );
+        idxsize = (size_t) numprecalculated * m * CV_ELEM_SIZE( idxtype );
+
+        if( data->quantizecache )
+        {
+            /* always a row per feature, whatever the arrangement of valcache.
+               Not set in data until done, so the callback evaluates features */
+            CV_CALL( valcache = cvCreateMatHeader( numprecalculated, m, valtype ) );
+            qvalcache = valcache;
+            CV_CALL( data->qscale = cvCreateMat( numprecalculated, 1, CV_32FC2 ) );
+        }
+        else
+        {
 #ifdef CV_COL_ARRANGEMENT
-        CV_CALL( data->valcache = cvCreateMat( numprecalculated, m, CV_32FC1 ) );
+            CV_CALL( valcache = cvCreateMatHeader( numprecalculated, m, valtype ) );
 #else
-        CV_CALL( data->valcache = cvCreateMat( m, numprecalculated, CV_32FC1 ) );
+            CV_CALL( valcache = cvCreateMatHeader( m, numprecalculated, valtype ) );
 #endif
-        CV_CALL( data->idxcache = cvCreateMat( numprecalculated, m, CV_IDX_MAT_TYPE ) );
+            data->valcache = valcache;
+        }
+        CV_CALL( data->idxcache = cvCreateMatHeader( numprecalculated, m, idxtype ) );
+
+        if( data->cachefile != NULL )
+        {
+#ifndef _WIN32
+            int fd;
+            /* keep the index rows aligned the way cvAlloc would */
+            size_t idxoffset = (valsize + CV_MALLOC_ALIGN - 1) & ~((size_t) CV_MALLOC_ALIGN - 1);
+
+            fd = open( data->cachefile, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+            if( fd < 0 )
+            {
+                CV_ERROR( CV_StsError, "Unable to create cache file" );
+            }
+            /* scratch space only, removed once unmapped */
+            unlink( data->cachefile );
+            if( ftruncate( fd, (off_t) (idxoffset + idxsize) ) != 0 )
+            {
+                close( fd );
+                CV_ERROR( CV_StsError, "Unable to resize cache file" );
+            }
+            data->cachemap = mmap( NULL, idxoffset + idxsize, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED, fd, 0 );
+            close( fd );
+            if( data->cachemap == MAP_FAILED )
+            {
+                data->cachemap = NULL;
+                CV_ERROR( CV_StsError, "Unable to map cache file" );
+            }
+            data->cachemapsize = idxoffset + idxsize;
+            cvSetData( valcache, data->cachemap, CV_AUTOSTEP );
+            cvSetData( data->idxcache, (uchar*) data->cachemap + idxoffset, CV_AUTOSTEP );
+#else
+            CV_ERROR( CV_StsNotImplemented, "Cache file is not supported on this platform" );
+#endif /* _WIN32 */
+        }
+        else
+        {
+            CV_CALL( cvCreateData( valcache ) );
+            CV_CALL( cvCreateData( data->idxcache ) );
+        }
 
         userdata = cvUserdata( data, haarFeatures );
 
         #ifdef _OPENMP
-        #pragma omp parallel for private(t_data, t_idx, first, t_portion)
+        #pragma omp parallel for private(t_data, t_values, t_buf, t_val, t_portion, i, j)
+        #endif /* _OPENMP */
         for( first = 0; first < numprecalculated; first += portion )
         {
-            t_data = *data->valcache;
-            t_idx = *data->idxcache;
             t_portion = MIN( portion, (numprecalculated - first) );
             
-            /* indices */
-            t_idx.rows = t_portion;
-            t_idx.data.ptr = data->idxcache->data.ptr + first * ((size_t)t_idx.step);
-
-            /* feature values */
+            /* feature values, straight into the cache unless they're quantized */
+            if( qvalcache == NULL )
+            {
+                t_data = *valcache;
+#ifdef CV_COL_ARRANGEMENT
+                t_data.rows = t_portion;
+                t_data.data.ptr = valcache->data.ptr +
+                    first * ((size_t) t_data.step );
+#else
+                t_data.cols = t_portion;
+                t_data.data.ptr = valcache->data.ptr +
+                    first * ((size_t) CV_ELEM_SIZE( t_data.type ));
+#endif
+                t_values = &t_data;
+            }
+            else
+            {
 #ifdef CV_COL_ARRANGEMENT
-            t_data.rows = t_portion;
-            t_data.data.ptr = data->valcache->data.ptr +
-                first * ((size_t) t_data.step );
+                t_values = cvCreateMat( t_portion, m, CV_32FC1 );
 #else
-            t_data.cols = t_portion;
-            t_data.data.ptr = data->valcache->data.ptr +
-                first * ((size_t) CV_ELEM_SIZE( t_data.type ));
+                t_values = cvCreateMat( m, t_portion, CV_32FC1 );
 #endif
-            icvGetTrainingDataCallback( &t_data, NULL, NULL, first, t_portion,
+            }
+            icvGetTrainingDataCallback( t_values, NULL, NULL, first, t_portion,
                                         &userdata );
+
+            /* indices */
+            t_buf = (uchar*) cvAlloc( m * (sizeof( float ) + sizeof( unsigned int )
+                                           + 2 * sizeof( int )) );
+            t_val = (float*) t_buf;
+            for( j = 0; j < t_portion; j++ )
+            {
+                for( i = 0; i < m; i++ )
+                {
 #ifdef CV_COL_ARRANGEMENT
-            cvGetSortedIndices( &t_data, &t_idx, 0 );
+                    t_val[i] = CV_MAT_ELEM( *t_values, float, j, i );
 #else
-            cvGetSortedIndices( &t_data, &t_idx, 1 );
+                    t_val[i] = CV_MAT_ELEM( *t_values, float, i, j );
 #endif
+                }
+                icvSortPrecalculatedFeature( t_val, m,
+                    ( qvalcache ) ? (ushort*) (qvalcache->data.ptr
+                        + (first + j) * ((size_t) qvalcache->step)) : NULL,
+                    ( qvalcache ) ? data->qscale->data.fl + 2 * (first + j) : NULL,
+                    data->idxcache->data.ptr + (first + j) * ((size_t) data->idxcache->step),
+                    idxtype, (unsigned int*) (t_val + m),
+                    (int*) (t_val + 2 * m), (int*) (t_val + 3 * m) );
+            }
+            cvFree( &t_buf );
+            if( t_values != &t_data )
+            {
+                cvReleaseMat( &t_values );
+            }
 
 #ifdef CV_VERBOSE
             putc( '.', stderr );
@@ -720,18 +1029,16 @@ void icvPrecalculate( CvHaarTrainingData* data, CvIntHaarFeatures* haarFeatures,
         fflush( stderr );
 #endif /* CV_VERBOSE */
 
-        #else
-        icvGetTrainingDataCallback( data->valcache, NULL, NULL, 0, numprecalculated,
-                                    &userdata );
-#ifdef CV_COL_ARRANGEMENT
-        cvGetSortedIndices( data->valcache, data->idxcache, 0 );
-#else
-        cvGetSortedIndices( data->valcache, data->idxcache, 1 );
-#endif
-        #endif /* _OPENMP */
+        data->qvalcache = qvalcache;
     }
 
     __END__;
+
+    /* quantized cache is only owned by data once it's complete */
+    if( qvalcache != NULL && data->qvalcache != qvalcache )
+    {
+        cvReleaseMat( &qvalcache );
+    }
 }
 
 static
@@ -1868,7 +2175,8 @@ void cvCreateCascadeClassifier( const char* dirname,
                                 int mode, int symmetric,
                                 int equalweights,
                                 int winwidth, int winheight,
-                                int boosttype, int stumperror )
+                                int boosttype, int stumperror,
+                                int quantizecache, const char* cachefile )
 {
     CvCascadeHaarClassifier* cascade = NULL;
     CvHaarTrainingData* data = NULL;
@@ -1903,6 +2211,8 @@ void cvCreateCascadeClassifier( const char* dirname,
     if( icvInitBackgroundReaders( bgfilename, winsize ) )
     {
         data = icvCreateHaarTrainingData( winsize, npos + nneg );
+        data->quantizecache = quantizecache;
+        data->cachefile = cachefile;
         haar_features = icvCreateIntHaarFeatures( winsize, mode, symmetric );
 
 #ifdef CV_VERBOSE
@@ -2212,7 +2522,8 @@ void cvCreateTreeCascadeClassifier( const char* dirname,
                                     int equalweights,
                                     int winwidth, int winheight,
                                     int boosttype, int stumperror,
-                                    int maxtreesplits, int minpos )
+                                    int maxtreesplits, int minpos,
+                                    int quantizecache, const char* cachefile )
 {
     CvTreeCascadeClassifier* tcc = NULL;
     CvIntHaarFeatures* haar_features = NULL;
@@ -2273,6 +2584,8 @@ void cvCreateTreeCascadeClassifier( const char* dirname,
     printf( "Number of features used : %d\n", haar_features->count );
 
     training_data = icvCreateHaarTrainingData( winsize, npos + nneg );
+    training_data->quantizecache = quantizecache;
+    training_data->cachefile = cachefile;
 
     sprintf( stage_name, "%s/", dirname );
     suffix = stage_name + strlen( stage_name );
@@ -48,6 +48,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include <cvhaartraining.h>
 
@@ -80,6 +81,8 @@ int main( int argc, char* argv[] )
     int stumperror = 0;
     int maxtreesplits = 0;
     int minpos = 500;
+    int quantizecache = 0;
+    const char* cachefile = NULL;
 
     if( argc == 1 )
     {
@@ -91,6 +94,8 @@ int main( int argc, char* argv[] )
                 "  [-nstages <number_of_stages = %d>]\n"
                 "  [-nsplits <number_of_splits = %d>]\n"
                 "  [-mem <memory_in_MB = %d>]\n"
+                "  [-quantize]\n"
+                "  [-cachefile <precalculation_cache_file_name>]\n"
                 "  [-sym (default)] [-nonsym]\n"
                 "  [-minhitrate <min_hit_rate = %f>]\n"
                 "  [-maxfalsealarm <max_false_alarm_rate = %f>]\n"
@@ -144,6 +149,14 @@ int main( int argc, char* argv[] )
         {
             mem = atoi( argv[++i] );
         }
+        else if( !strcmp( argv[i], "-quantize" ) )
+        {
+            quantizecache = 1;
+        }
+        else if( !strcmp( argv[i], "-cachefile" ) )
+        {
+            cachefile = argv[++i];
+        }
         else if( !strcmp( argv[i], "-sym" ) )
         {
             symmetric = 1;
@@ -239,8 +252,11 @@ int main( int argc, char* argv[] )
         }
     }
 
+    /* value is 16 bit if quantized, index 32 bit past SHRT_MAX samples */
     numprecalculated = (int) ( ((size_t) mem) * ((size_t) 1048576) /
-        ( ((size_t) (npos + nneg)) * (sizeof( float ) + sizeof( short )) ) );
+        ( ((size_t) (npos + nneg)) *
+          ( (quantizecache ? sizeof( short ) : sizeof( float )) +
+            ((npos + nneg > SHRT_MAX) ? sizeof( int ) : sizeof( short )) ) ) );
     
     printf( "Data dir name: %s\n", ((dirname == NULL) ? nullname : dirname ) );
     printf( "Vec file name: %s\n", ((vecname == NULL) ? nullname : vecname ) );
@@ -251,6 +267,8 @@ int main( int argc, char* argv[] )
     printf( "Num splits: %d (%s as weak classifier)\n", nsplits,
         (nsplits == 1) ? "stump" : "tree" );
     printf( "Mem: %d MB\n", mem );
+    printf( "Quantized cache: %s\n", (quantizecache) ? "TRUE" : "FALSE" );
+    printf( "Cache file name: %s\n", ((cachefile == NULL) ? nullname : cachefile ) );
     printf( "Symmetric: %s\n", (symmetric) ? "TRUE" : "FALSE" );
     printf( "Min hit rate: %f\n", minhitrate );
     printf( "Max false alarm rate: %f\n", maxfalsealarm );
@@ -274,7 +292,8 @@ int main( int argc, char* argv[] )
                                mode, symmetric,
                                equalweights, width, height,
                                boosttype, stumperror,
-                               maxtreesplits, minpos );
+                               maxtreesplits, minpos,
+                               quantizecache, cachefile );
 
     return 0;
 }
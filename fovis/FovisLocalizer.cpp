@@ -34,6 +34,7 @@ void FovisLocalizer::reloadFovis()
 	options["use-subpixel-refinement"] = "true";
 	options["feature-window-size"] = to_string(fv_param_feature_window_size);
 	options["target-pixels-per-feature"] = to_string(fv_param_target_ppf);
+	options["num-threads"] = to_string(fv_param_num_threads);
 
 	if (_odom)
 		delete _odom;
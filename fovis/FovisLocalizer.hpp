@@ -27,6 +27,7 @@ public:
 	int fv_param_feature_search_window = 25;
 	int fv_param_feature_window_size = 9; //fovis parameters
 	int fv_param_target_ppf = 250;
+	int fv_param_num_threads = 1; //threads used per frame, results are the same for any count
 
 	int num_optical_flow_sectors_x = 4;
 	int num_optical_flow_sectors_y = 3; //optical flow parameters
@@ -43,6 +43,28 @@ FeatureMatcher::matchFeatures(PyramidLevel* ref_level,
                               const std::vector<std::vector<int> >& candidates,
                               FeatureMatch* matches,
                               int* num_matches)
+{
+  int num_ref_features = ref_level->getNumKeypoints();
+  _candidate_start.resize(num_ref_features + 1);
+  _candidates.clear();
+  for (int ref_ind = 0; ref_ind < num_ref_features; ref_ind++) {
+    _candidate_start[ref_ind] = _candidates.size();
+    _candidates.insert(_candidates.end(), candidates[ref_ind].begin(),
+                       candidates[ref_ind].end());
+  }
+  _candidate_start[num_ref_features] = _candidates.size();
+  matchFeatures(ref_level, target_level, &_candidate_start[0],
+                _candidates.empty() ? NULL : &_candidates[0],
+                matches, num_matches);
+}
+
+void
+FeatureMatcher::matchFeatures(PyramidLevel* ref_level,
+                              PyramidLevel* target_level,
+                              const int* candidate_start,
+                              const int* candidates,
+                              FeatureMatch* matches,
+                              int* num_matches)
 {
   int num_ref_features = ref_level->getNumKeypoints();
   int num_target_features = target_level->getNumKeypoints();
@@ -87,12 +109,9 @@ FeatureMatcher::matchFeatures(PyramidLevel* ref_level,
   for (int ref_ind = 0; ref_ind < num_ref_features; ref_ind++) {
     const uint8_t * ref_desc = ref_level->getDescriptor(ref_ind);
 
-    const std::vector<int>& ref_candidates(candidates[ref_ind]);
-    for (std::vector<int>::const_iterator ref_candidates_itr = ref_candidates.begin(),
-         ref_candidates_end = ref_candidates.end();
-         ref_candidates_itr != ref_candidates_end;
-         ++ref_candidates_itr) {
-      int target_ind = *ref_candidates_itr;
+    for (int cand_ind = candidate_start[ref_ind];
+         cand_ind < candidate_start[ref_ind + 1]; cand_ind++) {
+      int target_ind = candidates[cand_ind];
       const uint8_t * target_desc = target_level->getDescriptor(target_ind);
 
       int score = sad.score(ref_desc, target_desc);
@@ -1,6 +1,8 @@
 #ifndef __fovis_feature_matcher_hpp__
 #define __fovis_feature_matcher_hpp__
 
+#include <vector>
+
 #include "feature_match.hpp"
 
 namespace fovis
@@ -42,6 +44,20 @@ public:
                      FeatureMatch* matches,
                      int* num_matches);
 
+  /**
+   * Same as above, with the candidates packed into one flat array.  The
+   * candidates for reference feature \p i are \p candidates[\p
+   * candidate_start[i]] up to but not including \p candidates[\p
+   * candidate_start[i+1]], so \p candidate_start has one more entry than
+   * there are features in \p ref_level.
+   */
+  void matchFeatures(PyramidLevel* ref_level,
+                     PyramidLevel* target_level,
+                     const int* candidate_start,
+                     const int* candidates,
+                     FeatureMatch* matches,
+                     int* num_matches);
+
 private:
   FeatureMatcher (const FeatureMatcher& other);
   FeatureMatcher& operator=(const FeatureMatcher& other);
@@ -55,6 +71,10 @@ private:
   int32_t* _ref_to_target_scores;
   int32_t* _target_to_ref_indices;
   int32_t* _target_to_ref_scores;
+
+  // candidates passed in as a vector of vectors, flattened
+  std::vector<int> _candidate_start;
+  std::vector<int> _candidates;
 };
 
 
@@ -13,6 +13,7 @@
 #include "depth_source.hpp"
 #include "internal_utils.hpp"
 #include "normalize_image.hpp"
+#include "thread_pool.hpp"
 
 #include "tictoc.hpp"
 
@@ -33,10 +34,12 @@ namespace fovis
 {
 
 OdometryFrame::OdometryFrame(const Rectification* rectification,
-                             const VisualOdometryOptions& options)
+                             const VisualOdometryOptions& options,
+                             ThreadPool* thread_pool)
 {
   const CameraIntrinsicsParameters& input_camera = rectification->getInputCameraParameters();
   _rectification = rectification;
+  _thread_pool = thread_pool;
   _orig_width = input_camera.width;
   _orig_height = input_camera.height;
 
@@ -108,94 +111,120 @@ OdometryFrame::prepareFrame(const uint8_t* raw_gray,
           prev_level->_pyrbuf);
     }
 
-    level->_initial_keypoints.clear();
-    FAST(level->_raw_gray, level->_width, level->_height, level->_raw_gray_stride,
-        &level->_initial_keypoints, fast_threshold, 1);
+    // Detecting features only reads this level's image, so with a
+    // thread pool it can run while the next level is downsampled
+    if (_thread_pool) {
+      _thread_pool->run(std::bind(&OdometryFrame::detectKeypoints, this,
+                                  level_num, fast_threshold, depth_source));
+    } else {
+      detectKeypoints(level_num, fast_threshold, depth_source);
+    }
+  }
+  if (_thread_pool) {
+    _thread_pool->wait();
+  }
 
-    // Keep track of this number before filtering out keyoints with the
-    // grid bucketing, to use it as a signal for FAST threshold adjustment.
-    level->_num_detected_keypoints = static_cast<int>(level->_initial_keypoints.size());
+  // populate 3D position for descriptors. Depth calculation may fail for some
+  // of these keypoints.
+  depth_source->getXyz(this);
 
-    if (_use_bucketing) {
-      tictoc("bucketing");
-      level->_grid_filter.filter(&level->_initial_keypoints);
-      tictoc("bucketing");
-    }
+  // Get rid of keypoints with no depth.
+  purgeBadKeypoints();
 
-    level->_num_keypoints = 0;
+}
 
-    int num_kp_candidates = level->_initial_keypoints.size();
+/**
+ * Find, filter and describe the keypoints of one pyramid level.
+ * Only touches data belonging to that level.
+ */
+void
+OdometryFrame::detectKeypoints(int level_num, int fast_threshold,
+                               DepthSource* depth_source)
+{
+  PyramidLevel* level = _levels[level_num];
 
-    // increase buffer size if needed
-    if (num_kp_candidates > level->_keypoints_capacity) {
-      level->increase_capacity(static_cast<int>(num_kp_candidates*1.2));
-    }
+  level->_initial_keypoints.clear();
+  FAST(level->_raw_gray, level->_width, level->_height, level->_raw_gray_stride,
+      &level->_initial_keypoints, fast_threshold, 1);
 
-    int min_dist_from_edge = (_feature_window_size - 1) / 2 + 1;
-    int min_x = min_dist_from_edge;
-    int min_y = min_dist_from_edge;
-    int max_x = level->_width - (min_dist_from_edge + 1);
-    int max_y = level->_height - (min_dist_from_edge + 1);
-
-    // filter the keypoint candidates, and compute derived data
-    for (int kp_ind=0; kp_ind<num_kp_candidates; kp_ind++) {
-      KeyPoint& kp_cand = level->_initial_keypoints[kp_ind];
-
-      // ignore features too close to border
-      if(kp_cand.u < min_x || kp_cand.u > max_x || kp_cand.v < min_y ||
-         kp_cand.v > max_y)
-        continue;
-
-      KeypointData kpdata;
-      kpdata.kp = kp_cand;
-      kpdata.base_uv(0) = kp_cand.u * (1 << level_num);
-      kpdata.base_uv(1) = kp_cand.v * (1 << level_num);
-      kpdata.pyramid_level = level_num;
-
-      assert(kpdata.base_uv(0) >= 0);
-      assert(kpdata.base_uv(1) < _orig_width);
-      assert(kpdata.base_uv(0) >= 0);
-      assert(kpdata.base_uv(1) < _orig_height);
-
-      // lookup rectified pixel coordinates
-      int pixel_index = static_cast<int>(kpdata.base_uv(1) * _orig_width + kpdata.base_uv(0));
-      _rectification->rectifyLookupByIndex(pixel_index, &kpdata.rect_base_uv);
-
-      // Ignore the points that fall
-      // outside the original image region when undistorted.
-      if (kpdata.rect_base_uv(0) < 0 || kpdata.rect_base_uv(0) >= _orig_width ||
-          kpdata.rect_base_uv(1) < 0 || kpdata.rect_base_uv(1) >= _orig_height) {
-        continue;
-      }
+  // Keep track of this number before filtering out keyoints with the
+  // grid bucketing, to use it as a signal for FAST threshold adjustment.
+  level->_num_detected_keypoints = static_cast<int>(level->_initial_keypoints.size());
+
+  if (_use_bucketing) {
+    // tictoc isn't thread safe
+    if (!_thread_pool)
+      tictoc("bucketing");
+    level->_grid_filter.filter(&level->_initial_keypoints);
+    if (!_thread_pool)
+      tictoc("bucketing");
+  }
 
-      // ignore features with unknown depth
-      int du = static_cast<int>(kpdata.rect_base_uv(0)+0.5);
-      int dv = static_cast<int>(kpdata.rect_base_uv(1)+0.5);
-      if (!depth_source->haveXyz(du, dv)) { continue; }
+  level->_num_keypoints = 0;
 
-      // We will calculate depth of all the keypoints later
-      kpdata.xyzw = Eigen::Vector4d(NAN, NAN, NAN, NAN);
-      kpdata.has_depth = false;
-      kpdata.keypoint_index = level->_num_keypoints;
+  int num_kp_candidates = level->_initial_keypoints.size();
 
-      kpdata.track_id = -1; //hasn't been associated with a track yet
+  // increase buffer size if needed
+  if (num_kp_candidates > level->_keypoints_capacity) {
+    level->increase_capacity(static_cast<int>(num_kp_candidates*1.2));
+  }
 
-      level->_keypoints[level->_num_keypoints] = kpdata;
-      level->_num_keypoints++;
+  int min_dist_from_edge = (_feature_window_size - 1) / 2 + 1;
+  int min_x = min_dist_from_edge;
+  int min_y = min_dist_from_edge;
+  int max_x = level->_width - (min_dist_from_edge + 1);
+  int max_y = level->_height - (min_dist_from_edge + 1);
+
+  // filter the keypoint candidates, and compute derived data
+  for (int kp_ind=0; kp_ind<num_kp_candidates; kp_ind++) {
+    KeyPoint& kp_cand = level->_initial_keypoints[kp_ind];
+
+    // ignore features too close to border
+    if(kp_cand.u < min_x || kp_cand.u > max_x || kp_cand.v < min_y ||
+       kp_cand.v > max_y)
+      continue;
+
+    KeypointData kpdata;
+    kpdata.kp = kp_cand;
+    kpdata.base_uv(0) = kp_cand.u * (1 << level_num);
+    kpdata.base_uv(1) = kp_cand.v * (1 << level_num);
+    kpdata.pyramid_level = level_num;
+
+    assert(kpdata.base_uv(0) >= 0);
+    assert(kpdata.base_uv(1) < _orig_width);
+    assert(kpdata.base_uv(0) >= 0);
+    assert(kpdata.base_uv(1) < _orig_height);
+
+    // lookup rectified pixel coordinates
+    int pixel_index = static_cast<int>(kpdata.base_uv(1) * _orig_width + kpdata.base_uv(0));
+    _rectification->rectifyLookupByIndex(pixel_index, &kpdata.rect_base_uv);
+
+    // Ignore the points that fall
+    // outside the original image region when undistorted.
+    if (kpdata.rect_base_uv(0) < 0 || kpdata.rect_base_uv(0) >= _orig_width ||
+        kpdata.rect_base_uv(1) < 0 || kpdata.rect_base_uv(1) >= _orig_height) {
+      continue;
     }
 
-    // extract features
-    level->populateDescriptorsAligned(level->_keypoints, level->_num_keypoints,
-                                      level->_descriptors);
-  }
+    // ignore features with unknown depth
+    int du = static_cast<int>(kpdata.rect_base_uv(0)+0.5);
+    int dv = static_cast<int>(kpdata.rect_base_uv(1)+0.5);
+    if (!depth_source->haveXyz(du, dv)) { continue; }
 
-  // populate 3D position for descriptors. Depth calculation may fail for some
-  // of these keypoints.
-  depth_source->getXyz(this);
+    // We will calculate depth of all the keypoints later
+    kpdata.xyzw = Eigen::Vector4d(NAN, NAN, NAN, NAN);
+    kpdata.has_depth = false;
+    kpdata.keypoint_index = level->_num_keypoints;
 
-  // Get rid of keypoints with no depth.
-  purgeBadKeypoints();
+    kpdata.track_id = -1; //hasn't been associated with a track yet
+
+    level->_keypoints[level->_num_keypoints] = kpdata;
+    level->_num_keypoints++;
+  }
 
+  // extract features
+  level->populateDescriptorsAligned(level->_keypoints, level->_num_keypoints,
+                                    level->_descriptors);
 }
 
 /**
@@ -20,6 +20,7 @@ namespace fovis
 class CameraIntrinsics;
 class Rectification;
 class DepthSource;
+class ThreadPool;
 
 /**
  * @ingroup FovisCore
@@ -33,8 +34,13 @@ class DepthSource;
 class OdometryFrame
 {
   public:
+    /**
+     * \param thread_pool if not NULL, feature detection for each pyramid
+     * level runs on this pool while the next level is being downsampled.
+     */
     OdometryFrame(const Rectification* rectification,
-                  const VisualOdometryOptions& options);
+                  const VisualOdometryOptions& options,
+                  ThreadPool* thread_pool = NULL);
 
     ~OdometryFrame();
 
@@ -74,6 +80,7 @@ class OdometryFrame
 
   private:
 
+    void detectKeypoints(int level_num, int fast_threshold, DepthSource* depth_source);
     void purgeBadKeypoints();
 
     int _orig_width;
@@ -87,6 +94,9 @@ class OdometryFrame
     // note: the rectification pointer is 'borrowed'
     const Rectification* _rectification;
 
+    // also borrowed, NULL to process levels serially
+    ThreadPool* _thread_pool;
+
     std::vector<PyramidLevel*> _levels;
 };
 
@@ -6,6 +6,8 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
 
 #include "motion_estimation.hpp"
 #include "absolute_orientation_horn.hpp"
@@ -18,6 +20,7 @@
 #include "refine_feature_match.hpp"
 
 #include "stereo_depth.hpp"
+#include "thread_pool.hpp"
 
 #define USE_HORN_ABSOLUTE_ORIENTATION
 #define USE_ROBUST_STEREO_COMPATIBILITY
@@ -37,9 +40,10 @@ const char* MotionEstimateStatusCodeStrings[] = {
 };
 
 MotionEstimator::MotionEstimator(const Rectification* rectification,
-    const VisualOdometryOptions& options)
+    const VisualOdometryOptions& options, ThreadPool* thread_pool)
 {
   _rectification = rectification;
+  _thread_pool = thread_pool;
 
   _ref_frame = NULL;
   _target_frame = NULL;
@@ -82,6 +86,9 @@ MotionEstimator::~MotionEstimator()
   _motion_estimate_covariance = NULL;
   _motion_estimate = NULL;
   _estimate_status = NO_DATA;
+  for (size_t i = 0; i < _level_matchers.size(); i++)
+    delete _level_matchers[i];
+  _level_matchers.clear();
 }
 
 void
@@ -112,10 +119,47 @@ MotionEstimator::estimateMotion(OdometryFrame* ref_frame,
   }
 
   int num_levels = _ref_frame->getNumLevels();
-  for (int level_ind = 0; level_ind < num_levels; level_ind++) {
-    PyramidLevel* ref_level = _ref_frame->getLevel(level_ind);
-    PyramidLevel* target_level = _target_frame->getLevel(level_ind);
-    matchFeatures(ref_level, target_level);
+  while (static_cast<int>(_level_matchers.size()) < num_levels)
+    _level_matchers.push_back(new LevelMatcher());
+  if (_thread_pool && num_levels > 1) {
+    // Each level can have at most min(ref, target) matches, and the sum
+    // of those is no more than the capacity allocated above. Give each
+    // level its own part of _matches to fill in, then pack them together
+    // in level order
+    _level_num_matches.resize(num_levels);
+    int level_offset = 0;
+    for (int level_ind = 0; level_ind < num_levels; level_ind++) {
+      PyramidLevel* ref_level = _ref_frame->getLevel(level_ind);
+      PyramidLevel* target_level = _target_frame->getLevel(level_ind);
+      LevelMatcher* level_matcher = _level_matchers[level_ind];
+      FeatureMatch* level_matches = &(_matches[level_offset]);
+      int* num_level_matches = &(_level_num_matches[level_ind]);
+      _thread_pool->run([=]() {
+        *num_level_matches = matchLevelFeatures(ref_level, target_level,
+                                                level_matcher, level_matches);
+      });
+      level_offset += std::min(ref_level->getNumKeypoints(), target_level->getNumKeypoints());
+    }
+    _thread_pool->wait();
+
+    level_offset = 0;
+    for (int level_ind = 0; level_ind < num_levels; level_ind++) {
+      int old_num_matches = _num_matches;
+      for (int n = 0; n < _level_num_matches[level_ind]; n++) {
+        if (level_offset + n != _num_matches)
+          _matches[_num_matches] = _matches[level_offset + n];
+        _num_matches++;
+      }
+      assignTrackIds(old_num_matches, _num_matches);
+      level_offset += std::min(_ref_frame->getLevel(level_ind)->getNumKeypoints(),
+                               _target_frame->getLevel(level_ind)->getNumKeypoints());
+    }
+  } else {
+    for (int level_ind = 0; level_ind < num_levels; level_ind++) {
+      PyramidLevel* ref_level = _ref_frame->getLevel(level_ind);
+      PyramidLevel* target_level = _target_frame->getLevel(level_ind);
+      matchFeatures(ref_level, target_level, _level_matchers[level_ind]);
+    }
   }
   if (_use_subpixel_refinement) {
     depth_source->refineXyz(_matches, _num_matches, target_frame);
@@ -249,7 +293,23 @@ void MotionEstimator::sanityCheck() const
 #endif
 }
 
-void MotionEstimator::matchFeatures(PyramidLevel* ref_level, PyramidLevel* target_level)
+void MotionEstimator::matchFeatures(PyramidLevel* ref_level, PyramidLevel* target_level,
+                                    LevelMatcher* level_matcher)
+{
+  int old_num_matches = _num_matches;
+  _num_matches += matchLevelFeatures(ref_level, target_level, level_matcher,
+                                     &(_matches[_num_matches]));
+  assignTrackIds(old_num_matches, _num_matches);
+}
+
+/**
+ * Match the features of one pyramid level, writing them to \p matches and
+ * returning how many there are.  Doesn't change anything outside of the two
+ * levels, \p level_matcher and \p matches so levels can be matched in
+ * parallel.
+ */
+int MotionEstimator::matchLevelFeatures(PyramidLevel* ref_level, PyramidLevel* target_level,
+                                        LevelMatcher* level_matcher, FeatureMatch* matches) const
 {
   // get the camera projection matrix
   Eigen::Matrix<double, 3, 4> xyz_c_to_uvw_c =
@@ -260,8 +320,60 @@ void MotionEstimator::matchFeatures(PyramidLevel* ref_level, PyramidLevel* targe
   int num_ref_features = ref_level->getNumKeypoints();
   int num_target_features = target_level->getNumKeypoints();
 
-  std::vector<std::vector<int> > candidates(num_ref_features);
+  // Bucket the target features into a grid of cells the size of the search
+  // window, so each reference feature only has to look at target features in
+  // the cells its window overlaps instead of all of them
+  float min_u = 0, min_v = 0, max_u = 0, max_v = 0;
+  for (int target_ind = 0; target_ind < num_target_features; target_ind++) {
+    float u = target_level->getKeypointRectBaseU(target_ind);
+    float v = target_level->getKeypointRectBaseV(target_ind);
+    if (target_ind == 0 || u < min_u) min_u = u;
+    if (target_ind == 0 || u > max_u) max_u = u;
+    if (target_ind == 0 || v < min_v) min_v = v;
+    if (target_ind == 0 || v > max_v) max_v = v;
+  }
+  double cell_size = std::max(_max_feature_motion, 1.0);
+  int grid_cols = static_cast<int>((max_u - min_u) / cell_size) + 1;
+  int grid_rows = static_cast<int>((max_v - min_v) / cell_size) + 1;
+  // a tiny search window would make for a huge, mostly empty grid
+  while (grid_cols * grid_rows > 4 * num_target_features + 16) {
+    cell_size *= 2;
+    grid_cols = static_cast<int>((max_u - min_u) / cell_size) + 1;
+    grid_rows = static_cast<int>((max_v - min_v) / cell_size) + 1;
+  }
+  int num_cells = grid_cols * grid_rows;
+
+  // counting sort by cell, which keeps each cell in target index order
+  std::vector<int>& cell_start(level_matcher->cell_start);
+  std::vector<int>& cell_targets(level_matcher->cell_targets);
+  cell_start.assign(num_cells + 1, 0);
+  cell_targets.resize(num_target_features);
+  for (int target_ind = 0; target_ind < num_target_features; target_ind++) {
+    int col = static_cast<int>((target_level->getKeypointRectBaseU(target_ind) - min_u) / cell_size);
+    int row = static_cast<int>((target_level->getKeypointRectBaseV(target_ind) - min_v) / cell_size);
+    cell_start[row * grid_cols + col + 1]++;
+  }
+  for (int cell = 0; cell < num_cells; cell++)
+    cell_start[cell + 1] += cell_start[cell];
+  // fills each cell from its start, leaving cell_start[i] at the start of
+  // cell i+1.  Shifted back below
+  for (int target_ind = 0; target_ind < num_target_features; target_ind++) {
+    int col = static_cast<int>((target_level->getKeypointRectBaseU(target_ind) - min_u) / cell_size);
+    int row = static_cast<int>((target_level->getKeypointRectBaseV(target_ind) - min_v) / cell_size);
+    cell_targets[cell_start[row * grid_cols + col]++] = target_ind;
+  }
+  for (int cell = num_cells; cell > 0; cell--)
+    cell_start[cell] = cell_start[cell - 1];
+  cell_start[0] = 0;
+
+  std::vector<int>& candidate_start(level_matcher->candidate_start);
+  std::vector<int>& candidates(level_matcher->candidates);
+  candidate_start.resize(num_ref_features + 1);
+  candidates.clear();
   for (int ref_ind = 0; ref_ind < num_ref_features; ref_ind++) {
+    candidate_start[ref_ind] = candidates.size();
+    if (num_target_features == 0)
+      continue;
     // constrain the matching to a search-region based on the
     // current motion estimate
     const Eigen::Vector4d& ref_xyzw = ref_level->getKeypointXYZW(ref_ind);
@@ -269,31 +381,54 @@ void MotionEstimator::matchFeatures(PyramidLevel* ref_level, PyramidLevel* targe
            !isnan(ref_xyzw(2)) && !isnan(ref_xyzw(3)));
     Eigen::Vector3d reproj_uv1 = reproj_mat * ref_xyzw;
     reproj_uv1 /= reproj_uv1(2);
-    Eigen::Vector2d ref_uv(ref_level->getKeypointRectBaseU(ref_ind),
-                           ref_level->getKeypointRectBaseV(ref_ind));
-    std::vector<int>& ref_candidates(candidates[ref_ind]);
-    for (int target_ind = 0; target_ind < num_target_features; target_ind++) {
-      Eigen::Vector2d target_uv(target_level->getKeypointRectBaseU(target_ind),
-                                target_level->getKeypointRectBaseV(target_ind));
-      //TODO: Should adapt based on covariance instead of constant sized window!
-      //Eigen::Vector2d err = target_uv - ref_uv; //ignore motion est
-      Eigen::Vector2d err = target_uv - reproj_uv1.head<2>();
-      if (err.norm() < _max_feature_motion) {
-        ref_candidates.push_back(target_ind);
+    // points which reproject to infinity can't match anything
+    if (!std::isfinite(reproj_uv1(0)) || !std::isfinite(reproj_uv1(1)))
+      continue;
+
+    // range of cells overlapping the search window, clamped to the grid
+    double col0 = floor((reproj_uv1(0) - _max_feature_motion - min_u) / cell_size);
+    double col1 = floor((reproj_uv1(0) + _max_feature_motion - min_u) / cell_size);
+    double row0 = floor((reproj_uv1(1) - _max_feature_motion - min_v) / cell_size);
+    double row1 = floor((reproj_uv1(1) + _max_feature_motion - min_v) / cell_size);
+    if (col1 < 0 || row1 < 0 || col0 >= grid_cols || row0 >= grid_rows)
+      continue;
+    int first_col = static_cast<int>(std::max(col0, 0.0));
+    int last_col = static_cast<int>(std::min(col1, grid_cols - 1.0));
+    int first_row = static_cast<int>(std::max(row0, 0.0));
+    int last_row = static_cast<int>(std::min(row1, grid_rows - 1.0));
+
+    for (int row = first_row; row <= last_row; row++) {
+      for (int cell = row * grid_cols + first_col;
+           cell <= row * grid_cols + last_col; cell++) {
+        for (int i = cell_start[cell]; i < cell_start[cell + 1]; i++) {
+          int target_ind = cell_targets[i];
+          Eigen::Vector2d target_uv(target_level->getKeypointRectBaseU(target_ind),
+                                    target_level->getKeypointRectBaseV(target_ind));
+          //TODO: Should adapt based on covariance instead of constant sized window!
+          //Eigen::Vector2d err = target_uv - ref_uv; //ignore motion est
+          Eigen::Vector2d err = target_uv - reproj_uv1.head<2>();
+          if (err.norm() < _max_feature_motion) {
+            candidates.push_back(target_ind);
+          }
+        }
       }
     }
+    // the matcher breaks ties in favor of the first candidate, so keep them
+    // in target index order like a search over every target feature would
+    std::sort(candidates.begin() + candidate_start[ref_ind], candidates.end());
   }
+  candidate_start[num_ref_features] = candidates.size();
 
   int inserted_matches = 0;
-  _matcher.matchFeatures(ref_level, target_level, candidates,
-                         &(_matches[_num_matches]), &inserted_matches);
-  int old_num_matches = _num_matches;
-  _num_matches = old_num_matches + inserted_matches;
+  level_matcher->matcher.matchFeatures(ref_level, target_level,
+                                       &candidate_start[0],
+                                       candidates.empty() ? NULL : &candidates[0],
+                                       matches, &inserted_matches);
 
   if (_use_subpixel_refinement) {
-    for (int n=old_num_matches; n < _num_matches; ++n) {
+    for (int n=0; n < inserted_matches; ++n) {
       //std::cerr << "n = " << n << std::endl;
-      FeatureMatch& match(_matches[n]);
+      FeatureMatch& match(matches[n]);
       const KeypointData* ref_kpdata(match.ref_keypoint);
       const KeypointData* target_kpdata(match.target_keypoint);
       Eigen::Vector2d ref_uv(ref_kpdata->kp.u, ref_kpdata->kp.v);
@@ -323,8 +458,17 @@ void MotionEstimator::matchFeatures(PyramidLevel* ref_level, PyramidLevel* targe
     }
   }
 
+  return inserted_matches;
+}
+
+/**
+ * Label matches [first_match, end_match) with their track ids.  Track
+ * ids are handed out in match order, so this has to run serially.
+ */
+void MotionEstimator::assignTrackIds(int first_match, int end_match)
+{
   // label matches with their track_id
-  for (int n=old_num_matches; n < _num_matches; ++n) {
+  for (int n=first_match; n < end_match; ++n) {
     FeatureMatch& match(_matches[n]);
     KeypointData* ref_kpdata(match.ref_keypoint);
     KeypointData* target_kpdata(match.target_keypoint);
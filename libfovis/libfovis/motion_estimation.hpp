@@ -2,6 +2,7 @@
 #define __fovis_motion_estimation_hpp__
 
 #include <stdint.h>
+#include <vector>
 
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
@@ -17,6 +18,8 @@
 namespace fovis
 {
 
+class ThreadPool;
+
 enum MotionEstimateStatusCode
 {
   NO_DATA,
@@ -37,7 +40,13 @@ extern const char* MotionEstimateStatusCodeStrings[];
 class MotionEstimator
 {
   public:
-    MotionEstimator(const Rectification* rectification, const VisualOdometryOptions& options);
+    /**
+     * \param thread_pool if not NULL, features in each pyramid level are
+     * matched at the same time on this pool.  Matches come out in the same
+     * order with the same track ids as when done serially.
+     */
+    MotionEstimator(const Rectification* rectification, const VisualOdometryOptions& options,
+                    ThreadPool* thread_pool = NULL);
     ~MotionEstimator();
 
     void estimateMotion(OdometryFrame* reference_frame,
@@ -85,7 +94,28 @@ class MotionEstimator
     void sanityCheck() const;
 
   private:
-    void matchFeatures(PyramidLevel* ref_level, PyramidLevel* target_level);
+    /**
+     * Everything needed to match the features of one pyramid level, kept
+     * from frame to frame so its buffers are only reallocated when a level
+     * has more features than it has had before.
+     */
+    struct LevelMatcher {
+      FeatureMatcher matcher;
+      // Target features bucketed into a grid of search window sized cells.
+      // Cell i holds cell_targets[cell_start[i]] to
+      // cell_targets[cell_start[i+1] - 1]
+      std::vector<int> cell_start;
+      std::vector<int> cell_targets;
+      // Match candidates for each reference feature, packed the same way
+      std::vector<int> candidate_start;
+      std::vector<int> candidates;
+    };
+
+    void matchFeatures(PyramidLevel* ref_level, PyramidLevel* target_level,
+                       LevelMatcher* level_matcher);
+    int matchLevelFeatures(PyramidLevel* ref_level, PyramidLevel* target_level,
+                           LevelMatcher* level_matcher, FeatureMatch* matches) const;
+    void assignTrackIds(int first_match, int end_match);
     void computeMaximallyConsistentClique();
     void estimateRigidBodyTransform();
     void refineMotionEstimate();
@@ -94,7 +124,12 @@ class MotionEstimator
     // convenience variable
     DepthSource* _depth_source;
 
-    FeatureMatcher _matcher;
+    // borrowed, NULL to match levels serially
+    ThreadPool* _thread_pool;
+    // one per pyramid level, so levels can be matched in parallel on
+    // _thread_pool
+    std::vector<LevelMatcher*> _level_matchers;
+    std::vector<int> _level_num_matches;
 
     // for each feature in the target frame,
     FeatureMatch* _matches;
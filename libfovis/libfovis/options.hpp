@@ -101,6 +101,14 @@ namespace fovis
  *                  frame-to-frame visual odometry, but is likely better when
  *                  using this library as part of a visual SLAM
  *                  algorithm.
+ *
+ *   "num-threads"
+ *     Type:        Integer
+ *     Default:     1
+ *     Range:       1+
+ *     Description: Number of threads used to detect features in and match
+ *                  pyramid levels at the same time.  1 processes each level
+ *                  in turn.  Results are the same for any number of threads.
  * \endverbatim
  */
 typedef std::map<std::string, std::string> VisualOdometryOptions;
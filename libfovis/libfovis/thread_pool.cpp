@@ -0,0 +1,70 @@
+#include "thread_pool.hpp"
+
+namespace fovis
+{
+
+ThreadPool::ThreadPool(int num_threads) :
+  _num_unfinished(0),
+  _stop(false)
+{
+  for (int i = 0; i < num_threads; i++)
+    _threads.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _task_ready.notify_all();
+  for (size_t i = 0; i < _threads.size(); i++)
+    _threads[i].join();
+}
+
+void
+ThreadPool::run(const std::function<void()>& task)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks.push_back(task);
+    _num_unfinished++;
+  }
+  _task_ready.notify_one();
+}
+
+void
+ThreadPool::wait()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (_num_unfinished > 0)
+    _tasks_done.wait(lock);
+}
+
+void
+ThreadPool::workerLoop()
+{
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      while (!_stop && _tasks.empty())
+        _task_ready.wait(lock);
+      if (_tasks.empty())
+        return;
+      task.swap(_tasks.front());
+      _tasks.pop_front();
+    }
+
+    task();
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _num_unfinished--;
+      if (_num_unfinished == 0)
+        _tasks_done.notify_all();
+    }
+  }
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef __fovis_thread_pool_hpp__
+#define __fovis_thread_pool_hpp__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fovis
+{
+
+/**
+ * \ingroup FovisCore
+ * \brief Fixed set of worker threads used to run independent parts of
+ * frame processing at the same time.
+ *
+ * Tasks are started in the order they are queued.  Callers are expected to
+ * split work so that no two tasks queued between calls to wait() write to the
+ * same data, which keeps results identical to running the same tasks one
+ * after another.
+ */
+class ThreadPool
+{
+  public:
+    /**
+     * \param num_threads number of worker threads to start.
+     */
+    explicit ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    int getNumThreads() const {
+      return static_cast<int>(_threads.size());
+    }
+
+    /**
+     * Queue \p task to run on one of the worker threads.
+     */
+    void run(const std::function<void()>& task);
+
+    /**
+     * Block until every task queued so far has finished.
+     */
+    void wait();
+
+  private:
+    ThreadPool(const ThreadPool& other);
+    ThreadPool& operator=(const ThreadPool& other);
+
+    void workerLoop();
+
+    std::vector<std::thread> _threads;
+    std::deque<std::function<void()> > _tasks;
+    std::mutex _mutex;
+    std::condition_variable _task_ready;
+    std::condition_variable _tasks_done;
+    // tasks queued or running
+    int _num_unfinished;
+    bool _stop;
+};
+
+}
+
+#endif
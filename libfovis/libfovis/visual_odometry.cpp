@@ -81,6 +81,7 @@ VisualOdometry::VisualOdometry(const Rectification* rectification,
   _fast_threshold = optionsGetIntOrFromDefault(_options, "fast-threshold", defaults);
   _use_adaptive_threshold = optionsGetBoolOrFromDefault(_options, "use-adaptive-threshold", defaults);
   _fast_threshold_adaptive_gain = optionsGetDoubleOrFromDefault(_options, "fast-threshold-adaptive-gain", defaults);
+  int num_threads = optionsGetIntOrFromDefault(_options, "num-threads", defaults);
 
   _fast_threshold_min = 5;
   _fast_threshold_max = 70;
@@ -95,13 +96,15 @@ VisualOdometry::VisualOdometry(const Rectification* rectification,
 
   _rectification = rectification;
 
-  _ref_frame = new OdometryFrame(_rectification, options);
+  _thread_pool = (num_threads > 1) ? new ThreadPool(num_threads) : NULL;
 
-  _prev_frame = new OdometryFrame(_rectification, options);
+  _ref_frame = new OdometryFrame(_rectification, options, _thread_pool);
 
-  _cur_frame = new OdometryFrame(_rectification, options);
+  _prev_frame = new OdometryFrame(_rectification, options, _thread_pool);
 
-  _estimator = new MotionEstimator(_rectification, _options);
+  _cur_frame = new OdometryFrame(_rectification, options, _thread_pool);
+
+  _estimator = new MotionEstimator(_rectification, _options, _thread_pool);
 }
 
 VisualOdometry::~VisualOdometry()
@@ -110,6 +113,7 @@ VisualOdometry::~VisualOdometry()
   delete _ref_frame;
   delete _prev_frame;
   delete _cur_frame;
+  delete _thread_pool;
   delete _p;
   _ref_frame = NULL;
   _prev_frame = NULL;
@@ -309,6 +313,7 @@ VisualOdometry::getDefaultOptions()
   r["fast-threshold-adaptive-gain"] = _toString(0.005);
   r["use-homography-initialization"] = "true";
   r["ref-frame-change-threshold"] = "150";
+  r["num-threads"] = "1";
 
   // OdometryFrame
   r["use-bucketing"] = "true";
@@ -11,6 +11,7 @@
 #include "depth_source.hpp"
 #include "motion_estimation.hpp"
 #include "options.hpp"
+#include "thread_pool.hpp"
 
 namespace fovis
 {
@@ -210,6 +211,9 @@ class VisualOdometry
 
     MotionEstimator* _estimator;
 
+    // NULL if running single threaded
+    ThreadPool* _thread_pool;
+
     VisualOdometryPriv* _p;
 
     bool _change_reference_frames;
@@ -0,0 +1,126 @@
+// Runs the same synthetic image sequence through VisualOdometry single
+// threaded and with a thread pool, and checks that every frame gives exactly
+// the same motion estimate, match count and inlier count.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include "../libfovis/visual_odometry.hpp"
+#include "../libfovis/depth_image.hpp"
+#include "../libfovis/rectification.hpp"
+
+using namespace fovis;
+
+static const int kWidth = 320;
+static const int kHeight = 240;
+static const int kNumFrames = 30;
+
+struct FrameResult {
+  Eigen::Matrix4d motion;
+  int num_matches;
+  int num_inliers;
+  MotionEstimateStatusCode status;
+};
+
+// Blocky random texture, larger than a frame so the camera can pan over it
+static std::vector<uint8_t>
+makeTexture(int width, int height)
+{
+  std::vector<uint8_t> texture(width * height);
+  srand(1234);
+  const int block = 6;
+  for (int by = 0; by < height; by += block) {
+    for (int bx = 0; bx < width; bx += block) {
+      uint8_t val = rand() % 256;
+      for (int y = by; y < by + block && y < height; y++)
+        for (int x = bx; x < bx + block && x < width; x++)
+          texture[y * width + x] = val;
+    }
+  }
+  return texture;
+}
+
+static std::vector<FrameResult>
+runOdometry(int num_threads, const std::vector<uint8_t>& texture, int texture_width)
+{
+  CameraIntrinsicsParameters params;
+  memset(&params, 0, sizeof(params));
+  params.width = kWidth;
+  params.height = kHeight;
+  params.fx = 300;
+  params.fy = 300;
+  params.cx = kWidth / 2.0;
+  params.cy = kHeight / 2.0;
+
+  Rectification rect(params);
+  VisualOdometryOptions options = VisualOdometry::getDefaultOptions();
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%d", num_threads);
+  options["num-threads"] = buf;
+  VisualOdometry odom(&rect, options);
+
+  DepthImage depth_source(params, kWidth, kHeight);
+  std::vector<float> depth(kWidth * kHeight, 2.0f);
+  depth_source.setDepthImage(&depth[0]);
+
+  std::vector<FrameResult> results;
+  std::vector<uint8_t> gray(kWidth * kHeight);
+  for (int frame = 0; frame < kNumFrames; frame++) {
+    // pan right and down a bit each frame
+    int x0 = frame * 2;
+    int y0 = frame;
+    for (int y = 0; y < kHeight; y++)
+      memcpy(&gray[y * kWidth], &texture[(y + y0) * texture_width + x0], kWidth);
+
+    odom.processFrame(&gray[0], &depth_source);
+
+    FrameResult result;
+    result.motion = odom.getMotionEstimate().matrix();
+    result.num_matches = odom.getMotionEstimator()->getNumMatches();
+    result.num_inliers = odom.getMotionEstimator()->getNumInliers();
+    result.status = odom.getMotionEstimateStatus();
+    results.push_back(result);
+  }
+  return results;
+}
+
+int main(int argc, char** argv)
+{
+  const int texture_width = kWidth + 2 * kNumFrames;
+  const int texture_height = kHeight + kNumFrames;
+  std::vector<uint8_t> texture = makeTexture(texture_width, texture_height);
+
+  std::vector<FrameResult> serial = runOdometry(1, texture, texture_width);
+  int num_failures = 0;
+  const int thread_counts[] = { 2, 4 };
+  for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+    std::vector<FrameResult> threaded = runOdometry(thread_counts[t], texture, texture_width);
+    for (int i = 0; i < kNumFrames; i++) {
+      if (serial[i].motion != threaded[i].motion ||
+          serial[i].num_matches != threaded[i].num_matches ||
+          serial[i].num_inliers != threaded[i].num_inliers ||
+          serial[i].status != threaded[i].status) {
+        printf("%d threads, frame %d differs : matches %d/%d inliers %d/%d\n",
+               thread_counts[t], i, serial[i].num_matches, threaded[i].num_matches,
+               serial[i].num_inliers, threaded[i].num_inliers);
+        num_failures++;
+      }
+    }
+  }
+
+  printf("last frame : %d matches, %d inliers, status %s\n",
+         serial.back().num_matches, serial.back().num_inliers,
+         MotionEstimateStatusCodeStrings[serial.back().status]);
+  if (num_failures) {
+    printf("FAILED\n");
+    return 1;
+  }
+  printf("threaded results match\n");
+  return 0;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <stdio.h>
 #include <string>
@@ -25,6 +26,7 @@ static void Usage(void)
    cout << "\t--saveSkip=          only write one of every N processed frames" << endl;
    cout << "\t--no-rects           start with detection rectangles disabled" << endl;
    cout << "\t--no-tracking        start with tracking rectangles disabled" << endl;
+   cout << "\t--depthFilter        start with filtering detections using depth enabled" << endl;
    cout << "\t--no-detection       disable object detection" << endl;
    cout << "\t--d12Base=           base directory for d12 info" << endl;
    cout << "\t--d12Dir=            pick d12 dir and stage number" << endl;
@@ -44,6 +46,30 @@ static void Usage(void)
    cout << "\t--c24Threshold=      set c24 detection threshold" << endl;
    cout << "\t--groundTruth        only test frames which have ground truth data " << endl;
    cout << "\t--xmlFile=           XML file to read/write settings to/from" << endl;
+   cout << "\t--pipeline=          run capture, goal detect, optical flow, detection, tracking" << endl;
+   cout << "\t                     and display in separate threads. latency drops stale frames," << endl;
+   cout << "\t                     throughput processes every frame (batch ZMS replays)" << endl;
+   cout << "\t--pipelineDepth=     frames queued between pipeline stages" << endl;
+   cout << "\t--fullDetect=        search the full frame for objects once every N frames." << endl;
+   cout << "\t                     Frames in between only search near tracked objects and" << endl;
+   cout << "\t                     newly visible parts of the frame" << endl;
+   cout << "\t--d12Budget=         max number of windows to run through d12 each frame." << endl;
+   cout << "\t                     Windows most likely to hold an object are kept. 0 = no limit" << endl;
+   cout << "\t--batchTune          time each net at several batch sizes when loading it and" << endl;
+   cout << "\t                     use the fastest one" << endl;
+   cout << "\t--trackSolver=       hungarian or jv - algorithm used to match detections to tracks" << endl;
+   cout << "\t--flowTrack          keep optical flow corners from frame to frame instead of" << endl;
+   cout << "\t                     searching the full frame for new ones each time" << endl;
+   cout << "\t--flowScale=         run optical flow on the frame scaled by this (0-1]" << endl;
+   cout << "\t--zmsThreads=        number of threads decoding ZMS input files" << endl;
+   cout << "\t--zmsReadAhead=      max number of decoded ZMS frames to queue up" << endl;
+   cout << "\t--zmsCodec=          compression for ZMS output : zlib, lz4 or zstd, optionally" << endl;
+   cout << "\t                     followed by :level, ,float to store unquantized depth and" << endl;
+   cout << "\t                     ,interleaved to skip splitting color planes" << endl;
+   cout << "\t--writeQueue=        number of frames queued up waiting to be written to video output" << endl;
+   cout << "\t--writePolicy=       oldest, newest or block - drop the oldest or newest frame when" << endl;
+   cout << "\t                     the write queue is full, or wait for room" << endl;
+   cout << "\t--writeThreads=      number of threads compressing ZMS or PNG output frames" << endl;
    cout << endl;
    cout << "Examples:" << endl;
    cout << "test : start in GUI mode, open default camera, start detecting and tracking while displaying results in the GUI" << endl;
@@ -56,6 +82,7 @@ Args::Args(void)
 	captureAll         = false;
 	tracking           = true;
 	rects              = true;
+	filterUsingDepth   = false;
 	batchMode          = false;
 	pause              = false;
 	skip               = 0;
@@ -84,6 +111,19 @@ Args::Args(void)
 	frameStart         = 0.0;
 	groundTruth        = false;
 	xmlFilename        = "/home/ubuntu/2016VisionCode/zebravision/settings.xml";
+	pipeline           = PIPELINE_OFF;
+	pipelineDepth      = 2;
+	fullDetectInterval = 1;
+	d12WindowBudget    = 0;
+	batchTune          = false;
+	trackSolver        = AssignmentProblemSolver::optimal;
+	flowTrack          = false;
+	flowScale          = 1.0;
+	zmsThreads         = 0;
+	zmsReadAhead       = 0;
+	writeQueueDepth    = 1;
+	writePolicy        = BQ_DROP_OLDEST;
+	writeThreads       = 1;
 }
 
 bool Args::processArgs(int argc, const char **argv)
@@ -100,6 +140,7 @@ bool Args::processArgs(int argc, const char **argv)
 	const string saveVideoSkipOpt   = "--saveSkip=";       // only write every N frames of processed video
 	const string rectsOpt           = "--no-rects";        // start with detection rectangles disabled
 	const string trackingOpt        = "--no-tracking";     // start with tracking rectangles disabled
+	const string depthFilterOpt     = "--depthFilter";     // start with depth filtering enabled
 	const string detectOpt          = "--no-detection";    // disable object detection
 	const string d12BaseOpt         = "--d12Base=";        // d12 base dir
 	const string d12DirOpt          = "--d12Dir=";         // pick d12 dir and stage number
@@ -119,6 +160,20 @@ bool Args::processArgs(int argc, const char **argv)
 	const string c24ThresholdOpt    = "--c24Threshold=";    
 	const string groundTruthOpt     = "--groundTruth";     // only test frames which have ground truth data
 	const string xmlFileOpt         = "--xmlFile=";        // read camera settings from XML file
+	const string pipelineOpt        = "--pipeline=";       // threaded pipeline, latency or throughput
+	const string pipelineDepthOpt   = "--pipelineDepth=";  // queue depth between pipeline stages
+	const string fullDetectOpt      = "--fullDetect=";     // full frame detection every N frames
+	const string d12BudgetOpt       = "--d12Budget=";      // max d12 windows per frame
+	const string batchTuneOpt       = "--batchTune";       // pick net batch sizes at startup
+	const string trackSolverOpt     = "--trackSolver=";    // track assignment algorithm
+	const string flowTrackOpt       = "--flowTrack";       // reuse optical flow corners
+	const string flowScaleOpt       = "--flowScale=";      // optical flow frame scale
+	const string zmsThreadsOpt      = "--zmsThreads=";     // ZMS decode thread count
+	const string zmsReadAheadOpt    = "--zmsReadAhead=";   // decoded ZMS frames queued
+	const string zmsCodecOpt        = "--zmsCodec=";       // ZMS output compression
+	const string writeQueueOpt      = "--writeQueue=";     // video output queue depth
+	const string writePolicyOpt     = "--writePolicy=";    // what to drop when the output queue is full
+	const string writeThreadsOpt    = "--writeThreads=";   // video output compression threads
 	const string badOpt             = "--";
 	// Read through command line args, extract
 	// cmd line parameters and input filename
@@ -151,6 +206,8 @@ bool Args::processArgs(int argc, const char **argv)
 			tracking = false;
 		else if (rectsOpt.compare(0, rectsOpt.length(), argv[fileArgc], rectsOpt.length()) == 0)
 			rects = false;
+		else if (depthFilterOpt.compare(0, depthFilterOpt.length(), argv[fileArgc], depthFilterOpt.length()) == 0)
+			filterUsingDepth = true;
 		else if (d12BaseOpt.compare(0, d12BaseOpt.length(), argv[fileArgc], d12BaseOpt.length()) == 0)
 			d12BaseDir = string(argv[fileArgc] + d12BaseOpt.length());
 		else if (d12DirOpt.compare(0, d12DirOpt.length(), argv[fileArgc], d12DirOpt.length()) == 0)
@@ -187,6 +244,89 @@ bool Args::processArgs(int argc, const char **argv)
 			groundTruth = true;
 		else if (xmlFileOpt.compare(0, xmlFileOpt.length(), argv[fileArgc], xmlFileOpt.length()) == 0)
 			xmlFilename = string(argv[fileArgc] + xmlFileOpt.length());
+		else if (pipelineOpt.compare(0, pipelineOpt.length(), argv[fileArgc], pipelineOpt.length()) == 0)
+		{
+			const string mode(argv[fileArgc] + pipelineOpt.length());
+			if (mode == "latency")
+				pipeline = PIPELINE_LATENCY;
+			else if (mode == "throughput")
+				pipeline = PIPELINE_THROUGHPUT;
+			else if (mode == "off")
+				pipeline = PIPELINE_OFF;
+			else
+			{
+				cerr << "Unknown pipeline mode " << mode << endl;
+				Usage();
+				return false;
+			}
+		}
+		else if (pipelineDepthOpt.compare(0, pipelineDepthOpt.length(), argv[fileArgc], pipelineDepthOpt.length()) == 0)
+			pipelineDepth = atoi(argv[fileArgc] + pipelineDepthOpt.length());
+		else if (fullDetectOpt.compare(0, fullDetectOpt.length(), argv[fileArgc], fullDetectOpt.length()) == 0)
+			fullDetectInterval = atoi(argv[fileArgc] + fullDetectOpt.length());
+		else if (d12BudgetOpt.compare(0, d12BudgetOpt.length(), argv[fileArgc], d12BudgetOpt.length()) == 0)
+			d12WindowBudget = max(0, atoi(argv[fileArgc] + d12BudgetOpt.length()));
+		else if (batchTuneOpt.compare(0, batchTuneOpt.length(), argv[fileArgc], batchTuneOpt.length()) == 0)
+			batchTune = true;
+		else if (trackSolverOpt.compare(0, trackSolverOpt.length(), argv[fileArgc], trackSolverOpt.length()) == 0)
+		{
+			const string solver(argv[fileArgc] + trackSolverOpt.length());
+			if (solver == "hungarian")
+				trackSolver = AssignmentProblemSolver::optimal;
+			else if (solver == "jv")
+				trackSolver = AssignmentProblemSolver::jonker_volgenant;
+			else
+			{
+				cerr << "Unknown track solver " << solver << endl;
+				Usage();
+				return false;
+			}
+		}
+		else if (flowTrackOpt.compare(0, flowTrackOpt.length(), argv[fileArgc], flowTrackOpt.length()) == 0)
+			flowTrack = true;
+		else if (flowScaleOpt.compare(0, flowScaleOpt.length(), argv[fileArgc], flowScaleOpt.length()) == 0)
+		{
+			flowScale = atof(argv[fileArgc] + flowScaleOpt.length());
+			if ((flowScale <= 0.) || (flowScale > 1.))
+			{
+				cerr << "Invalid flow scale " << flowScale << endl;
+				Usage();
+				return false;
+			}
+		}
+		else if (zmsThreadsOpt.compare(0, zmsThreadsOpt.length(), argv[fileArgc], zmsThreadsOpt.length()) == 0)
+			zmsThreads = atoi(argv[fileArgc] + zmsThreadsOpt.length());
+		else if (zmsReadAheadOpt.compare(0, zmsReadAheadOpt.length(), argv[fileArgc], zmsReadAheadOpt.length()) == 0)
+			zmsReadAhead = atoi(argv[fileArgc] + zmsReadAheadOpt.length());
+		else if (zmsCodecOpt.compare(0, zmsCodecOpt.length(), argv[fileArgc], zmsCodecOpt.length()) == 0)
+		{
+			if (!zmsParseCodec(argv[fileArgc] + zmsCodecOpt.length(), zmsCodec))
+			{
+				cerr << "Invalid ZMS codec " << argv[fileArgc] + zmsCodecOpt.length() << endl;
+				Usage();
+				return false;
+			}
+		}
+		else if (writeQueueOpt.compare(0, writeQueueOpt.length(), argv[fileArgc], writeQueueOpt.length()) == 0)
+			writeQueueDepth = max(1, atoi(argv[fileArgc] + writeQueueOpt.length()));
+		else if (writePolicyOpt.compare(0, writePolicyOpt.length(), argv[fileArgc], writePolicyOpt.length()) == 0)
+		{
+			const string policy(argv[fileArgc] + writePolicyOpt.length());
+			if (policy == "oldest")
+				writePolicy = BQ_DROP_OLDEST;
+			else if (policy == "newest")
+				writePolicy = BQ_DROP_NEWEST;
+			else if (policy == "block")
+				writePolicy = BQ_BLOCK;
+			else
+			{
+				cerr << "Unknown write policy " << policy << endl;
+				Usage();
+				return false;
+			}
+		}
+		else if (writeThreadsOpt.compare(0, writeThreadsOpt.length(), argv[fileArgc], writeThreadsOpt.length()) == 0)
+			writeThreads = max(1, atoi(argv[fileArgc] + writeThreadsOpt.length()));
 		else if (badOpt.compare(0, badOpt.length(), argv[fileArgc], badOpt.length()) == 0) // unknown option
 		{
 			cerr << "Unknown command line option " << argv[fileArgc] << endl;
@@ -2,6 +2,17 @@
 #define INC__ARGS_HPP__
 
 #include <string>
+#include "boundedqueue.hpp"
+#include "hungarian.hpp"
+#include "zmscodec.hpp"
+
+// How zv schedules the per-frame work
+enum PipelineMode
+{
+	PIPELINE_OFF,        // run everything serially in the main loop
+	PIPELINE_LATENCY,    // staged threads, drop stale frames to keep up
+	PIPELINE_THROUGHPUT  // staged threads, process every input frame
+};
 
 class Args //class for processing arguments
 {
@@ -9,6 +20,7 @@ class Args //class for processing arguments
 		bool captureAll;       // capture all found targets to image files?
 		bool tracking;         // display tracking info?
 		bool rects;            // display frame by frame hit info
+		bool filterUsingDepth; // throw out detections at the wrong depth
 		bool batchMode;        // non-interactive mode - no display, run through
 						       // as quickly as possible. Combine with --all?
 		bool pause;            // start paused
@@ -39,6 +51,21 @@ class Args //class for processing arguments
 		std::string inputName; // input file name or camera number
 		bool groundTruth;      // only test frames with ground truth data
 		std::string xmlFilename;   // XML settings file
+		PipelineMode pipeline;     // serial or threaded per-frame processing
+		int  pipelineDepth;        // frames queued between pipeline stages
+		int  fullDetectInterval;   // if > 1, only search the full frame every N frames,
+		                           // searching near tracked objects in between
+		int  zmsThreads;           // threads decoding ZMS input, 0 = pick based on CPU count
+		int  zmsReadAhead;         // max decoded ZMS frames queued ahead of processing, 0 = default
+		ZMSCodec zmsCodec;         // compression used for ZMS output
+		int  writeQueueDepth;      // frames queued up waiting to be written to video output
+		BoundedQueuePolicy writePolicy; // what to do with output frames when that queue is full
+		int  writeThreads;         // threads compressing output frames, if the format allows it
+		int  d12WindowBudget;      // max windows run through d12 per frame, 0 = no limit
+		bool batchTune;            // time nets at startup to pick their batch sizes
+		AssignmentProblemSolver::TMethod trackSolver; // algorithm matching detections to tracks
+		bool flowTrack;            // keep optical flow corners between frames
+		double flowScale;          // scale of frame used for optical flow
 
 		Args(void);
 		bool processArgs(int argc, const char **argv);
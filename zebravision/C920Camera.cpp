@@ -9,6 +9,7 @@
  */
 #include <iostream>
 #include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 #include "C920Camera.h"
 
 #define CLEAR(x) memset (&(x), 0, sizeof (x))
@@ -30,6 +31,34 @@ namespace v4l2 {
 		numerator = CAPTURE_FPS_NUMERATOR[fps];
 		denominator = CAPTURE_FPS_DENOMINATOR[fps];
 	}
+	bool DecodeMJPEG(const unsigned char *src, size_t length, int scale, cv::Mat &dst)
+	{
+		// Every JPEG starts with an SOI marker. Checking for it up front
+		// matters since a failed imdecode can leave dst untouched
+		if ((length < 2) || (src[0] != 0xFF) || (src[1] != 0xD8))
+			return false;
+
+		// Wrap the compressed data rather than copying it
+		const cv::Mat buf(1, length, CV_8UC1, const_cast<unsigned char *>(src));
+#if (CV_MAJOR_VERSION > 3) || ((CV_MAJOR_VERSION == 3) && (CV_MINOR_VERSION >= 1))
+		// The reduced modes set libjpeg's scale_denom, which
+		// skips most of the IDCT work for the dropped pixels
+		int flags;
+		switch (scale)
+		{
+			case 2:  flags = cv::IMREAD_REDUCED_COLOR_2; break;
+			case 4:  flags = cv::IMREAD_REDUCED_COLOR_4; break;
+			case 8:  flags = cv::IMREAD_REDUCED_COLOR_8; break;
+			default: flags = cv::IMREAD_COLOR; break;
+		}
+		cv::imdecode(buf, flags, &dst);
+#else
+		cv::imdecode(buf, 1, &dst);
+		for (int s = scale; s > 1; s /= 2)
+			cv::pyrDown(dst, dst);
+#endif
+		return !dst.empty();
+	}
 	static int xioctl(int fd, int request, void *arg) {
 		int r;
 		do {
@@ -80,21 +109,17 @@ namespace v4l2 {
 	IplImage* C920Camera::RetrieveFrame() {
 		return this->RetrieveFrame(this->capture);
 	}
-	bool C920Camera::RetrieveMat(cv::Mat &image) {
-		IplImage* _img = this->RetrieveFrame(this->capture);
-		if (!_img) {
+	bool C920Camera::RetrieveMat(cv::Mat &image, int scale) {
+		// Decode straight from the mmap'd driver buffer into image
+		if (!this->capture || (this->capture->BufferIndex < 0) ||
+			!DecodeMJPEG((const unsigned char *) this->capture->Buffers[this->capture->BufferIndex].start,
+				         this->capture->BytesUsed, scale, image) ||
+			(image.cols != (int)(this->capture->V4L2Format.fmt.pix.width + scale - 1) / scale) ||
+			(image.rows != (int)(this->capture->V4L2Format.fmt.pix.height + scale - 1) / scale)) {
+			fprintf(stdout, "C920Camera::RetrieveMat ERROR: Unable to decode frame.\n");
 			image.release();
 			return false;
 		}
-#if CV_MAJOR_VERSION == 2
-		cv::Mat temp(_img);
-#elif CV_MAJOR_VERSION == 3
-		cv::Mat temp = cv::cvarrToMat(_img);
-#endif
-		if (_img->origin == IPL_ORIGIN_TL)
-			temp.copyTo(image);
-		else 
-			cv::flip(temp, image, 0);
 		return true;
 	}
 	bool C920Camera::ChangeCaptureSize(enum CaptureSize cameracapturesize) {
@@ -273,11 +298,6 @@ namespace v4l2 {
 			fprintf(stdout, "V4L2Camera INFO: Closing capture frame %s.\n", capture->DeviceName);
 			if (capture->Frame.imageData)
 				cvFree(&capture->Frame.imageData);
-			fprintf(stdout, "V4L2Camera INFO: Closing capture buffer %s.\n", capture->DeviceName);
-			if (capture->Buffers[MAX_V4L_BUFFERS].start) {
-				free(capture->Buffers[MAX_V4L_BUFFERS].start);
-				capture->Buffers[MAX_V4L_BUFFERS].start = NULL;
-			}
 			free(capture->DeviceName);
 			capture->DeviceName = NULL;
 		}
@@ -303,7 +323,7 @@ namespace v4l2 {
 		return capture;
 	}
 	int C920Camera::InitializeCapture(V4L2CameraCapture* capture) {
-		capture->Buffers[MAX_V4L_BUFFERS].start = NULL;
+		capture->BufferIndex = -1;
 		fprintf(stdout, "C920Camera::InitilizeCapture INFO: Opening capture device %s.\n", capture->DeviceName);
 		capture->DeviceHandle = open(capture->DeviceName, O_RDWR /* required */| O_NONBLOCK, 0);
 		if (capture->DeviceHandle == 0) {
@@ -418,14 +438,6 @@ try_again: capture->V4L2RequestBuffers.count = buffer_number;
 				   this->CloseCapture(capture);
 				   return -4;
 			   }
-			   if (n_buffers == 0) {
-				   if (capture->Buffers[MAX_V4L_BUFFERS].start) {
-					   free(capture->Buffers[MAX_V4L_BUFFERS].start);
-					   capture->Buffers[MAX_V4L_BUFFERS].start = NULL;
-				   }
-				   capture->Buffers[MAX_V4L_BUFFERS].start = malloc(buffer.length);
-				   capture->Buffers[MAX_V4L_BUFFERS].length = buffer.length;
-			   };
 		   }
 		   return true;
 	}
@@ -444,6 +456,7 @@ try_again: capture->V4L2RequestBuffers.count = buffer_number;
 					return false;
 				}
 			}
+			capture->BufferIndex = -1;
 			fprintf(stdout, "C920Camera::GrabFrame INFO: Starting capture device stream %s.\n", capture->DeviceName);
 			/* enable the streaming */
 			capture->V4L2BufferType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -456,9 +469,12 @@ try_again: capture->V4L2RequestBuffers.count = buffer_number;
 			this->V4L2Loop(capture);
 			capture->NeedsCaptureInitialization = false;
 		}
+		// Give the last frame's buffer back to the driver so
+		// all of them are queued while waiting for the next one
+		this->RequeueBuffer(capture);
 		// Read Frame from camera.
 		this->V4L2Loop(capture);
-		return true;
+		return capture->BufferIndex >= 0;
 	}
 	void C920Camera::V4L2Loop(V4L2CameraCapture* capture) {
 		while (true) {
@@ -504,14 +520,40 @@ try_again: capture->V4L2RequestBuffers.count = buffer_number;
 			}
 		}
 		assert(buf.index < capture->V4L2RequestBuffers.count);
-		memcpy(capture->Buffers[MAX_V4L_BUFFERS].start, capture->Buffers[buf.index].start,
-				capture->Buffers[MAX_V4L_BUFFERS].length);
-		capture->BufferIndex = MAX_V4L_BUFFERS;
+		// Hang on to the buffer until the next grab so it can
+		// be decoded without copying it out first
+		capture->BufferIndex = buf.index;
+		capture->BytesUsed = buf.bytesused ? buf.bytesused : capture->Buffers[buf.index].length;
+		// If processing fell behind, more than one buffer can be
+		// full. Skip ahead to the newest rather than returning
+		// frames which are already stale
+		while (true) {
+			struct v4l2_buffer newer;
+			CLEAR(newer);
+			newer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			newer.memory = V4L2_MEMORY_MMAP;
+			if (-1 == xioctl(capture->DeviceHandle, VIDIOC_DQBUF, &newer))
+				break;
+			assert(newer.index < capture->V4L2RequestBuffers.count);
+			this->RequeueBuffer(capture);
+			capture->BufferIndex = newer.index;
+			capture->BytesUsed = newer.bytesused ? newer.bytesused : capture->Buffers[newer.index].length;
+		}
 		// printf("got data in buff %d, len=%d, flags=0x%X, seq=%d, used=%d)\n", buf.index, buf.length, buf.flags, buf.sequence,
 		// buf.bytesused);
+		return 1;
+	}
+	void C920Camera::RequeueBuffer(V4L2CameraCapture* capture) {
+		if (capture->BufferIndex < 0)
+			return;
+		struct v4l2_buffer buf;
+		CLEAR(buf);
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index = capture->BufferIndex;
 		if (-1 == xioctl(capture->DeviceHandle, VIDIOC_QBUF, &buf))
 			perror("VIDIOC_QBUF");
-		return 1;
+		capture->BufferIndex = -1;
 	}
 	IplImage* C920Camera::RetrieveFrame(V4L2CameraCapture* capture) {
 		// Resize Frame if Format size has changed.
@@ -522,25 +564,20 @@ try_again: capture->V4L2RequestBuffers.count = buffer_number;
 					IPL_DEPTH_8U, 3, IPL_ORIGIN_TL, 4);
 			capture->Frame.imageData = (char *) cvAlloc(capture->Frame.imageSize);
 		}
-		// Decode image from MJPEG to RGB24
-		if ((capture->Buffers[capture->BufferIndex].start) &&
-			!this->MJPEG2RGB24(capture->V4L2Format.fmt.pix.width, 
-				               capture->V4L2Format.fmt.pix.height,
-					           (unsigned char*) capture->Buffers[capture->BufferIndex].start, 
-							   capture->Buffers[capture->BufferIndex].length,
-					           (unsigned char*) capture->Frame.imageData)) {
+		// Decode image from MJPEG to RGB24. The Mat header points
+		// at Frame's data so imdecode fills it in directly
+		cv::Mat dst(capture->Frame.height, capture->Frame.width, CV_8UC3,
+				    capture->Frame.imageData, capture->Frame.widthStep);
+		const uchar *data = dst.data;
+		if ((capture->BufferIndex < 0) ||
+			!DecodeMJPEG((const unsigned char*) capture->Buffers[capture->BufferIndex].start,
+				         capture->BytesUsed, 1, dst) ||
+			(dst.data != data)) {
 			fprintf(stdout, "C920Camera::RetrieveFrame ERROR: Unable to decode frame.\n");
 			return 0;
 		}
 		return &capture->Frame;
 	}
-	bool C920Camera::MJPEG2RGB24(int width, int height, unsigned char *src, int length, unsigned char *dst) {
-		cv::Mat temp = cv::imdecode(cv::Mat(std::vector<uchar>(src, src + length)), 1);
-		if (!temp.data || temp.cols != width || temp.rows != height)
-			return false;
-		memcpy(dst, temp.data, width * height * 3);
-		return true;
-	}
 	int C920Camera::SetControl(V4L2CameraCapture* capture) {
 		if (xioctl(capture->DeviceHandle, VIDIOC_S_CTRL, &capture->V4L2Control) == -1) {
 			fprintf(stderr, "C920Camera::SetControl ERROR: Unable to set control...\n");
@@ -60,6 +60,12 @@ namespace v4l2 {
    };
    void GetCaptureFPS(enum CaptureFPS fps, unsigned int &numerator, unsigned int &denominator);
 
+   // Decode one MJPEG frame into dst, reusing dst's buffer when it is
+   // already the right size. A scale of 2, 4 or 8 shrinks the image by
+   // that much while decoding. Split out of the camera class so recorded
+   // MJPEG streams can be run through exactly the same code
+   bool DecodeMJPEG(const unsigned char *src, size_t length, int scale, cv::Mat &dst);
+
    struct V4L2Buffer {
       void * start;
       size_t length;
@@ -71,8 +77,12 @@ namespace v4l2 {
       enum CaptureSize CameraCaptureSize;
       enum CaptureFPS CameraCaptureFPS;
       IplImage Frame;
+      // Buffer dequeued by the last grab, or -1 if none. It is
+      // decoded in place and only given back to the driver at the
+      // start of the next grab
       int BufferIndex;
-      V4L2Buffer Buffers[DEFAULT_V4L_BUFFERS + 1];
+      size_t BytesUsed;
+      V4L2Buffer Buffers[MAX_V4L_BUFFERS];
       /* V4L2 Structs */
       struct v4l2_capability V4L2Capability;
       struct v4l2_format V4L2Format;
@@ -95,7 +105,9 @@ namespace v4l2 {
          bool IsOpen() const;
          bool GrabFrame();
          IplImage* RetrieveFrame();
-         bool RetrieveMat(cv::Mat &frame);
+         // Decodes into frame, reusing its buffer if it is the right
+         // size. scale is passed through to DecodeMJPEG
+         bool RetrieveMat(cv::Mat &frame, int scale = 1);
          bool ChangeCaptureSizeAndFPS(enum CaptureSize cameracapturesize, enum CaptureFPS cameracapturefps);
          bool ChangeCaptureSize(enum CaptureSize cameracapturesize);
          bool ChangeCaptureFPS(enum CaptureFPS cameracapturefps);
@@ -126,8 +138,8 @@ namespace v4l2 {
          bool GrabFrame(V4L2CameraCapture* capture);
          void V4L2Loop(V4L2CameraCapture* capture);
          int ReadFrame(V4L2CameraCapture* capture);
+         void RequeueBuffer(V4L2CameraCapture* capture);
          IplImage* RetrieveFrame(V4L2CameraCapture* capture);
-         bool MJPEG2RGB24(int width, int height, unsigned char *src, int length, unsigned char *dst);
          int SetControl(V4L2CameraCapture* capture);
          int GetControl(V4L2CameraCapture* capture);
    };
@@ -32,7 +32,8 @@ CaffeClassifier<MatT>::CaffeClassifier(const string& modelFile,
       const string& labelFile,
       const size_t  batchSize) :
 	Classifier<MatT>(modelFile, trainedFile, zcaWeightFile, labelFile, batchSize),
-	initialized_(false)
+	initialized_(false),
+	modelFile_(modelFile)
 {
 	// Base class loads labels and ZCA preprocessing data.
 	// If those fail, bail out immediately.
@@ -110,54 +111,60 @@ CaffeClassifier<MatT>::CaffeClassifier(const string& modelFile,
 	// Forward dimension change to all layers
 	net_->Reshape();
 
-	// The wrap code puts the buffer for each individual channel
-	// input to the net (one color channel of one image) into 
-	// a separate Mat 
-	// The inner vector here will be one Mat per channel of the 
-	// input to the net. The outer vector is a vector of those
-	// one for each of the batched input images.
-	// This allows an easy copy from the input images
-	// into the input buffers for the net by simply doing
-	// an OpenCV split() call to split a 3-channel input
-	// image into 3 separate 1-channel images arranged in
-	// the correct order
-	// 
-	// GPU code path writes directly to the mutable_gpu_data()
-	// pointer so no wrapping is needed
-	if (!IsGPU())
-	{
-		Blob<float>* inputLayer = net_->input_blobs()[0];
+	updateBatchNets();
 
-		const size_t width  = inputLayer->width();
-		const size_t height = inputLayer->height();
-		const size_t num    = inputLayer->num();
+	// We made it!
+	initialized_ = true;
+}
 
-		float* inputData = inputLayer->mutable_cpu_data();
 
-		inputBatch_.clear();
+// TODO : this probably isn't needed
+template <class MatT>
+CaffeClassifier<MatT>::~CaffeClassifier()
+{
+}
+
+// Number of differently sized nets to keep around. Each
+// is half the batch size of the previous one
+static const size_t batchNetCount = 4;
 
-		for (size_t j = 0; j < num; j++)
+template <class MatT>
+void CaffeClassifier<MatT>::updateBatchNets(void)
+{
+	map<size_t, shared_ptr<Net<float>>> batchNets;
+	size_t size = this->batchSize_;
+	for (size_t i = 0; (i < batchNetCount) && (size > 0); i++, size /= 2)
+	{
+		// Reuse nets from previous batch sizes where possible,
+		// creating and reshaping a net isn't cheap
+		auto it = batchNets_.find(size);
+		if (it != batchNets_.end())
+			batchNets[size] = it->second;
+		else if (size == this->maxBatchSize_)
+			batchNets[size] = net_;
+		else
 		{
-			vector<MatT> inputChannels;
-			for (int i = 0; i < inputLayer->channels(); ++i)
-			{
-				MatT channel(height, width, CV_32FC1, inputData);
-				inputChannels.push_back(channel);
-				inputData += width * height;
-			}
-			inputBatch_.push_back(vector<MatT>(inputChannels));
+			// Only the layer outputs are allocated per-net,
+			// the trained weights are shared with net_
+			shared_ptr<Net<float>> net(new Net<float>(modelFile_, TEST));
+			net->ShareTrainedLayersWith(net_.get());
+			Blob<float>* inputLayer = net->input_blobs()[0];
+			inputLayer->Reshape(size, inputLayer->channels(),
+								inputLayer->height(),
+								inputLayer->width());
+			net->Reshape();
+			batchNets[size] = net;
 		}
 	}
-	
-	// We made it!
-	initialized_ = true;
+	batchNets_.swap(batchNets);
 }
 
-
-// TODO : this probably isn't needed
 template <class MatT>
-CaffeClassifier<MatT>::~CaffeClassifier()
+void CaffeClassifier<MatT>::setBatchSize(size_t batchSize)
 {
+	Classifier<MatT>::setBatchSize(batchSize);
+	if (net_)
+		updateBatchNets();
 }
 
 // Get the output values for a set of images in one flat vector
@@ -170,15 +177,30 @@ CaffeClassifier<MatT>::~CaffeClassifier()
 template <class MatT>
 vector<float> CaffeClassifier<MatT>::PredictBatch(const vector<MatT> &imgs) 
 {
+	// Caffe's CPU / GPU mode is per-thread. The net
+	// might have been loaded by a different thread than
+	// the one using it, so make sure this thread's mode matches
+	const Caffe::Brew mode = IsGPU() ? Caffe::GPU : Caffe::CPU;
+	if (Caffe::mode() != mode)
+		Caffe::set_mode(mode);
+
+	// Use the smallest net which holds all of the images.
+	// Inputs past the end of imgs are left over from a
+	// previous batch and their outputs are ignored
+	auto netIt = batchNets_.lower_bound(imgs.size());
+	CHECK(netIt != batchNets_.end()) <<
+		"PredictBatch() : too many input images : batch size is " << this->batchSize_ << " imgs.size() = " << imgs.size();
+	Net<float> *net = netIt->second.get();
+
 	// Process each image so they match the format
 	// expected by the net, then copy the images
 	// into the net's input buffers
 	//double start = gtod_wrapper();
-	PreprocessBatch(imgs);
+	PreprocessBatch(imgs, net->input_blobs()[0]);
 	//cout << "PreprocessBatch " << gtod_wrapper() - start << endl;
 	//start = gtod_wrapper();
 	// Run a forward pass with the data filled in from above
-	net_->Forward();
+	net->Forward();
 	//cout << "Forward " << gtod_wrapper() - start << endl;
 
 	//start = gtod_wrapper();
@@ -186,7 +208,7 @@ vector<float> CaffeClassifier<MatT>::PredictBatch(const vector<MatT> &imgs)
 	// Use CPU data output unconditionally - it has
 	// to end up back at the CPU eventually so do it
 	// now ... just as good as any other time
-	Blob<float>* outputLayer = net_->output_blobs()[0];
+	Blob<float>* outputLayer = net->output_blobs()[0];
 	const float* begin = outputLayer->cpu_data();
 	const float* end = begin + outputLayer->channels()*imgs.size();
 	//cout << "Output " << gtod_wrapper() - start << endl;
@@ -197,28 +219,18 @@ vector<float> CaffeClassifier<MatT>::PredictBatch(const vector<MatT> &imgs)
 // and apply ZCA whitening to preprocess the files
 // Then actually write the images to the net input memory buffers
 template <>
-void CaffeClassifier<Mat>::PreprocessBatch(const vector<Mat> &imgs)
+void CaffeClassifier<Mat>::PreprocessBatch(const vector<Mat> &imgs, Blob<float> *inputLayer)
 {
 	CHECK(imgs.size() <= this->batchSize_) <<
 		"PreprocessBatch() : too many input images : batch size is " << this->batchSize_ << "imgs.size() = " << imgs.size(); 
 
-	vector<Mat> zcaImgs = this->zca_.Transform32FC3(imgs);
-
-	// Hack to reset input layer to think that
-	// data is on the CPU side.  Only really needed
+	// ZCA code normalizes each image and writes the whitened
+	// results directly into the net's input buffer as separate
+	// BGR planes. Calling mutable_cpu_data() also resets the input
+	// layer to think that data is on the CPU side, needed
 	// when CPU & GPU operations are combined
-	net_->input_blobs()[0]->mutable_cpu_data()[0] = 0;
-
-	// For each image in the list, copy it to 
-	// the net's input buffer
-	for (size_t i = 0 ; i < zcaImgs.size(); i++)
-	{
-		/* This operation will write the separate BGR planes directly to the
-		 * input layer of the network because it is wrapped by the MatT
-		 * objects in inputChannels. */
-		vector<Mat> *inputChannels = &inputBatch_.at(i);
-		split(zcaImgs[i], *inputChannels);
-	}
+	float* inputData = inputLayer->mutable_cpu_data();
+	this->zca_.Transform32FC3(imgs, inputData);
 }
 
 // Take each image in GpuMat, convert it to the correct image type,
@@ -227,12 +239,12 @@ void CaffeClassifier<Mat>::PreprocessBatch(const vector<Mat> &imgs)
 // that function copies its final results directly into the
 // input buffers of the net.
 template <>
-void CaffeClassifier<GpuMat>::PreprocessBatch(const vector<GpuMat> &imgs)
+void CaffeClassifier<GpuMat>::PreprocessBatch(const vector<GpuMat> &imgs, Blob<float> *inputLayer)
 {
 	CHECK(imgs.size() <= this->batchSize_) <<
 		"PreprocessBatch() : too many input images : batch size is " << this->batchSize_ << "imgs.size() = " << imgs.size(); 
 
-	float* inputData = net_->input_blobs()[0]->mutable_gpu_data();
+	float* inputData = inputLayer->mutable_gpu_data();
 	this->zca_.Transform32FC3(imgs, inputData);
 }
 
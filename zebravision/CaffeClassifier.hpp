@@ -1,4 +1,5 @@
 #pragma once
+#include <map>
 #include <caffe/caffe.hpp>
 #include "Classifier.hpp"
 
@@ -19,13 +20,16 @@ class CaffeClassifier : public Classifier<MatT>
 
 		bool initialized(void) const;
 
+		// Also updates the nets used for partial batches
+		void setBatchSize(size_t batchSize);
+
 	private:
 		// Take each image in Mat, convert it to the correct image type,
 		// color depth, size to match the net input. Convert to 
 		// F32 type, since that's what the net inputs are. 
 		// Subtract out the mean before passing to the net input
 		// Then actually write the images to the net input memory buffers
-		void PreprocessBatch(const std::vector<MatT> &imgs);
+		void PreprocessBatch(const std::vector<MatT> &imgs, caffe::Blob<float> *inputLayer);
 
 		// Get the output values for a set of images
 		// These values will be in the same order as the labels for each
@@ -40,7 +44,17 @@ class CaffeClassifier : public Classifier<MatT>
 		// on whether we're using GpuMats or Mats
 		bool IsGPU(void) const;
 
-		std::shared_ptr<caffe::Net<float>> net_; // the net itself
-		std::vector< std::vector<MatT>> inputBatch_; // net input buffers wrapped in Mats - used for CPU code only 
+		// Set up nets for the current batch size and a few
+		// smaller ones.  The net is always run for a full batch,
+		// so without these a list of windows which ends with a
+		// small partial batch pays for a full-sized forward pass
+		void updateBatchNets(void);
+
+		std::shared_ptr<caffe::Net<float>> net_; // the net itself, sized for maxBatchSize_
 		bool initialized_;   // set to true once the net is correctly initialzied
+		std::string modelFile_;
+
+		// Nets reshaped for various batch sizes, keyed by
+		// batch size. All share their weights with net_
+		std::map<size_t, std::shared_ptr<caffe::Net<float>>> batchNets_;
 };
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <sys/stat.h>
@@ -25,6 +27,7 @@ Classifier<MatT>::Classifier(const string& modelFile,
       const string& labelFile,
       const size_t  batchSize) :
 	batchSize_(batchSize),
+	maxBatchSize_(batchSize),
 	zca_(zcaWeightFile, batchSize)
 {
 	(void)modelFile;
@@ -99,6 +102,25 @@ vector< vector<Prediction> > Classifier<MatT>::ClassifyBatch(
 	return floatsToPredictions(outputBatch, imgs.size(), numClasses);
 }
 
+template <class MatT>
+void Classifier<MatT>::ScoreBatch(const vector<MatT> &imgs, const size_t labelIdx, vector<float> &scores)
+{
+	const vector<float> outputBatch = PredictBatch(imgs);
+	const size_t labelsSize = labels_.size();
+	scores.resize(imgs.size());
+	for (size_t i = 0; i < imgs.size(); i++)
+		scores[i] = outputBatch[i * labelsSize + labelIdx];
+}
+
+template <class MatT>
+int Classifier<MatT>::labelIndex(const string &label) const
+{
+	for (size_t i = 0; i < labels_.size(); i++)
+		if (labels_[i] == label)
+			return i;
+	return -1;
+}
+
 template <class MatT>
 vector<vector<Prediction>> Classifier<MatT>::floatsToPredictions(const vector<float> &floats, const size_t imgSize, const size_t numClasses)
 {
@@ -137,6 +159,76 @@ size_t Classifier<MatT>::batchSize(void) const
 	return batchSize_;
 }
 
+template <class MatT>
+size_t Classifier<MatT>::maxBatchSize(void) const
+{
+	return maxBatchSize_;
+}
+
+template <class MatT>
+void Classifier<MatT>::setBatchSize(size_t batchSize)
+{
+	batchSize_ = min(max<size_t>(batchSize, 1), maxBatchSize_);
+}
+
+// Larger batches usually get through more images per
+// second, up to a point which depends on the net, the
+// hardware and how many threads are competing for it.
+// Past that point they only add latency and make each
+// partial batch at the end of a list more expensive
+template <class MatT>
+size_t Classifier<MatT>::autoTuneBatchSize(void)
+{
+	// Try powers of two plus the max batch size
+	vector<size_t> sizes;
+	for (size_t size = 8; size < maxBatchSize_; size *= 2)
+		sizes.push_back(size);
+	sizes.push_back(maxBatchSize_);
+
+	// Contents only matter in that they have to look like
+	// real input - a flat image has a stddev of 0, and
+	// normalizing by that feeds NaNs to the net
+	RNG rng(12345);
+	vector<MatT> imgs;
+	for (size_t i = 0; i < maxBatchSize_; i++)
+	{
+		Mat img(inputGeometry_, CV_32FC3);
+		rng.fill(img, RNG::UNIFORM, 0, 256);
+		imgs.push_back(MatT(img));
+	}
+	size_t bestSize = batchSize_;
+	double bestRate = 0;
+	for (auto it = sizes.cbegin(); it != sizes.cend(); ++it)
+	{
+		setBatchSize(*it);
+		const vector<MatT> batch(imgs.begin(), imgs.begin() + *it);
+
+		// The first pass allocates buffers, skip it
+		PredictBatch(batch);
+		size_t images = 0;
+		double elapsed = 0;
+		const auto start = chrono::steady_clock::now();
+		do
+		{
+			PredictBatch(batch);
+			images += batch.size();
+			elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		}
+		while ((images < 3 * batch.size()) || (elapsed < 0.05));
+
+		// Only go to a bigger batch if it is
+		// noticably faster than a smaller one
+		const double rate = images / elapsed;
+		if (rate > bestRate * 1.05)
+		{
+			bestSize = *it;
+			bestRate = rate;
+		}
+	}
+	setBatchSize(bestSize);
+	return bestSize;
+}
+
 template <class MatT>
 Size Classifier<MatT>::getInputGeometry(void) const
 {
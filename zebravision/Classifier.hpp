@@ -30,12 +30,34 @@ class Classifier
 		// input image
 		std::vector<std::vector<Prediction>> ClassifyBatch(const std::vector<MatT> &imgs, const size_t numClasses);
 
+		// Lean version for detection nets which only need the
+		// score of one label. Fills scores with the output for
+		// label index labelIdx for each input image without building,
+		// sorting and string-matching a list of predictions
+		void ScoreBatch(const std::vector<MatT> &imgs, const size_t labelIdx, std::vector<float> &scores);
+
+		// Index of label in the list of labels, -1 if not found
+		int labelIndex(const std::string &label) const;
+
 		// Get the width and height of an input image to the net
 		cv::Size getInputGeometry(void) const;
 
 		// Get the batch size of the model
 		size_t batchSize(void) const;
 
+		// Largest batch size the model was set up for
+		size_t maxBatchSize(void) const;
+
+		// Change the number of images run through the
+		// net at once. Must be between 1 and maxBatchSize()
+		virtual void setBatchSize(size_t batchSize);
+
+		// Time PredictBatch at several batch sizes up to
+		// maxBatchSize() and switch to the one which gets
+		// through the most images per second on this
+		// machine. Returns the batch size picked
+		size_t autoTuneBatchSize(void);
+
 		// See if the classifier loaded correctly
 		bool initialized(void) const;
 
@@ -43,6 +65,7 @@ class Classifier
 		bool fileExists(const std::string &fileName) const;
 		cv::Size inputGeometry_;          // size of one input image
 		size_t batchSize_;                // number of images to process in one go
+		size_t maxBatchSize_;             // batch size buffers are allocated for
 		ZCA  zca_;                        // weights used to normalize input data
 		std::vector<std::string> labels_; // labels for each output index
 
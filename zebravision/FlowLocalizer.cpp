@@ -5,71 +5,213 @@
 using namespace cv;
 using namespace std;
 
-FlowLocalizer::FlowLocalizer(const cv::Mat &initial_frame)
+// Same as the calcOpticalFlowPyrLK defaults. Pyramids
+// built ahead of time have to match what it expects
+static const Size flowWinSize(21, 21);
+static const int  flowMaxLevel = 3;
+
+// Tracking mode splits the frame into a grid and only
+// looks for new corners in cells which have none left.
+// Corners per cell are picked so a full grid has about
+// as many as the full frame search
+static const int gridCols       = 8;
+static const int gridRows       = 6;
+static const int cornersPerCell = 4;
+
+// Tracked corners further than this many pixels
+// (in the scaled frame) from where the frame to frame
+// transform puts them are dropped. They are either
+// on something moving or have drifted off of their
+// original feature
+static const float maxCornerError = 2.0f;
+
+FlowLocalizer::FlowLocalizer(const cv::Mat &initial_frame, bool trackFeatures, double scale) :
+	_trackFeatures(trackFeatures),
+	_scale(((scale > 0.) && (scale < 1.)) ? scale : 1.),
+	_frameSize(initial_frame.size())
 {
-	cvtColor(initial_frame, _prevFrame, CV_BGR2GRAY);
+	toGray(initial_frame, _prevFrame);
+	if (_trackFeatures)
+	{
+		buildOpticalFlowPyramid(_prevFrame, _prevPyramid, flowWinSize, flowMaxLevel);
+		findNewCorners(_prevFrame);
+	}
 }
 
-void FlowLocalizer::processFrame(const Mat &frame) 
+void FlowLocalizer::toGray(const Mat &frame, Mat &gray)
 {
-	Mat currFrame;
-	cvtColor(frame, currFrame, CV_BGR2GRAY);
-	vector<Point2f> prevCorner, currCorner;
+	if (_scale == 1.)
+		cvtColor(frame, gray, CV_BGR2GRAY);
+	else
+	{
+		cvtColor(frame, _grayFrame, CV_BGR2GRAY);
+		resize(_grayFrame, gray, Size(), _scale, _scale, INTER_AREA);
+	}
+}
+
+// Turn a transform found on the scaled frame into a 3x3 one
+// for the full sized frame. Rotation is the same, translation
+// is scaled back up
+static Mat padTransform(const Mat &T, double scale)
+{
+	// Return a transformation matrix which best maps
+	// points from prev to curr.
+	// T = [ cos(angle) sin(angle) translation-x ]
+	//     [-sin(angle) cos(angle) translation-y ]
+	// If a valid transformation is found, update predicted position
+	// using it
+	if (T.empty())
+		return Mat::eye(3, 3, CV_64FC1);
+
+	// Pad the T matrix with a row (0, 0, 1)
+	// to make it 3x3 - this makes the translation/rotation
+	// to the next point a simple matrix multiply
+	Mat ret(3, 3, CV_64FC1);
+	T.copyTo(ret(Rect(0, 0, 3, 2)));
+	ret.at<double>(0,2) /= scale;
+	ret.at<double>(1,2) /= scale;
+	ret.at<double>(2,0) = 0.0;
+	ret.at<double>(2,1) = 0.0;
+	ret.at<double>(2,2) = 1.0;
+	//cout << "Optical Flow Transformation Matrix: " << ret << endl;
+	return ret;
+}
+
+void FlowLocalizer::processFrame(const Mat &frame)
+{
+	toGray(frame, _currFrame);
 	vector<Point2f> prevCorner2, currCorner2;
-	vector<uchar> status;
-	vector<float> err;
-	// Grab a set of features to track. Use optical flow to see
-	// how how they move between frames.
-	goodFeaturesToTrack(_prevFrame, prevCorner, 200, 0.01, 30);
-	if (prevCorner.size())
+	Mat T;
+
+	if (!_trackFeatures)
+	{
+		// Grab a set of features to track. Use optical flow to see
+		// how how they move between frames.
+		goodFeaturesToTrack(_prevFrame, _prevCorners, 200, 0.01, 30 * _scale);
+		if (_prevCorners.size())
+			calcOpticalFlowPyrLK(_prevFrame, _currFrame, _prevCorners, _currCorners, _status, _err);
+	}
+	else
 	{
-		calcOpticalFlowPyrLK(_prevFrame, currFrame, prevCorner, currCorner, status, err);
+		// Reuse the previous frame's pyramid rather than having
+		// calcOpticalFlowPyrLK build both of them every frame
+		buildOpticalFlowPyramid(_currFrame, _currPyramid, flowWinSize, flowMaxLevel);
+		if (_prevCorners.size())
+			calcOpticalFlowPyrLK(_prevPyramid, _currPyramid, _prevCorners, _currCorners, _status, _err, flowWinSize, flowMaxLevel);
+	}
 
-		// Status is set to true for each point where a match was found.
-		// Use only these points for the rest of the calculations
-		for (size_t i = 0; i < status.size(); i++)
+	// Status is set to true for each point where a match was found.
+	// Use only these points for the rest of the calculations.
+	// Corners which are carried forward also have to stay
+	// inside the frame
+	if (_prevCorners.size())
+	{
+		const Rect_<float> frameRect(0, 0, _currFrame.cols, _currFrame.rows);
+		for (size_t i = 0; i < _status.size(); i++)
 		{
-			if (status[i])
+			if (_status[i] && (!_trackFeatures || frameRect.contains(_currCorners[i])))
 			{
-				prevCorner2.push_back(prevCorner[i]);
-				currCorner2.push_back(currCorner[i]);
+				prevCorner2.push_back(_prevCorners[i]);
+				currCorner2.push_back(_currCorners[i]);
 			}
 		}
 	}
 
-	// Return a transformation matrix which best maps 
-	// points from prev to curr.
-	// T = [ cos(angle) sin(angle) translation-x ]
-	//     [-sin(angle) cos(angle) translation-y ] 
-	Mat T;
-
 	if (prevCorner2.size() && currCorner2.size())
 		T = estimateRigidTransform(prevCorner2, currCorner2, false);
 
-	// If a valid transformation is found, update predicted position
-	// using it
-	if (!T.empty())
-	{
-		// Pad the T matrix with a row (0, 0, 1)
-		// to make it 3x3 - this makes the translation/rotation
-		// to the next point a simple matrix multiply
-		Mat Tpad(1,3,CV_64FC1);
+	_transform_mat = padTransform(T, _scale);
 
-		Tpad.at<double>(0,0) = 0.0;
-		Tpad.at<double>(0,1) = 0.0;
-		Tpad.at<double>(0,2) = 1.0;
+	if (_trackFeatures)
+	{
+		// Carry matched corners forward to the next frame,
+		// dropping ones which don't fit the overall motion
+		_prevCorners.clear();
+		for (size_t i = 0; i < currCorner2.size(); i++)
+		{
+			if (!T.empty())
+			{
+				const double *t0 = T.ptr<double>(0);
+				const double *t1 = T.ptr<double>(1);
+				const Point2f &p = prevCorner2[i];
+				const Point2f mapped(t0[0] * p.x + t0[1] * p.y + t0[2],
+									 t1[0] * p.x + t1[1] * p.y + t1[2]);
+				const Point2f diff = mapped - currCorner2[i];
+				if ((diff.x * diff.x + diff.y * diff.y) > (maxCornerError * maxCornerError))
+					continue;
+			}
+			_prevCorners.push_back(currCorner2[i]);
+		}
+		findNewCorners(_currFrame);
+		swap(_prevPyramid, _currPyramid);
+	}
 
-		T.push_back(Tpad);
-		
-		//cout << "Optical Flow Transformation Matrix: " << T << endl;
+	// Swap current frame to previous for next iteration
+	swap(_prevFrame, _currFrame);
+}
 
-		_transform_mat = T.clone();
+// Add corners from frame to _prevCorners in grid cells
+// which don't have any left
+void FlowLocalizer::findNewCorners(const Mat &frame)
+{
+	const int cols = frame.cols;
+	const int rows = frame.rows;
+	int counts[gridRows][gridCols] = {{0}};
+	for (auto it = _prevCorners.cbegin(); it != _prevCorners.cend(); ++it)
+	{
+		const int gx = min(max(cvFloor(it->x * gridCols / cols), 0), gridCols - 1);
+		const int gy = min(max(cvFloor(it->y * gridRows / rows), 0), gridRows - 1);
+		counts[gy][gx] += 1;
 	}
-	else
+
+	for (int gy = 0; gy < gridRows; gy++)
 	{
-		_transform_mat = Mat::eye(3, 3, CV_64FC1);
+		for (int gx = 0; gx < gridCols; gx++)
+		{
+			if (counts[gy][gx])
+				continue;
+			const int x0 = gx * cols / gridCols;
+			const int y0 = gy * rows / gridRows;
+			const Rect cell(x0, y0, (gx + 1) * cols / gridCols - x0, (gy + 1) * rows / gridRows - y0);
+			if ((cell.width < 3) || (cell.height < 3))
+				continue;
+			goodFeaturesToTrack(frame(cell), _newCorners, cornersPerCell, 0.01, 30 * _scale);
+			for (auto it = _newCorners.cbegin(); it != _newCorners.cend(); ++it)
+				_prevCorners.push_back(*it + Point2f(cell.x, cell.y));
+		}
 	}
+}
+
+// Map the corners of the previous frame into the current one.
+// Anything between an edge of the current frame and the
+// closest mapped corner on that side is new
+vector<Rect> FlowLocalizer::exposedRegions(void) const
+{
+	vector<Rect> ret;
+	if (_transform_mat.empty())
+		return ret;
+
+	const int width  = _frameSize.width;
+	const int height = _frameSize.height;
+	vector<Point2f> corners;
+	corners.push_back(Point2f(0, 0));
+	corners.push_back(Point2f(width, 0));
+	corners.push_back(Point2f(width, height));
+	corners.push_back(Point2f(0, height));
+	vector<Point2f> mapped;
+	perspectiveTransform(corners, mapped, _transform_mat);
 
-	//copy current frame to previous for next iteration
-	_prevFrame = currFrame.clone();
+	const int left   = min(width,  max(0, cvCeil(max(mapped[0].x, mapped[3].x))));
+	const int right  = max(0, min(width,  cvFloor(min(mapped[1].x, mapped[2].x))));
+	const int top    = min(height, max(0, cvCeil(max(mapped[0].y, mapped[1].y))));
+	const int bottom = max(0, min(height, cvFloor(min(mapped[2].y, mapped[3].y))));
+	if (left > 0)
+		ret.push_back(Rect(0, 0, left, height));
+	if (right < width)
+		ret.push_back(Rect(right, 0, width - right, height));
+	if (top > 0)
+		ret.push_back(Rect(0, 0, width, top));
+	if (bottom < height)
+		ret.push_back(Rect(0, bottom, width, height - bottom));
+	return ret;
 }
@@ -1,14 +1,48 @@
+#include <vector>
 #include <opencv2/core/core.hpp>
 
-class FlowLocalizer 
+class FlowLocalizer
 {
 
 public:
-	FlowLocalizer(const cv::Mat &initial_frame);
+	// trackFeatures keeps corners from frame to frame, only
+	// looking for new ones in parts of the image which have
+	// lost theirs, rather than finding a new set every frame.
+	// scale < 1 runs optical flow on a downsized frame
+	FlowLocalizer(const cv::Mat &initial_frame, bool trackFeatures = false, double scale = 1.0);
 	void processFrame(const cv::Mat &frame);
 	cv::Mat transform_mat() const { return _transform_mat; }
-	//cv::Point transform_point(cv::Point input) const { return _transform_mat * input; } 
+	// Parts of the current frame which weren't visible in
+	// the previous one, based on the last computed transform.
+	// Returns strips along the edges of the frame
+	std::vector<cv::Rect> exposedRegions(void) const;
+	// Number of corners carried into the next frame
+	size_t featureCount(void) const { return _prevCorners.size(); }
+	//cv::Point transform_point(cv::Point input) const { return _transform_mat * input; }
 private:
+	void toGray(const cv::Mat &frame, cv::Mat &gray);
+	void findNewCorners(const cv::Mat &frame);
+
+	bool   _trackFeatures;
+	double _scale;
+	cv::Size _frameSize;    // full size of input frames
+
+	// Current and previous grayscale frames, plus their
+	// LK pyramids in tracking mode. The buffers are swapped
+	// at the end of each frame so they are only allocated once
 	cv::Mat _prevFrame;
+	cv::Mat _currFrame;
+	cv::Mat _grayFrame;
+	std::vector<cv::Mat> _prevPyramid;
+	std::vector<cv::Mat> _currPyramid;
+
+	// Corners tracked into the previous frame, in
+	// coordinates of the scaled frame
+	std::vector<cv::Point2f> _prevCorners;
+	std::vector<cv::Point2f> _currCorners;
+	std::vector<cv::Point2f> _newCorners;
+	std::vector<uchar>       _status;
+	std::vector<float>       _err;
+
 	cv::Mat _transform_mat;
 };
@@ -168,30 +168,15 @@ bool GIEClassifier<MatT>::initialized(void) const
 	return initialized_;
 }
 
-// Wrap input layer of the net into separate Mat objects
-// This sets them up to be written with actual data
-// in PreprocessBatch() using OpenCV split() calls
+// Allocate the CPU-side input buffer for the net
+// This is written with actual data in PredictBatch()
+// by the ZCA transform code
 template <class MatT>
 void GIEClassifier<MatT>::WrapBatchInputLayer(void)
 {
 	if (inputCPU_)
 		delete [] inputCPU_;
 	inputCPU_= new float[this->batchSize_ * numChannels_ * this->inputGeometry_.area()];
-	float *inputCPU = inputCPU_;
-
-	inputBatch_.clear();
-
-	for (size_t j = 0; j < this->batchSize_; j++)
-	{
-		vector<MatT> inputChannels;
-		for (size_t i = 0; i < numChannels_; ++i)
-		{
-			MatT channel(this->inputGeometry_.height, this->inputGeometry_.width, CV_32FC1, inputCPU);
-			inputChannels.push_back(channel);
-			inputCPU += this->inputGeometry_.area(); // point to start of next image's location in the buffer
-		}
-		inputBatch_.push_back(vector<MatT>(inputChannels));
-	}
 }
 
 template <>
@@ -207,15 +192,9 @@ vector<float> GIEClassifier<Mat>::PredictBatch(const vector<Mat> &imgs)
 	// F32 type, since that's what the net inputs are. 
 	// Subtract out the mean before passing to the net input
 	// Then actually write the images to the net input memory buffers
-	vector<Mat> zcaImgs = this->zca_.Transform32FC3(imgs);
-	for (size_t i = 0 ; i < zcaImgs.size(); i++)
-	{
-		/* This operation will write the separate BGR planes directly to the
-		 * inputCPU_ array since it is wrapped by the MatT
-		 * objects in inputChannels. */
-		vector<Mat> *inputChannels = &inputBatch_.at(i);
-		split(zcaImgs[i], *inputChannels);
-	}
+	// This writes the separate BGR planes directly to the
+	// inputCPU_ array
+	this->zca_.Transform32FC3(imgs, inputCPU_);
 	float output[this->labels_.size() * this->batchSize_];
 	// DMA the input to the GPU,  execute the batch asynchronously, and DMA it back:
 	CHECK_CUDA(cudaMemcpyAsync(buffers_[inputIndex_], inputCPU_, this->batchSize_ * this->inputGeometry_.area() * sizeof(float), cudaMemcpyHostToDevice, stream_));
@@ -20,9 +20,9 @@ class GIEClassifier : public Classifier<MatT>
 
 	private:
 #ifdef USE_GIE
-		// Wrap input layer of the net into separate Mat objects
-		// This sets them up to be written with actual data
-		// in PreprocessBatch()
+		// Allocate the CPU input buffer for the net.
+		// The ZCA code writes actual data into it
+		// in PredictBatch()
 		void WrapBatchInputLayer(void);
 #endif
 
@@ -49,7 +49,6 @@ class GIEClassifier : public Classifier<MatT>
 		size_t numChannels_;
 
 		float *inputCPU_;            // input CPU buffer
-		std::vector<std::vector<MatT>> inputBatch_; // net input buffers wrapped in Mats
 #endif
 
 		bool initialized_;
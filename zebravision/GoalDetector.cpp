@@ -1,3 +1,5 @@
+#include <cfloat>
+#include <climits>
 #include <iomanip>
 #include <opencv2/highgui/highgui.hpp>
 #include "GoalDetector.hpp"
@@ -54,10 +56,6 @@ struct GoalInfo
 
 void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 {
-	// Use to mask the contour off from the rest of the
-	// image - used when grabbing depth data for the contour
-	Mat contour_mask(image.rows, image.cols, CV_8UC1, Scalar(0));
-
 	// Reset previous detection vars
 	_isValid = false;
 	_dist_to_goal = -1.0;
@@ -69,8 +67,7 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 
 	// Look for parts the the image which are within the
 	// expected bright green color range
-	Mat threshold_image;
-	if (!generateThresholdAddSubtract(image, threshold_image))
+	if (!generateThresholdAddSubtract(image, _threshold_image))
 	{
 		_pastRects.push_back(SmartRect(Rect()));
 		return;
@@ -80,9 +77,9 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 	// of green to check later on to see how well they match the
 	// expected shape of the goal
 	// Note : findContours modifies the input mat
-	Mat threshold_copy = threshold_image.clone();
+	_threshold_image.copyTo(_threshold_copy);
 	vector<Vec4i>          hierarchy;
-	findContours(threshold_copy, _contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, Point(0, 0));
+	findContours(_threshold_copy, _contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, Point(0, 0));
 
 	// Create some target stats based on our idealized goal model
 	//center of mass as a percentage of the object size from top left
@@ -113,9 +110,9 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 			warped_shape.points(input_points);
 
 			//find how far slanted the goal is away from the screen
-			Mat contour_mask = Mat::zeros(depth.size(), CV_8UC1);
-			drawContours(contour_mask,_contours,i,Scalar(255), CV_FILLED);
-			std::pair<double,double> slope_of_shape = utils::slopeOfMasked(ObjectType(1), depth, contour_mask, _fov_size);
+			const Rect contour_roi(contourROI(br, depth.size()));
+			const Mat  contour_mask(contourMask(i, contour_roi));
+			std::pair<double,double> slope_of_shape = utils::slopeOfMasked(ObjectType(1), depth, contour_mask, _fov_size, contour_roi);
 			float x_angle = atan(slope_of_shape.first);
 			float y_angle = atan(slope_of_shape.second);
 			cout << "Contour  " << i << " angle of goal away from screen: " << x_angle * (180/M_PI) << " " << y_angle * (180/M_PI) << endl;
@@ -172,12 +169,15 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 
 
 		//create a mask which is the same shape as the contour
-		contour_mask.setTo(Scalar(0));
-		drawContours(contour_mask, _contours, i, Scalar(255), CV_FILLED);
+		//only covering the area around the contour
+		const Rect contour_roi(contourROI(br, image.size()));
+		const Mat  contour_mask(contourMask(i, contour_roi));
 
 		// get the minimum and maximum depth values in the contour,
-		// copy them into individual floats
-		pair<float, float> minMax = utils::minOfDepthMat(depth, contour_mask, br, 10);
+		// copy them into individual floats. A missing or mismatched
+		// depth image gives an empty Mat here, which is handled below
+		const Mat depth_roi((depth.size() == image.size()) ? depth(contour_roi) : Mat());
+		pair<float, float> minMax = utils::minOfDepthMat(depth_roi, contour_mask, br - contour_roi.tl(), 10);
 		float depth_z_min = minMax.first;
 		float depth_z_max = minMax.second;
 
@@ -200,8 +200,8 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 		// Since the goal is a U shape, there should be bright pixels
 		// at the bottom center of the contour and dimmer ones in the
 		// middle going towards the top. Check for that here
-		Mat topMidCol(threshold_image(Rect(cvRound(br.tl().x + br.width * .35f), br.tl().y, cvRound(br.width * .3f), cvRound(br.height * .4f))));
-		Mat botMidCol(threshold_image(Rect(br.tl().x, cvRound(br.tl().y + br.height * .85f), br.width, cvRound(br.height * .15f))));
+		Mat topMidCol(_threshold_image(Rect(cvRound(br.tl().x + br.width * .35f), br.tl().y, cvRound(br.width * .3f), cvRound(br.height * .4f))));
+		Mat botMidCol(_threshold_image(Rect(br.tl().x, cvRound(br.tl().y + br.height * .85f), br.width, cvRound(br.height * .15f))));
 		double topMaxCol;
 		minMaxLoc(topMidCol, NULL, &topMaxCol);
 		double botMaxCol;
@@ -225,11 +225,11 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 		// Sample the edges at both .35 and .65 of the way
 		// down the rect to find goals which look
 		// angled due to their offset
-		Mat leftTopMidRow(threshold_image(Rect(br.tl().x, cvRound(br.tl().y + br.height * .35f), cvRound(br.width * .15f), 1)));
-		Mat leftBotMidRow(threshold_image(Rect(br.tl().x, cvRound(br.tl().y + br.height * .65f), cvRound(br.width * .15f), 1)));
-		Mat rightTopMidRow(threshold_image(Rect(br.tl().x + cvRound(br.width * .85f), cvRound(br.tl().y + br.height * .35f), cvRound(br.width * .15f), 1)));
-		Mat rightBotMidRow(threshold_image(Rect(br.tl().x + cvRound(br.width * .85f), cvRound(br.tl().y + br.height * .65f), cvRound(br.width * .15f), 1)));
-		Mat centerMidRow(threshold_image(Rect(br.tl().x + cvRound(br.width * 3.f / 8.f), cvRound(br.tl().y + br.height / 4.f), cvRound(br.width / 4.f), 1)));
+		Mat leftTopMidRow(_threshold_image(Rect(br.tl().x, cvRound(br.tl().y + br.height * .35f), cvRound(br.width * .15f), 1)));
+		Mat leftBotMidRow(_threshold_image(Rect(br.tl().x, cvRound(br.tl().y + br.height * .65f), cvRound(br.width * .15f), 1)));
+		Mat rightTopMidRow(_threshold_image(Rect(br.tl().x + cvRound(br.width * .85f), cvRound(br.tl().y + br.height * .35f), cvRound(br.width * .15f), 1)));
+		Mat rightBotMidRow(_threshold_image(Rect(br.tl().x + cvRound(br.width * .85f), cvRound(br.tl().y + br.height * .65f), cvRound(br.width * .15f), 1)));
+		Mat centerMidRow(_threshold_image(Rect(br.tl().x + cvRound(br.width * 3.f / 8.f), cvRound(br.tl().y + br.height / 4.f), cvRound(br.width / 4.f), 1)));
 		double dummy;
 		double rightMaxRow;
 		minMaxLoc(rightTopMidRow, NULL, &dummy);
@@ -425,23 +425,37 @@ void GoalDetector::processFrame(const Mat& image, const Mat& depth)
 // show up in the output grayscale
 bool GoalDetector::generateThresholdAddSubtract(const Mat& imageIn, Mat& imageOut)
 {
-    vector<Mat> splitImage;
-    Mat         bluePlusRed;
-
-    split(imageIn, splitImage);
-	addWeighted(splitImage[0], _blue_scale / 100.0,
-			    splitImage[2], _red_scale / 100.0, 0.0,
-				bluePlusRed);
-	subtract(splitImage[1], bluePlusRed, imageOut);
-
-    Mat erodeElement(getStructuringElement(MORPH_RECT, Size(3, 3)));
-    Mat dilateElement(getStructuringElement(MORPH_RECT, Size(3, 3)));
-	for (int i = 0; i < 2; ++i)
+	CV_Assert(imageIn.type() == CV_8UC3);
+	imageOut.create(imageIn.size(), CV_8UC1);
+
+	// Do the weighted add and subtract in one pass straight
+	// from the interleaved image rather than splitting it
+	// into planes first. Weights are fixed point with 8
+	// fractional bits so the loop stays in integer math and
+	// vectorizes. Results can differ by 1 from the float
+	// math addWeighted uses, which doesn't matter here
+	const int blueWeight = cvRound(_blue_scale * 256 / 100.);
+	const int redWeight  = cvRound(_red_scale  * 256 / 100.);
+	for (int y = 0; y < imageIn.rows; y++)
 	{
-		erode(imageOut, imageOut, erodeElement, Point(-1, -1), 1);
-		dilate(imageOut, imageOut, dilateElement, Point(-1, -1), 1);
+		const uchar *in  = imageIn.ptr<uchar>(y);
+		uchar       *out = imageOut.ptr<uchar>(y);
+		for (int x = 0; x < imageIn.cols; x++)
+		{
+			const int bluePlusRed = min((in[3 * x] * blueWeight + in[3 * x + 2] * redWeight + 128) >> 8, 255);
+			out[x] = (uchar)max(in[3 * x + 1] - bluePlusRed, 0);
+		}
 	}
 
+	// Two iterations of 3x3 erode followed by 3x3 dilate.
+	// Each is done in place as a separable min or max filter.
+	// The Otsu histogram is collected during the last pass
+	int hist[256];
+	morph3x3(imageOut, false, NULL);
+	morph3x3(imageOut, true,  NULL);
+	morph3x3(imageOut, false, NULL);
+	morph3x3(imageOut, true,  hist);
+
 	// Use Ostu adaptive thresholding.  This will turn
 	// the gray scale image into a binary black and white one, with pixels
 	// above some value being forced white and those below forced to black
@@ -449,13 +463,153 @@ bool GoalDetector::generateThresholdAddSubtract(const Mat& imageIn, Mat& imageOu
 	// from the function.  If this value is too low, it means the image is
 	// really dark and the returned threshold image will be mostly noise.
 	// In that case, skip processing it entirely.
-	double otsuThreshold = threshold(imageOut, imageOut, 0., 255., CV_THRESH_BINARY | CV_THRESH_OTSU);
+	const int otsuThreshold = otsuThresholdFromHist(hist, imageOut.total());
 #ifdef VERBOSE
 	cout << "OSTU THRESHOLD " << otsuThreshold << endl;
 #endif
 	if (otsuThreshold < _otsu_threshold)
 		return false;
-    return countNonZero(imageOut) != 0;
+
+	// The histogram also says how many pixels will be
+	// set, so there's no need to count them afterwards
+	int nonZero = 0;
+	for (int i = otsuThreshold + 1; i < 256; i++)
+		nonZero += hist[i];
+	if (nonZero == 0)
+		return false;
+
+	for (int y = 0; y < imageOut.rows; y++)
+	{
+		uchar *out = imageOut.ptr<uchar>(y);
+		for (int x = 0; x < imageOut.cols; x++)
+			out[x] = (out[x] > otsuThreshold) ? 255 : 0;
+	}
+	return true;
+}
+
+// 3x3 rectangular erode (isMax false) or dilate (isMax
+// true) of an 8 bit single channel image, in place.
+// Split into a horizontal pass over 3 pixels followed
+// by a vertical one over 3 rows.  The horizontal results
+// for the 3 rows needed are kept in _morph_rows, and each
+// source row is filtered into it before the output row
+// on top of it is written, so no copy of the image is
+// needed. Pixels past the edge of the image are ignored,
+// same as the default border for erode() and dilate().
+// If hist is non-null it is filled with a histogram of
+// the output image
+void GoalDetector::morph3x3(Mat &image, bool isMax, int *hist)
+{
+	const int rows = image.rows;
+	const int cols = image.cols;
+	if (hist)
+		fill(hist, hist + 256, 0);
+	if ((rows == 0) || (cols == 0))
+		return;
+
+	_morph_rows.create(3, cols, CV_8UC1);
+	auto horizontal = [&](int y)
+	{
+		const uchar *in  = image.ptr<uchar>(y);
+		uchar       *out = _morph_rows.ptr<uchar>(y % 3);
+		if (cols == 1)
+		{
+			out[0] = in[0];
+			return;
+		}
+		out[0] = isMax ? max(in[0], in[1]) : min(in[0], in[1]);
+		if (isMax)
+			for (int x = 1; x < cols - 1; x++)
+				out[x] = max(max(in[x - 1], in[x]), in[x + 1]);
+		else
+			for (int x = 1; x < cols - 1; x++)
+				out[x] = min(min(in[x - 1], in[x]), in[x + 1]);
+		out[cols - 1] = isMax ? max(in[cols - 2], in[cols - 1]) : min(in[cols - 2], in[cols - 1]);
+	};
+
+	horizontal(0);
+	for (int y = 0; y < rows; y++)
+	{
+		if (y + 1 < rows)
+			horizontal(y + 1);
+
+		// Repeating the edge row in place of the missing
+		// one is the same as ignoring it for min and max
+		const uchar *above = _morph_rows.ptr<uchar>(max(y - 1, 0) % 3);
+		const uchar *row   = _morph_rows.ptr<uchar>(y % 3);
+		const uchar *below = _morph_rows.ptr<uchar>(min(y + 1, rows - 1) % 3);
+		uchar       *out   = image.ptr<uchar>(y);
+		if (isMax)
+			for (int x = 0; x < cols; x++)
+				out[x] = max(max(above[x], row[x]), below[x]);
+		else
+			for (int x = 0; x < cols; x++)
+				out[x] = min(min(above[x], row[x]), below[x]);
+		if (hist)
+			for (int x = 0; x < cols; x++)
+				hist[out[x]] += 1;
+	}
+}
+
+// Pick the threshold which maximizes the between-class
+// variance of the histogram. Same search threshold()
+// does for CV_THRESH_OTSU
+int GoalDetector::otsuThresholdFromHist(const int *hist, size_t total)
+{
+	const double scale = 1. / total;
+	double mu = 0;
+	for (int i = 0; i < 256; i++)
+		mu += i * (double)hist[i];
+	mu *= scale;
+
+	double mu1 = 0;
+	double q1 = 0;
+	double maxSigma = 0;
+	int    maxVal = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		const double p_i = hist[i] * scale;
+		mu1 *= q1;
+		q1 += p_i;
+		const double q2 = 1. - q1;
+		if ((min(q1, q2) < FLT_EPSILON) || (max(q1, q2) > 1. - FLT_EPSILON))
+			continue;
+		mu1 = (mu1 + i * p_i) / q1;
+		const double mu2 = (mu - q1 * mu1) / q2;
+		const double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+		if (sigma > maxSigma)
+		{
+			maxSigma = sigma;
+			maxVal = i;
+		}
+	}
+	return maxVal;
+}
+
+// Area to work on for a contour with bounding rect br.
+// Padded by a pixel on each side so depth code which
+// looks one past the edge of the rect or skips the first
+// row and column gives the same results as it would
+// using a full frame mask
+Rect GoalDetector::contourROI(const Rect &br, const Size &frame_size)
+{
+	const Rect padded(br.x - 1, br.y - 1, br.width + 2, br.height + 2);
+	return padded & Rect(Point(0, 0), frame_size);
+}
+
+// Mask of contour i covering just roi. This is a view into
+// a buffer kept from call to call which only grows to fit
+// the largest roi seen, and only the roi part of it is
+// cleared and drawn into. The mask is overwritten by the
+// next call
+Mat GoalDetector::contourMask(size_t i, const Rect &roi)
+{
+	if ((_contour_mask_pool.cols < roi.width) || (_contour_mask_pool.rows < roi.height))
+		_contour_mask_pool.create(max(roi.height, _contour_mask_pool.rows), max(roi.width, _contour_mask_pool.cols), CV_8UC1);
+	Mat mask(_contour_mask_pool(Rect(Point(0, 0), roi.size())));
+	mask.setTo(Scalar(0));
+	drawContours(mask, _contours, i, Scalar(255), CV_FILLED, 8, noArray(), INT_MAX, -roi.tl());
+	return mask;
 }
 
 // Use the camera FOV, image size and rect size to
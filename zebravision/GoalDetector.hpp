@@ -51,6 +51,12 @@ class GoalDetector
 		std::vector<std::vector<cv::Point> > _contours;
 		std::vector<float> _confidence;
 
+		// Buffers reused from frame to frame
+		cv::Mat _threshold_image;
+		cv::Mat _threshold_copy;
+		cv::Mat _morph_rows;
+		cv::Mat _contour_mask_pool;
+
 		float _min_valid_confidence;
 
 		int   _otsu_threshold;
@@ -62,5 +68,9 @@ int _camera_angle;
 		float createConfidence(float expectedVal, float expectedStddev, float actualVal);
 		float distanceUsingFOV(const cv::Rect &rect) const;
 		bool generateThresholdAddSubtract(const cv::Mat& imageIn, cv::Mat& imageOut);
+		void morph3x3(cv::Mat &image, bool isMax, int *hist);
+		static int otsuThresholdFromHist(const int *hist, size_t total);
+		static cv::Rect contourROI(const cv::Rect &br, const cv::Size &frame_size);
+		cv::Mat contourMask(size_t i, const cv::Rect &roi);
 		void isValid();
 };
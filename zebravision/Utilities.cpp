@@ -17,12 +17,16 @@ namespace utils {
 		int max_loc_x;
 		int max_loc_y;
 		bool found = false;
-		for (int j = bound_rect.tl().y; j <= bound_rect.br().y; j++) //for each row
+		// br() is exclusive, and the rect is clipped to the
+		// image so callers passing a rect which touches or runs
+		// off the edge don't read past the end of it
+		const cv::Rect scan_rect(bound_rect & cv::Rect(cv::Point(0, 0), mask.size()));
+		for (int j = scan_rect.tl().y; j < scan_rect.br().y; j++) //for each row
 		{
 			const float *ptr_img  = img.ptr<float>(j);
 			const uchar *ptr_mask = mask.ptr<uchar>(j);
 
-			for (int i = bound_rect.tl().x; i <= bound_rect.br().x; i++) //for each pixel in row
+			for (int i = scan_rect.tl().x; i < scan_rect.br().x; i++) //for each pixel in row
 			{
 				if ((ptr_mask[i] == 255) && !(isnan(ptr_img[i]) || (ptr_img[i] <= 0)))
 				{
@@ -120,20 +124,26 @@ namespace utils {
 	}
 
 	std::pair<double,double> slopeOfMasked(ObjectType ot, const cv::Mat &depth, const cv::Mat &mask, cv::Point2f fov) {
+		return slopeOfMasked(ot, depth, mask, fov, cv::Rect(0, 0, depth.cols, depth.rows));
+	}
+
+	//same as above but mask only covers roi of the depth image
+	std::pair<double,double> slopeOfMasked(ObjectType ot, const cv::Mat &depth, const cv::Mat &mask, cv::Point2f fov, const cv::Rect &roi) {
 
 		CV_Assert(mask.depth() == CV_8U);
+		CV_Assert(mask.size() == roi.size());
 		vector<double> slope_x_values;
 		vector<double> slope_y_values;
 		vector<double> slope_z_values;
 
-		for (int j = 0; j < depth.rows; j++) {
+		for (int j = 0; j < roi.height; j++) {
 
-			const float *ptr_depth = depth.ptr<float>(j);
+			const float *ptr_depth = depth.ptr<float>(j + roi.y) + roi.x;
 			const uchar *ptr_mask = mask.ptr<uchar>(j);
 
-			for (int i = 0; i < depth.cols; i++) {
+			for (int i = 0; i < roi.width; i++) {
 				if(ptr_mask[i] == 255 && ptr_depth[i] > 0) {
-					cv::Point3f pos = ot.screenToWorldCoords(cv::Rect(i,j,0,0), ptr_depth[i], fov, depth.size(), 0);
+					cv::Point3f pos = ot.screenToWorldCoords(cv::Rect(i + roi.x,j + roi.y,0,0), ptr_depth[i], fov, depth.size(), 0);
 					slope_x_values.push_back(pos.x);
 					slope_y_values.push_back(pos.y);
 					slope_z_values.push_back(pos.z);
@@ -22,6 +22,7 @@ void shrinkRect(cv::Rect &rect_in, float shrink_factor);
 //void printIsometry(const Eigen::Transform<double, 3, Eigen::Isometry> m);
 double slope_list(const std::vector<double>& x, const std::vector<double>& y);
 std::pair<double,double> slopeOfMasked(ObjectType ot, const cv::Mat &depth, const cv::Mat &mask, cv::Point2f fov);
+std::pair<double,double> slopeOfMasked(ObjectType ot, const cv::Mat &depth, const cv::Mat &mask, cv::Point2f fov, const cv::Rect &roi);
 double normalCFD(const std::pair<double, double> &meanAndStdev, double value);
 
 }
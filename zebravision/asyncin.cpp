@@ -30,7 +30,7 @@ void AsyncIn::stopThread(void)
 
 // update thread.  Run non-stop grabbing frames
 // from input source and storing them in
-// frame_ and depth_.  Don't worry about 
+// frame_.  Don't worry about 
 void AsyncIn::update(void)
 {
 	bool good = true;
@@ -42,27 +42,32 @@ void AsyncIn::update(void)
 		if (!isOpened() || !preLockUpdate())
 			good = false;
 
+		// Each frame is read into a buffer nobody
+		// else is using, so frames handed out
+		// earlier are never written over
+		shared_ptr<MediaFrame> next = framePool_.get();
+
 		boost::lock_guard<boost::mutex> guard(mtx_);
 
-		// Now have exclusive access to frame_
-		// and depth_.  Update them from the input
-		// source here
-		if (!good || !postLockUpdate(frame_, depth_))
+		// Now have exclusive access to frame_.
+		// Update it from the input source here
+		if (!good || !postLockUpdate(next->frame, next->depth))
 		{
 			good = false;
-			frame_ = Mat();
-			depth_ = Mat();
+			frame_.reset();
 		}
 		else
 		{
 			setTimeStamp();
 			incFrameNumber();
-			while (frame_.rows > 700)
+			while (next->frame.rows > 700)
 			{
-				pyrDown(frame_, frame_);
-				if (!depth_.empty())
-					pyrDown(depth_, depth_);
+				pyrDown(next->frame, next->frame);
+				if (!next->depth.empty())
+					pyrDown(next->depth, next->depth);
 			}
+			stampFrame(*next);
+			frame_ = next;
 		}
 
 		// Signal that update loop has made it through
@@ -75,7 +80,7 @@ void AsyncIn::update(void)
 }
 
 
-bool AsyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
+bool AsyncIn::getFrame(MediaFramePtr &frame, bool pause)
 {
 	if (!isOpened())
 		return false;
@@ -83,7 +88,7 @@ bool AsyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
 	if (!pause)
 	{
 		// Make sure only one thread is accessing
-		// shared frame_ and depth_ buffers at once
+		// shared frame_ at once
 		boost::mutex::scoped_lock guard(mtx_);
 
 		// Only needed to make sure the first
@@ -92,27 +97,38 @@ bool AsyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
 		while (!updateStarted_)
 			condVar_.wait(guard);
 
-		// Use an empty mat to signal an error 
+		// Use an empty handle to signal an error 
 		// happened in update
-		if (frame_.empty())
+		if (!frame_)
 			return false;
 
 		// Lock in the time and frame number associated
-		// with depth_ and frame_ so they're returned when
+		// with frame_ so they're returned when
 		// queried from the main code
 		lockTimeStamp();
 		lockFrameNumber();
-		frame_.copyTo(pausedFrame_);
-		depth_.copyTo(pausedDepth_);
+		pausedFrame_ = frame_;
 	}
 
-	// Use an empty mat to signal an error 
+	// Use an empty handle to signal an error 
 	// happened in update
-	if (pausedFrame_.empty())
+	if (!pausedFrame_)
+		return false;
+
+	frame = pausedFrame_;
+	return true;
+}
+
+// Callers of this version are free to draw on
+// the frame, so give them their own copy
+bool AsyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
+{
+	MediaFramePtr mediaFrame;
+	if (!getFrame(mediaFrame, pause))
 		return false;
 
-	pausedFrame_.copyTo(frame);
-	pausedDepth_.copyTo(depth);
+	mediaFrame->frame.copyTo(frame);
+	mediaFrame->depth.copyTo(depth);
 	return true;
 }
 
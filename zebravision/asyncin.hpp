@@ -20,6 +20,7 @@ class AsyncIn: public MediaIn
 		AsyncIn(ZvSettings *settings = NULL);
 
 		bool getFrame(cv::Mat &frame, cv::Mat &depth, bool pause = false);
+		bool getFrame(MediaFramePtr &frame, bool pause = false);
 
 	protected:
 		// Derived classes need to start and stop
@@ -38,17 +39,17 @@ class AsyncIn: public MediaIn
 		virtual bool postLockUpdate(cv::Mat &frame, cv::Mat &depth) = 0;
 
 	private:
-		// Input is buffered several times
 		// frame_ is the most recent frame grabbed from 
-		// the camera
+		// the camera. Empty if the last grab failed
 		// pausedFrame_ is the most recent frame returned
 		// from a call to getFrame. If video is paused, this
 		// frame is returned multiple times until the
 		// GUI is unpaused
-		cv::Mat           frame_;
-		cv::Mat           depth_;
-		cv::Mat           pausedFrame_;
-		cv::Mat           pausedDepth_;
+		// Both are handles to frames from framePool_, so
+		// handing one out doesn't copy anything
+		MediaFramePtr     frame_;
+		MediaFramePtr     pausedFrame_;
+		MediaFramePool    framePool_;
 
 		// Mutex used to protect frame_
 		// from simultaneous accesses 
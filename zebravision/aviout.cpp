@@ -21,18 +21,21 @@ AVIOut::AVIOut(const char *outFile, const Size &size, int frameSkip):
 }
 
 // Delete the writer_ object to close that
-// output file
+// output file. Wait for the writer thread
+// first so it isn't still using it
 AVIOut::~AVIOut()
 {
+	sync();
 	if (writer_)
 		delete writer_;
 }
 
 // Make sure the writer is initialized. If so,
 // write the next frame to it.
-bool AVIOut::write(const Mat &frame, const Mat &depth)
+bool AVIOut::write(const Mat &frame, const Mat &depth, long long timeStamp)
 {
 	(void)depth;
+	(void)timeStamp;
 	if (!writer_ || !writer_->isOpened())
 		return false;
 
@@ -16,7 +16,7 @@ class AVIOut : public MediaOut
 
 	private :
 		bool openNext(int fileCounter);
-		bool write(const cv::Mat &frame, const cv::Mat &depth);
+		bool write(const cv::Mat &frame, const cv::Mat &depth, long long timeStamp);
 
 		cv::Size         size_;
 		cv::VideoWriter *writer_;
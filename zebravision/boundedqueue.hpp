@@ -0,0 +1,111 @@
+// Fixed-depth FIFO used to hand data between threads.
+// Producers call push(), consumers call pop(). When the
+// queue is full push() either waits for room or throws
+// away the oldest or newest entry depending on the policy
+// picked at construction time.  close() wakes up everyone waiting
+// so threads can shut down cleanly.
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <boost/thread.hpp>
+
+enum BoundedQueuePolicy
+{
+	BQ_BLOCK,       // wait for the consumer to make room
+	BQ_DROP_OLDEST, // discard the oldest queued entry to make room
+	BQ_DROP_NEWEST  // discard the entry being pushed
+};
+
+template <class T>
+class BoundedQueue
+{
+	public:
+		BoundedQueue(size_t depth, BoundedQueuePolicy policy = BQ_BLOCK) :
+			depth_(std::max<size_t>(depth, 1)),
+			policy_(policy),
+			closed_(false),
+			dropped_(0)
+		{
+		}
+
+		// Make non-copyable
+		BoundedQueue(const BoundedQueue &boundedqueue) = delete;
+		BoundedQueue &operator=(const BoundedQueue &boundedqueue) = delete;
+
+		// Add an entry to the back of the queue.
+		// Returns false if the queue has been closed.
+		// An entry thrown away by BQ_DROP_NEWEST still
+		// counts as a successful push
+		bool push(const T &item)
+		{
+			boost::mutex::scoped_lock guard(mtx_);
+			if (policy_ == BQ_BLOCK)
+			{
+				while (!closed_ && (queue_.size() >= depth_))
+					notFull_.wait(guard);
+			}
+			else if (!closed_ && (queue_.size() >= depth_))
+			{
+				dropped_ += 1;
+				if (policy_ == BQ_DROP_NEWEST)
+					return true;
+				queue_.pop_front();
+			}
+			if (closed_)
+				return false;
+			queue_.push_back(item);
+			notEmpty_.notify_one();
+			return true;
+		}
+
+		// Remove the entry at the front of the queue,
+		// waiting for one to show up if needed.
+		// Returns false once the queue is closed and
+		// everything in it has been consumed
+		bool pop(T &item)
+		{
+			boost::mutex::scoped_lock guard(mtx_);
+			while (!closed_ && queue_.empty())
+				notEmpty_.wait(guard);
+			if (queue_.empty())
+				return false;
+			item = queue_.front();
+			queue_.pop_front();
+			notFull_.notify_one();
+			return true;
+		}
+
+		// Stop accepting new entries and wake up
+		// any threads blocked in push or pop
+		void close(void)
+		{
+			boost::mutex::scoped_lock guard(mtx_);
+			closed_ = true;
+			notEmpty_.notify_all();
+			notFull_.notify_all();
+		}
+
+		size_t size(void) const
+		{
+			boost::mutex::scoped_lock guard(mtx_);
+			return queue_.size();
+		}
+
+		// Number of entries thrown away by the drop policies
+		size_t dropped(void) const
+		{
+			boost::mutex::scoped_lock guard(mtx_);
+			return dropped_;
+		}
+
+	private:
+		std::deque<T>             queue_;
+		size_t                    depth_;
+		BoundedQueuePolicy        policy_;
+		bool                      closed_;
+		size_t                    dropped_;
+		mutable boost::mutex      mtx_;
+		boost::condition_variable notEmpty_;
+		boost::condition_variable notFull_;
+};
@@ -34,7 +34,8 @@ C920CameraIn::C920CameraIn(int stream, bool gui, ZvSettings *settings) :
 	backlightCompensation_   (0),
 	whiteBalanceTemperature_ (0),
 	captureSize_             (v4l2::CAPTURE_SIZE_1280x720),
-	captureFPS_              (v4l2::CAPTURE_FPS_30)
+	captureFPS_              (v4l2::CAPTURE_FPS_30),
+	decodeScale_             (1)
 {
 	if (!camera_.IsOpen())
 		cerr << "Could not open C920 camera" << endl;
@@ -148,12 +149,15 @@ bool C920CameraIn::initCamera(bool gui)
 
 	v4l2::GetCaptureSize(captureSize_, width_, height_);
 
-	// getNextFrame sizes down large images
-	// adjust width and height to match that
+	// AsyncIn sizes down large images. Do that
+	// while decoding instead, which is much cheaper
+	// than decoding full size and using pyrDown
+	decodeScale_ = 1;
 	while (height_ > 700)
 	{
 		width_ /= 2;
 		height_ /= 2;
+		decodeScale_ *= 2;
 	}
 
 	return true;
@@ -167,13 +171,20 @@ bool C920CameraIn::isOpened(void) const
 
 bool C920CameraIn::preLockUpdate(void)
 {
-	return camera_.GrabFrame() && camera_.RetrieveMat(localFrame_);
+	// Decoding reuses localFrame_'s buffer. If a frame
+	// handed out earlier still holds it, get a new one
+	// rather than writing over that frame
+	if (matIsShared(localFrame_))
+		localFrame_.release();
+	return camera_.GrabFrame() && camera_.RetrieveMat(localFrame_, decodeScale_);
 }
 
 
 bool C920CameraIn::postLockUpdate(cv::Mat &frame, cv::Mat &depth)
 {
-	localFrame_.copyTo(frame);
+	// Swap rather than copy. The old frame buffer
+	// is decoded into next time around
+	swap(frame, localFrame_);
 	depth = Mat();
 	return true;
 }
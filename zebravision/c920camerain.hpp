@@ -37,9 +37,15 @@ class C920CameraIn : public AsyncIn
 		// The camera object itself
 		v4l2::C920Camera  camera_;
 
-		// Frame buffer
+		// Frame buffer. Handed to AsyncIn by reference and
+		// swapped with the buffer it gives back, so frames
+		// are decoded in place rather than copied around
 		cv::Mat           localFrame_;
 
+		// Frames are shrunk by this much while decoding
+		// to get them down to the size AsyncIn expects
+		int               decodeScale_;
+
 		// Various camera settings
 		int               brightness_;
 		int               contrast_;
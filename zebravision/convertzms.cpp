@@ -31,12 +31,11 @@ int main(int argc, char **argv)
 
 	ZMSOut out(argv[2]);
 
-	Mat image;
-	Mat depth;
-	while (in->getFrame(image, depth) )
+	MediaFramePtr frame;
+	while (in->getFrame(frame) )
 	{
 		out.sync();
-		out.saveFrame(image, depth);
+		out.saveFrame(frame);
 		cout << in->FPS() << " FPS" << endl;
 	}
 	out.sync();
@@ -0,0 +1,33 @@
+#include <cmath>
+#include "depthgate.hpp"
+
+using namespace cv;
+
+// Be conservative - count pixels without depth info as
+// possibly being at the right depth
+void DepthGate::build(const Mat &depth, float depthMin, float depthMax)
+{
+	CV_Assert(depth.type() == CV_32FC1);
+	sum_.create(depth.rows + 1, depth.cols + 1, CV_32SC1);
+
+	// Integral image has an extra row and column of
+	// zeros along the top and left edges
+	int *above = sum_.ptr<int>(0);
+	for (int c = 0; c <= depth.cols; c++)
+		above[c] = 0;
+
+	for (int r = 0; r < depth.rows; r++)
+	{
+		const float *p = depth.ptr<float>(r);
+		int *s = sum_.ptr<int>(r + 1);
+		int rowSum = 0;
+		s[0] = 0;
+		for (int c = 0; c < depth.cols; c++)
+		{
+			const float d = p[c];
+			rowSum += std::isnan(d) || (d <= 0.0f) || ((d < depthMax) && (d > depthMin));
+			s[c + 1] = above[c + 1] + rowSum;
+		}
+		above = s;
+	}
+}
@@ -0,0 +1,45 @@
+// Fast check of whether detection windows contain any
+// pixels at a plausible depth.
+// build() makes a single pass over a depth image, creating
+// an integral image counting pixels which are either in
+// (depthMin, depthMax) or have no valid depth (NaN or <= 0).
+// After that, the test for any rectangle is 4 lookups
+// instead of a scan of every pixel in the window.  This is
+// the CPU equivalent of cudaDepthThreshold.
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+class DepthGate
+{
+	public:
+		// Set up for a new depth image and depth range.
+		// Reuses the integral image buffer from the previous call
+		void build(const cv::Mat &depth, float depthMin, float depthMax);
+
+		// Number of pixels in rect which could be part
+		// of an object at the expected depth
+		int count(const cv::Rect &rect) const
+		{
+			const int *top    = sum_.ptr<int>(rect.y);
+			const int *bottom = sum_.ptr<int>(rect.y + rect.height);
+			return bottom[rect.x + rect.width] - bottom[rect.x]
+				- top[rect.x + rect.width] + top[rect.x];
+		}
+
+		// True if any pixel in rect passes the depth test
+		bool inRange(const cv::Rect &rect) const
+		{
+			return count(rect) > 0;
+		}
+
+		// True if any pixel in rows [row, row + height) passes.
+		// Used to skip an entire row of windows at once
+		bool rowsInRange(int row, int height) const
+		{
+			return inRange(cv::Rect(0, row, sum_.cols - 1, height));
+		}
+
+	private:
+		cv::Mat sum_; // (rows + 1) x (cols + 1) CV_32S counts
+};
@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <iostream>
+#include <numeric>
+#include <type_traits>
 #include <sys/time.h>
 #include "opencv2_3_shim.hpp"
 
@@ -17,6 +20,40 @@
 using namespace std;
 using namespace cv;
 
+// Get input into the Mat type used by the detector,
+// reusing dest's memory where possible
+static void uploadStub(const Mat &src, Mat &dest)
+{
+	dest = src;
+}
+
+static void uploadStub(const Mat &src, GpuMat &dest)
+{
+	if (src.empty())
+		dest.release();
+	else
+		dest.upload(src);
+}
+
+// CPU ZCA code converts 8 bit windows to float as
+// part of normalizing them, so the CPU pyramid is built
+// directly from the input image.  The GPU ZCA code
+// needs float input
+static void pyramidStub(const Mat &src, Mat &dest)
+{
+	dest = src;
+}
+
+static void pyramidStub(const GpuMat &src, GpuMat &dest)
+{
+	src.convertTo(dest, CV_32FC3);
+}
+
+// Window budget hit map resolution, in input image
+// pixels, and how quickly old d12 hits are forgotten
+static const int   hitCellSize = 16;
+static const float hitDecay    = 0.5f;
+
 #if 0
 static double gtod_wrapper(void)
 {
@@ -58,8 +95,8 @@ void NNDetect<MatT, ClassifierT>::detectMultiscale(const Mat&            inputIm
 	// of the input image.  These vectors hold those resized images
 	// plus the scale factor to return objects detected in them
 	// to the correct size on the original input image
-    vector<pair<MatT, double> > scaledImages12;
-    vector<pair<MatT, double> > scaledImages24;
+    vector<pair<MatT, double> > &scaledImages12 = scaledImages12_;
+    vector<pair<MatT, double> > &scaledImages24 = scaledImages24_;
     // Maybe later ? vector<pair<MatT, double> > scaledImages48;
 
     // list of windows to work with.
@@ -80,29 +117,34 @@ void NNDetect<MatT, ClassifierT>::detectMultiscale(const Mat&            inputIm
     // Generate a list of initial windows to search. Each window will be a 12x12 image from 
 	// a scaled copy of the full input image. These scaled images let us search for 
 	// variable sized objects using a fixed-width detector
-    MatT f32Img;
+	// For GPU Mat, upload input CPU image and depth mats to GPU mats
+	uploadStub(inputImg, inputImg_);
+	uploadStub(depthMat, depth_);
 
-	// classifier runs on float pixel data. Convert it once here
-	// rather than every time we pass a sub-window into the detection
-	// code to save some time
-    MatT(inputImg).convertTo(f32Img, CV_32FC3);
+	// Get the image into the format the pyramid is built from.
+	// For GPU code the classifier runs on float pixel data, so convert
+	// it once here rather than every time we pass a sub-window
+	// into the detection code. CPU code resizes the 8 bit image
+	// (much cheaper than resizing floats) and the conversion
+	// happens per-window as part of the ZCA transform
+	pyramidStub(inputImg_, pyramidImg_);
 
-	// For GPU Mat, upload input CPU depth mat to GPU mat
-	MatT depth(depthMat);
-    generateInitialWindows(f32Img, depth, minSize, maxSize, wsize, scaleFactor, scaledImages12, windowsIn);
+    generateInitialWindows(pyramidImg_, depth_, minSize, maxSize, wsize, scaleFactor, scaledImages12, windowsIn);
 
     // Generate scaled images for the larger net sizes as well.  Using a separate
 	// set of scaled images for the 24x24 net will allow the code to grab
 	// the images for those at greater detail rather than just resizing
 	// a 12x12 image up to 24x24
-    scalefactor(f32Img, scaledImages12, 2, scaledImages24);
-    //scalefactor(f32Img, scaledImages12, 4, scaledImages48);
+    scalefactor(pyramidImg_, scaledImages12, 2, scaledImages24);
+    //scalefactor(pyramidImg_, scaledImages12, 4, scaledImages48);
 
     // Do 1st level of detection. This takes the initial list of windows
     // and returns the list which have a score for "ball" above the
     // threshold listed.
     runDetection(d12_, scaledImages12, windowsIn, detectThreshold[0], objToDetect_.name(), windowsMid, scores);
 	debug_.d12DetectOut = windowsMid.size();
+	if (windowBudget_)
+		updateHitStats(windowsMid, scaledImages12, inputImg.size());
     if ((detectThreshold.size() == 1) || (detectThreshold[1] <= 0.0))
 	{
 		runLocalNMS(windowsMid, scores, nmsThreshold[0], uncalibWindowsOut);
@@ -314,11 +356,13 @@ void NNDetect<MatT, ClassifierT>::generateInitialWindows(
     // Create array of scaled images for RGB 
 	// and depth data
     scalefactor(input, Size(wsize, wsize), minSize, maxSize, scaleFactor, scaledImages);
-    vector<pair<MatT, double> > scaledDepth;
+    vector<pair<MatT, double> > &scaledDepth = scaledDepth_;
     if (!depthIn.empty())
     {
         scalefactor(depthIn, Size(wsize, wsize), minSize, maxSize, scaleFactor, scaledDepth);
     }
+	windowPriority_.clear();
+	scaleHits_.resize(scaledImages.size(), 0.f);
 
     // Main loop.  Look at each scaled image in turn
     for (size_t scale = 0; scale < scaledImages.size(); ++scale)
@@ -333,60 +377,141 @@ void NNDetect<MatT, ClassifierT>::generateInitialWindows(
 #if 0
         cout << fixed << "Target size:" << wsize / scaledImages[scale].second << " Mat Size :" << scaledImages[scale].first.size() << " Dist:" << depth_avg << " Min/max:" << depth_min << "/" << depth_max;
 #endif
-        size_t thisWindowsChecked = 0;
-        size_t thisWindowsPassed  = 0;
+        const Size scaledSize(scaledImages[scale].first.size());
+        const size_t windowsBefore = windows.size();
 
-		vector<Window> unfilteredWindows;
         // Start at the upper left corner.  Loop through the rows and cols adding
 		// each position to the list to check until the detection window falls off 
-		// the edges of the scaled image
-        for (int r = 0; (r + wsize) <= scaledImages[scale].first.rows; r += step)
-        {
-            for (int c = 0; (c + wsize) <= scaledImages[scale].first.cols; c += step)
-            {
-                thisWindowsChecked += 1;
-				const Rect rect(c, r, wsize, wsize);
-				unfilteredWindows.push_back(Window(rect, scale));
-            }
-        }
+		// the edges of the scaled image.  If only searching part of the
+		// frame, only add windows near the regions of interest
+		vector<Window> &candidates = candidateWindows_;
+		candidates.clear();
+		if (useROIs_)
+			addROIWindows(scaledSize, wsize, step, scale, scaledImages[scale].second, candidates);
+		else
+		{
+			for (int r = 0; (r + wsize) <= scaledSize.height; r += step)
+				for (int c = 0; (c + wsize) <= scaledSize.width; c += step)
+					candidates.push_back(Window(Rect(c, r, wsize, wsize), scale));
+		}
+        const size_t thisWindowsChecked = candidates.size();
         debug_.initialWindows += thisWindowsChecked;
-		vector<bool> validList;
 
 		// If there is depth data, filter using it :
 		// Throw out rects which would indicate an object that is at the
 		// wrong depth given the size of the window being searched
 		if (!depthIn.empty())
-		{
-			vector<MatT> depthList;
-
-			for (size_t i = 0; i < unfilteredWindows.size(); i++)
-			{
-				const Rect r(unfilteredWindows[i].first);
-				size_t scale = unfilteredWindows[i].second;
-				depthList.push_back(scaledDepth[scale].first(r));
-			}
-			checkDepthList(depth_min, depth_max, depthList, validList);
-		}
+			filterWindowsUsingDepth(scaledDepth[scale].first, candidates,
+					depth_min, depth_max, windows);
 		else
-		{
-			validList = vector<bool>(unfilteredWindows.size(), true);
-		}
-		for (size_t i = 0; i < unfilteredWindows.size(); i++)
-		{
-			if (validList[i])
-			{
-				windows.push_back(unfilteredWindows[i]);
-				thisWindowsPassed += 1;
-			}
-		}
+			windows.insert(windows.end(), candidates.cbegin(), candidates.cend());
+		if (windowBudget_)
+			addWindowPriorities(windows, windowsBefore, scale, scaledImages[scale].second,
+					!depthIn.empty() && is_same<MatT, Mat>::value);
 #if 0
+        const size_t thisWindowsPassed = windows.size() - windowsBefore;
         cout << " Windows Passed:" << thisWindowsPassed << "/" << thisWindowsChecked << endl;
 #endif
     }
+	if (windowBudget_)
+		applyWindowBudget(windows);
 	debug_.d12In = windows.size();
 }
 
 
+// Estimate how likely each window added for this
+// scale is to hold an object. This has to be cheap
+// compared to running d12 on the window, so it only uses :
+//  - how often d12 has found objects at this scale recently
+//  - whether d12 found objects around the same spot last frame
+//  - the fraction of the window at the expected depth, if
+//    the depth gate for this scale is available
+template<class MatT, class ClassifierT>
+void NNDetect<MatT, ClassifierT>::addWindowPriorities(const vector<Window> &windows,
+		size_t firstWindow, size_t scale, double scaleValue,
+		bool useDepthGate)
+{
+	// Add one to each count so scales without
+	// recent hits still get searched
+	const float totalHits  = accumulate(scaleHits_.cbegin(), scaleHits_.cend(), 0.f);
+	const float scalePrior = (scaleHits_[scale] + 1.f) / (totalHits + scaleHits_.size());
+	for (size_t i = firstWindow; i < windows.size(); i++)
+	{
+		const Rect &rect = windows[i].first;
+		float priority = scalePrior;
+		const int cx = (rect.x + rect.width / 2) / scaleValue / hitCellSize;
+		const int cy = (rect.y + rect.height / 2) / scaleValue / hitCellSize;
+		if ((cx < hitMap_.cols) && (cy < hitMap_.rows))
+			priority *= 1.f + hitMap_.at<float>(cy, cx);
+		if (useDepthGate)
+			priority *= 0.5f + 0.5f * depthGate_.count(rect) / rect.area();
+		windowPriority_.push_back(priority);
+	}
+}
+
+// Keep only the windowBudget_ highest priority windows.
+// They stay in their original order so batches still
+// work through one scale at a time
+template<class MatT, class ClassifierT>
+void NNDetect<MatT, ClassifierT>::applyWindowBudget(vector<Window> &windows)
+{
+	if (windows.size() <= windowBudget_)
+		return;
+	vector<size_t> &order = budgetOrder_;
+	order.resize(windows.size());
+	iota(order.begin(), order.end(), 0);
+	nth_element(order.begin(), order.begin() + windowBudget_, order.end(),
+			[this](size_t a, size_t b)
+			{
+				if (windowPriority_[a] != windowPriority_[b])
+					return windowPriority_[a] > windowPriority_[b];
+				return a < b;
+			});
+	order.resize(windowBudget_);
+	sort(order.begin(), order.end());
+	// order is increasing, so order[i] >= i
+	// and this can be done in place
+	for (size_t i = 0; i < order.size(); i++)
+		windows[i] = windows[order[i]];
+	windows.resize(windowBudget_);
+}
+
+// Record where d12 found objects this frame so the
+// window budget favors those spots and scales next frame
+template<class MatT, class ClassifierT>
+void NNDetect<MatT, ClassifierT>::updateHitStats(const vector<Window> &hits,
+		const vector<pair<MatT, double> > &scaledImages,
+		const Size &inputSize)
+{
+	const Size mapSize((inputSize.width  + hitCellSize - 1) / hitCellSize,
+			           (inputSize.height + hitCellSize - 1) / hitCellSize);
+	if (hitMap_.size() != mapSize)
+		hitMap_ = Mat::zeros(mapSize, CV_32FC1);
+	else
+		hitMap_ *= hitDecay;
+	for (auto it = scaleHits_.begin(); it != scaleHits_.end(); ++it)
+		*it *= hitDecay;
+
+	for (auto it = hits.cbegin(); it != hits.cend(); ++it)
+	{
+		const double scale = scaledImages[it->second].second;
+		const Rect &rect = it->first;
+		const int c1 = max(0, (int)(rect.x / scale) / hitCellSize);
+		const int r1 = max(0, (int)(rect.y / scale) / hitCellSize);
+		const int c2 = min(mapSize.width  - 1, (int)((rect.x + rect.width)  / scale) / hitCellSize);
+		const int r2 = min(mapSize.height - 1, (int)((rect.y + rect.height) / scale) / hitCellSize);
+		for (int r = r1; r <= r2; r++)
+		{
+			float *row = hitMap_.ptr<float>(r);
+			for (int c = c1; c <= c2; c++)
+				row[c] += 1.f;
+		}
+		if (it->second < scaleHits_.size())
+			scaleHits_[it->second] += 1.f;
+	}
+}
+
+
 // Run the actual detection.  Pass in the classifer (a d12 or d24 
 // neural net) along with a set of windows to search. The scaledImages
 // vector is a set of the actual images to grab input data from.
@@ -413,8 +538,19 @@ void NNDetect<MatT, ClassifierT>::runDetection(ClassifierT &classifier,
     // the input array above which have a high enough confidence score
     vector<size_t> detected;
 
+    // Look up the label once rather than once per window
+    const int labelIdx = classifier.labelIndex(label);
+    if (labelIdx < 0)
+    {
+        cerr << "Label " << label << " not found in classifier labels" << endl;
+        return;
+    }
+
     size_t batchSize = classifier.batchSize(); // defined when classifer is constructed
     int    counter   = 0;
+	// These are just ROI headers into scaledImages - the
+	// classifier reads pixel data straight from there
+    images.reserve(batchSize);
     //double start     = gtod_wrapper(); // grab start time
 
     // For each input window, grab the correct image
@@ -433,7 +569,7 @@ void NNDetect<MatT, ClassifierT>::runDetection(ClassifierT &classifier,
         images.push_back(scaledImages[it->second].first(it->first));
         if ((images.size() == batchSize) || ((it + 1) == windows.cend()))
         {
-            doBatchPrediction(classifier, images, threshold, label, detected, scores);
+            doBatchPrediction(classifier, images, threshold, labelIdx, detected, scores);
 
             // Clear out images array to start the next batch
             // of processing fresh
@@ -464,36 +600,26 @@ template<class MatT, class ClassifierT>
 void NNDetect<MatT, ClassifierT>::doBatchPrediction(ClassifierT &classifier,
 												    const vector<MatT> &imgs,
 												    const float         threshold,
-												    const string&       label,
+												    const size_t        labelIdx,
 												    vector<size_t>&     detected,
 												    vector<float>&      scores)
 {
     detected.clear();
-    // Grab the top 2 detected classes.  Since we're doing an object /
-    // not object split, that will get the scores for both categories
-    vector<vector<Prediction> > predictions = classifier.ClassifyBatch(imgs, 2);
-
-    // Each outer loop is the predictions for one input image
-    for (size_t i = 0; i < imgs.size(); ++i)
+    // Only the score for the object label is needed, so grab
+    // it directly rather than building a list of predictions
+    vector<float> &batchScores = batchScores_;
+    classifier.ScoreBatch(imgs, labelIdx, batchScores);
+
+    // Look for images with >= <threshold> confidence for the label
+    // Higher confidences from the prediction mean that the net
+    // thinks it is more likely that the label correctly
+    // identifies the image passed in
+    for (size_t i = 0; i < batchScores.size(); ++i)
     {
-        // Each inner loop is the prediction for a particular label
-        // for the given image, sorted by score.
-        //
-        // Look for object with label <label>, >= <threshold> confidence
-		// Higher confidences from the prediction mean that the net
-		// thinks it is more likely that the label correctly
-		// identifies the image passed in
-        for (auto it = predictions[i].cbegin(); it != predictions[i].cend(); ++it)
+        if (batchScores[i] >= threshold)
         {
-            if (it->first == label)
-            {
-                if (it->second >= threshold)
-                {
-                    detected.push_back(i);
-                    scores.push_back(it->second);
-                }
-                break;
-            }
+            detected.push_back(i);
+            scores.push_back(batchScores[i]);
         }
     }
 }
@@ -680,66 +806,147 @@ void NNDetect<MatT, ClassifierT>::doBatchCalibration(ClassifierT            &cla
 }
 
 
-// Check each image in the list to see if any pixels
-// in the window are at the correct depth for the size/scale
-// of that window.  
+// Add the sliding windows for one scale which overlap any of
+// the regions of interest.  Only regions expecting objects
+// about the size wsize maps to at this scale are used.
+// Windows are added in the same row-major order as a full
+// frame search, each at most once
 template<class MatT, class ClassifierT>
-void NNDetect<MatT, ClassifierT>::checkDepthList(const float depth_min, const float depth_max,
-		const vector<Mat> &depthList, vector<bool> &validList)
+void NNDetect<MatT, ClassifierT>::addROIWindows(const Size &scaledSize,
+		int wsize, int step, size_t scale, double scaleValue,
+		vector<Window> &windows)
 {
-	validList.clear();
-	for (auto it = depthList.cbegin(); it != depthList.cend(); ++it)
-		validList.push_back(depthInRange(depth_min, depth_max, *it));
-}
+	if ((scaledSize.width < wsize) || (scaledSize.height < wsize))
+		return;
+	const int gridCols = (scaledSize.width  - wsize) / step + 1;
+	const int gridRows = (scaledSize.height - wsize) / step + 1;
+	const double objSize = wsize / scaleValue;
+
+	vector<unsigned char> &used = roiWindowMask_;
+	used.assign(gridCols * gridRows, 0);
+	bool any = false;
+	for (auto it = rois_.cbegin(); it != rois_.cend(); ++it)
+	{
+		if ((objSize < it->minSize) || (objSize > it->maxSize))
+			continue;
+
+		// Map the region into this scale then find the range
+		// of window positions which overlap it
+		const int x1 = cvFloor(it->area.x * scaleValue);
+		const int y1 = cvFloor(it->area.y * scaleValue);
+		const int x2 = cvCeil((it->area.x + it->area.width) * scaleValue);
+		const int y2 = cvCeil((it->area.y + it->area.height) * scaleValue);
+		if ((x2 <= 0) || (y2 <= 0))
+			continue;
+		const int c1 = max(0, (x1 - wsize + step) / step);
+		const int r1 = max(0, (y1 - wsize + step) / step);
+		const int c2 = min(gridCols - 1, (x2 - 1) / step);
+		const int r2 = min(gridRows - 1, (y2 - 1) / step);
+		for (int r = r1; r <= r2; r++)
+			for (int c = c1; c <= c2; c++)
+				used[r * gridCols + c] = 1;
+		any |= (r1 <= r2) && (c1 <= c2);
+	}
+	if (!any)
+		return;
 
+	for (int r = 0; r < gridRows; r++)
+		for (int c = 0; c < gridCols; c++)
+			if (used[r * gridCols + c])
+				windows.push_back(Window(Rect(c * step, r * step, wsize, wsize), scale));
+}
 
+// Add each candidate window which has any depth pixels
+// at the correct depth for the size/scale of that window.
 // Be conservative here - if any of the depth values in the target rect
 // are in the expected range, consider the rect in range.  Also
 // say that it is in range if any of the depth values are negative (i.e. no
-// depth info for those pixels)
+// depth info for those pixels).
+// DepthGate turns this into an O(1) check per window.  Candidates
+// are in row order, so a whole row of windows can be skipped with
+// one check if none of the pixels in that band are at a valid depth
 template<class MatT, class ClassifierT>
-bool NNDetect<MatT, ClassifierT>::depthInRange(const float depth_min, const float depth_max, const Mat& detectCheck)
+void NNDetect<MatT, ClassifierT>::filterWindowsUsingDepth(const Mat &depth,
+		const vector<Window> &candidates,
+		const float depth_min, const float depth_max,
+		vector<Window> &windows)
 {
-    for (int py = 0; py < detectCheck.rows; py++)
-    {
-        const float *p = detectCheck.ptr<float>(py);
-        for (int px = 0; px < detectCheck.cols; px++)
-        {
-            if (std::isnan(p[px]) || (p[px] <= 0.0) || ((p[px] < depth_max) && (p[px] > depth_min)))
-            {
-                return true;
-            }
-        }
-    }
-    return false;
+	if (candidates.empty())
+		return;
+	depthGate_.build(depth, depth_min, depth_max);
+	int  lastRow   = -1;
+	bool rowPassed = false;
+	for (auto it = candidates.cbegin(); it != candidates.cend(); ++it)
+	{
+		const Rect &rect = it->first;
+		if (rect.y != lastRow)
+		{
+			lastRow   = rect.y;
+			rowPassed = depthGate_.rowsInRange(rect.y, rect.height);
+		}
+		if (rowPassed && depthGate_.inRange(rect))
+			windows.push_back(*it);
+	}
 }
 
 // GPU specialization
 vector<bool> cudaDepthThreshold(const vector<GpuMat> &depthList, const float depthMin, const float depthMax);
 
 template<class MatT, class ClassifierT>
-void NNDetect<MatT, ClassifierT>::checkDepthList(const float depth_min, const float depth_max,
-		const vector<GpuMat> &depthList, vector<bool> &validList)
+void NNDetect<MatT, ClassifierT>::filterWindowsUsingDepth(const GpuMat &depth,
+		const vector<Window> &candidates,
+		const float depth_min, const float depth_max,
+		vector<Window> &windows)
 {
 	const size_t batchSize = 128;
-	validList.clear();
 	vector<GpuMat> depthBatch;
-	vector<Mat> depthMats;
-	for (auto it = depthList.cbegin(); it != depthList.cend(); ++it)
+	for (size_t i = 0; i < candidates.size(); i++)
 	{
-		depthBatch.push_back(*it);
-		if ((depthBatch.size() == batchSize) || (it == (depthList.cend() - 1)))
+		depthBatch.push_back(depth(candidates[i].first));
+		if ((depthBatch.size() == batchSize) || (i == (candidates.size() - 1)))
 		{
 			auto validBatch = cudaDepthThreshold(depthBatch, depth_min, depth_max);
-			for (auto v = validBatch.cbegin(); v != validBatch.cend(); ++v)
-				validList.push_back(*v);
+			const size_t batchStart = i + 1 - depthBatch.size();
+			for (size_t v = 0; v < validBatch.size(); v++)
+				if (validBatch[v])
+					windows.push_back(candidates[batchStart + v]);
 
 			depthBatch.clear();
-			validBatch.clear();
 		}
 	}
 }
 
+template<class MatT, class ClassifierT>
+void NNDetect<MatT, ClassifierT>::setROIs(const vector<DetectROI> &rois)
+{
+	rois_    = rois;
+	useROIs_ = true;
+}
+
+template<class MatT, class ClassifierT>
+void NNDetect<MatT, ClassifierT>::clearROIs(void)
+{
+	rois_.clear();
+	useROIs_ = false;
+}
+
+template<class MatT, class ClassifierT>
+void NNDetect<MatT, ClassifierT>::setWindowBudget(size_t budget)
+{
+	windowBudget_ = budget;
+}
+
+template<class MatT, class ClassifierT>
+void NNDetect<MatT, ClassifierT>::tuneBatchSize(void)
+{
+	d12_.autoTuneBatchSize();
+	d24_.autoTuneBatchSize();
+	c12_.autoTuneBatchSize();
+	c24_.autoTuneBatchSize();
+	cout << "Batch sizes d12:" << d12_.batchSize() << " d24:" << d24_.batchSize()
+		<< " c12:" << c12_.batchSize() << " c24:" << c24_.batchSize() << endl;
+}
+
 template<class MatT, class ClassifierT>
 bool NNDetect<MatT, ClassifierT>::initialized(void) const
 {
@@ -750,7 +957,10 @@ bool NNDetect<MatT, ClassifierT>::initialized(void) const
 template<class MatT, class ClassifierT>
 NNDetectDebugInfo NNDetect<MatT, ClassifierT>::DebugInfo(void) const
 {
-	return debug_;
+	NNDetectDebugInfo debug = debug_;
+	debug.d12BatchSize = d12_.batchSize();
+	debug.d24BatchSize = d24_.batchSize();
+	return debug;
 }
 
 // Explicitly instatiate classes used elsewhere
@@ -2,6 +2,7 @@
 
 #include "opencv2_3_shim.hpp"
 #include "objtype.hpp"
+#include "depthgate.hpp"
 // Turn Window from a typedef into a class :
 //   Private members are the rect, index from Window plus maybe a score?
 //   Constructor takes Rect, size_t index
@@ -25,13 +26,26 @@
 struct NNDetectDebugInfo
 {
 	size_t initialWindows; // # of d12 sliding windows
-	size_t d12In;          // # of windows passing depth test
+	size_t d12In;          // # of windows passing depth test and window budget
 	size_t d12DetectOut;   // # of windows passing d12 detectnet
 	size_t d12NMSOut;      // # of windows passing d12 NMS == # input to d24
 	size_t d24DetectOut;   // # of windows passing d24 detectnet
+	size_t d12BatchSize;   // # of windows run through d12 at once
+	size_t d24BatchSize;   // # of windows run through d24 at once
 };
 
 
+// Region of the input image to search when running
+// detection on only part of a frame.  Windows are checked if
+// they overlap area and their size in input image pixels
+// is between minSize and maxSize
+struct DetectROI
+{
+	cv::Rect area;
+	double   minSize;
+	double   maxSize;
+};
+
 template <class MatT, class ClassifierT>
 class NNDetect
 {
@@ -47,7 +61,9 @@ class NNDetect
 			c12_(c12Files[0], c12Files[1], c12Files[2], c12Files[3], 64),
 			c24_(c24Files[0], c24Files[1], c24Files[2], c24Files[3], 64),
 			hfov_(hfov),
-			objToDetect_(objToDetect)
+			objToDetect_(objToDetect),
+			useROIs_(false),
+			windowBudget_(0)
 		{
 		}
 
@@ -62,6 +78,22 @@ class NNDetect
 				std::vector<cv::Rect> &rectsOut,
 				std::vector<cv::Rect> &uncalibRectsOut);
 
+		// Limit the initial sliding window search to the
+		// given regions.  Stays in effect until clearROIs()
+		// is called.  An empty list searches nothing
+		void setROIs(const std::vector<DetectROI> &rois);
+		void clearROIs(void);
+
+		// Limit the number of windows run through d12 each
+		// frame, 0 for no limit.  If there are more windows than
+		// this, the ones most likely to hold an object are kept.
+		// This bounds the worst-case time spent in d12
+		void setWindowBudget(size_t budget);
+
+		// Pick the batch size for each net which gets
+		// the most windows per second on this machine
+		void tuneBatchSize(void);
+
 		bool initialized(void) const;
 
 		NNDetectDebugInfo DebugInfo(void) const;
@@ -74,10 +106,51 @@ class NNDetect
 		float hfov_;
 		ObjectType objToDetect_;
 		NNDetectDebugInfo debug_;
+
+		// Per-frame image pyramids. These are kept between
+		// calls so each frame resizes into the buffers allocated
+		// for the previous one instead of allocating new ones.
+		// On the CPU the pyramid is left as 8-bit data - ZCA
+		// converts each window to float as it normalizes it
+		MatT inputImg_;
+		MatT pyramidImg_;
+		MatT depth_;
+		std::vector<std::pair<MatT, double> > scaledImages12_;
+		std::vector<std::pair<MatT, double> > scaledImages24_;
+		std::vector<std::pair<MatT, double> > scaledDepth_;
+
+		// Search regions, only used if useROIs_ is set
+		std::vector<DetectROI> rois_;
+		bool                   useROIs_;
+
+		// Scratch space for generateInitialWindows, kept
+		// to avoid reallocating them every scale of every frame
+		std::vector<Window>        candidateWindows_;
+		std::vector<unsigned char> roiWindowMask_;
+
+		// Per-scale integral image of depth pixels
+		// which pass the depth check, CPU only
+		DepthGate depthGate_;
+
+		// Window budget state.  windowPriority_ holds a cheap
+		// estimate of how likely each initial window is to hold
+		// an object, built from the fraction of the window at a
+		// valid depth, d12 hits near the window last frame and how
+		// often d12 hits come from the window's scale.  The hit
+		// stats decay each frame so they follow moving objects
+		size_t              windowBudget_;
+		std::vector<float>  windowPriority_;
+		std::vector<size_t> budgetOrder_;
+		cv::Mat             hitMap_;    // CV_32F, d12 hits per hitCellSize square of the input image
+		std::vector<float>  scaleHits_; // d12 hits per scale
+
+		// Raw d12/d24 scores for one batch
+		std::vector<float>  batchScores_;
+
 		void doBatchPrediction(ClassifierT &classifier,
 				const std::vector<MatT> &imgs,
 				const float threshold,
-				const std::string &label,
+				const size_t labelIdx,
 				std::vector<size_t> &detected,
 				std::vector<float>  &scores);
 
@@ -120,11 +193,23 @@ class NNDetect
 					const float threshold,
 					std::vector<std::vector<float> >& shift);
 
-		void checkDepthList(const float depth_min, const float depth_max,
-				const std::vector<cv::Mat> &depthList, std::vector<bool> &validList);
-		void checkDepthList(const float depth_min, const float depth_max,
-				const std::vector<GpuMat> &depthList, std::vector<bool> &validList);
+		void addWindowPriorities(const std::vector<Window> &windows,
+				size_t firstWindow, size_t scale, double scaleValue,
+				bool useDepthGate);
+		void applyWindowBudget(std::vector<Window> &windows);
+		void updateHitStats(const std::vector<Window> &hits,
+				const std::vector<std::pair<MatT, double> > &scaledImages,
+				const cv::Size &inputSize);
+
+		void addROIWindows(const cv::Size &scaledSize, int wsize, int step,
+				size_t scale, double scaleValue, std::vector<Window> &windows);
 
-		bool depthInRange(const float depth_min, const float depth_max, 
-				const cv::Mat &detectCheck);
+		void filterWindowsUsingDepth(const cv::Mat &depth,
+				const std::vector<Window> &candidates,
+				const float depth_min, const float depth_max,
+				std::vector<Window> &windows);
+		void filterWindowsUsingDepth(const GpuMat &depth,
+				const std::vector<Window> &candidates,
+				const float depth_min, const float depth_max,
+				std::vector<Window> &windows);
 };
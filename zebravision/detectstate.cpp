@@ -5,9 +5,11 @@
 //
 // Methods are provided to change these settings
 // Each frame the code runs update(). If any settings
-// have changed since the last frame, the old
-// detector is deleted and a new one is created
-// with the updated settings.
+// have changed since the last frame, a detector
+// with the new settings is swapped in.  If it was used
+// recently that happens immediately. Otherwise it is
+// built in a background thread and the old detector
+// keeps running until the new one is ready.
 #include <iostream>
 #include <string>
 
@@ -38,7 +40,8 @@ DetectState::DetectState(const ClassifierIO &d12IO,
 		float hfov, 
 		bool gpu,
 	   	bool tensorRT,
-		const ObjectType &objToDetect) :
+		const ObjectType &objToDetect,
+		bool tuneBatch) :
     detector_(NULL),
 	d12IO_(d12IO),
 	d24IO_(d24IO),
@@ -50,20 +53,39 @@ DetectState::DetectState(const ClassifierIO &d12IO,
 	gpu_(gpu),
 	tensorRT_(tensorRT),
 	cascade_(false),
+	tuneBatch_(tuneBatch),
+	oldD12IO_(d12IO),
+	oldD24IO_(d24IO),
+	oldC12IO_(c12IO),
+	oldC24IO_(c24IO),
+	oldCasIO_(casIO_),
 	oldGpu_(gpu),
 	oldTensorRT_(tensorRT),
 	oldCascade_(false),
-	reload_(true)
+	reload_(true),
+	loadResult_(NULL),
+	loadDone_(false),
+	pending_(false)
 {
 	update();
 }
 
 DetectState::~DetectState()
 {
-	if (detector_)
-		delete detector_;
+	if (loadThread_.joinable())
+	{
+		loadThread_.join();
+		if (loadResult_)
+			delete loadResult_;
+	}
+	for (auto it = cache_.begin(); it != cache_.end(); ++it)
+		delete it->second;
 }
 
+// Number of detectors kept loaded, including
+// the one currently in use
+static const size_t cacheSize = 4;
+
 // Grab file names needed to load a given classifier
 // Check that the results make sense and return
 // them to the caller. 
@@ -84,77 +106,261 @@ bool DetectState::checkNNetFiles(const ClassifierIO &inCLIO,
 	return true;
 }
 
-// Called each frame. Reloads the detector if
-// any settings have changed
-bool DetectState::update(void)
+// Grab the files and flags needed to build a detector
+// with the current settings
+bool DetectState::makeConfig(DetectorConfig &config)
 {
-	if (reload_ == false)
-		return true;
-
-	vector<string> d12Files;
-	vector<string> d24Files;
-	vector<string> c12Files;
-	vector<string> c24Files;
+	config.gpu      = gpu_;
+	config.tensorRT = tensorRT_;
+	config.cascade  = cascade_;
+	config.d12Files.clear();
+	config.d24Files.clear();
+	config.c12Files.clear();
+	config.c24Files.clear();
+	config.casName.clear();
 
 	if (!cascade_)
-		if (!checkNNetFiles(d12IO_, "D12Files", d12Files) ||
-			!checkNNetFiles(d24IO_, "C24Files", d24Files) ||
-			!checkNNetFiles(c12IO_, "D12Files", c12Files) ||
-			!checkNNetFiles(c24IO_, "C24Files", c24Files))
+	{
+		if (!checkNNetFiles(d12IO_, "D12Files", config.d12Files) ||
+			!checkNNetFiles(d24IO_, "D24Files", config.d24Files) ||
+			!checkNNetFiles(c12IO_, "C12Files", config.c12Files) ||
+			!checkNNetFiles(c24IO_, "C24Files", config.c24Files))
 			return false;
+	}
+	else
+		config.casName = casIO_.getClassifierName();
 
-	// Save old detector state in case a problem
-	// occurs
-	ObjDetect *oldDetector = detector_;
+	config.key = string(gpu_ ? "GPU" : "CPU") + (tensorRT_ ? "_TensorRT" : "");
+	if (cascade_)
+		config.key += "_Cascade " + config.casName;
+	else
+	{
+		const vector<string> *files[] = {&config.d12Files, &config.d24Files, &config.c12Files, &config.c24Files};
+		for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+			for (auto it = files[i]->cbegin(); it != files[i]->cend(); ++it)
+				config.key += " " + *it;
+	}
+	return true;
+}
 
-	if (!cascade_)
+// Create a new detector.  This is slow - it loads
+// and sets up several nets - so other than the
+// very first detector it runs in loadThread()
+ObjDetect *DetectState::buildDetector(const DetectorConfig &config) const
+{
+	ObjDetect *detector;
+	if (!config.cascade)
 	{
 #ifndef USE_TensorRT
-		//if (!tensorRT_)
+		//if (!config.tensorRT)
 		{
-			if (!gpu_)
-				detector_ = new ObjDetectCaffeCPU(d12Files, d24Files, c12Files, c24Files, hfov_, objToDetect_);
+			if (!config.gpu)
+				detector = new ObjDetectCaffeCPU(config.d12Files, config.d24Files, config.c12Files, config.c24Files, hfov_, objToDetect_);
 			else
-				detector_ = new ObjDetectCaffeGPU(d12Files, d24Files, c12Files, c24Files, hfov_, objToDetect_);
+				detector = new ObjDetectCaffeGPU(config.d12Files, config.d24Files, config.c12Files, config.c24Files, hfov_, objToDetect_);
 		}
 #else
 		//else
 		{
-			if (!gpu_)
-				detector_ = new ObjDetectTensorRTCPU(d12Files, d24Files, c12Files, c24Files, hfov_, objToDetect_);
+			if (!config.gpu)
+				detector = new ObjDetectTensorRTCPU(config.d12Files, config.d24Files, config.c12Files, config.c24Files, hfov_, objToDetect_);
 			else
-				detector_ = new ObjDetectTensorRTGPU(d12Files, d24Files, c12Files, c24Files, hfov_, objToDetect_);
+				detector = new ObjDetectTensorRTGPU(config.d12Files, config.d24Files, config.c12Files, config.c24Files, hfov_, objToDetect_);
 		}
 #endif
 	}
+	else if (!config.gpu)
+		detector = new ObjDetectCascadeCPU(config.casName);
 	else
+		detector = new ObjDetectCascadeGPU(config.casName);
+
+	// Tuning is done once per detector. Cached
+	// detectors keep the batch sizes picked here
+	if (tuneBatch_ && detector->initialized())
+		detector->tuneBatchSize();
+	return detector;
+}
+
+// Look for an already loaded detector and mark
+// it as the most recently used one
+ObjDetect *DetectState::findCached(const string &key)
+{
+	for (auto it = cache_.begin(); it != cache_.end(); ++it)
 	{
-		string name = casIO_.getClassifierName();
-		if (!gpu_)
-			detector_ = new ObjDetectCascadeCPU(name);
-		else
-			detector_ = new ObjDetectCascadeGPU(name);
+		if (it->first == key)
+		{
+			cache_.splice(cache_.begin(), cache_, it);
+			return cache_.front().second;
+		}
+	}
+	return NULL;
+}
+
+// Add a detector to the cache, freeing the least
+// recently used one if the cache is full.  Never
+// delete the detector currently in use
+void DetectState::addCached(const string &key, ObjDetect *detector)
+{
+	cache_.push_front(make_pair(key, detector));
+	auto it = cache_.end();
+	while ((cache_.size() > cacheSize) && (it != cache_.begin()))
+	{
+		--it;
+		if (it->second != detector_)
+		{
+			delete it->second;
+			it = cache_.erase(it);
+		}
+	}
+}
+
+// The requested settings are now running
+void DetectState::commit(void)
+{
+	oldD12IO_    = d12IO_;
+	oldD24IO_    = d24IO_;
+	oldC12IO_    = c12IO_;
+	oldC24IO_    = c24IO_;
+	oldCasIO_    = casIO_;
+	oldGpu_      = gpu_;
+	oldTensorRT_ = tensorRT_;
+	oldCascade_  = cascade_;
+}
+
+// The requested settings didn't work, go back
+// to the ones used by the running detector
+void DetectState::rollback(void)
+{
+	d12IO_    = oldD12IO_;
+	d24IO_    = oldD24IO_;
+	c12IO_    = oldC12IO_;
+	c24IO_    = oldC24IO_;
+	casIO_    = oldCasIO_;
+	gpu_      = oldGpu_;
+	tensorRT_ = oldTensorRT_;
+	cascade_  = oldCascade_;
+	pending_  = false;
+	wantedKey_.clear();
+}
+
+// Switch to a detector with the given config. Use
+// it immediately if it is in the cache, otherwise
+// start loading it.  Only one load runs at a time -
+// if one is already going, this config is
+// loaded once it finishes
+void DetectState::requestDetector(const DetectorConfig &config)
+{
+	wantedKey_ = config.key;
+	ObjDetect *cached = findCached(config.key);
+	if (cached)
+	{
+		detector_ = cached;
+		pending_  = false;
+		commit();
+		return;
 	}
+	if (loadThread_.joinable())
+	{
+		pending_ = (config.key != loadConfig_.key);
+		if (pending_)
+			pendingConfig_ = config;
+		return;
+	}
+	cerr << "Loading detector " << config.key << endl;
+	loadConfig_ = config;
+	loadResult_ = NULL;
+	loadDone_   = false;
+	loadThread_ = boost::thread(&DetectState::loadThread, this);
+}
+
+void DetectState::loadThread(void)
+{
+	ObjDetect *detector = buildDetector(loadConfig_);
+	boost::lock_guard<boost::mutex> guard(loadMtx_);
+	loadResult_ = detector;
+	loadDone_   = true;
+}
+
+// Pick up the result of a background load. Cache
+// it if it worked and swap it in if it is still
+// the one wanted.  If not, start on the next request
+void DetectState::finishLoad(void)
+{
+	loadThread_.join();
+	ObjDetect *loaded = loadResult_;
+	loadResult_ = NULL;
+	loadDone_   = false;
 
+	const bool wanted = (loadConfig_.key == wantedKey_);
+	if (loaded && loaded->initialized())
+	{
+		addCached(loadConfig_.key, loaded);
+		if (wanted)
+		{
+			detector_ = loaded;
+			commit();
+		}
+	}
+	else
+	{
+		cerr << "Error loading detector " << loadConfig_.key << endl;
+		if (loaded)
+			delete loaded;
+		if (wanted)
+			rollback();
+	}
+
+	if (pending_)
+	{
+		pending_ = false;
+		requestDetector(pendingConfig_);
+	}
+}
+
+// Called each frame. Swaps in a new detector if
+// a background load has finished and starts
+// a load if any settings have changed
+bool DetectState::update(void)
+{
+	bool loadDone;
+	{
+		boost::lock_guard<boost::mutex> guard(loadMtx_);
+		loadDone = loadDone_;
+	}
+	if (loadDone)
+		finishLoad();
+
+	if (reload_ == false)
+		return true;
 	reload_ = false;
 
-	// Verfiy the load
-	if( !detector_ || !detector_->initialized() )
+	DetectorConfig config;
+	if (!makeConfig(config))
 	{
-		cerr << "Error loading detector" << endl;
-		detector_ = oldDetector;
-		gpu_ = oldGpu_;
-		tensorRT_ = oldTensorRT_;
-		cascade_ = oldCascade_;
-		return (oldDetector != NULL);
+		rollback();
+		return (detector_ != NULL);
 	}
 
-	if (oldDetector)
-		delete oldDetector;
-	oldGpu_ = gpu_;
-	oldTensorRT_ = tensorRT_;
-	oldCascade_ = cascade_;
+	// Nothing to fall back on the first time
+	// through, so wait for the initial load
+	if (!detector_)
+	{
+		ObjDetect *detector = buildDetector(config);
+		if (!detector || !detector->initialized())
+		{
+			cerr << "Error loading detector" << endl;
+			if (detector)
+				delete detector;
+			return false;
+		}
+		addCached(config.key, detector);
+		detector_  = detector;
+		wantedKey_ = config.key;
+		commit();
+		return true;
+	}
 
+	requestDetector(config);
 	return true;
 }
 
@@ -262,5 +468,7 @@ std::string DetectState::print(void) const
 			ret += "Caffe";
 		ret += " " + d12IO_.print() + "," + d24IO_.print() + "," + c12IO_.print() + "," + c24IO_.print();
 	}
+	if (loadThread_.joinable())
+		ret += " (loading)";
 	return ret;
 }
@@ -1,16 +1,22 @@
 #ifndef DETECT_STATE_HPP__
 #define DETECT_STATE_HPP__
 
+#include <list>
+#include <boost/thread.hpp>
+
 #include "classifierio.hpp"
 #include "cascadeclassifierio.hpp"
 #include "objdetect.hpp"
 
 // A class to manage the currently loaded detector plus the state loaded
 // into that detector.
+// Other than the first one, detectors are built in a background
+// thread while the current one keeps running.  The last few detectors
+// loaded are kept around so switching back to one of them is instant.
 class DetectState
 {
 	public:
-		DetectState(const ClassifierIO &d12IO, const ClassifierIO &d24IO, const ClassifierIO &c12IO, const ClassifierIO &c24IO, float hfov, bool gpu = false, bool tensorRT = false, const ObjectType &objToDetect = ObjectType(1));
+		DetectState(const ClassifierIO &d12IO, const ClassifierIO &d24IO, const ClassifierIO &c12IO, const ClassifierIO &c24IO, float hfov, bool gpu = false, bool tensorRT = false, const ObjectType &objToDetect = ObjectType(1), bool tuneBatch = false);
 		~DetectState();
 
 		// Make non-copyable
@@ -35,9 +41,35 @@ class DetectState
 			return detector_;
 		}
 	private:
+		// Everything needed to build a detector. key is
+		// unique for each combination of files and flags and
+		// is used to find previously loaded detectors
+		struct DetectorConfig
+		{
+			std::vector<std::string> d12Files;
+			std::vector<std::string> d24Files;
+			std::vector<std::string> c12Files;
+			std::vector<std::string> c24Files;
+			std::string              casName;
+			bool                     gpu;
+			bool                     tensorRT;
+			bool                     cascade;
+			std::string              key;
+		};
+
 		bool checkNNetFiles(const ClassifierIO &inCLIO,
 							const std::string &name,
 							std::vector<std::string> &outFiles);
+		bool makeConfig(DetectorConfig &config);
+		ObjDetect *buildDetector(const DetectorConfig &config) const;
+		void requestDetector(const DetectorConfig &config);
+		void loadThread(void);
+		void finishLoad(void);
+		ObjDetect *findCached(const std::string &key);
+		void addCached(const std::string &key, ObjDetect *detector);
+		void commit(void);
+		void rollback(void);
+
 		ObjDetect    *detector_;
 		ClassifierIO  d12IO_;
 		ClassifierIO  d24IO_;
@@ -49,13 +81,36 @@ class DetectState
 		bool          gpu_;
 		bool          tensorRT_;
 		bool          cascade_;
-		// Settings from previous frame - used
+		bool          tuneBatch_;  // pick net batch sizes by timing them after loading
+		// Settings for the detector currently running - used
 		// to undo changes if the selected state
 		// doesn't work
+		ClassifierIO  oldD12IO_;
+		ClassifierIO  oldD24IO_;
+		ClassifierIO  oldC12IO_;
+		ClassifierIO  oldC24IO_;
+		CascadeClassifierIO oldCasIO_;
 		bool          oldGpu_;
 		bool          oldTensorRT_;
 		bool          oldCascade_;
 		bool          reload_;
+
+		// Recently used detectors, most recent first.
+		// detector_ is always one of these
+		std::list<std::pair<std::string, ObjDetect *>> cache_;
+
+		// Background loading. loadConfig_ is only touched
+		// by the main thread while no load is running.
+		// If settings change during a load, the newest
+		// request waits in pendingConfig_
+		boost::thread  loadThread_;
+		boost::mutex   loadMtx_;
+		DetectorConfig loadConfig_;
+		ObjDetect     *loadResult_;
+		bool           loadDone_;
+		DetectorConfig pendingConfig_;
+		bool           pending_;
+		std::string    wantedKey_; // key of the most recently requested settings
 };
 
 #endif
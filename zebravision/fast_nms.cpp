@@ -35,9 +35,149 @@ class DetectedPlusIndex
 		}
 };
 
-void fastNMS(const vector<Detected> &detected, double overlap_th, vector<size_t> &filteredList) 
+// Rects sorted by decreasing score, stored as separate
+// arrays of coords so the overlap math in the inner loops
+// works on contiguous data
+struct NMSRects
+{
+	vector<int>    x1_;
+	vector<int>    y1_;
+	vector<int>    x2_;
+	vector<int>    y2_;
+	vector<int>    area_;
+	vector<size_t> index_;
+};
+
+// Uniform grid covering all of the rects.  Each rect is
+// added to every cell it touches, with a copy of its coords
+// stored per cell entry.  Cells are stored back to back
+// with cellStart_[i] .. cellEnd_[i] holding the entries
+// for cell i which are still in play
+class NMSGrid
+{
+	public:
+		NMSGrid(const NMSRects &rects)
+		{
+			const size_t n = rects.x1_.size();
+			minX_ = *min_element(rects.x1_.cbegin(), rects.x1_.cend());
+			minY_ = *min_element(rects.y1_.cbegin(), rects.y1_.cend());
+			const int maxX = *max_element(rects.x2_.cbegin(), rects.x2_.cend());
+			const int maxY = *max_element(rects.y2_.cbegin(), rects.y2_.cend());
+
+			// Start with cells about the size of an average
+			// rect - most rects then land in at most 4 cells.
+			// Grow them if there would be far more cells than rects
+			double sumSize = 0;
+			for (size_t i = 0; i < n; i++)
+				sumSize += (rects.x2_[i] - rects.x1_[i]) + (rects.y2_[i] - rects.y1_[i]);
+			cellSize_ = max(1, (int)(sumSize / (2 * n)));
+			while (true)
+			{
+				cols_ = max(1, (maxX - minX_ + cellSize_ - 1) / cellSize_);
+				rows_ = max(1, (maxY - minY_ + cellSize_ - 1) / cellSize_);
+				if ((size_t)cols_ * rows_ <= 4 * n + 16)
+					break;
+				cellSize_ *= 2;
+			}
+
+			// Count entries per cell, then fill them in
+			cellStart_.assign(cols_ * rows_ + 1, 0);
+			for (size_t i = 0; i < n; i++)
+				forEachCell(rects, i, [&](int cell) { cellStart_[cell + 1] += 1; });
+			for (size_t i = 1; i < cellStart_.size(); i++)
+				cellStart_[i] += cellStart_[i - 1];
+
+			const int entries = cellStart_.back();
+			x1_.resize(entries);
+			y1_.resize(entries);
+			x2_.resize(entries);
+			y2_.resize(entries);
+			area_.resize(entries);
+			rect_.resize(entries);
+			cellEnd_.assign(cellStart_.cbegin(), cellStart_.cend() - 1);
+			vector<int> &cursor = cellEnd_;
+			for (size_t i = 0; i < n; i++)
+				forEachCell(rects, i, [&](int cell)
+				{
+					const int e = cursor[cell]++;
+					x1_[e]   = rects.x1_[i];
+					y1_[e]   = rects.y1_[i];
+					x2_[e]   = rects.x2_[i];
+					y2_[e]   = rects.y2_[i];
+					area_[e] = rects.area_[i];
+					rect_[e] = i;
+				});
+		}
+
+		// Drop entries for rects which have already been
+		// used or suppressed, since they can't affect anything
+		// else.  Returns the number of entries left in the cell
+		int compact(int cell, const vector<unsigned char> &valid)
+		{
+			const int start = cellStart_[cell];
+			int end = start;
+			for (int e = start; e < cellEnd_[cell]; e++)
+			{
+				if (valid[rect_[e]])
+				{
+					x1_[end]   = x1_[e];
+					y1_[end]   = y1_[e];
+					x2_[end]   = x2_[e];
+					y2_[end]   = y2_[e];
+					area_[end] = area_[e];
+					rect_[end] = rect_[e];
+					end += 1;
+				}
+			}
+			cellEnd_[cell] = end;
+			return end - start;
+		}
+
+		int cellX(int x) const { return (x - minX_) / cellSize_; }
+		int cellY(int y) const { return (y - minY_) / cellSize_; }
+
+		// Call f(cell) for each cell rect i overlaps
+		template <class F>
+		void forEachCell(const NMSRects &rects, size_t i, F f) const
+		{
+			if ((rects.x2_[i] <= rects.x1_[i]) || (rects.y2_[i] <= rects.y1_[i]))
+				return;
+			const int cx2 = cellX(rects.x2_[i] - 1);
+			const int cy2 = cellY(rects.y2_[i] - 1);
+			for (int cy = cellY(rects.y1_[i]); cy <= cy2; cy++)
+				for (int cx = cellX(rects.x1_[i]); cx <= cx2; cx++)
+					f(cy * cols_ + cx);
+		}
+
+		int            cols_;
+		vector<int>    cellStart_;
+		vector<int>    cellEnd_;
+		vector<int>    x1_;
+		vector<int>    y1_;
+		vector<int>    x2_;
+		vector<int>    y2_;
+		vector<int>    area_;
+		vector<size_t> rect_;   // index into NMSRects for each entry
+
+	private:
+		int minX_;
+		int minY_;
+		int cellSize_;
+		int rows_;
+};
+
+// Rects are binned into a grid so each suppression test only
+// looks at rects in the cells the current best rect covers.
+// Only rects which intersect can suppress each other, so this
+// finds exactly the same set as checking against every other
+// rect.  The order rects are picked as "best" doesn't change
+// either, so results are identical to the brute force version.
+void fastNMS(const vector<Detected> &detected, double overlap_th, vector<size_t> &filteredList)
 {
 	filteredList.clear(); // Clear out return array
+	if (detected.empty())
+		return;
+
 	vector <DetectedPlusIndex> dpi;
 
 	// Create a list that includes the detected input plus the
@@ -51,60 +191,82 @@ void fastNMS(const vector<Detected> &detected, double overlap_th, vector<size_t>
 	// values first
 	sort(dpi.begin(), dpi.end(), greater<DetectedPlusIndex>());
 
-	// Loop through the dpi array. Each time through, grab
+	const size_t n = dpi.size();
+	NMSRects rects;
+	rects.x1_.resize(n);
+	rects.y1_.resize(n);
+	rects.x2_.resize(n);
+	rects.y2_.resize(n);
+	rects.area_.resize(n);
+	rects.index_.resize(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		const Rect &r = dpi[i].rect_;
+		rects.x1_[i]    = r.x;
+		rects.y1_[i]    = r.y;
+		rects.x2_[i]    = r.x + r.width;
+		rects.y2_[i]    = r.y + r.height;
+		rects.area_[i]  = r.area();
+		rects.index_[i] = dpi[i].index_;
+	}
+	NMSGrid grid(rects);
+
+	vector<unsigned char> valid(n, 1);
+	vector<unsigned char> suppress;
+
+	// Loop through the sorted rects. Each time through, grab
 	// the highest scoring remaining rect. Invalidate rects
 	// which overlap and have lower scores. Repeat until
 	// every rect has been the "best" or has been invalidated
-	auto it = dpi.begin();
-	auto dpi_end = dpi.end();
-	do
+	for (size_t i = 0; i < n; i++)
 	{
-		// Look for the highest scoring unprocessed 
-		// rectangle left in the list
-		while ((it != dpi_end) && !it->valid_)
-			++it;
+		if (!valid[i])
+			continue;
 
-		// Exit if everything has been processed
-		if (it != dpi_end)
-		{
-			// Save the index of the highest ranked remaining Rect
-			// and invalidate it - this means we've already
-			// processed it
-			filteredList.push_back(it->index_);
-			it->valid_ = false;
-
-			// Save this rect to compare against the
-			// remaining lower-scoring ones
-			Rect topRect = it->rect_;
-
-			// Set up to continue processing next
-			// rectangle next time through
-			++it;
-
-			// Loop through the rest of the array, looking
-			// for entries which overlap with the current "good"
-			// one being processed
-			for (auto jt = it; jt != dpi_end; ++jt) 
-			{
-				// Only check entries which haven't 
-				// been removed already
-				if (jt->valid_)
-				{
-					Rect thisRect = jt->rect_;
+		// Save the index of the highest ranked remaining Rect
+		// and invalidate it - this means we've already
+		// processed it
+		filteredList.push_back(rects.index_[i]);
+		valid[i] = 0;
 
-					// Look at the Intersection over Union ratio.
-					// The higher this is, the closer the two rects are
-					// to overlapping
-					double intersectArea = (topRect & thisRect).area();
-					double unionArea     = topRect.area() + thisRect.area() - intersectArea;
+		const int tx1   = rects.x1_[i];
+		const int ty1   = rects.y1_[i];
+		const int tx2   = rects.x2_[i];
+		const int ty2   = rects.y2_[i];
+		const int tArea = rects.area_[i];
 
-					if ((intersectArea > 0.0) && ((1-(intersectArea / unionArea)) <= overlap_th))
-						jt->valid_ = false; // invalidate Rects which overlap
-				}
+		grid.forEachCell(rects, i, [&](int cell)
+		{
+			const int cx    = cell % grid.cols_;
+			const int cy    = cell / grid.cols_;
+			const int start = grid.cellStart_[cell];
+			const int count = grid.compact(cell, valid);
+			suppress.resize(count);
+
+			// Look at the Intersection over Union ratio.
+			// The higher this is, the closer the two rects are
+			// to overlapping.  Rects which cover several cells
+			// are only checked in the cell holding the upper left
+			// corner of the intersection so they aren't counted twice.
+			// No branches or writes to shared state in this
+			// loop, so the compiler can vectorize it
+			for (int e = 0; e < count; e++)
+			{
+				const int ix1 = max(tx1, grid.x1_[start + e]);
+				const int iy1 = max(ty1, grid.y1_[start + e]);
+				const int iw  = min(tx2, grid.x2_[start + e]) - ix1;
+				const int ih  = min(ty2, grid.y2_[start + e]) - iy1;
+				const double intersectArea = ((iw > 0) && (ih > 0)) ? (double)iw * ih : 0.0;
+				const double unionArea     = tArea + grid.area_[start + e] - intersectArea;
+				suppress[e] = (intersectArea > 0.0) &&
+				              ((1-(intersectArea / unionArea)) <= overlap_th) &&
+				              (grid.cellX(ix1) == cx) && (grid.cellY(iy1) == cy);
 			}
-		}
+			for (int e = 0; e < count; e++)
+				if (suppress[e])
+					valid[grid.rect_[start + e]] = 0; // invalidate Rects which overlap
+		});
 	}
-	while (it != dpi_end);
 }
 
 #if 0
@@ -0,0 +1,130 @@
+// Compare FlowLocalizer modes on recorded footage.  Loads
+// frames from a ZMS file then runs each mode over all of
+// them, reporting time per frame and how far its frame to
+// frame transforms drift from the ones found by the
+// original full frame corner search at full resolution.
+// Drift is reported per frame and accumulated over the
+// whole clip by following the center of the first frame
+// through all of the transforms
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+
+#include "zmsin.hpp"
+#include "FlowLocalizer.hpp"
+
+using namespace std;
+using namespace cv;
+
+struct FlowMode
+{
+	const char *name;
+	bool        trackFeatures;
+	double      scale;
+};
+
+// Run one mode over all the frames, returning
+// seconds per frame. Fills transforms with the
+// result for each frame after the first
+static double runMode(const FlowMode &mode, const vector<Mat> &frames, vector<Mat> &transforms, double &avgFeatures)
+{
+	transforms.clear();
+	avgFeatures = 0;
+	FlowLocalizer fllc(frames[0], mode.trackFeatures, mode.scale);
+	const auto start = chrono::steady_clock::now();
+	for (size_t i = 1; i < frames.size(); i++)
+	{
+		fllc.processFrame(frames[i]);
+		transforms.push_back(fllc.transform_mat());
+		avgFeatures += fllc.featureCount();
+	}
+	const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	avgFeatures /= frames.size() - 1;
+	return elapsed / (frames.size() - 1);
+}
+
+static Point2d mapPoint(const Mat &T, const Point2d &p)
+{
+	return Point2d(T.at<double>(0,0) * p.x + T.at<double>(0,1) * p.y + T.at<double>(0,2),
+				   T.at<double>(1,0) * p.x + T.at<double>(1,1) * p.y + T.at<double>(1,2));
+}
+
+static double angleOf(const Mat &T)
+{
+	return atan2(T.at<double>(0,1), T.at<double>(0,0)) * 180. / M_PI;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		cout << argv[0] << " input.zms [max frames]" << endl;
+		return 0;
+	}
+	const size_t maxFrames = (argc > 2) ? atoi(argv[2]) : 300;
+
+	vector<Mat> frames;
+	{
+		ZMSIn in(argv[1]);
+		Mat frame;
+		Mat depth;
+		while ((frames.size() < maxFrames) && in.getFrame(frame, depth))
+			frames.push_back(frame.clone());
+	}
+	if (frames.size() < 2)
+	{
+		cerr << "Not enough frames read from " << argv[1] << endl;
+		return 1;
+	}
+	cout << "Loaded " << frames.size() << " frames, " << frames[0].size() << endl;
+
+	// The first entry is the reference the others are compared to
+	const FlowMode modes[] = {
+		{"full frame search", false, 1.0},
+		{"full frame search, 1/2", false, 0.5},
+		{"tracking", true, 1.0},
+		{"tracking, 1/2", true, 0.5},
+		{"tracking, 1/4", true, 0.25}
+	};
+
+	cout << setw(24) << left << "mode" << right
+		<< setw(10) << "ms/frame" << setw(10) << "features"
+		<< setw(12) << "dxy px" << setw(12) << "dangle deg"
+		<< setw(12) << "drift px" << endl;
+	vector<Mat> refTransforms;
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+	{
+		vector<Mat> transforms;
+		double avgFeatures;
+		const double secsPerFrame = runMode(modes[m], frames, transforms, avgFeatures);
+		if (m == 0)
+			refTransforms = transforms;
+
+		// Average per-frame difference from the reference
+		// transform, measured at the center of the frame
+		const Point2d center(frames[0].cols / 2., frames[0].rows / 2.);
+		double dxy = 0;
+		double dangle = 0;
+		Point2d pos(center);
+		Point2d refPos(center);
+		for (size_t i = 0; i < transforms.size(); i++)
+		{
+			const Point2d d(mapPoint(transforms[i], center) - mapPoint(refTransforms[i], center));
+			dxy += sqrt(d.dot(d));
+			dangle += fabs(angleOf(transforms[i]) - angleOf(refTransforms[i]));
+			pos = mapPoint(transforms[i], pos);
+			refPos = mapPoint(refTransforms[i], refPos);
+		}
+		const Point2d drift(pos - refPos);
+
+		cout << setw(24) << left << modes[m].name << right << fixed
+			<< setw(10) << setprecision(2) << secsPerFrame * 1000.
+			<< setw(10) << setprecision(0) << avgFeatures
+			<< setw(12) << setprecision(3) << dxy / transforms.size()
+			<< setw(12) << setprecision(4) << dangle / transforms.size()
+			<< setw(12) << setprecision(2) << sqrt(drift.dot(drift)) << endl;
+	}
+	return 0;
+}
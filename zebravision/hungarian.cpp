@@ -1,10 +1,12 @@
 // From https://raw.githubusercontent.com/Smorodov/Multitarget-tracker/master/HungarianAlg/HungarianAlg.cpp
+#include <algorithm>
 #include <limits>
 #include "hungarian.hpp"
 
 using namespace std;
 
-AssignmentProblemSolver::AssignmentProblemSolver()
+AssignmentProblemSolver::AssignmentProblemSolver() :
+	flagsSize_(0)
 {
 }
 
@@ -15,38 +17,48 @@ AssignmentProblemSolver::~AssignmentProblemSolver()
 double AssignmentProblemSolver::Solve(vector<vector<double>>& DistMatrix,vector<int>& Assignment,TMethod Method)
 {
 	int N=DistMatrix.size(); // number of columns (tracks)
-	int M=DistMatrix[0].size(); // number of rows (measurements)
+	int M=N ? DistMatrix[0].size() : 0; // number of rows (measurements)
 
-	int *assignment		=new int[N];
-	double *distIn		=new double[N*M];
-
-	double  cost;
-	// Fill matrix with random numbers
+	distIn_.resize(N*M);
 	for(int i=0; i<N; i++)
 	{
 		for(int j=0; j<M; j++)
 		{
-			distIn[i+N*j] = DistMatrix[i][j];
+			distIn_[i+N*j] = DistMatrix[i][j];
+		}
+	}
+	Assignment.resize(N);
+	return solveScratch(Assignment.data(), N, M, Method);
+}
+
+double AssignmentProblemSolver::Solve(const double *distMatrix, int nOfRows, int nOfColumns, int *assignment, TMethod Method)
+{
+	// The solvers work on column-major matrices
+	distIn_.resize(nOfRows*nOfColumns);
+	for(int row=0; row<nOfRows; row++)
+	{
+		for(int col=0; col<nOfColumns; col++)
+		{
+			distIn_[row+nOfRows*col] = distMatrix[row*nOfColumns+col];
 		}
 	}
+	return solveScratch(assignment, nOfRows, nOfColumns, Method);
+}
+
+// Solve using the costs already copied into distIn_
+double AssignmentProblemSolver::solveScratch(int *assignment, int nOfRows, int nOfColumns, TMethod Method)
+{
+	double cost = 0;
 	switch(Method)
 	{
-		case optimal: assignmentoptimal(assignment, &cost, distIn, N, M); break;
+		case optimal: assignmentoptimal(assignment, &cost, distIn_.data(), nOfRows, nOfColumns); break;
 
-		case many_forbidden_assignments: assignmentoptimal(assignment, &cost, distIn, N, M); break;
+		case many_forbidden_assignments: assignmentoptimal(assignment, &cost, distIn_.data(), nOfRows, nOfColumns); break;
 
-		case without_forbidden_assignments: assignmentoptimal(assignment, &cost, distIn, N, M); break;
-	}
+		case without_forbidden_assignments: assignmentoptimal(assignment, &cost, distIn_.data(), nOfRows, nOfColumns); break;
 
-	// form result 
-	Assignment.clear();
-	for(int x=0; x<N; x++)
-	{
-		Assignment.push_back(assignment[x]);
+		case jonker_volgenant: assignmentjv(assignment, &cost, distIn_.data(), nOfRows, nOfColumns); break;
 	}
-
-	delete[] assignment;
-	delete[] distIn;
 	return cost;
 }
 // --------------------------------------------------------------------------
@@ -82,8 +94,9 @@ void AssignmentProblemSolver::assignmentoptimal(int *assignment, double *cost, d
 
 	// Total elements number
 	nOfElements   = nOfRows * nOfColumns; 
-	// Memory allocation
-	distMatrix    = (double *)malloc(nOfElements * sizeof(double));
+	// Reuse scratch space from previous calls
+	distWork_.resize(nOfElements);
+	distMatrix    = distWork_.data();
 	// Pointer to last element
 	distMatrixEnd = distMatrix + nOfElements;
 
@@ -98,12 +111,21 @@ void AssignmentProblemSolver::assignmentoptimal(int *assignment, double *cost, d
 		distMatrix[row] = value;
 	}
 
-	// Memory allocation
-	coveredColumns = (bool *)calloc(nOfColumns,  sizeof(bool));
-	coveredRows    = (bool *)calloc(nOfRows,     sizeof(bool));
-	starMatrix     = (bool *)calloc(nOfElements, sizeof(bool));
-	primeMatrix    = (bool *)calloc(nOfElements, sizeof(bool));
-	newStarMatrix  = (bool *)calloc(nOfElements, sizeof(bool)); /* used in step4 */
+	// Carve the flag arrays out of one block,
+	// growing it only if this problem is bigger
+	// than any seen before
+	const size_t flagsSize = nOfColumns + nOfRows + 3 * nOfElements;
+	if (flagsSize > flagsSize_)
+	{
+		flags_.reset(new bool[flagsSize]);
+		flagsSize_ = flagsSize;
+	}
+	fill(flags_.get(), flags_.get() + flagsSize, false);
+	coveredColumns = flags_.get();
+	coveredRows    = coveredColumns + nOfColumns;
+	starMatrix     = coveredRows    + nOfRows;
+	primeMatrix    = starMatrix     + nOfElements;
+	newStarMatrix  = primeMatrix    + nOfElements; /* used in step4 */
 
 	/* preliminary steps */
 	if(nOfRows <= nOfColumns)
@@ -194,13 +216,6 @@ void AssignmentProblemSolver::assignmentoptimal(int *assignment, double *cost, d
 	step2b(assignment, distMatrix, starMatrix, newStarMatrix, primeMatrix, coveredColumns, coveredRows, nOfRows, nOfColumns, minDim);
 	/* compute cost and remove invalid assignments */
 	computeassignmentcost(assignment, cost, distMatrixIn, nOfRows);
-	/* free allocated memory */
-	free(distMatrix);
-	free(coveredColumns);
-	free(coveredRows);
-	free(starMatrix);
-	free(primeMatrix);
-	free(newStarMatrix);
 	return;
 }
 // --------------------------------------------------------------------------
@@ -510,6 +525,147 @@ void AssignmentProblemSolver::assignmentsuboptimal2(int *assignment, double *cos
 	free(distMatrix);
 }
 // --------------------------------------------------------------------------
+// Computes the optimal assignment using the Jonker-Volgenant shortest
+// augmenting path algorithm.  Each row in turn is added by finding the
+// cheapest path, in terms of reduced costs, from it to an unassigned
+// column and flipping the assignments along that path.  Row and column
+// potentials are updated so all reduced costs stay non-negative.
+// --------------------------------------------------------------------------
+void AssignmentProblemSolver::assignmentjv(int *assignment, double *cost, double *distMatrix, int nOfRows, int nOfColumns)
+{
+	*cost = 0;
+	for(int row=0; row<nOfRows; row++)
+	{
+		assignment[row] = -1;
+	}
+	if ((nOfRows == 0) || (nOfColumns == 0))
+	{
+		return;
+	}
+
+	// The algorithm needs at least as many columns as rows,
+	// so solve the transposed problem if that isn't the case
+	const bool transposed = nOfRows > nOfColumns;
+	const int  n = transposed ? nOfColumns : nOfRows;
+	const int  m = transposed ? nOfRows    : nOfColumns;
+	auto c = [=](int i, int j)
+	{
+		return transposed ? distMatrix[j + nOfRows*i] : distMatrix[i + nOfRows*j];
+	};
+
+	u_.assign(n, 0);
+	v_.assign(m, 0);
+	col4row_.assign(n, -1);
+	row4col_.assign(m, -1);
+	shortest_.resize(m);
+	path_.resize(m);
+	remaining_.resize(m);
+	scannedRows_.resize(n);
+	scannedCols_.resize(m);
+
+	for(int curRow=0; curRow<n; curRow++)
+	{
+		fill(shortest_.begin(), shortest_.end(), numeric_limits<double>::infinity());
+		fill(scannedRows_.begin(), scannedRows_.end(), 0);
+		fill(scannedCols_.begin(), scannedCols_.end(), 0);
+		// Fill in reverse so ties go to the lowest column
+		int numRemaining = m;
+		for(int j=0; j<m; j++)
+		{
+			remaining_[j] = m - j - 1;
+		}
+
+		double minVal = 0;
+		int    row    = curRow;
+		int    sink   = -1;
+		while(sink == -1)
+		{
+			scannedRows_[row] = 1;
+			int    indexLowest = -1;
+			double lowest      = numeric_limits<double>::infinity();
+			for(int it=0; it<numRemaining; it++)
+			{
+				const int    col = remaining_[it];
+				const double r   = minVal + c(row, col) - u_[row] - v_[col];
+				if(r < shortest_[col])
+				{
+					path_[col]     = row;
+					shortest_[col] = r;
+				}
+				// Prefer unassigned columns on ties, that ends the search sooner
+				if((shortest_[col] < lowest) ||
+				   ((shortest_[col] == lowest) && (row4col_[col] == -1)))
+				{
+					lowest      = shortest_[col];
+					indexLowest = it;
+				}
+			}
+			minVal = lowest;
+			if(indexLowest == -1)
+			{
+				// Only possible if costs aren't finite
+				cout << "All matrix elements have to be finite." << endl;
+				return;
+			}
+
+			const int col = remaining_[indexLowest];
+			scannedCols_[col] = 1;
+			remaining_[indexLowest] = remaining_[--numRemaining];
+			if(row4col_[col] == -1)
+			{
+				sink = col;
+			}
+			else
+			{
+				row = row4col_[col];
+			}
+		}
+
+		// Update potentials
+		u_[curRow] += minVal;
+		for(int i=0; i<n; i++)
+		{
+			if(scannedRows_[i] && (i != curRow))
+			{
+				u_[i] += minVal - shortest_[col4row_[i]];
+			}
+		}
+		for(int j=0; j<m; j++)
+		{
+			if(scannedCols_[j])
+			{
+				v_[j] -= minVal - shortest_[j];
+			}
+		}
+
+		// Augment along the path back from sink
+		int col = sink;
+		while(true)
+		{
+			const int i = path_[col];
+			row4col_[col] = i;
+			swap(col4row_[i], col);
+			if(i == curRow)
+			{
+				break;
+			}
+		}
+	}
+
+	for(int i=0; i<n; i++)
+	{
+		if(transposed)
+		{
+			assignment[col4row_[i]] = i;
+		}
+		else
+		{
+			assignment[i] = col4row_[i];
+		}
+	}
+	computeassignmentcost(assignment, cost, distMatrix, nOfRows);
+}
+// --------------------------------------------------------------------------
 // Computes a suboptimal solution. Good for cases with many forbidden assignments.
 // --------------------------------------------------------------------------
 void AssignmentProblemSolver::assignmentsuboptimal1(int *assignment, double *cost, double *distMatrixIn, int nOfRows, int nOfColumns)
@@ -1,7 +1,9 @@
 // from https://raw.githubusercontent.com/Smorodov/Multitarget-tracker/master/HungarianAlg/HungarianAlg.h
+#pragma once
 #include <vector>
 #include <iostream>
 #include <limits>
+#include <memory>
 // http://community.topcoder.com/tc?module=Static&d1=tutorials&d2=hungarianAlgorithm
 class AssignmentProblemSolver
 {
@@ -26,8 +28,36 @@ class AssignmentProblemSolver
 		// --------------------------------------------------------------------------
 		void assignmentsuboptimal2(int *assignment, double *cost, double *distMatrixIn, int nOfRows, int nOfColumns);
 	public:
-		enum TMethod { optimal, many_forbidden_assignments, without_forbidden_assignments };
+		enum TMethod { optimal, many_forbidden_assignments, without_forbidden_assignments, jonker_volgenant };
 		AssignmentProblemSolver();
 		~AssignmentProblemSolver();
 		double Solve(std::vector<std::vector<double> >& DistMatrix, std::vector<int>& Assignment,TMethod Method=optimal);
+
+		// Same as above using a flat nOfRows x nOfColumns row-major cost
+		// matrix.  assignment must have room for nOfRows entries
+		double Solve(const double *distMatrix, int nOfRows, int nOfColumns, int *assignment, TMethod Method=optimal);
+	private:
+		// --------------------------------------------------------------------------
+		// Computes the optimal assignment using the Jonker-Volgenant shortest
+		// augmenting path algorithm. All costs must be finite.
+		// --------------------------------------------------------------------------
+		void assignmentjv(int *assignment, double *cost, double *distMatrix, int nOfRows, int nOfColumns);
+
+		double solveScratch(int *assignment, int nOfRows, int nOfColumns, TMethod Method);
+
+		// Scratch space reused from call to call so solving
+		// lots of small problems doesn't hit the allocator
+		std::vector<double> distIn_;     // column-major copy of the input costs
+		std::vector<double> distWork_;   // working copy modified by the solver
+		std::unique_ptr<bool[]> flags_;  // covered / star / prime flags
+		size_t              flagsSize_;
+		std::vector<double> u_;          // JV row and column potentials
+		std::vector<double> v_;
+		std::vector<double> shortest_;   // JV shortest path to each column
+		std::vector<int>    path_;       // JV row preceding each column in the path
+		std::vector<int>    col4row_;
+		std::vector<int>    row4col_;
+		std::vector<int>    remaining_;  // JV columns not yet scanned
+		std::vector<char>   scannedRows_;
+		std::vector<char>   scannedCols_;
 };
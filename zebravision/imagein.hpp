@@ -14,6 +14,7 @@ class ImageIn : public MediaIn
 		~ImageIn() {}
 		bool isOpened(void) const;
 		bool getFrame(cv::Mat &frame, cv::Mat &depth, bool pause = false);
+		using MediaIn::getFrame;
 
 		int frameCount(void) const;
 
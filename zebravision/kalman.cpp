@@ -99,6 +99,12 @@ Point3f TKalmanFilter::GetPrediction()
 	return Point3f(prediction.at<float>(0),prediction.at<float>(1),prediction.at<float>(2)); 
 }
 //---------------------------------------------------------------------------
+Point3f TKalmanFilter::PeekPrediction() const
+{
+	Mat prediction = kalman.transitionMatrix * kalman.statePost;
+	return Point3f(prediction.at<float>(0),prediction.at<float>(1),prediction.at<float>(2)); 
+}
+//---------------------------------------------------------------------------
 Point3f TKalmanFilter::Update(const Point3f &p)
 {
 	Mat measurement(3, 1, CV_32F);
@@ -134,3 +140,197 @@ void TKalmanFilter::adjustPrediction(const cv::Point3f &delta_pos)
 	kalman.statePre.at<float>(1) = kalman.statePre.at<float>(1) + delta_pos.y;
 	kalman.statePre.at<float>(2) = kalman.statePre.at<float>(2) + delta_pos.z;
 }
+
+//---------------------------------------------------------------------------
+// Noise values match the matrices set up in TKalmanFilter
+KalmanBatch::KalmanBatch(float dt, float accel_noise_mag) :
+	dt_(dt),
+	r_(0.1f),
+	p0_(0.1f)
+{
+	q_[P00] = (float)pow(dt, 4.0) / 4.0f;
+	q_[P01] = (float)pow(dt, 3.0) / 2.0f;
+	q_[P11] = (float)pow(dt, 2.0);
+	for (size_t i = 0; i < COV_SIZE; i++)
+		q_[i] = (double)q_[i] * accel_noise_mag;
+}
+
+size_t KalmanBatch::size(void) const
+{
+	return pre_[PX].size();
+}
+
+void KalmanBatch::push_back(const Point3f &p)
+{
+	const float state[STATE_SIZE] = {p.x, p.y, p.z, 0, 0, 0};
+	for (size_t i = 0; i < STATE_SIZE; i++)
+	{
+		pre_[i].push_back(state[i]);
+		post_[i].push_back(state[i]);
+	}
+	// errorCovPre starts out at zero, errorCovPost
+	// as a diagonal matrix
+	const float cov[COV_SIZE] = {p0_, 0, p0_};
+	for (size_t i = 0; i < COV_SIZE; i++)
+	{
+		preCov_[i].push_back(0);
+		postCov_[i].push_back(cov[i]);
+	}
+}
+
+void KalmanBatch::compact(const vector<bool> &keep)
+{
+	const size_t n = size();
+	size_t out = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (!keep[i])
+			continue;
+		if (out != i)
+		{
+			for (size_t s = 0; s < STATE_SIZE; s++)
+			{
+				pre_[s][out]  = pre_[s][i];
+				post_[s][out] = post_[s][i];
+			}
+			for (size_t c = 0; c < COV_SIZE; c++)
+			{
+				preCov_[c][out]  = preCov_[c][i];
+				postCov_[c][out] = postCov_[c][i];
+			}
+		}
+		out += 1;
+	}
+	for (size_t s = 0; s < STATE_SIZE; s++)
+	{
+		pre_[s].resize(out);
+		post_[s].resize(out);
+	}
+	for (size_t c = 0; c < COV_SIZE; c++)
+	{
+		preCov_[c].resize(out);
+		postCov_[c].resize(out);
+	}
+}
+
+// x' = F x, P' = F P Ft + Q with, per axis,
+//   F = | 1  dt  |
+//       | 0  0.5 |
+// As with KalmanFilter::predict(), the post values
+// are set to the prediction in case there isn't an
+// update before the next predict
+void KalmanBatch::predict(vector<Point3f> &predictions)
+{
+	const size_t n  = size();
+	const float  dt = dt_;
+	for (size_t axis = 0; axis < 3; axis++)
+	{
+		const float *x    = post_[PX + axis].data();
+		const float *v    = post_[VX + axis].data();
+		float       *preX = pre_[PX + axis].data();
+		float       *preV = pre_[VX + axis].data();
+		float       *outX = post_[PX + axis].data();
+		float       *outV = post_[VX + axis].data();
+		for (size_t i = 0; i < n; i++)
+		{
+			const float px = x[i] + dt * v[i];
+			const float pv = 0.5f * v[i];
+			preX[i] = outX[i] = px;
+			preV[i] = outV[i] = pv;
+		}
+	}
+
+	float *p00 = postCov_[P00].data();
+	float *p01 = postCov_[P01].data();
+	float *p11 = postCov_[P11].data();
+	float *pre00 = preCov_[P00].data();
+	float *pre01 = preCov_[P01].data();
+	float *pre11 = preCov_[P11].data();
+	const float q00 = q_[P00];
+	const float q01 = q_[P01];
+	const float q11 = q_[P11];
+	for (size_t i = 0; i < n; i++)
+	{
+		// F P
+		const float a00 = p00[i] + dt * p01[i];
+		const float a01 = p01[i] + dt * p11[i];
+		const float a11 = 0.5f * p11[i];
+		// (F P) Ft + Q
+		const float c00 = a00 + dt * a01 + q00;
+		const float c01 = 0.5f * a01 + q01;
+		const float c11 = 0.5f * a11 + q11;
+		pre00[i] = p00[i] = c00;
+		pre01[i] = p01[i] = c01;
+		pre11[i] = p11[i] = c11;
+	}
+
+	predictions.resize(n);
+	for (size_t i = 0; i < n; i++)
+		predictions[i] = Point3f(pre_[PX][i], pre_[PY][i], pre_[PZ][i]);
+}
+
+// Measurements are position only, so per axis
+//   S = P00 + R, K = [P00 P01]t / S
+//   x = x + K (z - x)
+//   P = P - K [P00 P01]
+void KalmanBatch::update(const vector<Point3f> &measurements, vector<Point3f> &estimates)
+{
+	const size_t n = size();
+	const float *pre00 = preCov_[P00].data();
+	const float *pre01 = preCov_[P01].data();
+	const float *pre11 = preCov_[P11].data();
+	float *p00 = postCov_[P00].data();
+	float *p01 = postCov_[P01].data();
+	float *p11 = postCov_[P11].data();
+
+	// Gain is the same for all three axes. Keep it in
+	// the post covariance arrays until the state is updated
+	const float r = r_;
+	for (size_t i = 0; i < n; i++)
+	{
+		const float s = pre00[i] + r;
+		p00[i] = pre00[i] / s;
+		p01[i] = pre01[i] / s;
+	}
+	float Point3f::* const axes[3] = {&Point3f::x, &Point3f::y, &Point3f::z};
+	for (size_t axis = 0; axis < 3; axis++)
+	{
+		const float *x    = pre_[PX + axis].data();
+		const float *v    = pre_[VX + axis].data();
+		float       *outX = post_[PX + axis].data();
+		float       *outV = post_[VX + axis].data();
+		float Point3f::* const z = axes[axis];
+		for (size_t i = 0; i < n; i++)
+		{
+			const float innovation = measurements[i].*z - x[i];
+			outX[i] = x[i] + p00[i] * innovation;
+			outV[i] = v[i] + p01[i] * innovation;
+		}
+	}
+	for (size_t i = 0; i < n; i++)
+	{
+		const float k0 = p00[i];
+		const float k1 = p01[i];
+		p00[i] = pre00[i] - k0 * pre00[i];
+		p01[i] = pre01[i] - k0 * pre01[i];
+		p11[i] = pre11[i] - k1 * pre01[i];
+	}
+
+	estimates.resize(n);
+	for (size_t i = 0; i < n; i++)
+		estimates[i] = Point3f(post_[PX][i], post_[PY][i], post_[PZ][i]);
+}
+
+Point3f KalmanBatch::peekPrediction(size_t i) const
+{
+	return Point3f(post_[PX][i] + dt_ * post_[VX][i],
+				   post_[PY][i] + dt_ * post_[VY][i],
+				   post_[PZ][i] + dt_ * post_[VZ][i]);
+}
+
+void KalmanBatch::adjustPrediction(size_t i, const Point3f &delta_pos)
+{
+	pre_[PX][i] += delta_pos.x;
+	pre_[PY][i] += delta_pos.y;
+	pre_[PZ][i] += delta_pos.z;
+}
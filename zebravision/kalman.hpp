@@ -1,5 +1,6 @@
 // From : https://raw.githubusercontent.com/Smorodov/Multitarget-tracker/master/KalmanFilter/Kalman.h
 #pragma once
+#include <vector>
 #include <opencv2/opencv.hpp>
 //#include <Eigen/Geometry>
 // http://www.morethantechnical.com/2011/06/17/simple-kalman-filter-for-tracking-using-opencv-2-2-w-code/
@@ -8,6 +9,9 @@ class TKalmanFilter
 	public:
 		TKalmanFilter(const cv::Point3f &p, float dt = 0.05, float Accel_noise_mag = 0.5);
 		cv::Point3f GetPrediction();
+		// Predicted position for the next step without
+		// advancing the filter state
+		cv::Point3f PeekPrediction() const;
 		cv::Point3f Update(const cv::Point3f &p);
 	//	void adjustPrediction(const Eigen::Transform<double, 3, Eigen::Isometry> &delta_robot);
 		void adjustPrediction(const cv::Point3f &delta_pos);
@@ -15,3 +19,56 @@ class TKalmanFilter
 		cv::KalmanFilter kalman;
 };
 
+
+// The same constant velocity filter as TKalmanFilter for a whole
+// set of tracks, stored as one array per state variable.
+// Each axis' position only interacts with its own velocity and
+// all three axes start out with the same covariance, get the same
+// process and measurement noise and are always updated together.
+// That means the 6x6 covariance matrix is three copies of one
+// symmetric 2x2 block.  Storing just that block turns each predict
+// or update into a handful of multiply-adds per track which the
+// compiler can vectorize across tracks.
+class KalmanBatch
+{
+	public:
+		KalmanBatch(float dt = 0.05, float accel_noise_mag = 0.5);
+
+		size_t size(void) const;
+
+		// Add a filter starting at p with zero velocity
+		void push_back(const cv::Point3f &p);
+
+		// Remove each filter i where keep[i] is false.
+		// The rest stay in the same order
+		void compact(const std::vector<bool> &keep);
+
+		// Advance all filters one step. Fills predictions
+		// with the predicted position for each
+		void predict(std::vector<cv::Point3f> &predictions);
+
+		// Correct all filters with one measurement per filter.
+		// Fills estimates with the corrected positions
+		void update(const std::vector<cv::Point3f> &measurements, std::vector<cv::Point3f> &estimates);
+
+		// Predicted position of filter i for the next step
+		// without advancing the filter state
+		cv::Point3f peekPrediction(size_t i) const;
+
+		void adjustPrediction(size_t i, const cv::Point3f &delta_pos);
+
+	private:
+		enum { PX, PY, PZ, VX, VY, VZ, STATE_SIZE };
+		enum { P00, P01, P11, COV_SIZE };  // per-axis covariance block
+
+		float dt_;
+		float q_[COV_SIZE];   // process noise
+		float r_;             // measurement noise
+		float p0_;            // initial covariance diagonal
+
+		// Before (pre) and after (post) each update
+		std::vector<float> pre_[STATE_SIZE];
+		std::vector<float> post_[STATE_SIZE];
+		std::vector<float> preCov_[COV_SIZE];
+		std::vector<float> postCov_[COV_SIZE];
+};
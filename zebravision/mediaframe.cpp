@@ -0,0 +1,42 @@
+#include <atomic>
+#include "mediaframe.hpp"
+
+using namespace cv;
+using namespace std;
+
+bool matIsShared(const Mat &m)
+{
+#if CV_MAJOR_VERSION == 2
+	return m.refcount && (*m.refcount > 1);
+#else
+	return m.u && (m.u->refcount > 1);
+#endif
+}
+
+shared_ptr<MediaFrame> MediaFramePool::get(void)
+{
+	// use_count can't go from 1 to anything else behind
+	// our back since nothing else has a reference to copy
+	for (auto it = frames_.begin(); it != frames_.end(); ++it)
+	{
+		if (it->use_count() == 1)
+		{
+			// Pairs with the release done when the last
+			// reader dropped its reference, so anything it
+			// did with the frame is finished before reuse
+			atomic_thread_fence(memory_order_acquire);
+
+			// A reader could have kept a Mat header
+			// pointing at the image data after releasing
+			// the frame itself. Leave that data to them
+			// rather than writing over it
+			if (matIsShared((*it)->frame))
+				(*it)->frame.release();
+			if (matIsShared((*it)->depth))
+				(*it)->depth.release();
+			return *it;
+		}
+	}
+	frames_.push_back(make_shared<MediaFrame>());
+	return frames_.back();
+}
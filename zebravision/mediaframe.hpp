@@ -0,0 +1,47 @@
+// Frames handed out by MediaIn and passed on to MediaOut.
+// Once an input has filled one in it is shared, read only,
+// between everything using it - processing threads, video
+// writers and so on - rather than each making its own copy.
+// Frames come from a MediaFramePool and go back to it once
+// the last reference is dropped, so the image buffers are
+// reused from frame to frame instead of being reallocated
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+struct MediaFrame
+{
+	MediaFrame(void) : frameNumber(0), timeStamp(0) {}
+
+	cv::Mat   frame;
+	cv::Mat   depth;
+	int       frameNumber;
+	long long timeStamp;
+};
+
+// What consumers get. Nothing should write to the
+// image data through one of these - other threads
+// are likely looking at the same frame
+typedef std::shared_ptr<const MediaFrame> MediaFramePtr;
+
+// True if another Mat references m's data
+bool matIsShared(const cv::Mat &m);
+
+class MediaFramePool
+{
+	public:
+		// Get a frame to fill in. Its Mats keep their buffers
+		// from the last time it was used, so filling them in
+		// with Mat::create / copyTo at the same size doesn't
+		// allocate. Not thread safe - each pool is meant to be
+		// used by a single producer
+		std::shared_ptr<MediaFrame> get(void);
+
+	private:
+		// Every frame this pool has handed out. One whose
+		// only reference is the one held here has been
+		// released by all its readers and can be reused
+		std::vector<std::shared_ptr<MediaFrame>> frames_;
+};
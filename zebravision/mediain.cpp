@@ -54,6 +54,20 @@ bool MediaIn::getFrame(Mat &frame, Mat &depth, bool pause)
 	return false;
 }
 
+bool MediaIn::getFrame(MediaFramePtr &frame, bool pause)
+{
+	shared_ptr<MediaFrame> newFrame = make_shared<MediaFrame>();
+	if (!getFrame(newFrame->frame, newFrame->depth, pause))
+	{
+		frame.reset();
+		return false;
+	}
+	newFrame->frameNumber = frameNumber();
+	newFrame->timeStamp   = timeStamp();
+	frame = newFrame;
+	return true;
+}
+
 bool MediaIn::isOpened(void) const
 {
 	return false;
@@ -118,6 +132,12 @@ void MediaIn::lockFrameNumber(void)
 	lockedFrameNumber_ = frameNumber_;
 }
 
+void MediaIn::stampFrame(MediaFrame &frame) const
+{
+	frame.frameNumber = frameNumber_;
+	frame.timeStamp   = timeStamp_;
+}
+
 int MediaIn::frameNumber(void) const
 {
 	return lockedFrameNumber_;
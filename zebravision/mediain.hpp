@@ -11,6 +11,7 @@
 
 #include "cameraparams.hpp"
 #include "frameticker.hpp"
+#include "mediaframe.hpp"
 #include "ZvSettings.hpp"
 #include <navXTimeSync/AHRS.h>
 
@@ -30,6 +31,12 @@ class MediaIn
 		virtual bool isOpened(void) const;
 		virtual bool getFrame(cv::Mat &frame, cv::Mat &depth, bool pause = false);
 
+		// Get the next frame as a shared, read only handle
+		// rather than a copy. Pausing returns the handle from
+		// the last unpaused call again. The default wraps the
+		// Mat version above
+		virtual bool getFrame(MediaFramePtr &frame, bool pause = false);
+
 		// Image size
 		unsigned int width() const;
 		unsigned int height() const;
@@ -65,6 +72,9 @@ class MediaIn
 		void setFrameNumber(int frameNumber);
 		void incFrameNumber(void);
 		void lockFrameNumber(void);
+		// Copy the current (unlocked) frame number and
+		// time stamp into a frame about to be handed out
+		void stampFrame(MediaFrame &frame) const;
 		void FPSmark(void);
 
 		virtual bool loadSettings(void);
@@ -1,33 +1,59 @@
 #include <iostream>
+#include <sys/time.h>
 #include "mediaout.hpp"
 #include "frameticker.hpp"
 
 using namespace cv;
+using namespace std;
 
 // Set up variables to skip frames and split
 // between files as set up by the derived class
-// Initialize frameReady shared var to false and 
-// kick off the writer thread
+// Start with a one frame queue and kick off
+// the writer thread
 MediaOut::MediaOut(int frameSkip, int framesPerFile) :
 	frameSkip_(max(frameSkip, 1)),
 	frameCounter_(0),
 	fileCounter_(0),
 	framesPerFile_(framesPerFile),
 	framesThisFile_(framesPerFile_),
-	frameReady_(false),
-	writePending_(false),
-	thread_(boost::bind(&MediaOut::writeThread, this))
+	queueDepth_(1),
+	queuePolicy_(BQ_DROP_OLDEST),
+	popSeq_(0),
+	writeSeq_(0),
+	stats_(),
+	threadCount_(1)
 {
+	threads_.create_thread(boost::bind(&MediaOut::writeThread, this));
 }
 
 MediaOut::~MediaOut(void)
 {
 	// Make sure any pending frames have been
 	// written, then shut down the writer
-	// thread.  Once that's finished, exit
+	// threads.  Once that's finished, exit
 	sync();
-  	thread_.interrupt();
-  	thread_.join();
+	threads_.interrupt_all();
+	threads_.join_all();
+}
+
+void MediaOut::setWriteQueue(size_t depth, BoundedQueuePolicy policy, size_t encodeThreads)
+{
+	boost::mutex::scoped_lock lock(matLock_);
+	queueDepth_  = max<size_t>(depth, 1);
+	queuePolicy_ = policy;
+
+	// Extra threads only help if frames can be
+	// compressed without waiting for the one before
+	if (!canEncode())
+		encodeThreads = 1;
+	for (; threadCount_ < encodeThreads; threadCount_++)
+		threads_.create_thread(boost::bind(&MediaOut::writeThread, this));
+}
+
+MediaOutStats MediaOut::stats(void) const
+{
+	boost::mutex::scoped_lock lock(matLock_);
+	return stats_;
 }
 
 // Save a frame if there have been frameSkip_ frames
@@ -35,17 +61,40 @@ MediaOut::~MediaOut(void)
 // == 2 every other, and so on).
 // Open a new output file if framesPerFile_ frames have been written
 // to the current video
-bool MediaOut::saveFrame(const Mat &frame, const Mat &depth)
+bool MediaOut::saveFrame(const Mat &frame, const Mat &depth, long long timeStamp)
+{
+	// Only copy frames which will actually be written
+	if ((frameCounter_ % frameSkip_) != 0)
+	{
+		frameCounter_ += 1;
+		return true;
+	}
+	shared_ptr<MediaFrame> copy = framePool_.get();
+	frame.copyTo(copy->frame);
+	depth.copyTo(copy->depth);
+	if (timeStamp == -1)
+	{
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		timeStamp = (long long)tv.tv_sec * 1000000ULL + (long long)tv.tv_usec;
+	}
+	copy->timeStamp = timeStamp;
+	return saveFrame(copy);
+}
+
+bool MediaOut::saveFrame(const MediaFramePtr &frame)
 {
-	// Every frameSkip_ frames, copy another frame
-	// to the frame_ and depth_ vars. Then set frameReady_
-	// to trigger the writer thread to grab them and
-	// write them to disk
+	if (!frame)
+		return false;
+
+	// Every frameSkip_ frames, add another frame
+	// to the queue and wake up a writer thread
+	// to grab it and write it to disk
 	if ((frameCounter_++ % frameSkip_) == 0)
 	{
 		boost::mutex::scoped_lock lock(matLock_);
 
-		// Open a new video when we've written framesThisFile
+		// Open a new video when we've queued framesThisFile
 		// framesThisFile is initialized to framesPerFile so
 		// this also opens the file the first time this
 		// method is called
@@ -53,31 +102,43 @@ bool MediaOut::saveFrame(const Mat &frame, const Mat &depth)
 		{
 			// Wait until pending writes are complete
 			// before closing the previous file
-			while (frameReady_ || writePending_)
+			while (!queue_.empty() || (writeSeq_ != popSeq_))
 				frameCond_.wait(lock);
 
 			if (!openNext(fileCounter_++))
 				return false;
 			framesThisFile_ = 0;
 		}
-		// Copy input args to shared frame_ and depth_
-		// buffers. Do it unconditionally. This means that
-		// it is possible for the update thread to miss
-		// frames if two calls to this function come in back 
-		// to back. That's OK - the goal here is to
-		// write as many frames as possible
-		// without slowing down performance rather
-		// that waiting to be sure that every frame
-		// it captured to disk.  Programs which
-		// need to save every frame can explicitly
-		// call the sync() method below before
-		// each call to this function.
-		frame.copyTo(frame_);
-		depth.copyTo(depth_);
-		frameReady_ = true;
-		// Set a flag to indicate there is a disk write
-		// that needs to complete
-		writePending_ = true;
+		stats_.enqueued += 1;
+
+		// If the writer threads are behind, what happens
+		// next depends on the policy. By default the oldest
+		// waiting frame is thrown away. The goal there is to
+		// write as many frames as possible without slowing
+		// down the caller rather than waiting to be sure
+		// every frame it captured makes it to disk.
+		// Programs which need to save every frame can use
+		// BQ_BLOCK or explicitly call the sync() method below
+		// before each call to this function.
+		if (queuePolicy_ == BQ_BLOCK)
+		{
+			while (queue_.size() >= queueDepth_)
+				frameCond_.wait(lock);
+		}
+		else if (queue_.size() >= queueDepth_)
+		{
+			stats_.dropped += 1;
+			if (queuePolicy_ == BQ_DROP_NEWEST)
+				return true;
+			queue_.pop_front();
+			framesThisFile_ -= 1;
+		}
+		queue_.push_back(frame);
+		// Count frames as they're queued rather than
+		// when written, otherwise everything waiting in
+		// the queue would end up in this file as well
+		framesThisFile_ += 1;
+		stats_.highWater = max(stats_.highWater, queue_.size());
 
 		// Notifiy other threads waiting
 		// on the mutex that it is now
@@ -99,81 +160,111 @@ bool MediaOut::openNext(int fileCounter)
 	return false;
 }
 
-bool MediaOut::write(const Mat &frame, const Mat &depth)
+bool MediaOut::write(const Mat &frame, const Mat &depth, long long timeStamp)
+{
+	(void)frame;
+	(void)depth;
+	(void)timeStamp;
+	return false;
+}
+
+// Formats which can't compress frames on their
+// own leave these alone and only implement write()
+bool MediaOut::canEncode(void) const
+{
+	return false;
+}
+
+bool MediaOut::encode(const Mat &frame, const Mat &depth, string &buf) const
 {
 	(void)frame;
 	(void)depth;
+	(void)buf;
 	return false;
 }
 
-// Separate thread to write video frames to disk
-// This runs as quickly as possible, but is also
-// designed to drop frames if it gets behind the
+bool MediaOut::writeEncoded(const string &buf, long long timeStamp)
+{
+	(void)buf;
+	(void)timeStamp;
+	return false;
+}
+
+// Separate threads to write video frames to disk
+// These run as quickly as possible, but are also
+// designed to drop frames if they get behind the
 // main processing thread.  
 void MediaOut::writeThread(void)
 {
-	Mat frame;
-	Mat depth;
+	MediaFramePtr frame;
+	// Reused for each frame this thread compresses
+	string buf;
 	while (true)
 	{
 		// Grab the lock mutex
-		// Check that frameReady is set
-		// if it hasn't, that means there's
-		// no new data to write.  In that case,
-		// call wait() to release the mutex and 
-		// loop around to try again. This lets a
-		// call to saveFrame to complete if one
-		// is waiting on the mutex.
-		// Once frameReady_ has been set, copy
-		// the data out of the member variables
-		// into a local var, release the lock, 
-		// and do the write with the copies
-		// of the Mats.  Using the copies will
-		// let saveFrame write new data to the shared vars
-		// while write() works on the old frame.
-		// Note that saveFrame intentionally
-		// doesn't check to see if frame_ and
-		// depth_ have been copied by this thread
-		// before writing to them.
-		// This way if the write() call takes too
-		// long it is possible for saveFrame to
-		// update the frame_ and depth_ vars more 
-		// than once before this thread reads them again.
-		// That will potentially drop frames, but it
-		// also lets the main thread run as quickly
-		// as possible rather than waiting on this thread
+		// Check that there's a frame in the queue.
+		// If there isn't, call wait() to release
+		// the mutex and loop around to try again.
+		// This lets a call to saveFrame to complete
+		// if one is waiting on the mutex.
+		// Once there's a frame, take its handle
+		// out of the queue into a local var, release
+		// the lock, and do the write with that.
+		// Frames are read only so this lets saveFrame
+		// queue up new frames while write() works on
+		// the old one.
+		size_t seq;
+		bool parallel;
 		{
 			boost::mutex::scoped_lock lock(matLock_);
-			while (!frameReady_)
+			while (queue_.empty())
 				frameCond_.wait(lock);
 
-			frame_.copyTo(frame);
-			depth_.copyTo(depth);
-			frameReady_ = false;
+			frame = queue_.front();
+			queue_.pop_front();
+			seq = popSeq_++;
+			parallel = threadCount_ > 1;
+			// Might have made room for a blocked saveFrame
+			frameCond_.notify_all();
 		}
 
 		// Call a derived class' write() method
-		// to actually format and write the data to disk
-		write(frame, depth);
-		
-		// If there's no frame in the buffer above
-		// clear out writePending_
-		// Can't just unconditionally clear it since
-		// it is likely that saveFrame() added a new
-		// frame to the shared buffer while the 
-		// write() call just above was taking place
+		// to actually format and write the data to disk.
+		// With several threads, compress the frame first
+		// then wait for the ones taken before it to be
+		// written.
+		// Drop the handle afterwards so the frame can
+		// go back to its pool, keeping its capture time
+		// for the write
+		const long long timeStamp = frame->timeStamp;
+		bool ok = !parallel || encode(frame->frame, frame->depth, buf);
+		if (parallel)
+			frame.reset();
+		{
+			boost::mutex::scoped_lock lock(matLock_);
+			while (writeSeq_ != seq)
+				frameCond_.wait(lock);
+		}
+		if (parallel)
+			ok = ok && writeEncoded(buf, timeStamp);
+		else
+		{
+			ok = write(frame->frame, frame->depth, timeStamp);
+			frame.reset();
+		}
+
+		// Let the next frame in line be written, and
+		// let sync() know once everything is done
 		{
 			boost::mutex::scoped_lock lock(matLock_);
-			// Update count of frames actually
-			// written to the output
-			framesThisFile_ += 1;
-			if (!frameReady_)
-			{
-				writePending_ = false;
-				frameCond_.notify_all();
-			}
+			if (ok)
+				stats_.written += 1;
+			else
+				stats_.failed += 1;
+			writeSeq_ += 1;
+			ft_.mark();
+			frameCond_.notify_all();
 		}
-		ft_.mark();
 
 		boost::this_thread::interruption_point();
 	}
@@ -200,6 +291,6 @@ float MediaOut::FPS(void) const
 void MediaOut::sync(void)
 {
 	boost::mutex::scoped_lock lock(matLock_);
-	while (frameReady_ || writePending_)
+	while (!queue_.empty() || (writeSeq_ != popSeq_))
 		frameCond_.wait(lock);
 }
@@ -1,9 +1,25 @@
 #pragma once
 
+#include <deque>
+#include <string>
 #include <boost/thread.hpp>
 #include <opencv2/core/core.hpp>
 
+#include "boundedqueue.hpp"
 #include "frameticker.hpp"
+#include "mediaframe.hpp"
+
+// Running totals of what happened to frames passed
+// to MediaOut::saveFrame. Once sync() returns,
+// enqueued == written + failed + dropped
+struct MediaOutStats
+{
+	size_t enqueued;  // frames not skipped by frameSkip
+	size_t written;   // frames written to the output
+	size_t failed;    // frames the derived class couldn't write
+	size_t dropped;   // frames thrown away because the queue was full
+	size_t highWater; // most frames ever waiting in the queue
+};
 
 // Base class for output.  Derived classes are for writing 
 // AVI videos, zms (video + depth), plus whatever else we
@@ -13,17 +29,44 @@ class MediaOut
    public:
 		MediaOut(int frameSkip, int framesPerFile);
 		virtual ~MediaOut();
-		bool saveFrame(const cv::Mat &frame, const cv::Mat &depth);
+		// Copies frame and depth, since callers are free to
+		// change them once this returns. timeStamp is when
+		// the frame was captured, in usec. -1 uses the time
+		// saveFrame was called
+		bool saveFrame(const cv::Mat &frame, const cv::Mat &depth, long long timeStamp = -1);
+		// Frames from MediaIn are read only, so these are
+		// queued for writing as-is without a copy
+		bool saveFrame(const MediaFramePtr &frame);
 		void sync(void);
 		float FPS(void) const;
 
+		// Queue up to depth frames waiting to be written,
+		// using policy to decide what happens when it is full.
+		// If the derived class supports it, encodeThreads
+		// frames are compressed at once. They are still
+		// written in order. Call before the first saveFrame.
+		// The default is a single frame, replaced by newer
+		// ones if the writer falls behind
+		void setWriteQueue(size_t depth, BoundedQueuePolicy policy, size_t encodeThreads = 1);
+		MediaOutStats stats(void) const;
+
    protected:
 		// The base class calls these dervied classes to do the 
 		// heavy lifting.  They have to be implemented in the 
 		// base class as well, but hopefully those are never
-		// called 
+		// called. timeStamp is the capture time of the frame
+		// being written, not the time it was written
 		virtual bool openNext(int fileCounter);
-		virtual bool write(const cv::Mat &frame, const cv::Mat &depth);
+		virtual bool write(const cv::Mat &frame, const cv::Mat &depth, long long timeStamp);
+
+		// Formats which compress each frame independently
+		// return true from canEncode and split write() into
+		// encode, which can be called from several threads
+		// at once so mustn't change any members, and
+		// writeEncoded, which is called one frame at a time
+		virtual bool canEncode(void) const;
+		virtual bool encode(const cv::Mat &frame, const cv::Mat &depth, std::string &buf) const;
+		virtual bool writeEncoded(const std::string &buf, long long timeStamp);
 
    private: 
 		// Skip output frames if requested.  Skip is how many to 
@@ -37,12 +80,22 @@ class MediaOut
 		int framesPerFile_;
 		int framesThisFile_;
 		void writeThread(void);
-		cv::Mat frame_;
-		cv::Mat depth_;
-		boost::mutex matLock_;
+		// Frames waiting to be written, plus a pool of buffers
+		// for copies made by the Mat version of saveFrame
+		std::deque<MediaFramePtr> queue_;
+		size_t queueDepth_;
+		BoundedQueuePolicy queuePolicy_;
+		MediaFramePool framePool_;
+		// Frames are numbered as writer threads take
+		// them from the queue. Each waits until writeSeq_
+		// reaches its number before writing, keeping the
+		// output in order
+		size_t popSeq_;
+		size_t writeSeq_;
+		MediaOutStats stats_;
+		mutable boost::mutex matLock_;
 		boost::condition_variable frameCond_;
-		bool frameReady_;
-		bool writePending_;
-		boost::thread thread_;
+		boost::thread_group threads_;
+		size_t threadCount_;
 		FrameTicker ft_;
 };
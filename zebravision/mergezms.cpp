@@ -15,16 +15,15 @@ int main(int argc, char **argv)
 		return 0;
 	}
 	ZMSOut out(argv[1]);
-	Mat image;
-	Mat depth;
+	MediaFramePtr frame;
 	for (int i = 2; i < argc; i++)
 	{
 		ZMSIn in(argv[i]);
 
-		while (in.getFrame(image, depth))
+		while (in.getFrame(frame))
 		{
 			out.sync();
-			out.saveFrame(image, depth);
+			out.saveFrame(frame);
 			cout << in.FPS() << " FPS" << endl;
 		}
 	}
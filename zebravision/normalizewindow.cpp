@@ -0,0 +1,282 @@
+// Global contrast normalization for detection windows.
+// This runs once per window per frame for every d12/d24/c12/c24
+// input, so it is worth the effort to make it fast.
+// One pass collects per-channel sum and sum of squares, a
+// second writes (pixel - mean) * (1 / stddev).  Data is
+// interleaved BGR, so the vector code works on chunks of 24
+// values (8 pixels).  Value i of each chunk is channel i % 3 since
+// every row and every chunk starts on a pixel boundary.  That
+// lets each vector lane keep a running total for a fixed channel,
+// and the lanes are only folded back together once per window.
+#include <cmath>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "normalizewindow.hpp"
+
+using namespace std;
+using namespace cv;
+
+template <class T>
+static inline const T *rowPtr(const T *src, size_t stride, int row)
+{
+	return (const T *)((const unsigned char *)src + row * stride);
+}
+
+// Turn running totals into mean and 1/stddev per channel.
+// Totals are relative to shift - accumulating the difference
+// from the first pixel rather than the raw values keeps sums
+// small and avoids cancellation in sumSq/n - mean^2
+static void finishStats(const float shift[3], const double sum[3], const double sumSq[3],
+		int count, float mean[3], float invStddev[3])
+{
+	for (int ch = 0; ch < 3; ch++)
+	{
+		const double m   = sum[ch] / count;
+		const double var = max(sumSq[ch] / count - m * m, 0.);
+		mean[ch]      = shift[ch] + m;
+		invStddev[ch] = 1.0 / sqrt(var);
+	}
+}
+
+template <class T>
+static void normalizeScalar(const T *src, size_t stride, int rows, int cols, float *dest)
+{
+	const int rowLen = cols * 3;
+	const float shift[3] = { (float)src[0], (float)src[1], (float)src[2] };
+	double sum[3]   = {0., 0., 0.};
+	double sumSq[3] = {0., 0., 0.};
+	for (int r = 0; r < rows; r++)
+	{
+		const T *p = rowPtr(src, stride, r);
+		for (int c = 0; c < rowLen; c += 3)
+			for (int ch = 0; ch < 3; ch++)
+			{
+				const double v = p[c + ch] - shift[ch];
+				sum[ch]   += v;
+				sumSq[ch] += v * v;
+			}
+	}
+
+	float mean[3];
+	float invStddev[3];
+	finishStats(shift, sum, sumSq, rows * cols, mean, invStddev);
+
+	for (int r = 0; r < rows; r++)
+	{
+		const T *p = rowPtr(src, stride, r);
+		for (int c = 0; c < rowLen; c += 3)
+			for (int ch = 0; ch < 3; ch++)
+				*dest++ = (p[c + ch] - mean[ch]) * invStddev[ch];
+	}
+}
+
+#if defined(__AVX2__)
+// 3 x 8 lanes per 24 value chunk
+struct VecOps
+{
+	typedef __m256 V;
+	enum { N = 3, L = 8 };
+	static const char *name(void) { return "AVX2"; }
+	static V zero(void) { return _mm256_setzero_ps(); }
+	static V load(const float *p) { return _mm256_loadu_ps(p); }
+	static void store(float *p, V v) { _mm256_storeu_ps(p, v); }
+	static V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V madd(V acc, V a, V b) { return _mm256_add_ps(acc, _mm256_mul_ps(a, b)); }
+	static void load24(const float *p, V v[N])
+	{
+		for (int k = 0; k < N; k++)
+			v[k] = _mm256_loadu_ps(p + k * L);
+	}
+	static void load24(const unsigned char *p, V v[N])
+	{
+		for (int k = 0; k < N; k++)
+			v[k] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(p + k * L))));
+	}
+};
+#define HAVE_VEC_OPS
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+// 6 x 4 lanes per 24 value chunk
+struct VecOps
+{
+	typedef float32x4_t V;
+	enum { N = 6, L = 4 };
+	static const char *name(void) { return "NEON"; }
+	static V zero(void) { return vdupq_n_f32(0.f); }
+	static V load(const float *p) { return vld1q_f32(p); }
+	static void store(float *p, V v) { vst1q_f32(p, v); }
+	static V add(V a, V b) { return vaddq_f32(a, b); }
+	static V sub(V a, V b) { return vsubq_f32(a, b); }
+	static V mul(V a, V b) { return vmulq_f32(a, b); }
+	static V madd(V acc, V a, V b) { return vmlaq_f32(acc, a, b); }
+	static void load24(const float *p, V v[N])
+	{
+		for (int k = 0; k < N; k++)
+			v[k] = vld1q_f32(p + k * L);
+	}
+	static void load24(const unsigned char *p, V v[N])
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			const uint16x8_t w = vmovl_u8(vld1_u8(p + k * 8));
+			v[2 * k]     = vcvtq_f32_u32(vmovl_u16(vget_low_u16(w)));
+			v[2 * k + 1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(w)));
+		}
+	}
+};
+#define HAVE_VEC_OPS
+#endif
+
+#ifdef HAVE_VEC_OPS
+template <class T>
+static void normalizeVector(const T *src, size_t stride, int rows, int cols, float *dest)
+{
+	typedef VecOps::V V;
+	const int N      = VecOps::N;
+	const int L      = VecOps::L;
+	const int rowLen = cols * 3;
+	const int vecLen = rowLen - rowLen % 24; // part of each row done 24 values at a time
+
+	const float shift[3] = { (float)src[0], (float)src[1], (float)src[2] };
+	float lanes[24];
+	V vShift[N];
+	V vSum[N];
+	V vSumSq[N];
+	for (int i = 0; i < 24; i++)
+		lanes[i] = shift[i % 3];
+	for (int k = 0; k < N; k++)
+	{
+		vShift[k] = VecOps::load(lanes + k * L);
+		vSum[k]   = VecOps::zero();
+		vSumSq[k] = VecOps::zero();
+	}
+
+	// Leftovers at the end of rows which don't fill
+	// a full chunk are added up here
+	double sum[3]   = {0., 0., 0.};
+	double sumSq[3] = {0., 0., 0.};
+	for (int r = 0; r < rows; r++)
+	{
+		const T *p = rowPtr(src, stride, r);
+		int c = 0;
+		for (; c < vecLen; c += 24)
+		{
+			V v[N];
+			VecOps::load24(p + c, v);
+			for (int k = 0; k < N; k++)
+			{
+				v[k]      = VecOps::sub(v[k], vShift[k]);
+				vSum[k]   = VecOps::add(vSum[k], v[k]);
+				vSumSq[k] = VecOps::madd(vSumSq[k], v[k], v[k]);
+			}
+		}
+		for (; c < rowLen; c += 3)
+			for (int ch = 0; ch < 3; ch++)
+			{
+				const double v = p[c + ch] - shift[ch];
+				sum[ch]   += v;
+				sumSq[ch] += v * v;
+			}
+	}
+
+	// Fold per-lane totals back into per-channel ones
+	for (int k = 0; k < N; k++)
+	{
+		VecOps::store(lanes, vSum[k]);
+		for (int j = 0; j < L; j++)
+			sum[(k * L + j) % 3] += lanes[j];
+		VecOps::store(lanes, vSumSq[k]);
+		for (int j = 0; j < L; j++)
+			sumSq[(k * L + j) % 3] += lanes[j];
+	}
+
+	float mean[3];
+	float invStddev[3];
+	finishStats(shift, sum, sumSq, rows * cols, mean, invStddev);
+
+	V vMean[N];
+	V vInvStddev[N];
+	for (int i = 0; i < 24; i++)
+		lanes[i] = mean[i % 3];
+	for (int k = 0; k < N; k++)
+		vMean[k] = VecOps::load(lanes + k * L);
+	for (int i = 0; i < 24; i++)
+		lanes[i] = invStddev[i % 3];
+	for (int k = 0; k < N; k++)
+		vInvStddev[k] = VecOps::load(lanes + k * L);
+
+	// Reads of a chunk finish before it is written, so this
+	// also works in place (src == dest, contiguous)
+	for (int r = 0; r < rows; r++)
+	{
+		const T *p = rowPtr(src, stride, r);
+		int c = 0;
+		for (; c < vecLen; c += 24)
+		{
+			V v[N];
+			VecOps::load24(p + c, v);
+			for (int k = 0; k < N; k++)
+				VecOps::store(dest + c + k * L, VecOps::mul(VecOps::sub(v[k], vMean[k]), vInvStddev[k]));
+		}
+		for (; c < rowLen; c += 3)
+			for (int ch = 0; ch < 3; ch++)
+				dest[c + ch] = (p[c + ch] - mean[ch]) * invStddev[ch];
+		dest += rowLen;
+	}
+}
+#endif
+
+void normalizeWindowScalar(const unsigned char *src, size_t stride, int rows, int cols, float *dest)
+{
+	normalizeScalar(src, stride, rows, cols, dest);
+}
+
+void normalizeWindowScalar(const float *src, size_t stride, int rows, int cols, float *dest)
+{
+	normalizeScalar(src, stride, rows, cols, dest);
+}
+
+void normalizeWindow(const unsigned char *src, size_t stride, int rows, int cols, float *dest)
+{
+#ifdef HAVE_VEC_OPS
+	normalizeVector(src, stride, rows, cols, dest);
+#else
+	normalizeScalar(src, stride, rows, cols, dest);
+#endif
+}
+
+void normalizeWindow(const float *src, size_t stride, int rows, int cols, float *dest)
+{
+#ifdef HAVE_VEC_OPS
+	normalizeVector(src, stride, rows, cols, dest);
+#else
+	normalizeScalar(src, stride, rows, cols, dest);
+#endif
+}
+
+void normalizeWindow(const Mat &input, float *dest)
+{
+	CV_Assert(input.channels() == 3);
+	if (input.depth() == CV_8U)
+		normalizeWindow(input.ptr<unsigned char>(0), input.step, input.rows, input.cols, dest);
+	else
+	{
+		CV_Assert(input.depth() == CV_32F);
+		normalizeWindow(input.ptr<float>(0), input.step, input.rows, input.cols, dest);
+	}
+}
+
+const char *normalizeWindowImpl(void)
+{
+#ifdef HAVE_VEC_OPS
+	return VecOps::name();
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,28 @@
+// Per-window global contrast normalization used before
+// applying ZCA weights.  Each color channel of a window is
+// shifted to 0 mean and scaled to a standard deviation of 1.
+// Stats and output are computed from interleaved BGR data
+// read in place - input can be an ROI into a larger image.
+// Vectorized using AVX2 or NEON when the compiler is targeting
+// them, with a plain C++ fallback for everything else.
+#pragma once
+
+#include <cstddef>
+#include <opencv2/core/core.hpp>
+
+// Raw versions.  Normalize a rows x cols window of 3-channel
+// data with stride bytes between rows.  Results are
+// written to dest as rows*cols*3 contiguous, interleaved floats
+void normalizeWindow(const unsigned char *src, size_t stride, int rows, int cols, float *dest);
+void normalizeWindow(const float *src, size_t stride, int rows, int cols, float *dest);
+
+// Same, but always uses the plain C++ code.  Used to check
+// the vectorized versions
+void normalizeWindowScalar(const unsigned char *src, size_t stride, int rows, int cols, float *dest);
+void normalizeWindowScalar(const float *src, size_t stride, int rows, int cols, float *dest);
+
+// Mat wrappers. input is either 8UC3 or 32FC3
+void normalizeWindow(const cv::Mat &input, float *dest);
+
+// Name of the code path normalizeWindow uses - "AVX2", "NEON" or "scalar"
+const char *normalizeWindowImpl(void);
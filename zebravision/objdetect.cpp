@@ -42,6 +42,24 @@ std::vector<size_t> ObjDetect::DebugInfo(void) const
 	return std::vector<size_t>();
 }
 
+void ObjDetect::setROIs(const std::vector<DetectROI> &rois)
+{
+	(void)rois;
+}
+
+void ObjDetect::clearROIs(void)
+{
+}
+
+void ObjDetect::setWindowBudget(size_t budget)
+{
+	(void)budget;
+}
+
+void ObjDetect::tuneBatchSize(void)
+{
+}
+
 bool ObjDetect::initialized(void) const
 {
 	return init_;
@@ -208,9 +226,35 @@ vector<size_t> ObjDetectNNet<MatT, ClassifierT>::DebugInfo(void) const
 	ret.push_back(debug.d12DetectOut);
 	ret.push_back(debug.d12NMSOut);
 	ret.push_back(debug.d24DetectOut);
+	ret.push_back(debug.d12BatchSize);
+	ret.push_back(debug.d24BatchSize);
 	return ret;
 }
 
+template <class MatT, class ClassifierT>
+void ObjDetectNNet<MatT, ClassifierT>::setROIs(const vector<DetectROI> &rois)
+{
+	classifier_.setROIs(rois);
+}
+
+template <class MatT, class ClassifierT>
+void ObjDetectNNet<MatT, ClassifierT>::clearROIs(void)
+{
+	classifier_.clearROIs();
+}
+
+template <class MatT, class ClassifierT>
+void ObjDetectNNet<MatT, ClassifierT>::setWindowBudget(size_t budget)
+{
+	classifier_.setWindowBudget(budget);
+}
+
+template <class MatT, class ClassifierT>
+void ObjDetectNNet<MatT, ClassifierT>::tuneBatchSize(void)
+{
+	classifier_.tuneBatchSize();
+}
+
 #ifndef USE_GIE 
 template class ObjDetectNNet<Mat, CaffeClassifier<Mat>>;
 template class ObjDetectNNet<GpuMat, CaffeClassifier<GpuMat>>;
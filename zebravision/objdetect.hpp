@@ -30,6 +30,23 @@ class ObjDetect
 							std::vector<cv::Rect> &imageRects, 
 							std::vector<cv::Rect> &uncalibImageRects) = 0;
 		virtual std::vector<size_t> DebugInfo(void) const;
+
+		// Restrict subsequent Detect calls to the given
+		// regions, or go back to searching the full frame.
+		// Detectors which can't do this ignore the request
+		// and always search the full frame
+		virtual void setROIs(const std::vector<DetectROI> &rois);
+		virtual void clearROIs(void);
+
+		// Limit the number of initial windows searched per
+		// frame, 0 for no limit.  Ignored by detectors
+		// which don't use sliding windows
+		virtual void setWindowBudget(size_t budget);
+
+		// Adjust batch sizes to run as fast as possible on
+		// this machine. Slow, so only call this right after
+		// the detector is created
+		virtual void tuneBatchSize(void);
 		bool initialized(void) const;
 
 	protected:
@@ -92,6 +109,10 @@ class ObjDetectNNet : public ObjDetect
 					std::vector<cv::Rect> &imageRects, 
 					std::vector<cv::Rect> &uncalibImageRects);
 		std::vector<size_t> DebugInfo(void) const;
+		void setROIs(const std::vector<DetectROI> &rois);
+		void clearROIs(void);
+		void setWindowBudget(size_t budget);
+		void tuneBatchSize(void);
 	private :
 		NNDetect<MatT, ClassifierT> classifier_;
 };
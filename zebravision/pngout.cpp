@@ -24,9 +24,13 @@ PNGOut::~PNGOut()
 // Write the frame to a file. This might overwrite 
 // the last one, but if we're looking at a 
 // still image the output should be one as well.
-bool PNGOut::write(const Mat &frame, const Mat &depth)
+// Every frame goes to the same file, so frames
+// are written one at a time rather than encoded
+// in parallel
+bool PNGOut::write(const Mat &frame, const Mat &depth, long long timeStamp)
 {
 	(void)depth;
+	(void)timeStamp;
 	return imwrite(fileName_, frame);
 }
 
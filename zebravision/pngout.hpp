@@ -12,7 +12,7 @@ class PNGOut : public MediaOut
 
 	private :
 		bool openNext(int fileCounter);
-		bool write(const cv::Mat &frame, const cv::Mat &depth);
+		bool write(const cv::Mat &frame, const cv::Mat &depth, long long timeStamp);
 
 		cv::Size         size_;
 		std::string      fileName_;
@@ -0,0 +1,59 @@
+// Fixed-capacity ring buffer stored inline rather than on
+// the heap.  Once full, each push_back() overwrites the
+// oldest entry.  Index 0 is the oldest entry.
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+template <class T, size_t N>
+class RingArray
+{
+	public:
+		RingArray(void) :
+			start_(0),
+			size_(0)
+		{
+		}
+
+		void push_back(const T &value)
+		{
+			if (size_ < N)
+			{
+				data_[(start_ + size_) % N] = value;
+				size_ += 1;
+			}
+			else
+			{
+				data_[start_] = value;
+				start_ = (start_ + 1) % N;
+			}
+		}
+
+		T &operator[](size_t i)
+		{
+			return data_[(start_ + i) % N];
+		}
+		const T &operator[](size_t i) const
+		{
+			return data_[(start_ + i) % N];
+		}
+
+		size_t size(void) const
+		{
+			return size_;
+		}
+		size_t capacity(void) const
+		{
+			return N;
+		}
+		bool empty(void) const
+		{
+			return size_ == 0;
+		}
+
+	private:
+		std::array<T, N> data_;
+		size_t start_;
+		size_t size_;
+};
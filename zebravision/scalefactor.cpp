@@ -20,10 +20,12 @@ static void resizeStub(const GpuMat &src, GpuMat &dest, const Size &size, const
 	cuda::resize(src, dest, size, fx, fy);
 }
 
+// Entries already in scaleInfo are reused as resize destinations.
+// When called with the same input size and scale settings as
+// the previous call, no new image memory is allocated
 template <class MatT>
 void scalefactor(const MatT &inputimage, const Size &objectsize, const Size &minsize, const Size &maxsize, double scaleFactor, vector<pair<MatT, double> > &scaleInfo)
 {
-	scaleInfo.clear();
 	/*
 	Loop multiplying the image size by the scalefactor upto the maxsize	
 	Store each image in the images vector
@@ -32,22 +34,25 @@ void scalefactor(const MatT &inputimage, const Size &objectsize, const Size &min
 
 	//only works for square image?
 	double scale = (double)objectsize.width / minsize.width;
+	size_t count = 0;
 
 	while(scale > (double)objectsize.width / maxsize.width)
 	{	
 		//set objectsize.width to scalefactor * objectsize.width
 		//set objectsize.height to scalefactor * objectsize.height
-		MatT outputimage;
+		if (count >= scaleInfo.size())
+			scaleInfo.push_back(make_pair(MatT(), 0.0));
+		MatT &outputimage = scaleInfo[count].first;
 		resizeStub(inputimage, outputimage, Size(), scale, scale);
 
 		// Resize will round / truncate to integer size, recalculate
 		// scale using actual results from the resize
-		double newscale = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
-		
-		scaleInfo.push_back(make_pair(outputimage, newscale));
+		scaleInfo[count].second = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
+		count += 1;
 
 		scale /= scaleFactor;		
 	}	
+	scaleInfo.resize(count);
 }
 
 
@@ -55,21 +60,21 @@ void scalefactor(const MatT &inputimage, const Size &objectsize, const Size &min
 // of resizeFactor. Used to create a list of d24-sized images from a d12 list. Can't
 // use the function above with a different window size since rounding errors will add +/- 1 to
 // the size versus just doing 2x the actual size of the d12 calculations
+// As above, existing entries in scaleInfoOut are reused
 template <class MatT>
 void scalefactor(const MatT &inputimage, const vector<pair<MatT, double> > &scaleInfoIn, int rescaleFactor, vector<pair<MatT, double> > &scaleInfoOut)
 {
-	scaleInfoOut.clear();
-	for (auto it = scaleInfoIn.cbegin(); it != scaleInfoIn.cend(); ++it)
+	scaleInfoOut.resize(scaleInfoIn.size());
+	for (size_t i = 0; i < scaleInfoIn.size(); i++)
 	{
-		MatT outputimage;
+		MatT &outputimage = scaleInfoOut[i].first;
 
-		Size newSize(it->first.cols * rescaleFactor, it->first.rows * rescaleFactor);
+		Size newSize(scaleInfoIn[i].first.cols * rescaleFactor, scaleInfoIn[i].first.rows * rescaleFactor);
 		resizeStub(inputimage, outputimage, newSize);
 		// calculate scale from actual size, which will
 		// include rounding done to get to integral number
 		// of pixels in each dimension
-		double scale = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
-		scaleInfoOut.push_back(make_pair(outputimage, scale));
+		scaleInfoOut[i].second = max((double)outputimage.rows / inputimage.rows, (double)outputimage.cols / inputimage.cols);
 	}
 }
 
@@ -5,6 +5,7 @@
 #include "ZvSettings.hpp"
 
 using namespace cv;
+using namespace std;
 
 SyncIn::SyncIn(ZvSettings *settings) :
 	MediaIn(settings),
@@ -23,6 +24,11 @@ void SyncIn::stopThread(void)
 	thread_.join();
 }
 
+long long SyncIn::postLockTimeStamp(void) const
+{
+	return -1;
+}
+
 // Read the next frame from the input file.  Store the
 // read frame in frame_.
 // The code is designed not to skip any input frames,
@@ -33,6 +39,7 @@ void SyncIn::update(void)
 {
 	// Loop until an empty frame is read - 
 	// this should identify EOF
+	bool good;
 	do
 	{
 		// If the frame read from the last update()
@@ -45,21 +52,26 @@ void SyncIn::update(void)
 		while (frameReady_)
 			condVar_.wait(guard);
 
-		if (postLockUpdate(frame_, depth_))
+		// Read into a buffer nobody else is using, so
+		// frames handed out earlier are never written over
+		shared_ptr<MediaFrame> next = framePool_.get();
+		good = postLockUpdate(next->frame, next->depth) && !next->frame.empty();
+		if (good)
 		{
-			setTimeStamp();
+			setTimeStamp(postLockTimeStamp());
 			incFrameNumber();
-			while (frame_.rows > 700)
+			while (next->frame.rows > 700)
 			{
-				pyrDown(frame_, frame_);
-				if (!depth_.empty())
-					pyrDown(depth_, depth_);
+				pyrDown(next->frame, next->frame);
+				if (!next->depth.empty())
+					pyrDown(next->depth, next->depth);
 			}
+			stampFrame(*next);
+			frame_ = next;
 		}
 		else
 		{
-			frame_ = Mat();
-			depth_ = Mat();
+			frame_.reset();
 		}
 
 		// Let getFrame know that a frame is ready
@@ -67,17 +79,17 @@ void SyncIn::update(void)
 		frameReady_ = true;
 		condVar_.notify_all();
 	}
-	while (!frame_.empty());
+	while (good);
 }
 
 
-bool SyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
+bool SyncIn::getFrame(MediaFramePtr &frame, bool pause)
 {
 	if (!isOpened())
 		return false;
 
-	// If not paused, copy the next frame from
-	// frame_. This is the Mat holding the next
+	// If not paused, take the next frame from
+	// frame_. This is the handle to the next
 	// frame read from the video that update()
 	// fills in a separate thread
 	if (!pause)
@@ -87,15 +99,14 @@ bool SyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
 		while (!frameReady_)
 			condVar_.wait(guard);
 
-		if (frame_.empty())
+		if (!frame_)
 			return false;
 
-		frame_.copyTo(prevGetFrame_);
-		depth_.copyTo(prevGetDepth_);
+		prevGetFrame_ = frame_;
 		lockTimeStamp();
 		lockFrameNumber();
 
-		// Let update() know that getFrame has copied
+		// Let update() know that getFrame has taken
 		// the current frame out of frame_
 		frameReady_ = false;
 		condVar_.notify_all();
@@ -105,10 +116,22 @@ bool SyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
 		// current one is returned and processed
 		// in the main thread.
 	}
-	if (prevGetFrame_.empty())
+	if (!prevGetFrame_)
 		return false;
-	prevGetFrame_.copyTo(frame);
-	prevGetDepth_.copyTo(depth);
+	frame = prevGetFrame_;
+	return true;
+}
+
+// Callers of this version are free to draw on
+// the frame, so give them their own copy
+bool SyncIn::getFrame(Mat &frame, Mat &depth, bool pause)
+{
+	MediaFramePtr mediaFrame;
+	if (!getFrame(mediaFrame, pause))
+		return false;
+
+	mediaFrame->frame.copyTo(frame);
+	mediaFrame->depth.copyTo(depth);
 	return true;
 }
 
@@ -18,6 +18,7 @@ class SyncIn : public MediaIn
 		SyncIn(ZvSettings *settings = NULL);
 
 		bool getFrame(cv::Mat &frame, cv::Mat &depth, bool pause = false);
+		bool getFrame(MediaFramePtr &frame, bool pause = false);
 		void frameNumber(int framenumber);
 
 	protected:
@@ -36,16 +37,22 @@ class SyncIn : public MediaIn
 		virtual bool postLockUpdate(cv::Mat &frame, cv::Mat &depth) = 0;
 		virtual bool postLockFrameNumber(int framenumber) = 0;
 
+		// Capture time of the frame just read by postLockUpdate.
+		// Inputs which record it can override this. The default
+		// of -1 uses the time the frame was read
+		virtual long long postLockTimeStamp(void) const;
+
 	private:
 		// frame_ is the most recent frame grabbed from 
-		// the camera
+		// the camera. Empty at EOF
 		// prevGetFrame_ is the last frame returned from
 		// getFrame().  If paused, code needs to keep returning
 		// this frame rather than getting a new one from frame_
-		cv::Mat           frame_;
-		cv::Mat           depth_;
-		cv::Mat           prevGetFrame_;
-		cv::Mat           prevGetDepth_;
+		// Both are handles to frames from framePool_, so
+		// handing one out doesn't copy anything
+		MediaFramePtr     frame_;
+		MediaFramePtr     prevGetFrame_;
+		MediaFramePool    framePool_;
 
 		// Mutex used to protect frame_
 		// from simultaneous accesses 
@@ -0,0 +1,109 @@
+// Check fastNMS against a brute force O(n^2) version and
+// time both for a range of input sizes.  Returns non-zero if
+// the two ever disagree
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include "fast_nms.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Compare each kept rect against every lower scoring one
+static void bruteForceNMS(const vector<Detected> &detected, double overlap_th, vector<size_t> &filteredList)
+{
+	filteredList.clear();
+	vector<pair<Detected, size_t> > sorted;
+	for (size_t i = 0; i < detected.size(); i++)
+		sorted.push_back(make_pair(detected[i], i));
+	stable_sort(sorted.begin(), sorted.end(),
+			[](const pair<Detected, size_t> &a, const pair<Detected, size_t> &b)
+			{ return a.first.second > b.first.second; });
+
+	vector<bool> valid(sorted.size(), true);
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		if (!valid[i])
+			continue;
+		filteredList.push_back(sorted[i].second);
+		const Rect topRect = sorted[i].first.first;
+		for (size_t j = i + 1; j < sorted.size(); j++)
+		{
+			if (!valid[j])
+				continue;
+			const Rect thisRect = sorted[j].first.first;
+			double intersectArea = (topRect & thisRect).area();
+			double unionArea     = topRect.area() + thisRect.area() - intersectArea;
+			if ((intersectArea > 0.0) && ((1-(intersectArea / unionArea)) <= overlap_th))
+				valid[j] = false;
+		}
+	}
+}
+
+// Clusters of rects around random centers, sized like
+// the output of the d12 detector for a 1280x720 frame.
+// Scores are unique so the sort order is well defined
+static vector<Detected> makeRects(size_t count, mt19937 &gen)
+{
+	uniform_int_distribution<int> center(0, 1280);
+	uniform_int_distribution<int> jitter(-6, 6);
+	uniform_int_distribution<int> size(12, 96);
+	vector<Detected> rects;
+	while (rects.size() < count)
+	{
+		const int cx = center(gen);
+		const int cy = center(gen) * 720 / 1280;
+		const int s  = size(gen);
+		for (int i = 0; (i < 8) && (rects.size() < count); i++)
+		{
+			const int w = max(4, s + jitter(gen));
+			rects.push_back(Detected(Rect(cx + jitter(gen) - w / 2, cy + jitter(gen) - w / 2, w, w), 0));
+		}
+	}
+	vector<size_t> order(rects.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	shuffle(order.begin(), order.end(), gen);
+	for (size_t i = 0; i < rects.size(); i++)
+		rects[i].second = 1.0f - (float)order[i] / rects.size();
+	return rects;
+}
+
+static double seconds(const chrono::steady_clock::time_point &start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(void)
+{
+	mt19937 gen(12345);
+	bool pass = true;
+	const size_t counts[] = { 1, 10, 1000, 5000, 10000, 25000, 50000 };
+	const double thresholds[] = { 0.2, 0.4, 0.8 };
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+	{
+		for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); t++)
+		{
+			const vector<Detected> rects = makeRects(counts[c], gen);
+
+			vector<size_t> expected;
+			auto start = chrono::steady_clock::now();
+			bruteForceNMS(rects, thresholds[t], expected);
+			const double bruteTime = seconds(start);
+
+			vector<size_t> actual;
+			start = chrono::steady_clock::now();
+			fastNMS(rects, thresholds[t], actual);
+			const double fastTime = seconds(start);
+
+			const bool match = (expected == actual);
+			pass &= match;
+			cout << (match ? "PASS " : "FAIL ") << counts[c] << " rects, threshold " << thresholds[t]
+				<< " : " << actual.size() << " kept, brute force " << bruteTime * 1000.
+				<< " msec, fastNMS " << fastTime * 1000. << " msec" << endl;
+		}
+	}
+	return pass ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+// Check KalmanBatch against one TKalmanFilter per track on
+// simulated tracks, then time both for 1 to 500 tracks.
+// Returns non-zero if the results ever differ by more than
+// float rounding
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "kalman.hpp"
+
+using namespace std;
+using namespace cv;
+
+static const float dt            = 0.5;
+static const float accelNoiseMag = 0.25;
+
+// One frame the way TrackedObjectList runs it - predict, then
+// update with either a noisy detection or the prediction itself
+static void simulate(size_t tracks, size_t frames, bool check, double &filterTime, double &batchTime, double &maxErr)
+{
+	mt19937 rng(tracks);
+	uniform_real_distribution<float> pos(-5, 5);
+	normal_distribution<float>       noise(0, 0.05);
+	bernoulli_distribution           detected(0.8);
+
+	vector<TKalmanFilter> filters;
+	KalmanBatch batch(dt, accelNoiseMag);
+	vector<Point3f> start;
+	vector<Point3f> velocity;
+	for (size_t i = 0; i < tracks; i++)
+	{
+		start.push_back(Point3f(pos(rng), pos(rng) + 6, pos(rng) * 0.1));
+		velocity.push_back(Point3f(pos(rng) * 0.1, pos(rng) * 0.1, 0));
+		filters.push_back(TKalmanFilter(start.back(), dt, accelNoiseMag));
+		batch.push_back(start.back());
+	}
+
+	// Generate all of the detections up front so
+	// both versions see the same thing
+	vector<vector<Point3f>> detections(frames, vector<Point3f>(tracks));
+	vector<vector<bool>>    seen(frames, vector<bool>(tracks));
+	for (size_t f = 0; f < frames; f++)
+		for (size_t i = 0; i < tracks; i++)
+		{
+			detections[f][i] = start[i] + velocity[i] * (float)(f * dt) + Point3f(noise(rng), noise(rng), noise(rng));
+			seen[f][i] = detected(rng);
+		}
+
+	vector<vector<Point3f>> filterOut(frames, vector<Point3f>(tracks));
+	auto t0 = chrono::steady_clock::now();
+	for (size_t f = 0; f < frames; f++)
+		for (size_t i = 0; i < tracks; i++)
+		{
+			const Point3f prediction = filters[i].GetPrediction();
+			filterOut[f][i] = filters[i].Update(seen[f][i] ? detections[f][i] : prediction);
+		}
+	filterTime = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	vector<vector<Point3f>> batchOut(frames);
+	vector<Point3f> predictions;
+	vector<Point3f> measurements(tracks);
+	t0 = chrono::steady_clock::now();
+	for (size_t f = 0; f < frames; f++)
+	{
+		batch.predict(predictions);
+		for (size_t i = 0; i < tracks; i++)
+			measurements[i] = seen[f][i] ? detections[f][i] : predictions[i];
+		batch.update(measurements, batchOut[f]);
+	}
+	batchTime = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	maxErr = 0;
+	if (!check)
+		return;
+	for (size_t f = 0; f < frames; f++)
+		for (size_t i = 0; i < tracks; i++)
+		{
+			const Point3f diff = filterOut[f][i] - batchOut[f][i];
+			maxErr = max<double>(maxErr, max(fabs(diff.x), max(fabs(diff.y), fabs(diff.z))));
+		}
+	for (size_t i = 0; i < tracks; i++)
+	{
+		const Point3f diff = filters[i].PeekPrediction() - batch.peekPrediction(i);
+		maxErr = max<double>(maxErr, max(fabs(diff.x), max(fabs(diff.y), fabs(diff.z))));
+	}
+}
+
+int main(void)
+{
+	int rc = 0;
+	const size_t trackCounts[] = {1, 5, 20, 100, 500};
+	const size_t frames = 200;
+	cout << "tracks  TKalmanFilter uSec/frame  KalmanBatch uSec/frame  speedup  max diff" << endl;
+	for (auto tracks : trackCounts)
+	{
+		double filterTime;
+		double batchTime;
+		double maxErr;
+		simulate(tracks, frames, true, filterTime, batchTime, maxErr);
+		cout << tracks << "\t" << filterTime * 1e6 / frames << "\t\t\t"
+			<< batchTime * 1e6 / frames << "\t\t\t"
+			<< filterTime / batchTime << "\t" << maxErr << endl;
+		if (maxErr > 1e-4)
+		{
+			cerr << "KalmanBatch doesn't match TKalmanFilter" << endl;
+			rc = 1;
+		}
+	}
+	return rc;
+}
@@ -0,0 +1,165 @@
+// Check the MediaOut write queue without any real
+// video output.  A fake output with a slow write
+// records the order frames arrive in, checking each
+// queue policy keeps frames in order, that each keeps
+// its capture time and that the counters add up.  Also times serial writes against
+// several encoder threads
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+#include <opencv2/core/core.hpp>
+
+#include "mediaout.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Each frame is a single int holding its number.
+// Writes take writeMs, spent either all in write()
+// or mostly in encode() when that's enabled
+class TestOut : public MediaOut
+{
+	public:
+		TestOut(bool parallel, int writeMs, int framesPerFile = 1000000) :
+			MediaOut(1, framesPerFile),
+			filesOpened_(0),
+			parallel_(parallel),
+			writeMs_(writeMs)
+		{
+		}
+		~TestOut()
+		{
+			sync();
+		}
+
+		vector<int>       written_;
+		vector<long long> timeStamps_;
+		int               filesOpened_;
+
+	private:
+		bool openNext(int fileCounter)
+		{
+			(void)fileCounter;
+			filesOpened_ += 1;
+			return true;
+		}
+		bool write(const Mat &frame, const Mat &depth, long long timeStamp)
+		{
+			(void)depth;
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(writeMs_));
+			written_.push_back(frame.at<int>(0));
+			timeStamps_.push_back(timeStamp);
+			return true;
+		}
+		bool canEncode(void) const
+		{
+			return parallel_;
+		}
+		bool encode(const Mat &frame, const Mat &depth, string &buf) const
+		{
+			(void)depth;
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(writeMs_));
+			buf = to_string(frame.at<int>(0));
+			return true;
+		}
+		bool writeEncoded(const string &buf, long long timeStamp)
+		{
+			written_.push_back(stoi(buf));
+			timeStamps_.push_back(timeStamp);
+			return true;
+		}
+
+		bool parallel_;
+		int  writeMs_;
+};
+
+static int failures = 0;
+
+static long long timeStampOf(int frameNumber)
+{
+	return 1000000000LL + frameNumber * 33333LL;
+}
+
+static void check(bool good, const string &name, const string &what)
+{
+	if (!good)
+	{
+		cerr << name << " : " << what << endl;
+		failures += 1;
+	}
+}
+
+// Save frameCount frames, frameMs apart, through a queue
+// set up as requested. Frame i is stamped as captured at
+// timeStampOf(i). Returns seconds taken to save and
+// write all of them
+static double runQueue(const string &name, size_t depth, BoundedQueuePolicy policy, size_t threads,
+		bool parallel, int frameCount, int frameMs, int writeMs, int framesPerFile = 1000000)
+{
+	TestOut out(parallel, writeMs, framesPerFile);
+	out.setWriteQueue(depth, policy, threads);
+	const Mat depthMat;
+	const auto start = chrono::steady_clock::now();
+	for (int i = 0; i < frameCount; i++)
+	{
+		const Mat frame(1, 1, CV_32SC1, Scalar(i));
+		out.saveFrame(frame, depthMat, timeStampOf(i));
+		if (frameMs)
+			boost::this_thread::sleep_for(boost::chrono::milliseconds(frameMs));
+	}
+	out.sync();
+	const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	const MediaOutStats stats = out.stats();
+	check(stats.enqueued == (size_t)frameCount, name, "wrong enqueued count");
+	check(stats.written == out.written_.size(), name, "wrong written count");
+	check(stats.failed == 0, name, "writes failed");
+	check(stats.written + stats.dropped == stats.enqueued, name, "written + dropped != enqueued");
+	check(stats.highWater <= depth, name, "queue grew past its depth");
+	for (size_t i = 1; i < out.written_.size(); i++)
+		check(out.written_[i] > out.written_[i - 1], name, "frames written out of order");
+	for (size_t i = 0; i < out.written_.size(); i++)
+		check(out.timeStamps_[i] == timeStampOf(out.written_[i]), name, "capture time lost");
+	if (policy == BQ_BLOCK)
+		check(stats.dropped == 0, name, "frames dropped while blocking");
+	else
+		check(stats.dropped > 0, name, "nothing dropped from a slow writer");
+	// Drop oldest always ends up with the last frame, drop newest
+	// with the first since the queue starts out empty
+	if ((policy == BQ_DROP_OLDEST) && !out.written_.empty())
+		check(out.written_.back() == frameCount - 1, name, "last frame not written");
+	if ((policy == BQ_DROP_NEWEST) && !out.written_.empty())
+		check(out.written_.front() == 0, name, "first frame not written");
+	if (framesPerFile < frameCount)
+		check(out.filesOpened_ == (frameCount + framesPerFile - 1) / framesPerFile, name, "wrong number of files");
+
+	cout << name << " : " << stats.written << " written, " << stats.dropped << " dropped, high water "
+		<< stats.highWater << ", " << elapsed * 1000. << " ms" << endl;
+	return elapsed;
+}
+
+int main(void)
+{
+	// Writer is 4x slower than frames come in
+	runQueue("block", 4, BQ_BLOCK, 1, false, 40, 1, 4);
+	runQueue("drop oldest", 4, BQ_DROP_OLDEST, 1, false, 40, 1, 4);
+	runQueue("drop newest", 4, BQ_DROP_NEWEST, 1, false, 40, 1, 4);
+	runQueue("default mailbox", 1, BQ_DROP_OLDEST, 1, false, 40, 1, 4);
+	runQueue("file split", 2, BQ_BLOCK, 1, false, 23, 0, 1, 5);
+
+	// Extra threads shouldn't be used by outputs
+	// which can't encode frames on their own
+	const double serial   = runQueue("serial encode", 8, BQ_BLOCK, 4, false, 40, 0, 10);
+	const double parallel = runQueue("4 thread encode", 8, BQ_BLOCK, 4, true, 40, 0, 10);
+	runQueue("4 thread drop oldest", 8, BQ_DROP_OLDEST, 4, true, 200, 1, 10);
+	runQueue("4 thread split", 8, BQ_BLOCK, 4, true, 23, 0, 2, 5);
+	check(parallel < serial * 0.5, "4 thread encode", "no faster than serial");
+
+	if (failures)
+		cout << failures << " failures" << endl;
+	else
+		cout << "All tests passed" << endl;
+	return failures ? 1 : 0;
+}
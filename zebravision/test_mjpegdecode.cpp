@@ -0,0 +1,167 @@
+// Check the C920 MJPEG decoder without a camera.  Feeds a
+// recorded MJPEG stream (back to back JPEG images, e.g. from
+// ffmpeg -f mjpeg) through v4l2::DecodeMJPEG at each scale,
+// comparing against a full size imdecode shrunk with resize.
+// With no file a synthetic stream is generated instead.
+// Also times the decoder against the old copy, decode, copy,
+// pyrDown path.  Returns non-zero on any mismatch
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <opencv2/opencv.hpp>
+
+#include "C920Camera.h"
+
+using namespace std;
+using namespace cv;
+
+// Split a stream into JPEG images using the SOI
+// and EOI markers at the start and end of each
+static vector<vector<uchar>> splitStream(const vector<uchar> &stream)
+{
+	vector<vector<uchar>> frames;
+	size_t start = stream.size();
+	for (size_t i = 0; i + 1 < stream.size(); i++)
+	{
+		if (stream[i] != 0xFF)
+			continue;
+		if ((stream[i + 1] == 0xD8) && (start == stream.size()))
+			start = i;
+		else if ((stream[i + 1] == 0xD9) && (start < stream.size()))
+		{
+			frames.push_back(vector<uchar>(stream.begin() + start, stream.begin() + i + 2));
+			start = stream.size();
+		}
+	}
+	return frames;
+}
+
+// Moving blocks over a gradient, encoded the way the
+// C920 sends it
+static vector<vector<uchar>> syntheticStream(int frameCount)
+{
+	vector<vector<uchar>> frames;
+	Mat frame(720, 1280, CV_8UC3);
+	for (int i = 0; i < frameCount; i++)
+	{
+		for (int r = 0; r < frame.rows; r++)
+			frame.row(r).setTo(Scalar(r * 255 / frame.rows, 128, 255 - r * 255 / frame.rows));
+		for (int j = 0; j < 20; j++)
+			rectangle(frame, Rect((j * 97 + i * 13) % 1200, (j * 61 + i * 7) % 650, 60, 50),
+					Scalar(j * 12, 255 - j * 12, (j * 40) % 256), CV_FILLED);
+		vector<uchar> jpeg;
+		imencode(".jpg", frame, jpeg);
+		frames.push_back(jpeg);
+	}
+	return frames;
+}
+
+// What C920Camera used to do for each frame
+static void oldDecode(const vector<uchar> &jpeg, int scale, Mat &ipl, Mat &out)
+{
+	Mat temp = imdecode(Mat(vector<uchar>(jpeg.begin(), jpeg.end())), 1);
+	ipl.create(temp.size(), CV_8UC3);
+	memcpy(ipl.data, temp.data, temp.total() * 3);
+	ipl.copyTo(out);
+	for (int s = scale; s > 1; s /= 2)
+		pyrDown(out, out);
+}
+
+int main(int argc, char **argv)
+{
+	vector<vector<uchar>> frames;
+	if (argc > 1)
+	{
+		ifstream in(argv[1], ios::binary);
+		const vector<uchar> stream((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		frames = splitStream(stream);
+	}
+	else
+		frames = syntheticStream(60);
+	if (frames.empty())
+	{
+		cerr << "No frames found" << endl;
+		return 1;
+	}
+	cout << frames.size() << " frames" << endl;
+
+	int failures = 0;
+	const int scales[] = {1, 2, 4};
+	for (size_t s = 0; s < sizeof(scales) / sizeof(scales[0]); s++)
+	{
+		const int scale = scales[s];
+		Mat decoded;
+		Mat ipl;
+		Mat old;
+		const uchar *firstData = NULL;
+		double maxDiff = 0;
+		double newTime = 0;
+		double oldTime = 0;
+		for (size_t i = 0; i < frames.size(); i++)
+		{
+			auto start = chrono::steady_clock::now();
+			if (!v4l2::DecodeMJPEG(&frames[i][0], frames[i].size(), scale, decoded))
+			{
+				cerr << "Frame " << i << " failed to decode at scale " << scale << endl;
+				failures += 1;
+				continue;
+			}
+			newTime += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			start = chrono::steady_clock::now();
+			oldDecode(frames[i], scale, ipl, old);
+			oldTime += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+			// Every frame should decode into the same buffer
+			if (i == 0)
+				firstData = decoded.data;
+			else if (decoded.data != firstData)
+			{
+				cerr << "Frame " << i << " reallocated the output at scale " << scale << endl;
+				failures += 1;
+			}
+
+			const Mat full = imdecode(frames[i], 1);
+			const Size expected((full.cols + scale - 1) / scale, (full.rows + scale - 1) / scale);
+			if (decoded.size() != expected)
+			{
+				cerr << "Frame " << i << " is " << decoded.size() << " at scale " << scale << ", expected " << expected << endl;
+				failures += 1;
+				continue;
+			}
+			Mat ref;
+			if (scale == 1)
+				ref = full;
+			else
+				resize(full, ref, expected, 0, 0, INTER_AREA);
+			Mat diff;
+			absdiff(decoded, ref, diff);
+			const Scalar meanDiff = mean(diff);
+			maxDiff = max(maxDiff, max(meanDiff[0], max(meanDiff[1], meanDiff[2])));
+		}
+
+		// Full size must be exact. Scaled decodes use a
+		// different filter than resize, so allow for that
+		const bool good = (scale == 1) ? (maxDiff == 0) : (maxDiff < 4);
+		if (!good)
+			failures += 1;
+		cout << "scale 1/" << scale << " : " << newTime / frames.size() * 1000. << " ms/frame, old "
+			<< oldTime / frames.size() * 1000. << " ms/frame, mean diff " << maxDiff
+			<< (good ? "" : " FAILED") << endl;
+	}
+
+	// Garbage input shouldn't decode
+	Mat decoded;
+	const uchar garbage[] = {0x00, 0x11, 0x22, 0x33};
+	if (v4l2::DecodeMJPEG(garbage, sizeof(garbage), 1, decoded))
+	{
+		cerr << "Garbage decoded" << endl;
+		failures += 1;
+	}
+
+	if (failures)
+		cout << failures << " failures" << endl;
+	else
+		cout << "All tests passed" << endl;
+	return failures ? 1 : 0;
+}
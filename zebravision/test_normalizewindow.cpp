@@ -0,0 +1,121 @@
+// Check normalizeWindow against the meanStdDev-based code
+// ZCA used to use, then time both.  Returns non-zero if
+// any output is off by more than a small tolerance
+#include <iostream>
+#include <sstream>
+#include <opencv2/core/core.hpp>
+#include "normalizewindow.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Old ZCA::Transform32FC3 normalization code
+static void reference(const Mat &input, Mat &output)
+{
+	input.convertTo(output, CV_32FC3);
+	Scalar mean;
+	Scalar stddev;
+	cv::meanStdDev(output, mean, stddev);
+
+	for (int r = 0; r < output.rows; r++)
+	{
+		Vec3f *p = output.ptr<Vec3f>(r);
+		for (int c = 0; c < output.cols; c++)
+			for (int ch = 0; ch < 3; ch++)
+				p[c][ch] = (p[c][ch] - mean[ch]) / stddev[ch];
+	}
+}
+
+static bool check(const string &name, const Mat &input)
+{
+	Mat expected;
+	reference(input, expected);
+	expected = expected.reshape(1, 1);
+
+	Mat actual(1, input.rows * input.cols * 3, CV_32FC1);
+	normalizeWindow(input, actual.ptr<float>(0));
+
+	Mat scalar(1, input.rows * input.cols * 3, CV_32FC1);
+	if (input.depth() == CV_8U)
+		normalizeWindowScalar(input.ptr<unsigned char>(0), input.step, input.rows, input.cols, scalar.ptr<float>(0));
+	else
+		normalizeWindowScalar(input.ptr<float>(0), input.step, input.rows, input.cols, scalar.ptr<float>(0));
+
+	const double err       = cv::norm(expected, actual, NORM_INF);
+	const double scalarErr = cv::norm(expected, scalar, NORM_INF);
+	const bool pass = (err < 1e-3) && (scalarErr < 1e-3);
+	cout << (pass ? "PASS " : "FAIL ") << name << " max error " << err << " scalar " << scalarErr << endl;
+	return pass;
+}
+
+static void benchmark(const string &name, const Mat &input, int iterations)
+{
+	Mat ref;
+	Mat out(1, input.rows * input.cols * 3, CV_32FC1);
+
+	int64 start = getTickCount();
+	for (int i = 0; i < iterations; i++)
+		reference(input, ref);
+	const double refTime = (getTickCount() - start) / getTickFrequency();
+
+	start = getTickCount();
+	for (int i = 0; i < iterations; i++)
+		normalizeWindow(input, out.ptr<float>(0));
+	const double newTime = (getTickCount() - start) / getTickFrequency();
+
+	cout << name << " meanStdDev " << refTime * 1e9 / iterations << " nsec/window, "
+		<< normalizeWindowImpl() << " " << newTime * 1e9 / iterations << " nsec/window" << endl;
+}
+
+int main(void)
+{
+	RNG rng(12345);
+	bool pass = true;
+
+	const Size sizes[] = { Size(12, 12), Size(24, 24), Size(7, 5), Size(1, 1) };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		Mat img8(sizes[i], CV_8UC3);
+		rng.fill(img8, RNG::UNIFORM, 0, 256);
+		Mat img32;
+		img8.convertTo(img32, CV_32FC3, 1.0 / 3.0, 0.25);
+
+		// Single pixel windows have 0 stddev - skip them
+		// here but make sure they don't crash below
+		if (sizes[i].area() > 1)
+		{
+			stringstream s;
+			s << sizes[i].width << "x" << sizes[i].height;
+			pass &= check(s.str() + " 8UC3", img8);
+			pass &= check(s.str() + " 32FC3", img32);
+		}
+		else
+		{
+			float dummy[3];
+			normalizeWindow(img8, dummy);
+			normalizeWindow(img32, dummy);
+		}
+	}
+
+	// Windows pulled from a larger image, the way
+	// NNDetect passes them in
+	Mat big(240, 320, CV_8UC3);
+	rng.fill(big, RNG::UNIFORM, 0, 256);
+	Mat big32;
+	big.convertTo(big32, CV_32FC3);
+	pass &= check("12x12 ROI 8UC3", big(Rect(37, 101, 12, 12)));
+	pass &= check("24x24 ROI 8UC3", big(Rect(5, 13, 24, 24)));
+	pass &= check("24x24 ROI 32FC3", big32(Rect(201, 77, 24, 24)));
+
+	// Low contrast window with a large offset - catches
+	// precision problems in the variance calculation
+	Mat flat(24, 24, CV_8UC3);
+	rng.fill(flat, RNG::UNIFORM, 250, 253);
+	pass &= check("24x24 low contrast 8UC3", flat);
+
+	benchmark("12x12 8UC3", big(Rect(37, 101, 12, 12)), 200000);
+	benchmark("24x24 8UC3", big(Rect(5, 13, 24, 24)), 50000);
+	benchmark("24x24 32FC3", big32(Rect(201, 77, 24, 24)), 50000);
+
+	return pass ? 0 : 1;
+}
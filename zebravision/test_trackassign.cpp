@@ -0,0 +1,187 @@
+// Check TrackAssociator with both solvers against a brute force
+// search on small random problems, then time them on bigger,
+// cluttered ones.  Returns non-zero if any results disagree
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include "trackassociator.hpp"
+
+using namespace std;
+
+// Try every assignment. Best has the most pairs
+// within the gate, then the lowest total cost
+static void bruteForce(const vector<double> &cost, size_t tracks, size_t detections, double gate,
+		size_t track, vector<bool> &used, size_t matches, double total,
+		size_t &bestMatches, double &bestTotal)
+{
+	if (track == tracks)
+	{
+		if ((matches > bestMatches) || ((matches == bestMatches) && (total < bestTotal)))
+		{
+			bestMatches = matches;
+			bestTotal   = total;
+		}
+		return;
+	}
+	bruteForce(cost, tracks, detections, gate, track + 1, used, matches, total, bestMatches, bestTotal);
+	for (size_t d = 0; d < detections; d++)
+	{
+		const double c = cost[track * detections + d];
+		if (!used[d] && (c <= gate))
+		{
+			used[d] = true;
+			bruteForce(cost, tracks, detections, gate, track + 1, used, matches + 1, total + c, bestMatches, bestTotal);
+			used[d] = false;
+		}
+	}
+}
+
+// Make sure assignment is valid and return its
+// match count and total cost
+static bool score(const vector<int> &assignment, const vector<double> &cost, size_t detections,
+		double gate, size_t &matches, double &total)
+{
+	vector<bool> used(detections, false);
+	matches = 0;
+	total   = 0;
+	for (size_t t = 0; t < assignment.size(); t++)
+	{
+		const int d = assignment[t];
+		if (d < 0)
+			continue;
+		if ((d >= (int)detections) || used[d] || (cost[t * detections + d] > gate))
+			return false;
+		used[d] = true;
+		matches += 1;
+		total   += cost[t * detections + d];
+	}
+	return true;
+}
+
+// Objects scattered around a field, distance as cost
+static void randomProblem(mt19937 &rng, size_t tracks, size_t detections, double fieldSize, vector<double> &cost)
+{
+	uniform_real_distribution<double> pos(0, fieldSize);
+	vector<pair<double, double>> t(tracks);
+	for (auto &p : t)
+		p = make_pair(pos(rng), pos(rng));
+	cost.resize(tracks * detections);
+	for (size_t d = 0; d < detections; d++)
+	{
+		const double x = pos(rng);
+		const double y = pos(rng);
+		for (size_t i = 0; i < tracks; i++)
+			cost[i * detections + d] = hypot(t[i].first - x, t[i].second - y);
+	}
+	// Mismatched types
+	uniform_int_distribution<int> pick(0, 9);
+	for (auto &c : cost)
+		if (pick(rng) == 0)
+			c = numeric_limits<double>::max();
+}
+
+int main(void)
+{
+	const double gate = 1.0;
+	mt19937 rng(1234);
+	TrackAssociator hungarian(AssignmentProblemSolver::optimal);
+	TrackAssociator jv(AssignmentProblemSolver::jonker_volgenant);
+	vector<double> cost;
+	vector<int> assignment;
+	int rc = 0;
+
+	size_t checked = 0;
+	for (int iter = 0; iter < 20000; iter++)
+	{
+		uniform_int_distribution<size_t> count(0, 6);
+		uniform_real_distribution<double> field(1, 6);
+		const size_t tracks     = count(rng);
+		const size_t detections = count(rng);
+		randomProblem(rng, tracks, detections, field(rng), cost);
+
+		size_t bestMatches = 0;
+		double bestTotal   = 0;
+		vector<bool> used(detections, false);
+		bruteForce(cost, tracks, detections, gate, 0, used, 0, 0, bestMatches, bestTotal);
+
+		TrackAssociator *associators[] = {&hungarian, &jv};
+		for (auto a : associators)
+		{
+			a->solve(cost, tracks, detections, gate, assignment);
+			size_t matches;
+			double total;
+			if (!score(assignment, cost, detections, gate, matches, total) ||
+				(matches != bestMatches) || (fabs(total - bestTotal) > 1e-9))
+			{
+				cerr << "Mismatch " << tracks << "x" << detections << " expected " << bestMatches
+					<< " matches cost " << bestTotal << " got " << matches << " cost " << total
+					<< (a == &jv ? " (JV)" : " (Hungarian)") << endl;
+				rc = 1;
+			}
+		}
+		checked += 1;
+	}
+	cout << "Checked " << checked << " small problems" << endl;
+
+	// Flat solver on dense problems - both should find
+	// the same minimum cost
+	AssignmentProblemSolver aps;
+	for (int iter = 0; iter < 2000; iter++)
+	{
+		uniform_int_distribution<int> count(1, 30);
+		const int rows = count(rng);
+		const int cols = count(rng);
+		uniform_real_distribution<double> value(0, 100);
+		cost.resize(rows * cols);
+		for (auto &c : cost)
+			c = floor(value(rng));
+		vector<int> a1(rows), a2(rows);
+		const double c1 = aps.Solve(cost.data(), rows, cols, a1.data(), AssignmentProblemSolver::optimal);
+		const double c2 = aps.Solve(cost.data(), rows, cols, a2.data(), AssignmentProblemSolver::jonker_volgenant);
+		if (fabs(c1 - c2) > 1e-9)
+		{
+			cerr << "Dense " << rows << "x" << cols << " Hungarian " << c1 << " JV " << c2 << endl;
+			rc = 1;
+		}
+	}
+
+	// Lots of objects, lots of false positives
+	const size_t sizes[] = {10, 40, 100};
+	for (auto size : sizes)
+	{
+		const size_t tracks     = size;
+		const size_t detections = size * 2;
+		vector<vector<double>> problems(50);
+		for (auto &p : problems)
+			randomProblem(rng, tracks, detections, 20, p);
+
+		// The old code : one ungated Hungarian solve
+		auto start = chrono::steady_clock::now();
+		for (auto &p : problems)
+		{
+			vector<vector<double>> nested(tracks, vector<double>(detections));
+			for (size_t t = 0; t < tracks; t++)
+				for (size_t d = 0; d < detections; d++)
+					nested[t][d] = p[t * detections + d];
+			AssignmentProblemSolver oldAPS;
+			oldAPS.Solve(nested, assignment, AssignmentProblemSolver::optimal);
+		}
+		const double oldTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		start = chrono::steady_clock::now();
+		for (auto &p : problems)
+			hungarian.solve(p, tracks, detections, gate, assignment);
+		const double hungarianTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		start = chrono::steady_clock::now();
+		for (auto &p : problems)
+			jv.solve(p, tracks, detections, gate, assignment);
+		const double jvTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		cout << tracks << "x" << detections << " : ungated " << oldTime * 1e6 / problems.size()
+			<< " uSec, gated Hungarian " << hungarianTime * 1e6 / problems.size()
+			<< " uSec, gated JV " << jvTime * 1e6 / problems.size() << " uSec" << endl;
+	}
+	return rc;
+}
@@ -93,29 +93,29 @@ TrackedObject::TrackedObject(int               id,
 							 double            avg_depth,
 							 const Point2f    &fov_size,
 							 const Size       &frame_size,
-							 float             camera_elevation,
-							 float             dt,
-							 float             accel_noise_mag,
-							 size_t            historyLength) :
+							 float             camera_elevation) :
 		type_(type_in),
-		detectHistory_(historyLength),
-		positionHistory_(historyLength),
-		KF_(type_.screenToWorldCoords(screen_position, avg_depth, fov_size, frame_size, camera_elevation),
-			dt, accel_noise_mag),
+		id_(id),
 		missedFrameCount_(0),
 		cameraElevation_(camera_elevation)
 {
 	setPosition(screen_position, avg_depth, fov_size, frame_size);
 	setDetected();
+}
 
-	// Label with base-26 letter ID (A, B, C .. Z, AA, AB, AC, etc)
+// Label with base-26 letter ID (A, B, C .. Z, AA, AB, AC, etc)
+string TrackedObject::getId(void) const
+{
+	string ret;
+	int id = id_;
 	do
 	{
-		id_ += (char)(id % 26 + 'A');
+		ret += (char)(id % 26 + 'A');
 		id /= 26;
 	}
 	while (id != 0);
-	reverse(id_.begin(), id_.end());
+	reverse(ret.begin(), ret.end());
+	return ret;
 }
 
 
@@ -179,9 +179,10 @@ void TrackedObject::adjustPosition(const Mat &transform_mat, float depth, const
 	Rect new_screen_rect(new_screen_pos.x,new_screen_pos.y,0,0);
 	setPosition(new_screen_rect,depth,fov_size,frame_size);
 	//update the history
-	for (auto it = positionHistory_.begin(); it != positionHistory_.end(); ++it)
+	for (size_t i = 0; i < positionHistory_.size(); i++)
 	{
-		screen_rect = type_.worldToScreenCoords(*it,fov_size,frame_size, cameraElevation_);
+		Point3f &it = positionHistory_[i];
+		screen_rect = type_.worldToScreenCoords(it,fov_size,frame_size, cameraElevation_);
 		screen_pos = Point(screen_rect.tl().x + screen_rect.width / 2, screen_rect.tl().y + screen_rect.height / 2);
 		pos_mat.at<double>(0,0) = screen_pos.x;
 		pos_mat.at<double>(0,1) = screen_pos.y;
@@ -189,7 +190,7 @@ void TrackedObject::adjustPosition(const Mat &transform_mat, float depth, const
 		Mat new_screen_pos_mat = transform_mat * pos_mat;
 		Point new_screen_pos(new_screen_pos_mat.at<double>(0),new_screen_pos_mat.at<double>(1));
 		Rect new_screen_rect(new_screen_pos.x,new_screen_pos.y,0,0);
-		*it = type_.screenToWorldCoords(new_screen_rect, depth, fov_size, frame_size, cameraElevation_);
+		it = type_.screenToWorldCoords(new_screen_rect, depth, fov_size, frame_size, cameraElevation_);
 	}
 }
 
@@ -222,8 +223,8 @@ bool TrackedObject::tooManyMissedFrames(void) const
 	if (detectHistory_.size() <= 10)
 	{
 		size_t detectCount = 0;
-		for (auto it = detectHistory_.begin();  it != detectHistory_.end(); ++it)
-			if (*it)
+		for (size_t i = 0; i < detectHistory_.size(); i++)
+			if (detectHistory_[i])
 				detectCount += 1;
 		if (((double)detectCount / detectHistory_.size()) <= 0.34)
 			return true;
@@ -244,9 +245,9 @@ vector <Point> TrackedObject::getScreenPositionHistory(const Point2f &fov_size,
 {
 	vector <Point> ret;
 
-	for (auto it = positionHistory_.begin(); it != positionHistory_.end(); ++it)
+	for (size_t i = 0; i < positionHistory_.size(); i++)
 	{
-		Rect screen_rect(type_.worldToScreenCoords(*it,fov_size,frame_size, cameraElevation_));
+		Rect screen_rect(type_.worldToScreenCoords(positionHistory_[i],fov_size,frame_size, cameraElevation_));
 		ret.push_back(Point(cvRound(screen_rect.x + screen_rect.width / 2.),cvRound( screen_rect.y + screen_rect.height / 2.)));
 	}
 	return ret;
@@ -267,8 +268,8 @@ double TrackedObject::getDetectedRatio(void) const
 		return 0.01;
 
 	size_t detectCount = 0;
-	for (auto it = detectHistory_.begin();  it != detectHistory_.end(); ++it)
-		if (*it)
+	for (size_t i = 0; i < detectHistory_.size(); i++)
+		if (detectHistory_[i])
 			detectCount += 1;
 
 	// For newly added tracks make sure only 1 frame is missed at most
@@ -301,7 +302,12 @@ double TrackedObject::getDetectedRatio(void) const
 
 Rect TrackedObject::getScreenPosition(const Point2f &fov_size, const Size &frame_size) const
 {
-	return type_.worldToScreenCoords(position_, fov_size, frame_size, cameraElevation_);
+	return getScreenPosition(position_, fov_size, frame_size);
+}
+
+Rect TrackedObject::getScreenPosition(const Point3f &position, const Point2f &fov_size, const Size &frame_size) const
+{
+	return type_.worldToScreenCoords(position, fov_size, frame_size, cameraElevation_);
 }
 
 
@@ -323,33 +329,13 @@ double TrackedObject::contourArea(const Point2f &fov_size, const Size &frame_siz
 	return cv::contourArea(scaled_contour);
 }
 
-Point3f TrackedObject::predictKF(void)
-{
-	return KF_.GetPrediction();
-}
-
-
-Point3f TrackedObject::updateKF(Point3f pt)
-{
-	return KF_.Update(pt);
-}
-
-#if 0
-void TrackedObject::adjustKF(const Eigen::Transform<double, 3, Eigen::Isometry> &delta_robot)
-{
-	KF_.adjustPrediction(delta_robot);
-}
-#endif
-void TrackedObject::adjustKF(Point3f delta_pos)
-{
-	KF_.adjustPrediction(delta_pos);
-}
-
-
 //Create a tracked object list
 // those stay constant for the entire length of the run
+// Kalman filter time step and acceleration noise are
+// tuned for the frame rate we typically see
 TrackedObjectList::TrackedObjectList(const Size &imageSize, const Point2f &fovSize, float cameraElevation) :
 	detectCount_(0),
+	kf_(0.5, 0.25),
 	imageSize_(imageSize),
 	fovSize_(fovSize),
 	cameraElevation_(cameraElevation)
@@ -369,8 +355,9 @@ void TrackedObjectList::adjustLocation(const Eigen::Transform<double, 3, Eigen::
 // Adjust position for camera motion between frames using optical flow
 void TrackedObjectList::adjustLocation(const Mat &transform_mat)
 {
-	for (auto it = list_.begin(); it != list_.end(); ++it)
+	for (size_t i = 0; i < list_.size(); i++)
 	{
+		TrackedObject *it = &list_[i];
 		//measure the amount that the position changed and apply the same change to the kalman filter
 		Point3f old_pos = it->getPosition();
 		//compute r and use it for depth (assume depth doesn't change)
@@ -378,7 +365,7 @@ void TrackedObjectList::adjustLocation(const Mat &transform_mat)
 		it->adjustPosition(transform_mat, r, fovSize_, imageSize_);
 		Point3f delta_pos = it->getPosition() - old_pos;
 
-		it->adjustKF(delta_pos);
+		kf_.adjustPrediction(i, delta_pos);
 	}
 }
 
@@ -391,6 +378,26 @@ vector<vector<Point>> TrackedObjectList::getScreenPositionHistories(void) const
 	return ret;
 }
 
+// Predicted screen position of each tracked object, moved
+// by the camera motion in transform_mat
+void TrackedObjectList::getPredictedScreenRects(const Mat &transform_mat, vector<Rect> &rects) const
+{
+	rects.clear();
+	for (size_t i = 0; i < list_.size(); i++)
+	{
+		Rect rect = list_[i].getScreenPosition(kf_.peekPrediction(i), fovSize_, imageSize_);
+		if (!transform_mat.empty())
+		{
+			const Point2d center(rect.x + rect.width / 2., rect.y + rect.height / 2.);
+			Mat pos_mat = (Mat_<double>(3, 1) << center.x, center.y, 1.0);
+			Mat new_pos_mat = transform_mat * pos_mat;
+			rect.x = cvRound(new_pos_mat.at<double>(0) - rect.width / 2.);
+			rect.y = cvRound(new_pos_mat.at<double>(1) - rect.height / 2.);
+		}
+		rects.push_back(rect);
+	}
+}
+
 // Simple printout of list into stdout
 void TrackedObjectList::print(void) const
 {
@@ -418,6 +425,11 @@ void TrackedObjectList::getDisplay(vector<TrackedObjectDisplay> &displayList) co
 	}
 }
 
+void TrackedObjectList::setAssignmentMethod(AssignmentProblemSolver::TMethod method)
+{
+	associator_.setMethod(method);
+}
+
 const double dist_thresh_ = 1.0; // FIX ME!
 //#define VERBOSE_TRACK
 
@@ -449,15 +461,16 @@ void TrackedObjectList::processDetect(const vector<Rect> &detectedRects,
 
 	// Maps tracks to the closest new detected object.
 	// assignment[track] = index of closest detection
-	vector<int> assignment;
+	vector<int> &assignment = assignment_;
+	assignment.clear();
 	if (list_.size())
 	{
 		size_t tracks = list_.size();		          // number of tracked objects from prev frames
 		size_t detections = detectedPositions.size(); // number of detections this frame
 
-		//Cost[t][d] is the distance between old tracked location t
+		//cost_[t * detections + d] is the distance between old tracked location t
 		//and newly detected object d's position 
-		vector< vector<double> > Cost(tracks,vector<double>(detections));
+		cost_.resize(tracks * detections);
 
 		// Calculate cost for each track->pair combo
 		// The cost here is just the distance between them
@@ -467,22 +480,24 @@ void TrackedObjectList::processDetect(const vector<Rect> &detectedRects,
 		{
 			// Point3f prediction=tracks[t]->prediction;
 			// cout << prediction << endl;
+			const ObjectType it_type = it->getType();
+			const Point3f position = it->getPosition();
+			double *costRow = &cost_[t * detections];
 			for(size_t d = 0; d < detections; d++)
 			{
-				const ObjectType it_type = it->getType();
 				if(types[d] == it_type) {
-					Point3f diff = it->getPosition() - detectedPositions[d];
-					Cost[t][d] = sqrtf(diff.x * diff.x + diff.y * diff.y + diff.z * diff.z);
+					Point3f diff = position - detectedPositions[d];
+					costRow[d] = sqrtf(diff.x * diff.x + diff.y * diff.y + diff.z * diff.z);
 				} else {
-					Cost[t][d] = numeric_limits<double>::max();
+					costRow[d] = numeric_limits<double>::max();
 				}
 			}
 		}
 
 		// Solving assignment problem (find minimum-cost assignment
 		// between tracks and previously-predicted positions)
-		AssignmentProblemSolver APS;
-		APS.Solve(Cost, assignment, AssignmentProblemSolver::optimal);
+		// Pairs further apart than dist_thresh_ are never matched
+		associator_.solve(cost_, tracks, detections, dist_thresh_, assignment);
 
 #ifdef VERBOSE_TRACK
 		// assignment[i] holds the index of the detection assigned
@@ -492,23 +507,49 @@ void TrackedObjectList::processDetect(const vector<Rect> &detectedRects,
 		for(size_t i = 0; i < assignment.size(); i++)
 			cout << i << ":" << assignment[i] << endl;
 #endif
-		// clear assignment from pairs with large distance
-		for(size_t i = 0; i < assignment.size(); i++)
-			if ((assignment[i] != -1) && (Cost[i][assignment[i]] > dist_thresh_))
-				assignment[i] = -1;
+	}
+
+	// Run the Kalman filter for all of the existing tracks.
+	// Tracks with a matching detection are updated with its
+	// coordinates. The rest continue using their predictions
+	// If track updated less than one time, than filter state is not correct.
+	kf_.predict(predictions_);
+	measurements_.resize(assignment.size());
+	for (size_t t = 0; t < assignment.size(); t++)
+		measurements_[t] = (assignment[t] != -1) ? detectedPositions[assignment[t]] : predictions_[t];
+	kf_.update(measurements_, estimates_);
+	for (size_t t = 0; t < assignment.size(); t++)
+	{
+#ifdef VERBOSE_TRACK
+		cout << "prediction:" << predictions_[t] << endl;
+		cout << ((assignment[t] != -1) ? "Update match: " : "Update no match: ") << endl;
+#endif
+		list_[t].setPosition(estimates_[t]);
+		if (assignment[t] != -1)
+			list_[t].setDetected();
+		else
+			list_[t].clearDetected();
+#ifdef VERBOSE_TRACK
+		cout << list_[t].getScreenPosition(fovSize_, imageSize_) << endl;
+#endif
 	}
 
 	// Search for unassigned detects and start new tracks for them.
 	// This will also handle the case where no tracks are present,
 	// since assignment will be empty in that case - everything gets added
+	vector<bool> detectionAssigned(detectedPositions.size(), false);
+	for(size_t i = 0; i < assignment.size(); i++)
+		if (assignment[i] != -1)
+			detectionAssigned[assignment[i]] = true;
 	for(size_t i = 0; i < detectedPositions.size(); i++)
 	{
-		if (find(assignment.begin(), assignment.end(), i) == assignment.end())
+		if (!detectionAssigned[i])
 		{
 #ifdef VERBOSE_TRACK
 			cout << "New assignment created " << i << endl;
 #endif
 			list_.push_back(TrackedObject(detectCount_++, types[i], detectedRects[i], depths[i], fovSize_, imageSize_, cameraElevation_));
+			kf_.push_back(list_.back().getPosition());
 
 #ifdef VERBOSE_TRACK
 			cout << "New assignment finished" << endl;
@@ -516,60 +557,27 @@ void TrackedObjectList::processDetect(const vector<Rect> &detectedRects,
 		}
 	}
 
-	auto tr = list_.begin();
-	auto as = assignment.begin();
-	while ((tr != list_.end()) && (as != assignment.end()))
+	// Remove tracks which haven't been seen in a while
+	keep_.resize(list_.size());
+	size_t out = 0;
+	for (size_t i = 0; i < list_.size(); i++)
 	{
-		// If track updated less than one time, than filter state is not correct.
-#ifdef VERBOSE_TRACK
-		cout << "Predict: " << endl;
-#endif
-		Point3f prediction = tr->predictKF();
-#ifdef VERBOSE_TRACK
-		cout << "prediction:" << prediction << endl;
-#endif
-
-		if(*as != -1) // If we have assigned detect, then update using its coordinates
+		keep_[i] = !list_[i].tooManyMissedFrames(); // For now just remove ones for
+		if (!keep_[i])                               // which detectList is empty
 		{
 #ifdef VERBOSE_TRACK
-			cout << "Update match: " << endl;
+			cout << "Dropping " << list_[i].getId() << endl;
 #endif
-			tr->setPosition(tr->updateKF(detectedPositions[*as]));
-#ifdef VERBOSE_TRACK
-			cout << tr->getScreenPosition(fovSize_, imageSize_) << endl;
-#endif
-			tr->setDetected();
-		}
-		else          // if not continue using predictions
-		{
-#ifdef VERBOSE_TRACK
-			cout << "Update no match: " << endl;
-#endif
-			tr->setPosition(tr->updateKF(prediction));
-#ifdef VERBOSE_TRACK
-			cout << tr->getScreenPosition(fovSize_, imageSize_) << endl;
-#endif
-			tr->clearDetected();
+			continue;
 		}
-
-		++tr;
-		++as;
+		if (out != i)
+			list_[out] = move(list_[i]);
+		out += 1;
 	}
-
-	// Remove tracks which haven't been seen in a while
-	for (auto it = list_.begin(); it != list_.end(); )
+	if (out != list_.size())
 	{
-		if (it->tooManyMissedFrames()) // For now just remove ones for
-		{                              // which detectList is empty
-#ifdef VERBOSE_TRACK
-			cout << "Dropping " << it->getId() << endl;
-#endif
-			it = list_.erase(it);
-		}
-		else
-		{
-			++it;
-		}
+		list_.erase(list_.begin() + out, list_.end());
+		kf_.compact(keep_);
 	}
 #ifdef VERBOSE_TRACK
 	print();
@@ -2,11 +2,11 @@
 #include <algorithm>
 #include <string>
 #include <vector>
-#include <list>
 //#include <Eigen/Geometry>
-#include <boost/circular_buffer.hpp>
 #include "kalman.hpp"
 #include "objtype.hpp"
+#include "ringarray.hpp"
+#include "trackassociator.hpp"
 
 const size_t TrackedObjectHistoryLength = 20;
 
@@ -20,6 +20,8 @@ const size_t TrackedObjectHistoryLength = 20;
 // same object.
 // Has method to compensate for robot rotation and translation with
 // data from the fovis code
+// The Kalman filter for each object is kept by TrackedObjectList
+// so all of them can be run at once
 class TrackedObject
 {
 	public :
@@ -29,10 +31,7 @@ class TrackedObject
 				double             avg_depth,
 				const cv::Point2f &fov_size,
 				const cv::Size    &frame_size,
-				float              camera_elevation = 0.0,
-				float              dt = 0.5,
-				float              accel_noise_mag = 0.25,
-				size_t             historyLength = TrackedObjectHistoryLength);
+				float              camera_elevation = 0.0);
 
 		//~TrackedObject();
 
@@ -68,17 +67,14 @@ class TrackedObject
 		//get position of a rect on the screen corresponding to the object size and location
 		//inverse of setPosition(Rect,depth)
 		cv::Rect getScreenPosition(const cv::Point2f &fov_size, const cv::Size &frame_size) const;
+		// Same, but as if the object were at position
+		cv::Rect getScreenPosition(const cv::Point3f &position, const cv::Point2f &fov_size, const cv::Size &frame_size) const;
 		cv::Point3f getPosition(void) const { return position_; }
 
-		//void adjustKF(const Eigen::Transform<double, 3, Eigen::Isometry> &delta_robot);
-		void adjustKF(cv::Point3f delta_pos);
-
-		cv::Point3f predictKF(void);
-		cv::Point3f updateKF(cv::Point3f pt);
 		std::vector<cv::Point> getScreenPositionHistory(const cv::Point2f &fov_size, const cv::Size &frame_size) const;
 
-		std::string getId(void) const { return id_; }
-		ObjectType getType(void) const { return type_; }
+		std::string getId(void) const;
+		const ObjectType &getType(void) const { return type_; }
 
 	private :
 		ObjectType type_;
@@ -89,14 +85,11 @@ class TrackedObject
 		// used to flag entries in other history arrays as valid
 		// and to figure out which tracked objects are persistent
 		// enough to care about
-		boost::circular_buffer<bool> detectHistory_;
-		boost::circular_buffer<cv::Point3f> positionHistory_;
-
-		// Kalman filter for tracking and noise filtering
-		TKalmanFilter KF_;
+		RingArray<bool, TrackedObjectHistoryLength> detectHistory_;
+		RingArray<cv::Point3f, TrackedObjectHistoryLength> positionHistory_;
 
-		std::string id_; //unique target ID - use a string rather than numbers so it isn't confused
-						 // with individual frame detect indexes
+		int id_; //unique target ID - shown as letters rather than numbers so it isn't confused
+				 // with individual frame detect indexes
 		int missedFrameCount_;
 
 		float cameraElevation_;
@@ -147,6 +140,11 @@ class TrackedObjectList
 
 		// Get position history for each tracked object
 		std::vector<std::vector<cv::Point>> getScreenPositionHistories(void) const;
+
+		// Where each tracked object is expected to show up on
+		// screen in the next frame. transform_mat is the camera
+		// motion from optical flow for that frame
+		void getPredictedScreenRects(const cv::Mat &transform_mat, std::vector<cv::Rect> &rects) const;
 		// Simple printout of list into
 		void print(void) const;
 
@@ -160,9 +158,26 @@ class TrackedObjectList
 						   const std::vector<float> &depths,
 						   const std::vector<ObjectType> &types);
 
+		// Pick the algorithm used to match detections to tracks
+		void setAssignmentMethod(AssignmentProblemSolver::TMethod method);
+
 	private :
-		std::list<TrackedObject> list_; // list of currently valid detected objects
-		int detectCount_;               // ID of next object to be created
+		std::vector<TrackedObject> list_; // list of currently valid detected objects
+		int detectCount_;                 // ID of next object to be created
+
+		// Kalman filters for each entry in list_, in the
+		// same order. Plus scratch space for running them
+		KalmanBatch              kf_;
+		std::vector<cv::Point3f> predictions_;
+		std::vector<cv::Point3f> measurements_;
+		std::vector<cv::Point3f> estimates_;
+		std::vector<bool>        keep_;
+
+		// Matching detections to tracks. The cost matrix
+		// and assignment are kept to reuse their memory
+		TrackAssociator     associator_;
+		std::vector<double> cost_;
+		std::vector<int>    assignment_;
 
 		//values stay constant throughout the run but are needed for computing stuff
 		cv::Size    imageSize_;
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <numeric>
+#include "trackassociator.hpp"
+
+using namespace std;
+
+TrackAssociator::TrackAssociator(AssignmentProblemSolver::TMethod method) :
+	method_(method)
+{
+}
+
+void TrackAssociator::setMethod(AssignmentProblemSolver::TMethod method)
+{
+	method_ = method;
+}
+
+int TrackAssociator::findRoot(int node)
+{
+	while (parent_[node] != node)
+	{
+		parent_[node] = parent_[parent_[node]];
+		node = parent_[node];
+	}
+	return node;
+}
+
+void TrackAssociator::solve(const vector<double> &cost, size_t tracks, size_t detections,
+							double gate, vector<int> &assignment)
+{
+	assignment.assign(tracks, -1);
+	if (!tracks || !detections)
+		return;
+
+	// Join each track and detection within the gate
+	// into the same group. Nodes [0, tracks) are tracks,
+	// [tracks, tracks + detections) are detections
+	const size_t nodes = tracks + detections;
+	parent_.resize(nodes);
+	iota(parent_.begin(), parent_.end(), 0);
+	for (size_t t = 0; t < tracks; t++)
+	{
+		const double *row = &cost[t * detections];
+		for (size_t d = 0; d < detections; d++)
+		{
+			if (row[d] <= gate)
+			{
+				const int a = findRoot(t);
+				const int b = findRoot(tracks + d);
+				if (a != b)
+					parent_[max(a, b)] = min(a, b);
+			}
+		}
+	}
+
+	// Bucket nodes by root.  The root of a group is its
+	// lowest numbered node, so every group with a track
+	// in it has a track as its root
+	groupStart_.assign(nodes + 1, 0);
+	for (size_t n = 0; n < nodes; n++)
+	{
+		parent_[n] = findRoot(n);
+		groupStart_[parent_[n] + 1] += 1;
+	}
+	partial_sum(groupStart_.begin(), groupStart_.end(), groupStart_.begin());
+	groupNodes_.resize(nodes);
+	for (size_t n = 0; n < nodes; n++)
+		groupNodes_[groupStart_[parent_[n]]++] = n;
+	// groupStart_[r] now holds the end of group r, so
+	// the start is the end of the previous root
+	int start = 0;
+	for (size_t root = 0; root < tracks; root++)
+	{
+		const int end = groupStart_[root];
+		if (end == start)
+			continue;
+
+		groupTracks_.clear();
+		groupDetections_.clear();
+		for (int i = start; i < end; i++)
+		{
+			if (groupNodes_[i] < (int)tracks)
+				groupTracks_.push_back(groupNodes_[i]);
+			else
+				groupDetections_.push_back(groupNodes_[i] - tracks);
+		}
+		start = end;
+
+		// A track with nothing in range stays unassigned
+		if (groupDetections_.empty())
+			continue;
+
+		// Only one pair possible, no need to solve anything
+		if ((groupTracks_.size() == 1) && (groupDetections_.size() == 1))
+		{
+			assignment[groupTracks_[0]] = groupDetections_[0];
+			continue;
+		}
+
+		// Out of range pairs get a cost higher than any
+		// set of in-range matches could add up to. That
+		// way the solver only uses them when there's nothing
+		// better and they can be thrown out afterwards
+		const size_t groupTracks     = groupTracks_.size();
+		const size_t groupDetections = groupDetections_.size();
+		const double forbidden = (min(groupTracks, groupDetections) + 1) * max(gate, 0.) + 1.;
+		groupCost_.resize(groupTracks * groupDetections);
+		for (size_t t = 0; t < groupTracks; t++)
+		{
+			const double *row = &cost[groupTracks_[t] * detections];
+			for (size_t d = 0; d < groupDetections; d++)
+			{
+				const double c = row[groupDetections_[d]];
+				groupCost_[t * groupDetections + d] = (c <= gate) ? max(c, 0.) : forbidden;
+			}
+		}
+		groupAssignment_.resize(groupTracks);
+		solver_.Solve(groupCost_.data(), groupTracks, groupDetections, groupAssignment_.data(), method_);
+		for (size_t t = 0; t < groupTracks; t++)
+		{
+			const int d = groupAssignment_[t];
+			if ((d >= 0) && (groupCost_[t * groupDetections + d] < forbidden))
+				assignment[groupTracks_[t]] = groupDetections_[d];
+		}
+	}
+}
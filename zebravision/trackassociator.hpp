@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include "hungarian.hpp"
+
+// Matches tracked objects to new detections.
+// Pairs further apart than a gate distance are never
+// matched.  Tracks and detections are split into groups
+// connected by pairs within the gate and each group is
+// solved separately, so a frame full of far-apart objects
+// is a bunch of tiny problems rather than one big one.
+// Scratch space is kept between calls.
+class TrackAssociator
+{
+	public:
+		TrackAssociator(AssignmentProblemSolver::TMethod method = AssignmentProblemSolver::optimal);
+
+		// Pick the solver used for groups with more than
+		// one possible match
+		void setMethod(AssignmentProblemSolver::TMethod method);
+
+		// cost is a tracks x detections row-major matrix. Sets
+		// assignment[track] to the detection matched to each
+		// track or -1 if there isn't one.  Within the gate, the
+		// most matches possible are made and ties are broken by
+		// the lowest total cost
+		void solve(const std::vector<double> &cost, size_t tracks, size_t detections,
+				   double gate, std::vector<int> &assignment);
+
+	private:
+		int findRoot(int node);
+
+		AssignmentProblemSolver          solver_;
+		AssignmentProblemSolver::TMethod method_;
+
+		std::vector<int>    parent_;     // union-find parents, tracks then detections
+		std::vector<int>    groupStart_; // start of each root's nodes in groupNodes_
+		std::vector<int>    groupNodes_; // nodes sorted by group
+		std::vector<int>    groupTracks_;
+		std::vector<int>    groupDetections_;
+		std::vector<double> groupCost_;
+		std::vector<int>    groupAssignment_;
+};
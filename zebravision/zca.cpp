@@ -64,6 +64,7 @@
 
 #include "cuda_utils.hpp"
 #include "zca.hpp"
+#include "normalizewindow.hpp"
 
 using namespace std;
 using namespace cv;
@@ -328,6 +329,8 @@ Mat ZCA::Transform32FC3(const Mat &input)
 // Transform a vector of input images in floating
 // point format using the weights loaded
 // when this object was initialized
+// 8UC3 inputs are also accepted - they're converted
+// to float on the fly
 vector<Mat> ZCA::Transform32FC3(const vector<Mat> &input)
 {
 	Mat output;
@@ -343,26 +346,22 @@ vector<Mat> ZCA::Transform32FC3(const vector<Mat> &input)
 	// channel. That way each image is normalized to 0-mean 
 	// and a standard deviation of 1 before running it
 	// through ZCA weights.
+	// Input can be either 8 or 32 bit - convertTo
+	// handles both, and also copies the window into
+	// a contiguous buffer so reshape works on it
+	Mat resized;
 	for (auto it = input.cbegin(); it != input.cend(); ++it)
 	{
 		if (it->size() != size_)
-			cv::resize(*it, output, size_);
-		else 
-			// need clone so mat is contiguous - 
-			// reshape won't work otherwise
-			output = it->clone();
-
-		Scalar mean;
-		Scalar stddev;
-		cv::meanStdDev(output, mean, stddev);
-
-		for (int r = 0; r < output.rows; r++)
 		{
-			Vec3f *p = output.ptr<Vec3f>(r);
-			for (int c = 0; c < output.cols; c++)
-				for (int ch = 0; ch < 3; ch++)
-					p[c][ch] = (p[c][ch] - mean[ch]) / stddev[ch];
+			cv::resize(*it, resized, size_);
+			resized.convertTo(output, CV_32FC3);
 		}
+		else 
+			it->convertTo(output, CV_32FC3);
+
+		// output is contiguous, so this can work in place
+		normalizeWindow(output, output.ptr<float>(0));
 
 		// Reshape flattens the image to 1 channel, 1 row.
 		// Push that row into the bottom of work
@@ -409,6 +408,70 @@ vector<Mat> ZCA::Transform32FC3(const vector<Mat> &input)
 	return ret;
 }
 
+// Reorder the columns of weightsT_ so the output of
+// images * weightsTPlanar_ has each channel of an image
+// contiguous rather than interleaved. Caffe wants input
+// in that format, so this removes the need to split()
+// each image after transforming it
+void ZCA::buildPlanarWeights(void)
+{
+	const int area = size_.area();
+	weightsTPlanar_.create(weightsT_.rows, weightsT_.cols, weightsT_.type());
+	for (int p = 0; p < area; p++)
+		for (int ch = 0; ch < 3; ch++)
+			weightsT_.col(p * 3 + ch).copyTo(weightsTPlanar_.col(ch * area + p));
+}
+
+// Transform a vector of input images using the weights
+// loaded when this object was initialized.  Output
+// is written to dest, which needs room for 
+// input.size() * size().area() * 3 floats. Each image
+// is written as 3 separate planes of B, G then R data,
+// one image after the next - the layout of a Caffe
+// input blob.
+// Each window is normalized directly from the input into
+// a reused work buffer and the ZCA matrix multiply writes
+// its results straight to dest, so there's no per-image
+// allocation or copying
+void ZCA::Transform32FC3(const vector<Mat> &input, float *dest)
+{
+	if (input.empty())
+		return;
+	if (weightsTPlanar_.empty())
+		buildPlanarWeights();
+
+	const int rowLen = size_.area() * 3;
+	if ((work_.rows < (int)input.size()) || (work_.cols != rowLen))
+		work_.create(input.size(), rowLen, CV_32FC1);
+	Mat work(work_.rowRange(0, input.size()));
+
+	Mat resized;
+	for (size_t i = 0; i < input.size(); i++)
+	{
+		const Mat *in = &input[i];
+		if (in->size() != size_)
+		{
+			cv::resize(*in, resized, size_);
+			in = &resized;
+		}
+		normalizeWindow(*in, work.ptr<float>(i));
+	}
+
+	// See comments in Transform32FC3 above for why
+	// this is images * weightsT rather than weights * images
+#ifdef USE_MKL
+	const size_t m = work.rows;
+	const size_t n = weightsTPlanar_.rows;
+	const size_t k = weightsTPlanar_.cols;
+
+	cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, 
+			m, n, k, 1.0, (const float *)work.data, k, (const float *)weightsTPlanar_.data, n, 0.0, dest, n);
+#else
+	Mat output(work.rows, rowLen, CV_32FC1, dest);
+	cv::gemm(work, weightsTPlanar_, 1.0, Mat(), 0.0, output);
+#endif
+}
+
 void cudaZCATransform(const vector<GpuMat> &input, 
 		const GpuMat &weightsT, 
 		PtrStepSz<float> *dPssIn,
@@ -532,6 +595,7 @@ ZCA &ZCA::operator=(const ZCA &zca)
 		svdU_ = zca.svdU_;
 		svdW_ = zca.svdW_;
 		weightsT_ = zca.weightsT_;
+		weightsTPlanar_ = Mat();
 		if (dPssIn_)
 		{
 			cudaSafeCall(cudaFree(dPssIn_), "cudaFreedPssIn");
@@ -580,6 +644,7 @@ void ZCA::Resize(int size)
 	// Weights are U * S * U'
 	weights = svdU * svdS * svdU.t();
 	weightsT_ = weights.t();
+	weightsTPlanar_ = Mat();
 	if (getCudaEnabledDeviceCount() > 0)
 		weightsTGPU_.upload(weightsT_);
 }
@@ -622,6 +687,7 @@ void ZCA::load(Archive &ar, const unsigned int version)
 	Mat weights;
 	ar & weights;
 	weightsT_ = weights.t();
+	weightsTPlanar_ = Mat();
 	if (!weightsT_.empty() && (getCudaEnabledDeviceCount() > 0))
 		weightsTGPU_.upload(weightsT_);
 	ar & epsilon_;
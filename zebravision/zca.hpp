@@ -45,6 +45,11 @@ class ZCA
 		std::vector<GpuMat> Transform32FC3(const std::vector<GpuMat> &input);
 		void Transform32FC3(const std::vector<GpuMat> &input, float *dest);
 
+		// Transform a batch straight into a planar buffer
+		// laid out like a Caffe input blob.  Input can be 8UC3
+		// or 32FC3 ROIs - they're read in place, no copies
+		void Transform32FC3(const std::vector<cv::Mat> &input, float *dest);
+
 		void Print(void) const;
 
 		// a and b parameters for transforming
@@ -79,6 +84,13 @@ class ZCA
 		// calculations - see notes in zca.cpp
 		cv::Mat  weightsT_;
 		GpuMat   weightsTGPU_;
+		// weightsT_ with columns reordered so the transform
+		// output comes out with each color channel contiguous.
+		// Built the first time it is needed
+		cv::Mat  weightsTPlanar_;
+		// CPU buffer holding normalized images, one per row.
+		// Reused from batch to batch
+		cv::Mat  work_;
 		// GPU buffers - more efficient to allocate
 		// them once gloabally and reuse them
 		GpuMat   gm_;
@@ -90,4 +102,6 @@ class ZCA
 		float            epsilon_;
 		double           overallMin_;
 		double           overallMax_;
+
+		void buildPlanarWeights(void);
 };
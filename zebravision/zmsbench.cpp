@@ -0,0 +1,178 @@
+// Compare ZMS frame codecs on recorded footage.  Loads frames
+// from a ZMS file then, for each codec, times compressing
+// and uncompressing all of them and reports the size of
+// the output.  Also checks that each codec gives back the
+// same color data, the same invalid depth pixels and valid
+// depth within quantization error.
+// The baseline is the zlib compressed archive used for
+// version 1 and 2 files
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "zmsin.hpp"
+#include "zmsv2.hpp"
+#include "portable_binary_oarchive.hpp"
+#include "cvMatSerialize.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Frames as written by the old ZMSOut
+static bool archiveEncode(const Mat &frame, const Mat &depth, string &buf)
+{
+	buf.clear();
+	boost::iostreams::filtering_ostream os;
+	os.push(boost::iostreams::zlib_compressor(boost::iostreams::zlib::best_speed));
+	os.push(boost::iostreams::back_inserter(buf));
+	{
+		portable_binary_oarchive archive(os);
+		archive << frame << depth;
+	}
+	os.reset();
+	return true;
+}
+
+// Returns the largest difference between valid depth values,
+// or -1 if the frames don't match otherwise
+static double compare(const Mat &frame, const Mat &depth, const Mat &outFrame, const Mat &outDepth)
+{
+	if ((frame.size() != outFrame.size()) || (frame.type() != outFrame.type()) ||
+		(depth.size() != outDepth.size()) || (depth.type() != outDepth.type()))
+		return -1;
+	if (!frame.empty() && (norm(frame, outFrame, NORM_INF) != 0))
+		return -1;
+	if (depth.type() != CV_32FC1)
+		return (depth.empty() || (norm(depth, outDepth, NORM_INF) == 0)) ? 0 : -1;
+
+	double maxErr = 0;
+	for (int y = 0; y < depth.rows; y++)
+	{
+		const float *in  = depth.ptr<float>(y);
+		const float *out = outDepth.ptr<float>(y);
+		for (int x = 0; x < depth.cols; x++)
+		{
+			if (std::isnan(in[x]) || std::isnan(out[x]))
+			{
+				if (std::isnan(in[x]) != std::isnan(out[x]))
+					return -1;
+			}
+			else if (std::isinf(in[x]) || std::isinf(out[x]))
+			{
+				if (in[x] != out[x])
+					return -1;
+			}
+			else
+				maxErr = max<double>(maxErr, fabs(in[x] - out[x]));
+		}
+	}
+	return maxErr;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		cout << argv[0] << " input.zms [max frames]" << endl;
+		return 0;
+	}
+	const size_t maxFrames = (argc > 2) ? atoi(argv[2]) : 300;
+
+	vector<Mat> frames;
+	vector<Mat> depths;
+	size_t rawBytes = 0;
+	{
+		ZMSIn in(argv[1]);
+		Mat frame;
+		Mat depth;
+		while ((frames.size() < maxFrames) && in.getFrame(frame, depth))
+		{
+			frames.push_back(frame.clone());
+			depths.push_back(depth.clone());
+			rawBytes += frame.total() * frame.elemSize() + depth.total() * depth.elemSize();
+		}
+	}
+	if (frames.empty())
+	{
+		cerr << "No frames read from " << argv[1] << endl;
+		return 1;
+	}
+	cout << "Loaded " << frames.size() << " frames, " << frames[0].size()
+		<< " " << rawBytes / (1024. * 1024.) << " MB uncompressed" << endl;
+
+	const char *codecs[] = {
+		NULL, // zlib archive
+		"zlib,float,interleaved",
+		"zlib",
+		"lz4,float,interleaved",
+		"lz4",
+		"zstd,float",
+		"zstd",
+		"zstd:3"
+	};
+
+	cout << setw(24) << left << "codec" << right
+		<< setw(10) << "enc FPS" << setw(10) << "enc MB/s"
+		<< setw(10) << "dec FPS" << setw(10) << "ratio"
+		<< setw(12) << "max err" << endl;
+	int rc = 0;
+	for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++)
+	{
+		ZMSCodec codec;
+		if (codecs[c] && !zmsParseCodec(codecs[c], codec))
+			continue;
+		const uint32_t version = codecs[c] ? 3 : 2;
+
+		vector<string> encoded(frames.size());
+		auto start = chrono::steady_clock::now();
+		for (size_t i = 0; i < frames.size(); i++)
+		{
+			if (codecs[c])
+				zmsEncodeFrame(frames[i], depths[i], codec, encoded[i]);
+			else
+				archiveEncode(frames[i], depths[i], encoded[i]);
+		}
+		const double encodeTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		size_t encodedBytes = 0;
+		for (auto it = encoded.cbegin(); it != encoded.cend(); ++it)
+			encodedBytes += it->size();
+
+		vector<Mat> outFrames(frames.size());
+		vector<Mat> outDepths(frames.size());
+		start = chrono::steady_clock::now();
+		bool decoded = true;
+		for (size_t i = 0; i < frames.size(); i++)
+			decoded &= zmsDecodeFrame(version, encoded[i].data(), encoded[i].size(), outFrames[i], outDepths[i]);
+		const double decodeTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		double maxErr = decoded ? 0 : -1;
+		for (size_t i = 0; decoded && (i < frames.size()); i++)
+		{
+			const double err = compare(frames[i], depths[i], outFrames[i], outDepths[i]);
+			maxErr = (err < 0) ? err : max(maxErr, err);
+			if (err < 0)
+				break;
+		}
+
+		cout << setw(24) << left << (codecs[c] ? codecs[c] : "zlib archive (v2)") << right << fixed
+			<< setw(10) << setprecision(1) << frames.size() / encodeTime
+			<< setw(10) << setprecision(1) << rawBytes / (1024. * 1024.) / encodeTime
+			<< setw(10) << setprecision(1) << frames.size() / decodeTime
+			<< setw(10) << setprecision(2) << (double)rawBytes / encodedBytes;
+		if (maxErr < 0)
+		{
+			cout << setw(12) << "MISMATCH" << endl;
+			rc = 1;
+		}
+		else
+			cout << setw(12) << setprecision(5) << maxErr << endl;
+	}
+	return rc;
+}
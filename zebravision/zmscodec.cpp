@@ -0,0 +1,555 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <vector>
+#include <zlib.h>
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "zmscodec.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Frame layout :
+//   uint8 flags
+//   int32 frame rows, cols, type
+//   int32 depth rows, cols, type
+//   color block
+//   depth block
+// Each block is uint8 compressor, uint64 uncompressed size,
+// uint64 compressed size then the compressed data.
+// All integers are little endian
+static const uint8_t flagDepth16     = 1; // depth is quantized uint16 differences
+static const uint8_t flagPlanar      = 2; // color channels stored one after another
+static const uint8_t flagExceptions  = 4; // depth16 data has a mask of unquantized pixels
+static const size_t  frameHeaderSize = 1 + 6 * 4;
+static const size_t  blockHeaderSize = 1 + 8 + 8;
+static const int     maxDimension    = 16384;
+
+// Depth16 data is the low byte of each difference, then the
+// high bytes.  If any pixels couldn't be quantized that's
+// followed by a class byte per pixel and then the raw float
+// value of each DEPTH_RAW pixel
+enum DepthClass
+{
+	DEPTH_VALID   = 0,
+	DEPTH_NAN     = 1,
+	DEPTH_POS_INF = 2,
+	DEPTH_NEG_INF = 3,
+	DEPTH_RAW     = 4
+};
+static const float depthScale = 1000.f; // meters -> mm
+static const float maxDepth   = 65535.f / depthScale;
+
+static void putLE(unsigned char *p, uint64_t v, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; i++)
+		p[i] = (v >> (8 * i)) & 0xff;
+}
+
+static uint64_t getLE(const unsigned char *p, size_t bytes)
+{
+	uint64_t v = 0;
+	for (size_t i = 0; i < bytes; i++)
+		v |= (uint64_t)p[i] << (8 * i);
+	return v;
+}
+
+ZMSCodec::ZMSCodec(void) :
+#ifdef USE_LZ4
+	compressor(ZMS_COMPRESS_LZ4),
+#else
+	compressor(ZMS_COMPRESS_ZLIB),
+#endif
+	level(0),
+	depth16(true),
+	planarColor(true)
+{
+}
+
+bool zmsCompressorAvailable(ZMSCompressor compressor)
+{
+	switch (compressor)
+	{
+		case ZMS_COMPRESS_ZLIB:
+			return true;
+#ifdef USE_LZ4
+		case ZMS_COMPRESS_LZ4:
+			return true;
+#endif
+#ifdef USE_ZSTD
+		case ZMS_COMPRESS_ZSTD:
+			return true;
+#endif
+		default:
+			break;
+	}
+	return false;
+}
+
+const char *zmsCompressorName(ZMSCompressor compressor)
+{
+	switch (compressor)
+	{
+		case ZMS_COMPRESS_ZLIB:
+			return "zlib";
+		case ZMS_COMPRESS_LZ4:
+			return "lz4";
+		case ZMS_COMPRESS_ZSTD:
+			return "zstd";
+	}
+	return "unknown";
+}
+
+bool zmsParseCodec(const string &str, ZMSCodec &codec)
+{
+	ZMSCodec parsed;
+	stringstream ss(str);
+	string token;
+	bool first = true;
+	while (getline(ss, token, ','))
+	{
+		if (first)
+		{
+			first = false;
+			const size_t colon = token.find(':');
+			const string name = token.substr(0, colon);
+			if (name == "zlib")
+				parsed.compressor = ZMS_COMPRESS_ZLIB;
+			else if (name == "lz4")
+				parsed.compressor = ZMS_COMPRESS_LZ4;
+			else if (name == "zstd")
+				parsed.compressor = ZMS_COMPRESS_ZSTD;
+			else
+			{
+				cerr << "Unknown ZMS compressor " << name << endl;
+				return false;
+			}
+			if (colon != string::npos)
+				parsed.level = atoi(token.c_str() + colon + 1);
+		}
+		else if (token == "float")
+			parsed.depth16 = false;
+		else if (token == "interleaved")
+			parsed.planarColor = false;
+		else
+		{
+			cerr << "Unknown ZMS codec option " << token << endl;
+			return false;
+		}
+	}
+	if (first)
+		return false;
+	if (!zmsCompressorAvailable(parsed.compressor))
+	{
+		cerr << "ZMS compressor " << zmsCompressorName(parsed.compressor) << " not built in" << endl;
+		return false;
+	}
+	codec = parsed;
+	return true;
+}
+
+// Append a compressed block to buf
+static bool compressBlock(ZMSCompressor compressor, int level,
+		const unsigned char *src, size_t size, string &buf)
+{
+	size_t bound = 0;
+	switch (compressor)
+	{
+		case ZMS_COMPRESS_ZLIB:
+			bound = compressBound(size);
+			break;
+#ifdef USE_LZ4
+		case ZMS_COMPRESS_LZ4:
+			bound = LZ4_compressBound(size);
+			break;
+#endif
+#ifdef USE_ZSTD
+		case ZMS_COMPRESS_ZSTD:
+			bound = ZSTD_compressBound(size);
+			break;
+#endif
+		default:
+			cerr << "ZMS compressor " << zmsCompressorName(compressor) << " not built in" << endl;
+			return false;
+	}
+
+	const size_t start = buf.size();
+	buf.resize(start + blockHeaderSize + bound);
+	char *dst = &buf[start + blockHeaderSize];
+	size_t compSize = 0;
+	if (size)
+	{
+		switch (compressor)
+		{
+			case ZMS_COMPRESS_ZLIB:
+				{
+					uLongf destLen = bound;
+					if (compress2((Bytef *)dst, &destLen, src, size, level ? level : Z_BEST_SPEED) == Z_OK)
+						compSize = destLen;
+				}
+				break;
+#ifdef USE_LZ4
+			case ZMS_COMPRESS_LZ4:
+				compSize = max(LZ4_compress_fast((const char *)src, dst, size, bound, level ? level : 1), 0);
+				break;
+#endif
+#ifdef USE_ZSTD
+			case ZMS_COMPRESS_ZSTD:
+				{
+					const size_t rc = ZSTD_compress(dst, bound, src, size, level ? level : 1);
+					if (!ZSTD_isError(rc))
+						compSize = rc;
+				}
+				break;
+#endif
+			default:
+				break;
+		}
+		if (compSize == 0)
+		{
+			cerr << "ZMS : " << zmsCompressorName(compressor) << " compression failed" << endl;
+			buf.resize(start);
+			return false;
+		}
+	}
+
+	unsigned char *header = (unsigned char *)&buf[start];
+	header[0] = compressor;
+	putLE(header + 1, size, 8);
+	putLE(header + 9, compSize, 8);
+	buf.resize(start + blockHeaderSize + compSize);
+	return true;
+}
+
+struct Block
+{
+	uint8_t              compressor;
+	uint64_t             rawSize;
+	uint64_t             compSize;
+	const unsigned char *data;
+};
+
+static bool readBlock(const unsigned char *&p, const unsigned char *end, Block &block)
+{
+	if ((size_t)(end - p) < blockHeaderSize)
+		return false;
+	block.compressor = p[0];
+	block.rawSize    = getLE(p + 1, 8);
+	block.compSize   = getLE(p + 9, 8);
+	p += blockHeaderSize;
+	if (block.compSize > (uint64_t)(end - p))
+		return false;
+	block.data = p;
+	p += block.compSize;
+	return true;
+}
+
+static bool decompressBlock(const Block &block, unsigned char *dst)
+{
+	if (block.rawSize == 0)
+		return block.compSize == 0;
+	switch (block.compressor)
+	{
+		case ZMS_COMPRESS_ZLIB:
+			{
+				uLongf destLen = block.rawSize;
+				return (uncompress(dst, &destLen, block.data, block.compSize) == Z_OK) &&
+					(destLen == block.rawSize);
+			}
+#ifdef USE_LZ4
+		case ZMS_COMPRESS_LZ4:
+			return LZ4_decompress_safe((const char *)block.data, (char *)dst,
+					block.compSize, block.rawSize) == (int)block.rawSize;
+#endif
+#ifdef USE_ZSTD
+		case ZMS_COMPRESS_ZSTD:
+			{
+				const size_t rc = ZSTD_decompress(dst, block.rawSize, block.data, block.compSize);
+				return !ZSTD_isError(rc) && (rc == block.rawSize);
+			}
+#endif
+		default:
+			break;
+	}
+	cerr << "ZMS : can't decompress data using compressor " << (int)block.compressor << endl;
+	return false;
+}
+
+// Copy Mat data into a contiguous buffer, optionally
+// splitting a 3 channel image into separate planes
+static void matToRaw(const Mat &mat, bool planar, vector<unsigned char> &raw)
+{
+	const size_t rowBytes = mat.cols * mat.elemSize();
+	raw.resize(mat.rows * rowBytes);
+	if (planar)
+	{
+		const size_t n = mat.total();
+		unsigned char *c0 = raw.data();
+		unsigned char *c1 = c0 + n;
+		unsigned char *c2 = c1 + n;
+		for (int y = 0; y < mat.rows; y++)
+		{
+			const unsigned char *p = mat.ptr<unsigned char>(y);
+			for (int x = 0; x < mat.cols; x++, p += 3)
+			{
+				*c0++ = p[0];
+				*c1++ = p[1];
+				*c2++ = p[2];
+			}
+		}
+	}
+	else
+	{
+		for (int y = 0; y < mat.rows; y++)
+			memcpy(&raw[y * rowBytes], mat.ptr(y), rowBytes);
+	}
+}
+
+static void rawToPlanar(const unsigned char *raw, Mat &mat)
+{
+	const size_t n = mat.total();
+	const unsigned char *c0 = raw;
+	const unsigned char *c1 = c0 + n;
+	const unsigned char *c2 = c1 + n;
+	for (int y = 0; y < mat.rows; y++)
+	{
+		unsigned char *p = mat.ptr<unsigned char>(y);
+		for (int x = 0; x < mat.cols; x++, p += 3)
+		{
+			p[0] = *c0++;
+			p[1] = *c1++;
+			p[2] = *c2++;
+		}
+	}
+}
+
+// Quantize float meters to uint16 mm.  Each pixel is stored
+// as the difference from the one to its left, or the one
+// above for the first column.  Pixels which can't be quantized
+// reuse the previous value so they don't break up the
+// run of small differences around them.  Returns true if
+// any such pixels were found
+static bool depthToRaw16(const Mat &depth, vector<unsigned char> &raw)
+{
+	const size_t n = depth.total();
+	raw.resize(2 * n);
+	unsigned char *lo = raw.data();
+	unsigned char *hi = lo + n;
+	vector<unsigned char> classes;
+	vector<unsigned char> rawValues;
+	uint16_t rowStart = 0;
+	size_t   i = 0;
+	for (int y = 0; y < depth.rows; y++)
+	{
+		const float *p = depth.ptr<float>(y);
+		uint16_t pred = rowStart;
+		for (int x = 0; x < depth.cols; x++, i++)
+		{
+			const float v = p[x];
+			uint16_t q;
+			if ((v >= 0.f) && (v <= maxDepth))
+				q = min(lrintf(v * depthScale), 65535L);
+			else
+			{
+				if (classes.empty())
+					classes.resize(n, DEPTH_VALID);
+				if (std::isnan(v))
+					classes[i] = DEPTH_NAN;
+				else if (std::isinf(v))
+					classes[i] = (v > 0) ? DEPTH_POS_INF : DEPTH_NEG_INF;
+				else
+				{
+					classes[i] = DEPTH_RAW;
+					uint32_t bits;
+					memcpy(&bits, &v, sizeof(bits));
+					unsigned char le[4];
+					putLE(le, bits, 4);
+					rawValues.insert(rawValues.end(), le, le + 4);
+				}
+				q = pred;
+			}
+			const uint16_t diff = q - pred;
+			lo[i] = diff & 0xff;
+			hi[i] = diff >> 8;
+			pred  = q;
+			if (x == 0)
+				rowStart = q;
+		}
+	}
+	if (classes.empty())
+		return false;
+	raw.insert(raw.end(), classes.begin(), classes.end());
+	raw.insert(raw.end(), rawValues.begin(), rawValues.end());
+	return true;
+}
+
+static bool raw16ToDepth(const unsigned char *raw, size_t size, bool exceptions, Mat &depth)
+{
+	const size_t n = depth.total();
+	if (size < (exceptions ? 3 : 2) * n)
+		return false;
+	const unsigned char *lo        = raw;
+	const unsigned char *hi        = lo + n;
+	const unsigned char *classes   = exceptions ? hi + n : NULL;
+	const unsigned char *rawValues = raw + 3 * n;
+	const unsigned char *end       = raw + size;
+	uint16_t rowStart = 0;
+	size_t   i = 0;
+	for (int y = 0; y < depth.rows; y++)
+	{
+		float *p = depth.ptr<float>(y);
+		uint16_t pred = rowStart;
+		for (int x = 0; x < depth.cols; x++, i++)
+		{
+			const uint16_t q = pred + (lo[i] | (hi[i] << 8));
+			if (!classes || (classes[i] == DEPTH_VALID))
+				p[x] = q * (1.f / depthScale);
+			else if (classes[i] == DEPTH_NAN)
+				p[x] = numeric_limits<float>::quiet_NaN();
+			else if (classes[i] == DEPTH_POS_INF)
+				p[x] = numeric_limits<float>::infinity();
+			else if (classes[i] == DEPTH_NEG_INF)
+				p[x] = -numeric_limits<float>::infinity();
+			else if ((classes[i] == DEPTH_RAW) && ((end - rawValues) >= 4))
+			{
+				const uint32_t bits = getLE(rawValues, 4);
+				memcpy(&p[x], &bits, sizeof(bits));
+				rawValues += 4;
+			}
+			else
+				return false;
+			pred = q;
+			if (x == 0)
+				rowStart = q;
+		}
+	}
+	return true;
+}
+
+static void putMatHeader(unsigned char *p, const Mat &mat)
+{
+	putLE(p,     (uint32_t)mat.rows, 4);
+	putLE(p + 4, (uint32_t)mat.cols, 4);
+	putLE(p + 8, (uint32_t)mat.type(), 4);
+}
+
+static bool getMatHeader(const unsigned char *p, Mat &mat)
+{
+	const int rows = (int32_t)getLE(p, 4);
+	const int cols = (int32_t)getLE(p + 4, 4);
+	const int type = (int32_t)getLE(p + 8, 4);
+	if ((rows < 0) || (rows > maxDimension) ||
+		(cols < 0) || (cols > maxDimension) ||
+		(type != CV_MAT_TYPE(type)))
+		return false;
+	if (rows && cols)
+		mat.create(rows, cols, type);
+	else
+		mat = Mat();
+	return true;
+}
+
+bool zmsCodecEncode(const Mat &frame, const Mat &depth, const ZMSCodec &codec, string &buf)
+{
+	uint8_t flags = 0;
+	const bool planar = codec.planarColor && (frame.type() == CV_8UC3);
+	if (planar)
+		flags |= flagPlanar;
+	const bool depth16 = codec.depth16 && (depth.type() == CV_32FC1);
+	if (depth16)
+		flags |= flagDepth16;
+
+	// Compress continuous data in place, everything
+	// else is rearranged into raw first
+	vector<unsigned char> raw;
+	const unsigned char *colorData = frame.ptr();
+	size_t colorSize = frame.total() * frame.elemSize();
+	if (planar || !frame.isContinuous())
+	{
+		matToRaw(frame, planar, raw);
+		colorData = raw.data();
+	}
+
+	buf.resize(frameHeaderSize);
+	if (!compressBlock(codec.compressor, codec.level, colorData, colorSize, buf))
+		return false;
+
+	const unsigned char *depthData = depth.ptr();
+	size_t depthSize = depth.total() * depth.elemSize();
+	if (depth16)
+	{
+		if (depthToRaw16(depth, raw))
+			flags |= flagExceptions;
+		depthData = raw.data();
+		depthSize = raw.size();
+	}
+	else if (!depth.isContinuous())
+	{
+		matToRaw(depth, false, raw);
+		depthData = raw.data();
+	}
+	if (!compressBlock(codec.compressor, codec.level, depthData, depthSize, buf))
+		return false;
+
+	unsigned char *header = (unsigned char *)&buf[0];
+	header[0] = flags;
+	putMatHeader(header + 1, frame);
+	putMatHeader(header + 13, depth);
+	return true;
+}
+
+bool zmsCodecDecode(const char *data, size_t size, Mat &frame, Mat &depth)
+{
+	const unsigned char *p   = (const unsigned char *)data;
+	const unsigned char *end = p + size;
+	if (size < frameHeaderSize)
+		return false;
+	const uint8_t flags = p[0];
+	if (!getMatHeader(p + 1, frame) || !getMatHeader(p + 13, depth))
+		return false;
+	p += frameHeaderSize;
+
+	Block colorBlock;
+	Block depthBlock;
+	if (!readBlock(p, end, colorBlock) || !readBlock(p, end, depthBlock))
+		return false;
+
+	// Decompress straight into the Mat unless
+	// the data has to be rearranged first
+	vector<unsigned char> raw;
+	if (colorBlock.rawSize != (frame.total() * frame.elemSize()))
+		return false;
+	if (flags & flagPlanar)
+	{
+		if (frame.type() != CV_8UC3)
+			return false;
+		raw.resize(colorBlock.rawSize);
+		if (!decompressBlock(colorBlock, raw.data()))
+			return false;
+		rawToPlanar(raw.data(), frame);
+	}
+	else if (!decompressBlock(colorBlock, frame.ptr()))
+		return false;
+
+	if (flags & flagDepth16)
+	{
+		// Worst case every pixel is a raw float
+		if ((depth.type() != CV_32FC1) || (depthBlock.rawSize > (7 * depth.total())))
+			return false;
+		raw.resize(depthBlock.rawSize);
+		return decompressBlock(depthBlock, raw.data()) &&
+			raw16ToDepth(raw.data(), raw.size(), flags & flagExceptions, depth);
+	}
+	if (depthBlock.rawSize != (depth.total() * depth.elemSize()))
+		return false;
+	return decompressBlock(depthBlock, depth.ptr());
+}
@@ -0,0 +1,59 @@
+// Frame compression for ZMS files.
+// Version 2 files ran a serialized BGR frame plus float
+// depth Mat through zlib.  That's too slow to keep up on the
+// Jetson and float depth data compresses poorly.  Version 3
+// frames are instead stored as separately compressed color
+// and depth blocks :
+//   - color can be split into one plane per channel, which
+//     gives the compressor longer runs of similar bytes
+//   - depth can be quantized to uint16 millimeters and stored
+//     as the difference from the pixel to the left.  Pixels
+//     which don't fit - NaN, inf, negative or too far away -
+//     are flagged in a mask and restored exactly
+//   - each block is compressed with zlib, LZ4 or Zstd. The
+//     latter two are only available if the libraries were
+//     found at build time
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <opencv2/core/core.hpp>
+
+enum ZMSCompressor
+{
+	ZMS_COMPRESS_ZLIB = 0,
+	ZMS_COMPRESS_LZ4  = 1,
+	ZMS_COMPRESS_ZSTD = 2
+};
+
+struct ZMSCodec
+{
+	ZMSCompressor compressor;
+	int           level;       // compressor-specific level, 0 picks the fastest setting
+	bool          depth16;     // quantize depth to uint16 mm, otherwise store raw floats
+	bool          planarColor; // split 3 channel color into separate planes
+
+	// Defaults to the fastest compressor which
+	// is available with depth16 and planarColor set
+	ZMSCodec(void);
+};
+
+// Was support for this compressor built in?
+bool zmsCompressorAvailable(ZMSCompressor compressor);
+const char *zmsCompressorName(ZMSCompressor compressor);
+
+// Parse a codec description of the form
+//   compressor[:level][,float][,interleaved]
+// e.g. "lz4", "zstd:3,float" or "zlib:1,interleaved".
+// float stores depth without quantizing it, interleaved
+// leaves color channels interleaved.  Returns false if
+// the string is invalid or the compressor isn't available
+bool zmsParseCodec(const std::string &str, ZMSCodec &codec);
+
+// Encode frame and depth into buf using the given codec.
+// Returns false if the compressor fails or isn't available
+bool zmsCodecEncode(const cv::Mat &frame, const cv::Mat &depth, const ZMSCodec &codec, std::string &buf);
+
+// Decode data written by zmsCodecEncode.  Returns false if
+// the data is corrupt or needs a compressor which isn't available
+bool zmsCodecDecode(const char *data, size_t size, cv::Mat &frame, cv::Mat &depth);
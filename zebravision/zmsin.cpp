@@ -5,7 +5,12 @@
 // Initial versions of these files were non-portable
 // but later versions were changed to be useable
 // on both ARM and x86.  Handle loading both types,
-// at least for the time being
+// at least for the time being.
+// Version 2 files (see zmsv2.hpp) compress each frame
+// separately and include an index, so they can be
+// randomly accessed.  Old files are still read
+// sequentially
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include "zmsin.hpp"
@@ -21,20 +26,28 @@ using namespace std;
 using namespace cv;
 using namespace boost::filesystem;
 
-ZMSIn::ZMSIn(const char *inFileName, ZvSettings *settings) :
+ZMSIn::ZMSIn(const char *inFileName, ZvSettings *settings,
+		int readAheadThreads, int readAheadDepth) :
 	SyncIn(settings),
 	serializeIn_(NULL),
 	filtSBIn_(NULL),
 	archiveIn_(NULL),
-	portableArchiveIn_(NULL)
+	portableArchiveIn_(NULL),
+	formatVersion_(0),
+	nextFrame_(0),
+	readAhead_(NULL)
 {
 	width_ = 0;
 	height_ = 0;
 	// Grab the first frame to figure out image size
 	cerr << "Loading " << inFileName << " for reading" << endl;
 	bool loaded = false;
-	if (openSerializeInput(inFileName, true) ||
-		openSerializeInput(inFileName, false))
+	if (openV2Input(inFileName))
+	{
+		loaded = readV2Frame(0, frame_, depth_);
+	}
+	else if (openSerializeInput(inFileName, true) ||
+		     openSerializeInput(inFileName, false))
 	{
 		loaded = true;
 		try
@@ -61,11 +74,20 @@ ZMSIn::ZMSIn(const char *inFileName, ZvSettings *settings) :
 	height_ = frame_.rows;
 
 	// Reopen the file so callers can get the first frame
-	if (!openSerializeInput(inFileName, archiveIn_ == NULL))
+	// v2 files can just seek back to it
+	if (index_.empty() && !openSerializeInput(inFileName, archiveIn_ == NULL))
 	{
 		cerr << "Zed init : Could not reopen " << inFileName << " for reading" << endl;
 		return;
 	}
+	nextFrame_ = 0;
+
+	// Decoding is the bottleneck reading v2 files - spread
+	// it across several threads which work ahead of the
+	// frame currently being processed
+	if (!index_.empty())
+		readAhead_ = new ZMSReadAhead(inFileName, index_, formatVersion_,
+				max(readAheadThreads, 0), max(readAheadDepth, 0));
 
 	while (height_ > 700)
 	{
@@ -75,6 +97,40 @@ ZMSIn::ZMSIn(const char *inFileName, ZvSettings *settings) :
 	startThread();
 }
 
+// Check for a v2 file and load its frame index. Files
+// which weren't closed cleanly won't have an index at the
+// end - rebuild it from the per-frame headers instead
+bool ZMSIn::openV2Input(const char *inFileName)
+{
+	deleteInputPointers();
+	serializeIn_ = new ifstream(inFileName, ios::in | ios::binary);
+	if (!serializeIn_ || !serializeIn_->is_open() || !zmsReadHeader(*serializeIn_, formatVersion_))
+	{
+		deleteInputPointers();
+		return false;
+	}
+	if (!zmsReadIndex(*serializeIn_, index_) && !zmsScanIndex(*serializeIn_, index_))
+	{
+		cerr << "ZMS file " << inFileName << " has no frames" << endl;
+		deleteInputPointers();
+		return false;
+	}
+	return true;
+}
+
+bool ZMSIn::readV2Frame(size_t index, Mat &frame, Mat &depth)
+{
+	if (index >= index_.size())
+		return false;
+	const ZMSIndexEntry &entry = index_[index];
+	readBuf_.resize(entry.size);
+	serializeIn_->clear();
+	serializeIn_->seekg(entry.offset);
+	if (!serializeIn_->read(readBuf_.data(), entry.size))
+		return false;
+	return zmsDecodeFrame(formatVersion_, readBuf_.data(), entry.size, frame, depth);
+}
+
 // Input needs 3 things. First is a standard ifstream to read from
 // Next is an (optional) filtered stream buffer. This is used to
 // uncompress on the fly - uncompressed files take up way too
@@ -141,6 +197,11 @@ bool ZMSIn::openSerializeInput(const char *inFileName, bool portable)
 // Helper to easily delete and NULL out input file pointers
 void ZMSIn::deleteInputPointers(void)
 {
+	if (readAhead_)
+	{
+		delete readAhead_;
+		readAhead_ = NULL;
+	}
 	if (archiveIn_)
 	{
 		delete archiveIn_;
@@ -161,6 +222,7 @@ void ZMSIn::deleteInputPointers(void)
 		delete serializeIn_;
 		serializeIn_ = NULL;
 	}
+	index_.clear();
 }
 
 
@@ -173,12 +235,29 @@ ZMSIn::~ZMSIn()
 
 bool ZMSIn::isOpened(void) const
 {
-	return archiveIn_ || portableArchiveIn_;
+	return archiveIn_ || portableArchiveIn_ || !index_.empty();
+}
+
+
+// Frame count is only known for v2 files
+int ZMSIn::frameCount(void) const
+{
+	if (index_.empty())
+		return -1;
+	return index_.size();
 }
 
 
 bool ZMSIn::postLockUpdate(cv::Mat &frame, cv::Mat &depth)
 {
+	if (!index_.empty())
+	{
+		if (!readAhead_->get(nextFrame_, frame, depth))
+			return false;
+		nextFrame_ += 1;
+		return true;
+	}
+
 	// Ugly try-catch to detect EOF
 	try
 	{
@@ -197,14 +276,25 @@ bool ZMSIn::postLockUpdate(cv::Mat &frame, cv::Mat &depth)
 }
 
 
-// Can't randomly seek in ZMS yet
-// TOOD : if moving forward, read frames sequentially?
-//        if moving backwards, reopen then read forward sequentially?
+// v2 files have an index of frame locations,
+// so seeking is just picking which one to read next.
+// v1 files are one compressed stream and can't
+// be randomly accessed
 bool ZMSIn::postLockFrameNumber(int framenumber)
 {
-	(void) framenumber;
-	return false;
+	if ((framenumber < 0) || ((size_t)framenumber >= index_.size()))
+		return false;
+	nextFrame_ = framenumber;
+	return true;
+}
 
+
+// v2 files store the time each frame was captured
+long long ZMSIn::postLockTimeStamp(void) const
+{
+	if (index_.empty() || (nextFrame_ == 0))
+		return -1;
+	return index_[nextFrame_ - 1].timestamp;
 }
 
 
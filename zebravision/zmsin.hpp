@@ -8,11 +8,17 @@
 #include <boost/iostreams/filtering_streambuf.hpp>
 
 #include "portable_binary_iarchive.hpp"
+#include "zmsv2.hpp"
+#include "zmsreadahead.hpp"
 
 class ZMSIn : public SyncIn
 {
 	public:
-		ZMSIn(const char *inFileName = NULL, ZvSettings *settings = NULL);
+		// v2 files are decoded by readAheadThreads worker threads
+		// keeping up to readAheadDepth frames ready. 0 for
+		// either picks a default based on the number of CPUs
+		ZMSIn(const char *inFileName = NULL, ZvSettings *settings = NULL,
+				int readAheadThreads = 0, int readAheadDepth = 0);
 		~ZMSIn();
 
 		// Make class non-copyable
@@ -20,6 +26,7 @@ class ZMSIn : public SyncIn
 		ZMSIn& operator=(const ZMSIn& zmsin) = delete;
 
 		bool isOpened(void) const;
+		int frameCount(void) const;
 
 		CameraParams getCameraParams(void) const;
 
@@ -30,10 +37,13 @@ class ZMSIn : public SyncIn
 		// while postLock happens inside it
 		bool postLockUpdate(cv::Mat &frame, cv::Mat &depth);
 		bool postLockFrameNumber(int framenumber);
+		long long postLockTimeStamp(void) const;
 
 	private:
 		void deleteInputPointers(void);
 		bool openSerializeInput(const char *filename, bool portable);
+		bool openV2Input(const char *filename);
+		bool readV2Frame(size_t index, cv::Mat &frame, cv::Mat &depth);
 		void update(void);
 
 		// frame_ is the most recent frame grabbed from 
@@ -52,4 +62,13 @@ class ZMSIn : public SyncIn
 		boost::iostreams::filtering_streambuf<boost::iostreams::input> *filtSBIn_;
 		boost::archive::binary_iarchive *archiveIn_;
 		portable_binary_iarchive *portableArchiveIn_;
+
+		// v2 files are read directly from serializeIn_
+		// using the frame index at the end of the file.
+		// index_ is empty for v1 files
+		std::vector<ZMSIndexEntry> index_;
+		uint32_t                   formatVersion_;
+		size_t                     nextFrame_;
+		std::vector<char>          readBuf_;
+		ZMSReadAhead              *readAhead_;
 };
@@ -4,10 +4,8 @@
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include <boost/filesystem.hpp>
-#include <boost/iostreams/filter/zlib.hpp>
 
 #include "zmsout.hpp"
-#include "cvMatSerialize.hpp"
 
 using namespace std;
 using namespace cv;
@@ -16,70 +14,74 @@ using namespace boost::filesystem;
 // Save the raw camera stream to disk.  This uses a home-brew
 // method to serialize image and depth data to disk rather than
 // relying on Stereolab's SVO format.
-ZMSOut::ZMSOut(const char *outFile, int frameSkip) :
+ZMSOut::ZMSOut(const char *outFile, int frameSkip, const ZMSCodec &codec) :
 	MediaOut(frameSkip, 150),
 	fileName_(outFile),
-	serializeOut_(NULL),
-	filtSBOut_(NULL),
-	archiveOut_(NULL)
+	codec_(codec),
+	serializeOut_(NULL)
 {
 }
 
-// Clean up pointers, which will also 
-// close the files they point to
+// Finish up the current file, which
+// writes the index and closes it.  Wait for
+// the writer thread first so the last frame
+// makes it into the index
 ZMSOut::~ZMSOut()
 {
-	deleteOutputPointers();
+	sync();
+	closeOutput();
 }
 
-// Serialize the frame plus depth info
-bool ZMSOut::write(const Mat &frame, const Mat &depth)
+// Compress the frame plus depth info and append
+// it to the file, remembering where it went
+bool ZMSOut::write(const Mat &frame, const Mat &depth, long long timeStamp)
 {
-	if (!archiveOut_)
+	if (!serializeOut_)
 		return false;
+	if (!encode(frame, depth, encodeBuf_))
+		return false;
+	return writeEncoded(encodeBuf_, timeStamp);
+}
 
-	*archiveOut_ << frame << depth;
+// Each frame is compressed on its own, so several
+// writer threads can work on different frames at once
+bool ZMSOut::canEncode(void) const
+{
 	return true;
 }
 
+bool ZMSOut::encode(const Mat &frame, const Mat &depth, string &buf) const
+{
+	return zmsEncodeFrame(frame, depth, codec_, buf);
+}
 
-// Output needs 3 things. First is a standard ofstream to write to
-// Next is an (optional) filtered stream buffer. This is used to
-// compress on the fly - uncompressed files take up way too
-// much space. Last item is the actual boost binary archive template
-// If all three are opened, return true. If not, delete and set to
-// NULL all pointers related to serialized Output
-bool ZMSOut::openSerializeOutput(const char *fileName)
+// The index records when the frame was captured rather
+// than when it was written, which can be a queue's worth
+// of frames later. ZMSIn reports it as the frame's time
+bool ZMSOut::writeEncoded(const string &buf, long long timeStamp)
 {
-	deleteOutputPointers();
-	// First create an ofstream to write to
-	serializeOut_ = new ofstream(fileName, ios::out | ios::binary);
-	if (!serializeOut_ || !serializeOut_->is_open())
-	{
-		cerr << "Could not open ofstream(" << fileName << ")" << endl;
-		deleteOutputPointers();
+	if (!serializeOut_)
 		return false;
-	}
-	// Create a filtering streambuf.  Push zlib and then
-	// the ofstream created above so output is automatically
-	// compressed before writing to disk
-	filtSBOut_= new boost::iostreams::filtering_streambuf<boost::iostreams::output>;
-	if (!filtSBOut_)
-	{
-		cerr << "Could not create filtering_streambuf<output> in constructor" <<endl;
-		deleteOutputPointers();
+
+	ZMSIndexEntry entry;
+	if (!zmsWriteFrame(*serializeOut_, buf, timeStamp, entry))
 		return false;
-	}
-	filtSBOut_->push(boost::iostreams::zlib_compressor(boost::iostreams::zlib::best_speed));
-	filtSBOut_->push(*serializeOut_);
+	index_.push_back(entry);
+	return true;
+}
 
-	// Create an output archive which writes to the previously
-	// created output chain (zlib->output file path)
-	archiveOut_ = new portable_binary_oarchive(*filtSBOut_);
-	if (!archiveOut_)
+
+// Open the output file and write the header.
+// Frames are compressed one at a time in write() so
+// that readers can seek to any of them
+bool ZMSOut::openSerializeOutput(const char *fileName)
+{
+	closeOutput();
+	serializeOut_ = new ofstream(fileName, ios::out | ios::binary);
+	if (!serializeOut_ || !serializeOut_->is_open() || !zmsWriteHeader(*serializeOut_))
 	{
-		cerr << "Could not create binary_oarchive in constructor" <<endl;
-		deleteOutputPointers();
+		cerr << "Could not open ofstream(" << fileName << ")" << endl;
+		closeOutput();
 		return false;
 	}
 	return true;
@@ -102,22 +104,16 @@ bool ZMSOut::openNext(int fileCounter)
 }
 
 
-// Helper to easily delete and NULLize output file pointers
-void ZMSOut::deleteOutputPointers(void)
+// Write the frame index to the end of the current
+// file then close and NULL out the output pointer
+void ZMSOut::closeOutput(void)
 {
-	if (archiveOut_)
-	{
-		delete archiveOut_;
-		archiveOut_ = NULL;
-	}
-	if (filtSBOut_)
-	{
-		delete filtSBOut_;
-		filtSBOut_ = NULL;
-	}
 	if (serializeOut_)
 	{
+		if (serializeOut_->is_open())
+			zmsWriteIndex(*serializeOut_, index_);
 		delete serializeOut_;
 		serializeOut_ = NULL;
 	}
+	index_.clear();
 }
@@ -1,14 +1,18 @@
 #pragma once
-#include <portable_binary_oarchive.hpp>
-#include <boost/iostreams/filtering_streambuf.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
 #include "mediaout.hpp"
+#include "zmsv2.hpp"
 
 // Hack up a way to save zed data - serialize both
-// BGR frame and depth frame
+// BGR frame and depth frame.  Files are written in
+// the seekable format described in zmsv2.hpp with
+// frames compressed using codec (see zmscodec.hpp)
 class ZMSOut : public MediaOut
 {
 	public:
-		ZMSOut(const char *outFile, int frameSkip = 0);
+		ZMSOut(const char *outFile, int frameSkip = 0, const ZMSCodec &codec = ZMSCodec());
 		~ZMSOut();
 
 		// Make non-copyable
@@ -16,13 +20,24 @@ class ZMSOut : public MediaOut
 		ZMSOut &operator=(const ZMSOut &zmsout) = delete;
 	private :
 		bool openNext(int fileCounter);
-		void deleteOutputPointers(void);
+		void closeOutput(void);
 		bool openSerializeOutput(const char *filename);
-		bool write(const cv::Mat &frame, const cv::Mat &depth);
+		bool write(const cv::Mat &frame, const cv::Mat &depth, long long timeStamp);
+		bool canEncode(void) const;
+		bool encode(const cv::Mat &frame, const cv::Mat &depth, std::string &buf) const;
+		bool writeEncoded(const std::string &buf, long long timeStamp);
 
 		std::string fileName_;
+		ZMSCodec    codec_;
 
 		std::ofstream *serializeOut_;
-		boost::iostreams::filtering_streambuf<boost::iostreams::output> *filtSBOut_;
-		portable_binary_oarchive *archiveOut_;
+
+		// Location of each frame written to the
+		// current file. Written at the end of the
+		// file when it is closed
+		std::vector<ZMSIndexEntry> index_;
+
+		// Reused buffer for compressed frame data
+		// when there's only one writer thread
+		std::string encodeBuf_;
 };
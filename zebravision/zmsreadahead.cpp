@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "zmsreadahead.hpp"
+
+using namespace std;
+using namespace cv;
+
+static size_t defaultThreads(void)
+{
+	return max<size_t>(1, min<size_t>(boost::thread::hardware_concurrency() / 2, 4));
+}
+
+ZMSReadAhead::ZMSReadAhead(const string &fileName,
+		const vector<ZMSIndexEntry> &index,
+		uint32_t version,
+		size_t threads,
+		size_t depth) :
+	fileName_(fileName),
+	index_(index),
+	version_(version),
+	depth_(depth ? depth : 2 * (threads ? threads : defaultThreads())),
+	readPos_(0),
+	decodePos_(0),
+	generation_(0),
+	stop_(false)
+{
+	if (threads == 0)
+		threads = defaultThreads();
+	// No point in having more workers than frames
+	// they're allowed to decode at once
+	threads = min(threads, depth_);
+	for (size_t i = 0; i < threads; i++)
+		threads_.create_thread(boost::bind(&ZMSReadAhead::worker, this));
+}
+
+ZMSReadAhead::~ZMSReadAhead()
+{
+	{
+		boost::mutex::scoped_lock guard(mtx_);
+		stop_ = true;
+		spaceCond_.notify_all();
+		decodedCond_.notify_all();
+	}
+	threads_.join_all();
+}
+
+// Each worker grabs the next frame which hasn't been
+// started yet, reads and decodes it outside the lock,
+// then stores the result.  Frames more than depth_ past
+// the one the reader is waiting for aren't started until
+// the reader catches up
+void ZMSReadAhead::worker(void)
+{
+	ifstream in(fileName_.c_str(), ios::in | ios::binary);
+	vector<char> buf;
+	boost::mutex::scoped_lock guard(mtx_);
+	while (!stop_)
+	{
+		if ((decodePos_ >= index_.size()) || (decodePos_ >= (readPos_ + depth_)))
+		{
+			spaceCond_.wait(guard);
+			continue;
+		}
+		const size_t   frameNum   = decodePos_++;
+		const unsigned generation = generation_;
+		guard.unlock();
+
+		const ZMSIndexEntry &entry = index_[frameNum];
+		Decoded result;
+		buf.resize(entry.size);
+		in.clear();
+		in.seekg(entry.offset);
+		result.valid = in.read(buf.data(), entry.size) &&
+			zmsDecodeFrame(version_, buf.data(), entry.size, result.frame, result.depth);
+
+		guard.lock();
+		// Throw away results from before the last seek
+		if (generation == generation_)
+		{
+			decoded_[frameNum] = result;
+			decodedCond_.notify_all();
+		}
+	}
+}
+
+// Drop everything decoded so far and start
+// over at a new position in the file
+void ZMSReadAhead::restart(size_t frameNum)
+{
+	generation_ += 1;
+	decoded_.clear();
+	readPos_   = frameNum;
+	decodePos_ = frameNum;
+	spaceCond_.notify_all();
+}
+
+bool ZMSReadAhead::get(size_t frameNum, Mat &frame, Mat &depth)
+{
+	if (frameNum >= index_.size())
+		return false;
+
+	boost::mutex::scoped_lock guard(mtx_);
+	if (frameNum != readPos_)
+		restart(frameNum);
+
+	map<size_t, Decoded>::iterator it;
+	while ((it = decoded_.find(frameNum)) == decoded_.end())
+		decodedCond_.wait(guard);
+
+	const bool valid = it->second.valid;
+	frame = it->second.frame;
+	depth = it->second.depth;
+	decoded_.erase(it);
+
+	// Let workers start on the next frame
+	readPos_ = frameNum + 1;
+	spaceCond_.notify_all();
+	return valid;
+}
@@ -0,0 +1,69 @@
+// Parallel decoder for ZMS v2 files.
+// Each frame in a v2 file is compressed on its own, so
+// several can be inflated and deserialized at the same time.
+// A pool of worker threads decodes frames ahead of the one
+// the reader is waiting on.  At most depth decoded frames
+// exist at any time - workers wait rather than getting
+// further ahead than that - so memory use is bounded no
+// matter how fast the workers are compared to the reader.
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+#include <opencv2/core/core.hpp>
+
+#include "zmsv2.hpp"
+
+class ZMSReadAhead
+{
+	public:
+		// Workers each open their own copy of fileName so
+		// reads don't need to be serialized. threads and depth
+		// of 0 pick defaults based on the number of CPUs
+		ZMSReadAhead(const std::string &fileName,
+				const std::vector<ZMSIndexEntry> &index,
+				uint32_t version,
+				size_t threads = 0,
+				size_t depth = 0);
+		~ZMSReadAhead();
+
+		// Make non-copyable
+		ZMSReadAhead(const ZMSReadAhead &zmsreadahead) = delete;
+		ZMSReadAhead &operator=(const ZMSReadAhead &zmsreadahead) = delete;
+
+		// Get frame number frameNum, waiting for it to be
+		// decoded if needed.  Asking for anything other than
+		// the frame after the previous one restarts read-ahead
+		// from the new position.  Returns false past the end
+		// of the file or if the frame can't be decoded
+		bool get(size_t frameNum, cv::Mat &frame, cv::Mat &depth);
+
+	private:
+		struct Decoded
+		{
+			bool    valid;
+			cv::Mat frame;
+			cv::Mat depth;
+		};
+
+		void worker(void);
+		void restart(size_t frameNum);
+
+		const std::string                fileName_;
+		const std::vector<ZMSIndexEntry> index_;
+		const uint32_t                   version_;
+		const size_t                     depth_;
+
+		boost::mutex              mtx_;
+		boost::condition_variable decodedCond_;  // signalled when a frame is decoded
+		boost::condition_variable spaceCond_;    // signalled when a slot is freed
+
+		size_t                    readPos_;     // next frame get() expects to return
+		size_t                    decodePos_;   // next frame for a worker to start on
+		unsigned                  generation_;  // bumped on restart to discard stale work
+		bool                      stop_;
+		std::map<size_t, Decoded> decoded_;     // finished frames, keyed by frame number
+		boost::thread_group       threads_;
+};
@@ -0,0 +1,187 @@
+#include <cstring>
+#include <iostream>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "zmsv2.hpp"
+#include "portable_binary_iarchive.hpp"
+#include "cvMatSerialize.hpp"
+
+using namespace std;
+using namespace cv;
+
+static const char     headerMagic[4]  = {'Z', 'M', 'S', '2'};
+static const char     trailerMagic[4] = {'Z', 'M', 'S', 'I'};
+static const uint32_t archiveVersion  = 2; // frames are zlib compressed archives
+static const uint32_t formatVersion   = 3; // frames are written by zmsCodecEncode
+static const size_t   headerSize      = 8;
+static const size_t   frameHeaderSize = 16;
+static const size_t   indexEntrySize  = 24;
+static const size_t   trailerSize     = 20;
+
+// Fixed size little endian integers, independent
+// of the byte order of the machine
+static void putLE(unsigned char *p, uint64_t v, size_t bytes)
+{
+	for (size_t i = 0; i < bytes; i++)
+		p[i] = (v >> (8 * i)) & 0xff;
+}
+
+static uint64_t getLE(const unsigned char *p, size_t bytes)
+{
+	uint64_t v = 0;
+	for (size_t i = 0; i < bytes; i++)
+		v |= (uint64_t)p[i] << (8 * i);
+	return v;
+}
+
+bool zmsWriteHeader(ostream &os)
+{
+	unsigned char buf[headerSize];
+	memcpy(buf, headerMagic, sizeof(headerMagic));
+	putLE(buf + 4, formatVersion, 4);
+	os.write((const char *)buf, sizeof(buf));
+	return os.good();
+}
+
+bool zmsReadHeader(istream &is, uint32_t &version)
+{
+	unsigned char buf[headerSize];
+	if (!is.read((char *)buf, sizeof(buf)))
+		return false;
+	version = getLE(buf + 4, 4);
+	return (memcmp(buf, headerMagic, sizeof(headerMagic)) == 0) &&
+		   (version >= archiveVersion) && (version <= formatVersion);
+}
+
+bool zmsEncodeFrame(const Mat &frame, const Mat &depth, const ZMSCodec &codec, string &buf)
+{
+	return zmsCodecEncode(frame, depth, codec, buf);
+}
+
+bool zmsDecodeFrame(uint32_t version, const char *data, size_t size, Mat &frame, Mat &depth)
+{
+	if (version != archiveVersion)
+	{
+		if (zmsCodecDecode(data, size, frame, depth))
+			return true;
+		cerr << "ZMS : could not decode frame" << endl;
+		return false;
+	}
+	try
+	{
+		boost::iostreams::filtering_istream is;
+		is.push(boost::iostreams::zlib_decompressor());
+		is.push(boost::iostreams::array_source(data, size));
+		portable_binary_iarchive archive(is);
+		archive >> frame >> depth;
+	}
+	catch (const std::exception &e)
+	{
+		cerr << "ZMS : could not decode frame : " << e.what() << endl;
+		return false;
+	}
+	return true;
+}
+
+bool zmsWriteFrame(ostream &os, const string &buf, long long timestamp, ZMSIndexEntry &entry)
+{
+	unsigned char header[frameHeaderSize];
+	putLE(header, buf.size(), 8);
+	putLE(header + 8, timestamp, 8);
+	os.write((const char *)header, sizeof(header));
+
+	entry.offset    = os.tellp();
+	entry.size      = buf.size();
+	entry.timestamp = timestamp;
+	os.write(buf.data(), buf.size());
+	return os.good();
+}
+
+bool zmsWriteIndex(ostream &os, const vector<ZMSIndexEntry> &index)
+{
+	const uint64_t indexOffset = os.tellp();
+	unsigned char buf[indexEntrySize];
+	for (auto it = index.cbegin(); it != index.cend(); ++it)
+	{
+		putLE(buf,      it->offset, 8);
+		putLE(buf + 8,  it->size, 8);
+		putLE(buf + 16, it->timestamp, 8);
+		os.write((const char *)buf, sizeof(buf));
+	}
+	unsigned char trailer[trailerSize];
+	putLE(trailer,     indexOffset, 8);
+	putLE(trailer + 8, index.size(), 8);
+	memcpy(trailer + 16, trailerMagic, sizeof(trailerMagic));
+	os.write((const char *)trailer, sizeof(trailer));
+	return os.good();
+}
+
+bool zmsReadIndex(istream &is, vector<ZMSIndexEntry> &index)
+{
+	index.clear();
+	is.clear();
+	is.seekg(0, ios::end);
+	const uint64_t fileSize = is.tellg();
+	if (fileSize < headerSize + trailerSize)
+		return false;
+
+	unsigned char trailer[trailerSize];
+	is.seekg(fileSize - trailerSize);
+	if (!is.read((char *)trailer, sizeof(trailer)) ||
+		(memcmp(trailer + 16, trailerMagic, sizeof(trailerMagic)) != 0))
+		return false;
+
+	const uint64_t indexOffset = getLE(trailer, 8);
+	const uint64_t frameCount  = getLE(trailer + 8, 8);
+	if ((indexOffset + frameCount * indexEntrySize + trailerSize) != fileSize)
+		return false;
+
+	vector<unsigned char> buf(frameCount * indexEntrySize);
+	is.seekg(indexOffset);
+	if (frameCount && !is.read((char *)&buf[0], buf.size()))
+		return false;
+	index.resize(frameCount);
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		const unsigned char *p = &buf[i * indexEntrySize];
+		index[i].offset    = getLE(p, 8);
+		index[i].size      = getLE(p + 8, 8);
+		index[i].timestamp = getLE(p + 16, 8);
+		if ((index[i].offset + index[i].size) > indexOffset)
+		{
+			index.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool zmsScanIndex(istream &is, vector<ZMSIndexEntry> &index)
+{
+	index.clear();
+	is.clear();
+	is.seekg(0, ios::end);
+	const uint64_t fileSize = is.tellg();
+	uint64_t pos = headerSize;
+	unsigned char header[frameHeaderSize];
+	while ((pos + frameHeaderSize) <= fileSize)
+	{
+		is.seekg(pos);
+		if (!is.read((char *)header, sizeof(header)))
+			break;
+		ZMSIndexEntry entry;
+		entry.offset    = pos + frameHeaderSize;
+		entry.size      = getLE(header, 8);
+		entry.timestamp = getLE(header + 8, 8);
+		// A partially written frame at the end of
+		// the file is dropped
+		if ((entry.offset + entry.size) > fileSize)
+			break;
+		index.push_back(entry);
+		pos = entry.offset + entry.size;
+	}
+	is.clear();
+	return !index.empty();
+}
@@ -0,0 +1,64 @@
+// Version 2 of the ZMS file format.
+// Version 1 files are a single zlib stream of serialized
+// frame + depth Mats, which means they can only be read
+// start to finish.  Version 2 compresses each frame separately
+// and adds an index at the end of the file so readers can
+// jump directly to any frame.
+//
+// Layout :
+//   "ZMS2" magic, uint32 version
+//   frame 0 : uint64 size, int64 timestamp, then size bytes of
+//             frame data.  For version 2 files this is a zlib
+//             compressed portable archive of frame, depth.
+//             Version 3 files use the codecs in zmscodec.hpp
+//   frame 1 : ...
+//   index   : for each frame, uint64 offset, uint64 size, int64 timestamp
+//   trailer : uint64 index offset, uint64 frame count, "ZMSI" magic
+// All integers are little endian
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "zmscodec.hpp"
+
+struct ZMSIndexEntry
+{
+	uint64_t  offset;    // start of compressed frame data in the file
+	uint64_t  size;      // bytes of compressed frame data
+	long long timestamp; // capture time, usec
+};
+
+// Write the file header. Returns false on error
+bool zmsWriteHeader(std::ostream &os);
+
+// Check for the header at the current read position and
+// return the format version of the file
+bool zmsReadHeader(std::istream &is, uint32_t &version);
+
+// Compress a frame and depth Mat into buf using codec.
+// Returns false on error
+bool zmsEncodeFrame(const cv::Mat &frame, const cv::Mat &depth, const ZMSCodec &codec, std::string &buf);
+
+// Uncompress frame and depth from a buffer read from a file
+// with the given format version. Returns false if the data is corrupt
+bool zmsDecodeFrame(uint32_t version, const char *data, size_t size, cv::Mat &frame, cv::Mat &depth);
+
+// Write a frame encoded by zmsEncodeFrame at the current
+// position in the file. Fills in entry with its location
+bool zmsWriteFrame(std::ostream &os, const std::string &buf, long long timestamp, ZMSIndexEntry &entry);
+
+// Append the index and trailer to the end of the file
+bool zmsWriteIndex(std::ostream &os, const std::vector<ZMSIndexEntry> &index);
+
+// Read the index using the trailer at the end of the file.
+// Returns false if it is missing - e.g. the file wasn't closed cleanly
+bool zmsReadIndex(std::istream &is, std::vector<ZMSIndexEntry> &index);
+
+// Rebuild the index for a file without one by walking the frames
+// from the start of the file. Used to recover files from runs
+// which crashed before closing their output
+bool zmsScanIndex(std::istream &is, std::vector<ZMSIndexEntry> &index);
@@ -6,6 +6,8 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <signal.h>
+#include <atomic>
+#include <limits>
 
 #include <boost/filesystem.hpp>
 #include <zmq.hpp>
@@ -34,6 +36,7 @@
 #include "ZvSettings.hpp"
 #include "version.hpp"
 #include "colormap.hpp"
+#include "boundedqueue.hpp"
 
 using namespace std;
 using namespace cv;
@@ -45,16 +48,17 @@ using namespace cv::cuda;
 #endif
 
 //function prototypes
-void sendZMQData(size_t objectCount, zmq::socket_t& publisher, const vector<TrackedObjectDisplay>& displayList, const GoalDetector& gd, long long timestamp);
+void sendZMQData(size_t objectCount, zmq::socket_t& publisher, const vector<TrackedObjectDisplay>& displayList, float goalDist, float goalAngle, long long timestamp);
 void writeImage(const Mat& frame, const vector<Rect>& rects, size_t index, const char *path, int frameNumber);
 string getDateTimeString(void);
 void drawRects(Mat image, const vector<Rect> &detectRects, Scalar rectColor = Scalar(0,0,255), bool text = true);
 void drawTrackingInfo(Mat &frame, const vector<TrackedObjectDisplay> &displayList, const vector<vector<Point>> &posHist);
 void drawTrackingTopDown(Mat &frame, const vector<TrackedObjectDisplay> &displayList);
-bool openMedia(const string &readFileName, bool gui, const string &xmlFilename, MediaIn *&cap, string &capPath, string &windowName);
+bool openMedia(const string &readFileName, bool gui, const string &xmlFilename, const Args &args, MediaIn *&cap, string &capPath, string &windowName);
 string getVideoOutName(bool raw, const char *suffix);
 
-static bool isRunning = true;
+// Shared with the pipeline threads as well as the signal handler
+static atomic<bool> isRunning(true);
 static ZvSettings *zvSettings = NULL;
 
 void my_handler(int s)
@@ -169,6 +173,509 @@ void drawTrackingTopDown(Mat& frame, const vector<TrackedObjectDisplay>& display
     }
 }
 
+// Look up a depth for each detected rectangle.  Rects which
+// end up without a usable depth are dropped.
+void depthFilterDetects(const vector<Rect> &detectRects, const Mat &depth, const Size &frameSize, float hfov,
+		vector<Rect> &depthFilteredDetectRects, vector<float> &depths, vector<ObjectType> &objTypes)
+{
+	const float depthRectScale = 0.2;
+	for(auto it = detectRects.cbegin(); it != detectRects.cend(); ++it)
+	{
+		//cout << "Detected object at: " << *it;
+		Rect depthRect = *it;
+
+		//when we use optical flow to adjust we need to recompute the depth based on the new locations.
+		//to do this shrink the bounding rectangle and take the minimum rect of the inside
+		shrinkRect(depthRect,depthRectScale);
+		Mat emptyMask(depth.rows,depth.cols,CV_8UC1,Scalar(255));
+		float objectDepth = minOfDepthMat(depth, emptyMask, depthRect, 10).first;
+
+		// If no depth data is available, calculate a fake
+		// depth value as if the object were at the perfect
+		// location for the detected rectangle size
+		if (objectDepth < 0)
+		{
+			objectDepth = ObjectType(1).expectedDepth(*it, frameSize, hfov);
+		}
+		//cout << " Depth: " << objectDepth << endl;
+		if (objectDepth > 0)
+		{
+			depthFilteredDetectRects.push_back(*it);
+			depths.push_back(objectDepth);
+			objTypes.push_back(ObjectType(1));
+		}
+	}
+}
+
+// Regions to search on frames between full frame detects.
+// This is the area around where each tracked object should
+// show up plus any part of the frame which the camera has
+// just moved to - new objects can only appear there.
+// Search windows near tracked objects are limited to sizes
+// close to the object's predicted size
+void buildDetectROIs(const TrackedObjectList &trackList, const FlowLocalizer &fllc,
+		const Size &frameSize, vector<DetectROI> &rois)
+{
+	rois.clear();
+	const Rect frameRect(Point(0, 0), frameSize);
+
+	vector<Rect> predicted;
+	trackList.getPredictedScreenRects(fllc.transform_mat(), predicted);
+	for (auto it = predicted.cbegin(); it != predicted.cend(); ++it)
+	{
+		const int size   = max(it->width, it->height);
+		const int margin = size / 2 + 8;
+		DetectROI roi;
+		roi.area    = Rect(it->x - margin, it->y - margin, it->width + 2 * margin, it->height + 2 * margin) & frameRect;
+		roi.minSize = size * 0.6;
+		roi.maxSize = size * 1.6;
+		if (roi.area.area() > 0)
+			rois.push_back(roi);
+	}
+
+	const vector<Rect> exposed = fllc.exposedRegions();
+	for (auto it = exposed.cbegin(); it != exposed.cend(); ++it)
+	{
+		DetectROI roi;
+		roi.area    = *it & frameRect;
+		roi.minSize = 0;
+		roi.maxSize = numeric_limits<double>::max();
+		if (roi.area.area() > 0)
+			rois.push_back(roi);
+	}
+}
+
+// Data handed between stages of the threaded pipeline.
+// id is a sequential capture index used to line up the
+// results of stages which run side by side on the same
+// input frame. An id of -1 marks the end of the input.
+struct PipelineFrame
+{
+	int           id;
+	int           frameNumber;
+	long long     timeStamp;
+	MediaFramePtr media; // keeps frame & depth from being reused by the input
+	Mat           frame;
+	Mat           depth;
+};
+
+struct PipelineGoal
+{
+	int     id;
+	Rect    rect;
+	Point3f pos;
+	float   dist;
+	float   angle;
+};
+
+struct PipelineFlow
+{
+	int id;
+	Mat transform;
+};
+
+struct PipelineDetect
+{
+	int            id;
+	PipelineFrame  in;
+	vector<Rect>   detectRects;
+	vector<Rect>   uncalibDetectRects;
+	string         debugInfo;
+	string         detectorName;
+};
+
+struct PipelineTrack
+{
+	PipelineDetect               detect;
+	PipelineGoal                 goal;
+	vector<TrackedObjectDisplay> displayList;
+	vector<Rect>                 groundTruthHitList;
+	vector<Rect>                 goalTruthHitList;
+};
+
+// Run each step of the per-frame processing in its own thread.
+// Capture feeds goal detect, optical flow and NN detection,
+// which all run in parallel on the same frame. Tracking / ZMQ
+// publishing lines their results back up by frame id, and
+// display happens in this (the main) thread so highgui is happy.
+// In latency mode the queues in front of the parallel stages
+// throw out the oldest waiting frame when full, so each stage
+// always works on the freshest input.  In throughput mode every
+// stage blocks instead, guaranteeing every frame gets processed.
+void runPipeline(Args &args, MediaIn *cap, const Mat &firstFrame, const Mat &firstDepth,
+		DetectState *detectState, FlowLocalizer &fllc, GoalDetector &gd,
+		TrackedObjectList &objectTrackingList, zmq::socket_t &publisher,
+		size_t netTableArraySize, MediaOut *rawOut, MediaOut *processedOut,
+		GroundTruth &groundTruth, GroundTruth &goalTruth,
+		const CameraParams &camParams, const string &capPath, const string &windowName)
+{
+	const BoundedQueuePolicy inPolicy = (args.pipeline == PIPELINE_LATENCY) ? BQ_DROP_OLDEST : BQ_BLOCK;
+	const size_t queueDepth = args.pipelineDepth;
+
+	BoundedQueue<PipelineFrame>  goalInQ(queueDepth, inPolicy);
+	BoundedQueue<PipelineFrame>  flowInQ(queueDepth, inPolicy);
+	BoundedQueue<PipelineFrame>  detectInQ(queueDepth, inPolicy);
+	BoundedQueue<PipelineGoal>   goalOutQ(queueDepth);
+	BoundedQueue<PipelineFlow>   flowOutQ(queueDepth);
+	BoundedQueue<PipelineDetect> detectOutQ(queueDepth);
+	BoundedQueue<PipelineTrack>  renderQ(queueDepth, inPolicy);
+
+	// Toggled from the display loop, read by the detect thread
+	atomic<bool> filterUsingDepth(args.filterUsingDepth);
+
+	// Capture - grab frames, save raw video, fan out to
+	// the parallel processing stages
+	boost::thread captureThread([&]()
+	{
+		PipelineFrame pf;
+		pf.id          = 0;
+		pf.frameNumber = cap->frameNumber();
+		pf.timeStamp   = cap->timeStamp();
+		// The caller already read the first frame. Asking
+		// for it again while paused gets it as a handle
+		if (cap->getFrame(pf.media, true))
+		{
+			pf.frame = pf.media->frame;
+			pf.depth = pf.media->depth;
+		}
+		else
+		{
+			pf.frame = firstFrame;
+			pf.depth = firstDepth;
+		}
+		while (isRunning)
+		{
+			if (rawOut)
+			{
+				if (pf.media)
+					rawOut->saveFrame(pf.media);
+				else
+					rawOut->saveFrame(pf.frame, pf.depth, pf.timeStamp);
+			}
+
+			if (!goalInQ.push(pf) || !flowInQ.push(pf) || !detectInQ.push(pf))
+				return;
+
+			// Still images only need to be processed once
+			if (args.batchMode && (cap->frameCount() == 1))
+				break;
+
+			if (args.skip > 0)
+			{
+				if ((cap->frameNumber() + args.skip) >= cap->frameCount())
+					break;
+				cap->frameNumber(cap->frameNumber() + args.skip);
+			}
+
+			// Each frame comes in its own buffer - the
+			// old ones are still referenced by frames in
+			// the queues.  Stages only read from them
+			if (!cap->getFrame(pf.media))
+				break;
+			pf.id         += 1;
+			pf.frameNumber = cap->frameNumber();
+			pf.timeStamp   = cap->timeStamp();
+			pf.frame       = pf.media->frame;
+			pf.depth       = pf.media->depth;
+		}
+		PipelineFrame end;
+		end.id = -1;
+		goalInQ.push(end);
+		flowInQ.push(end);
+		detectInQ.push(end);
+	});
+
+	boost::thread goalThread([&]()
+	{
+		PipelineFrame pf;
+		while (goalInQ.pop(pf))
+		{
+			PipelineGoal pg;
+			pg.id = pf.id;
+			if (pf.id >= 0)
+			{
+				gd.processFrame(pf.frame, pf.depth);
+				pg.rect  = gd.goal_rect();
+				pg.pos   = gd.goal_pos();
+				pg.dist  = gd.dist_to_goal();
+				pg.angle = gd.angle_to_goal();
+			}
+			if (!goalOutQ.push(pg) || (pf.id < 0))
+				break;
+		}
+	});
+
+	boost::thread flowThread([&]()
+	{
+		PipelineFrame pf;
+		while (flowInQ.pop(pf))
+		{
+			PipelineFlow pfl;
+			pfl.id = pf.id;
+			if (pf.id >= 0)
+			{
+				if (detectState)
+					fllc.processFrame(pf.frame);
+				pfl.transform = detectState ? fllc.transform_mat() : Mat::eye(3, 3, CV_64FC1);
+			}
+			if (!flowOutQ.push(pfl) || (pf.id < 0))
+				break;
+		}
+	});
+
+	boost::thread detectThread([&]()
+	{
+		PipelineFrame pf;
+		while (detectInQ.pop(pf))
+		{
+			PipelineDetect pd;
+			pd.id = pf.id;
+			pd.in = pf;
+			if ((pf.id >= 0) && detectState)
+			{
+				// Classifier reloads happen here, off the capture
+				// and display threads
+				if (!detectState->update())
+				{
+					isRunning = false;
+					pd.id = -1;
+				}
+				else
+				{
+					detectState->detector()->setWindowBudget(args.d12WindowBudget);
+					detectState->detector()->Detect(pf.frame, filterUsingDepth ? pf.depth : Mat(), pd.detectRects, pd.uncalibDetectRects);
+					stringstream s;
+					vector<size_t> debugInfo = detectState->detector()->DebugInfo();
+					for (auto it = debugInfo.cbegin(); it != debugInfo.cend(); ++it)
+					{
+						s << *it;
+						if ((it + 1) != debugInfo.cend())
+							s << " / ";
+					}
+					pd.debugInfo = s.str();
+					pd.detectorName = detectState->print();
+				}
+			}
+			if (!detectOutQ.push(pd) || (pd.id < 0))
+				break;
+		}
+	});
+
+	// Track / publish - join results from the parallel stages,
+	// update tracked objects and send data over ZMQ
+	boost::thread trackThread([&]()
+	{
+		PipelineGoal   pg;
+		PipelineFlow   pfl;
+		PipelineDetect pd;
+		// Optical flow from frames which were dropped by
+		// other stages is accumulated here so tracked objects
+		// still see the full camera motion
+		Mat pendingFlow = Mat::eye(3, 3, CV_64FC1);
+		if (!goalOutQ.pop(pg) || !flowOutQ.pop(pfl) || !detectOutQ.pop(pd))
+			return;
+		while (true)
+		{
+			// Line up all three stages on the same frame.
+			// End of input (id == -1) sorts after everything else
+			bool good = true;
+			while (good && (pg.id >= 0) && (pfl.id >= 0) && (pd.id >= 0) &&
+				   ((pg.id != pfl.id) || (pg.id != pd.id)))
+			{
+				const int target = max(pg.id, max(pfl.id, pd.id));
+				while (good && (pg.id >= 0) && (pg.id < target))
+					good = goalOutQ.pop(pg);
+				while (good && (pfl.id >= 0) && (pfl.id < target))
+				{
+					pendingFlow = pfl.transform * pendingFlow;
+					good = flowOutQ.pop(pfl);
+				}
+				while (good && (pd.id >= 0) && (pd.id < target))
+					good = detectOutQ.pop(pd);
+			}
+			if (!good || (pg.id < 0) || (pfl.id < 0) || (pd.id < 0))
+				break;
+
+			if (detectState)
+				objectTrackingList.adjustLocation(pfl.transform * pendingFlow);
+			pendingFlow = Mat::eye(3, 3, CV_64FC1);
+
+			vector<Rect> depthFilteredDetectRects;
+			vector<float> depths;
+			vector<ObjectType> objTypes;
+			depthFilterDetects(pd.detectRects, pd.in.depth, pd.in.frame.size(), camParams.fov.x,
+					depthFilteredDetectRects, depths, objTypes);
+			objectTrackingList.processDetect(depthFilteredDetectRects, depths, objTypes);
+
+			PipelineTrack pt;
+			pt.detect = pd;
+			pt.goal   = pg;
+			objectTrackingList.getDisplay(pt.displayList);
+
+			sendZMQData(detectState ? netTableArraySize : 0, publisher, pt.displayList, pg.dist, pg.angle, pd.in.timeStamp);
+
+			if (cap->frameCount() >= 0)
+			{
+				vector<Rect> goalDetects;
+				goalDetects.push_back(pg.rect);
+				pt.goalTruthHitList   = goalTruth.processFrame(pd.in.frameNumber, goalDetects);
+				pt.groundTruthHitList = groundTruth.processFrame(pd.in.frameNumber, pd.detectRects);
+			}
+
+			if (!renderQ.push(pt))
+				return;
+
+			if (!goalOutQ.pop(pg) || !flowOutQ.pop(pfl) || !detectOutQ.pop(pd))
+				break;
+		}
+		PipelineTrack end;
+		end.detect.id = -1;
+		renderQ.push(end);
+	});
+
+	// Render - runs in the main thread
+	FrameTicker frameTicker;
+	Mat top_frame;
+	PipelineTrack pt;
+	while (renderQ.pop(pt) && (pt.detect.id >= 0))
+	{
+		frameTicker.mark();
+		Mat frame = pt.detect.in.frame;
+		const int frameNumber = pt.detect.in.frameNumber;
+
+		if (args.captureAll)
+			for (size_t index = 0; index < pt.detect.detectRects.size(); index++)
+				writeImage(frame, pt.detect.detectRects, index, capPath.c_str(), frameNumber);
+
+		stringstream fpsStr;
+		if (frameTicker.valid())
+		{
+			float inFPS = cap->FPS();
+			float outFPS = rawOut ? rawOut->FPS(): -1;
+			if (inFPS > 0)
+				fpsStr << fixed << setprecision(1) << inFPS << "G ";
+			fpsStr << fixed << setprecision(2) << frameTicker.getFPS() << "M";
+			if (outFPS > 0)
+				fpsStr << " " << fixed << setprecision(1) << outFPS << "W";
+			fpsStr << " FPS";
+			if (args.pipeline == PIPELINE_LATENCY)
+			{
+				const size_t dropped = goalInQ.dropped() + flowInQ.dropped() +
+					detectInQ.dropped() + goalOutQ.dropped() + flowOutQ.dropped() +
+					detectOutQ.dropped() + renderQ.dropped();
+				fpsStr << " " << dropped << " dropped";
+			}
+			if (args.batchMode)
+			{
+				stringstream frameStr;
+				frameStr << frameNumber;
+				if (cap->frameCount() > 0)
+					frameStr << '/' << cap->frameCount();
+				cerr << args.inputName << " : " << frameStr.str() << " : " << fpsStr.str() << endl;
+			}
+		}
+
+		if (args.batchMode && !(args.saveVideo && processedOut))
+			continue;
+
+		// Frame is shared with the other stages, draw
+		// on a private copy
+		frame = frame.clone();
+		putText(frame, fpsStr.str(), Point(frame.cols - 14 * fpsStr.str().length(), 20), FONT_HERSHEY_PLAIN, 1.5, Scalar(0,0,255));
+		if (args.rects)
+		{
+			drawRects(frame, pt.detect.detectRects);
+			drawRects(frame, groundTruth.get(frameNumber - 1), Scalar(128, 0, 0), false);
+			drawRects(frame, pt.groundTruthHitList, Scalar(128, 128, 128), false);
+			drawRects(frame, goalTruth.get(frameNumber - 1), Scalar(0, 0, 128), false);
+			drawRects(frame, pt.goalTruthHitList, Scalar(128, 128, 128), false);
+			rectangle(frame, pt.goal.rect, Scalar(0, 255, 0));
+		}
+		if (args.tracking)
+			drawTrackingInfo(frame, pt.displayList, vector<vector<Point>>());
+		if (args.captureAll)
+			putText(frame, "A", Point(25,25), FONT_HERSHEY_PLAIN, 2, Scalar(0, 255, 255));
+		if (filterUsingDepth)
+			putText(frame, "D", Point(50,25), FONT_HERSHEY_PLAIN, 2, Scalar(0, 0, 255));
+		if (detectState)
+		{
+			putText(frame, pt.detect.debugInfo,
+					Point(0, frame.rows - 28), FONT_HERSHEY_PLAIN,
+					1.5, Scalar(0,0,255));
+			putText(frame, pt.detect.detectorName,
+					Point(0, frame.rows - 8), FONT_HERSHEY_PLAIN,
+					1.5, Scalar(0,0,255));
+		}
+		if (args.calibrate)
+		{
+			line (frame, Point(frame.cols/2, 0) , Point(frame.cols/2, frame.rows), Scalar(255,255,0));
+			line (frame, Point(0, frame.rows/2) , Point(frame.cols, frame.rows/2), Scalar(255,255,0));
+		}
+
+		if (args.saveVideo && processedOut)
+		{
+			WriteOnFrame textWriter;
+			textWriter.writeTime(frame);
+			textWriter.writeMatchNumTime(frame);
+			processedOut->sync();
+			processedOut->saveFrame(frame, pt.detect.in.depth, pt.detect.in.timeStamp);
+		}
+
+		if (!args.batchMode)
+		{
+			vector<TrackedObjectDisplay> emptyDisplayList;
+			drawTrackingTopDown(top_frame, args.tracking ? pt.displayList : emptyDisplayList, pt.goal.pos);
+			imshow("Top view", top_frame);
+			imshow(windowName, frame);
+
+			// Only a subset of the interactive commands make
+			// sense when frames are in flight in other threads
+			char c = waitKey(5);
+			if ((c == 'q') || (c == 27))
+				break;
+			else if (c == 't')
+				args.tracking = !args.tracking;
+			else if (c == 'r')
+				args.rects = !args.rects;
+			else if (c == 'd')
+			{
+				args.filterUsingDepth = !args.filterUsingDepth;
+				filterUsingDepth = args.filterUsingDepth;
+			}
+		}
+	}
+
+	// Shut down the rest of the pipeline
+	isRunning = false;
+	goalInQ.close();
+	flowInQ.close();
+	detectInQ.close();
+	goalOutQ.close();
+	flowOutQ.close();
+	detectOutQ.close();
+	renderQ.close();
+	captureThread.join();
+	goalThread.join();
+	flowThread.join();
+	detectThread.join();
+	trackThread.join();
+}
+
+// Finish writing out any queued frames, then report how
+// many made it to disk.  Used to pick write queue settings
+// which keep up with the camera
+void closeVideoOut(const char *name, MediaOut *out)
+{
+	if (!out)
+		return;
+	out->sync();
+	const MediaOutStats stats = out->stats();
+	cout << name << " video : " << stats.enqueued << " frames queued, "
+		<< stats.written << " written, " << stats.dropped << " dropped, "
+		<< stats.failed << " failed, queue high water " << stats.highWater << endl;
+	delete out;
+}
+
 int main( int argc, const char** argv )
 {
 	// Flags for various UI features
@@ -188,7 +695,6 @@ int main( int argc, const char** argv )
 
 	bool pause = !args.batchMode && args.pause;
 	bool calibRects = false;
-	bool filterUsingDepth = false;
 	bool showTrackingHistory = false;
 
 	//stuff to handle ctrl+c and escape gracefully
@@ -203,7 +709,7 @@ int main( int argc, const char** argv )
 	MediaIn* cap; //input object
 
 	shared_ptr<tinyxml2::XMLDocument> capSettings;
-	if (!openMedia(args.inputName, !args.batchMode, args.xmlFilename, cap, capPath, windowName))
+	if (!openMedia(args.inputName, !args.batchMode, args.xmlFilename, args, cap, capPath, windowName))
 	{
 		cerr << "Could not open input file " << args.inputName << endl;
 		return 0;
@@ -266,6 +772,7 @@ int main( int argc, const char** argv )
 
 	// Create list of tracked objects
 	TrackedObjectList objectTrackingList(Size(cap->width(),cap->height()), camParams.fov);
+	objectTrackingList.setAssignmentMethod(args.trackSolver);
 
 	zmq::context_t context(1);
 	zmq::socket_t publisher(context, ZMQ_PUB);
@@ -290,7 +797,7 @@ int main( int argc, const char** argv )
 				ClassifierIO(args.d24BaseDir, args.d24DirNum, args.d24StageNum),
 				ClassifierIO(args.c12BaseDir, args.c12DirNum, args.c12StageNum),
 				ClassifierIO(args.c24BaseDir, args.c24DirNum, args.c24StageNum),
-				camParams.fov.x, hasGPU, false, ObjectType(1));
+				camParams.fov.x, hasGPU, false, ObjectType(1), args.batchTune);
 	}
 
 	// Find the first frame number which has ground truth data
@@ -312,7 +819,7 @@ int main( int argc, const char** argv )
 		if (depth.empty())
 			rawOut = new AVIOut(getVideoOutName(true, ".avi").c_str(), frame.size(), args.writeVideoSkip);
 		else
-			rawOut = new ZMSOut(getVideoOutName(true, ".zms").c_str(), args.writeVideoSkip);
+			rawOut = new ZMSOut(getVideoOutName(true, ".zms").c_str(), args.writeVideoSkip, args.zmsCodec);
 	}
 
 	// No point in saving ZMS files of processed output, since
@@ -330,27 +837,53 @@ int main( int argc, const char** argv )
 		else
 			processedOut = new AVIOut(getVideoOutName(false, ".avi").c_str(), frame.size(), args.saveVideoSkip);
 	}
+	if (rawOut)
+		rawOut->setWriteQueue(args.writeQueueDepth, args.writePolicy, args.writeThreads);
+	if (processedOut)
+		processedOut->setWriteQueue(args.writeQueueDepth, args.writePolicy, args.writeThreads);
 
 	//FovisLocalizer fvlc(cap->getCameraParams(), frame);
 
 	//Creating optical flow computation object
-	FlowLocalizer fllc(frame);
+	FlowLocalizer fllc(frame, args.flowTrack, args.flowScale);
 
 	//Creating Goaldetection object
 	GoalDetector gd(camParams.fov, Size(cap->width(),cap->height()), !args.batchMode);
 
+	// Ground truth mode jumps around the input from
+	// the main loop, so it always runs serially
+	if (args.groundTruth && (args.pipeline != PIPELINE_OFF))
+	{
+		cerr << "--groundTruth not supported with --pipeline, running serially" << endl;
+		args.pipeline = PIPELINE_OFF;
+	}
+	if ((args.fullDetectInterval > 1) && (args.pipeline != PIPELINE_OFF))
+		cerr << "--fullDetect needs tracking results from the previous frame, ignored with --pipeline" << endl;
+	if (args.pipeline != PIPELINE_OFF)
+		runPipeline(args, cap, frame, depth, detectState, fllc, gd,
+				objectTrackingList, publisher, netTableArraySize,
+				rawOut, processedOut, groundTruth, goalTruth,
+				camParams, capPath, windowName);
+
 	// Start of the main loop
 	//  -- grab a frame
 	//  -- update the angle of tracked objects
 	//  -- do a cascade detect on the current frame
 	//  -- add those newly detected objects to the list of tracked objects
-	while(isRunning)
+	int framesSinceFullDetect = 0;
+	while(isRunning && (args.pipeline == PIPELINE_OFF))
 	{
 		frameTicker.mark(); // mark start of new frame
 
-		// Write raw video before anything gets drawn on it
+		// Write raw video before anything gets drawn on it.
+		// The input still holds the frame just read, so
+		// hand that over rather than copying frame
 		if (rawOut)
-			rawOut->saveFrame(frame, depth);
+		{
+			MediaFramePtr rawFrame;
+			if (cap->getFrame(rawFrame, true))
+				rawOut->saveFrame(rawFrame);
+		}
 
 		// This code will load a classifier if none is loaded - this handles
 		// initializing the classifier the first time through the loop.
@@ -384,7 +917,20 @@ int main( int argc, const char** argv )
 		vector<Rect> detectRects;
 		vector<Rect> uncalibDetectRects;
 		if (detectState)
-			detectState->detector()->Detect(frame, filterUsingDepth ? depth : Mat(), detectRects, uncalibDetectRects);
+		{
+			// Between full frame searches, only look near
+			// existing tracks and in newly visible areas
+			if ((args.fullDetectInterval > 1) && ((framesSinceFullDetect++ % args.fullDetectInterval) != 0))
+			{
+				vector<DetectROI> rois;
+				buildDetectROIs(objectTrackingList, fllc, frame.size(), rois);
+				detectState->detector()->setROIs(rois);
+			}
+			else
+				detectState->detector()->clearROIs();
+			detectState->detector()->setWindowBudget(args.d12WindowBudget);
+			detectState->detector()->Detect(frame, args.filterUsingDepth ? depth : Mat(), detectRects, uncalibDetectRects);
+		}
 
 		// If args.captureAll is enabled, write each detected rectangle
 		// to their own output image file. Do it before anything else
@@ -418,33 +964,8 @@ int main( int argc, const char** argv )
 		vector<Rect>depthFilteredDetectRects;
 		vector<float> depths;
 		vector<ObjectType> objTypes;
-		const float depthRectScale = 0.2;
-		for(auto it = detectRects.cbegin(); it != detectRects.cend(); ++it)
-		{
-			//cout << "Detected object at: " << *it;
-			Rect depthRect = *it;
-
-			//when we use optical flow to adjust we need to recompute the depth based on the new locations.
-			//to do this shrink the bounding rectangle and take the minimum rect of the inside
-			shrinkRect(depthRect,depthRectScale);
-			Mat emptyMask(depth.rows,depth.cols,CV_8UC1,Scalar(255));
-			float objectDepth = minOfDepthMat(depth, emptyMask, depthRect, 10).first;
-
-			// If no depth data is available, calculate a fake
-			// depth value as if the object were at the perfect
-			// location for the detected rectangle size
-			if (objectDepth < 0)
-			{
-				objectDepth = ObjectType(1).expectedDepth(*it, frame.size(), camParams.fov.x);
-			}
-			//cout << " Depth: " << objectDepth << endl;
-			if (objectDepth > 0)
-			{
-				depthFilteredDetectRects.push_back(*it);
-				depths.push_back(objectDepth);
-				objTypes.push_back(ObjectType(1));
-			}
-		}
+		depthFilterDetects(detectRects, depth, frame.size(), camParams.fov.x,
+				depthFilteredDetectRects, depths, objTypes);
 
 		objectTrackingList.processDetect(depthFilteredDetectRects, depths, objTypes);
 
@@ -458,7 +979,7 @@ int main( int argc, const char** argv )
 		// Send data over the network
 		// If objdetction is enabled, send detection data
 		// always send goal detection info
-        sendZMQData(detectState ? netTableArraySize : 0, publisher, displayList, gd, cap->timeStamp());
+        sendZMQData(detectState ? netTableArraySize : 0, publisher, displayList, gd.dist_to_goal(), gd.angle_to_goal(), cap->timeStamp());
 
 		// Ground truth is a way of storing known locations of objects in a file.
 		// Check ground truth data on videos and images,
@@ -535,7 +1056,7 @@ int main( int argc, const char** argv )
 			// users can keep track of that toggle's mode
 			if (args.captureAll)
 				putText(frame, "A", Point(25,25), FONT_HERSHEY_PLAIN, 2, Scalar(0, 255, 255));
-			if (filterUsingDepth)
+			if (args.filterUsingDepth)
 				putText(frame, "D", Point(50,25), FONT_HERSHEY_PLAIN, 2, Scalar(0, 0, 255));
 
 			// Display current classifier infomation
@@ -606,7 +1127,7 @@ int main( int argc, const char** argv )
 				// Make sure last frame finished 
 				// writing, then write this one
 				processedOut->sync();
-				processedOut->saveFrame(frame, depth);
+				processedOut->saveFrame(frame, depth, cap->timeStamp());
 			}
 
 			// Process user input for this frame
@@ -654,7 +1175,7 @@ int main( int argc, const char** argv )
 			}
 			else if (c == 'd')
 			{
-				filterUsingDepth = !filterUsingDepth;
+				args.filterUsingDepth = !args.filterUsingDepth;
 			}
 			else if (c == 'A') // toggle capture-all
 			{
@@ -854,6 +1375,9 @@ int main( int argc, const char** argv )
 	cout << endl << "Goal detect ground truth : " << endl;
 	goalTruth.print();
 
+	closeVideoOut("Raw", rawOut);
+	closeVideoOut("Processed", processedOut);
+
 	if (detectState)
 		delete detectState;
   	if(cap)
@@ -861,7 +1385,7 @@ int main( int argc, const char** argv )
 	return 0;
 }
 
-void sendZMQData(size_t objectCount, zmq::socket_t& publisher, const vector<TrackedObjectDisplay>& displayList, const GoalDetector& gd, long long timestamp)
+void sendZMQData(size_t objectCount, zmq::socket_t& publisher, const vector<TrackedObjectDisplay>& displayList, float goalDist, float goalAngle, long long timestamp)
 {
 	// Only send objdetect data if the objdetection code is running
 	if (objectCount)
@@ -896,8 +1420,8 @@ void sendZMQData(size_t objectCount, zmq::socket_t& publisher, const vector<Trac
     //Creates immutable strings for 0MQ Output
     stringstream goalString;
     goalString << "G : ";
-    goalString << fixed << setprecision(4) << gd.dist_to_goal() << " ";
-    goalString << fixed << setprecision(2) << gd.angle_to_goal();
+    goalString << fixed << setprecision(4) << goalDist << " ";
+    goalString << fixed << setprecision(2) << goalAngle;
 
     cout << "G " << timestamp << " : " << goalString.str().length() << " : " << goalString.str() << endl;
     zmq::message_t grequest(goalString.str().length() - 1);
@@ -936,7 +1460,7 @@ string getDateTimeString(void)
 
 
 // Open video capture object. Figure out if input is camera, video, image, etc
-bool openMedia(const string &readFileName, bool gui, const string &xmlFilename, MediaIn *&cap, string &capPath, string &windowName)
+bool openMedia(const string &readFileName, bool gui, const string &xmlFilename, const Args &args, MediaIn *&cap, string &capPath, string &windowName)
 {
 	zvSettings = new ZvSettings(xmlFilename);
 
@@ -980,7 +1504,7 @@ bool openMedia(const string &readFileName, bool gui, const string &xmlFilename,
 		else if ((ext ==  ".svo") || (ext ==  ".SVO"))
 			cap = new ZedSVOIn(readFileName.c_str(), zvSettings);
 		else if ((ext == ".zms") || (ext == ".ZMS"))
-			cap = new ZMSIn(readFileName.c_str(), zvSettings);
+			cap = new ZMSIn(readFileName.c_str(), zvSettings, args.zmsThreads, args.zmsReadAhead);
 		else
 			cap = new VideoIn(readFileName.c_str(), zvSettings);
 